@@ -1,231 +1,2341 @@
-﻿#include <QString>
+﻿#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QString>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #include "audioplayer.h"
+#include "dspkernels.h"
+#include "tracksource.h"
+
+namespace
+{
+    // long enough to avoid a click, short enough to feel immediate
+    constexpr double skipFadeSeconds = 0.15;
+
+    // at most this many real seeks per second while the cursor slider is dragged
+    constexpr std::chrono::milliseconds scrubInterval{ 40 };
+
+    // how much plays at each scrub position with preview on
+    constexpr std::chrono::milliseconds previewLength{ 90 };
+
+    // ramps around a preview burst, so it starts and stops without a click
+    constexpr ma_uint64 previewFadeMs = 5;
+
+    // previous, next and the autoplay pick when that is neither
+    constexpr size_t maxWarmTracks = 3;
+
+    // frames per pass through the conversion scratch
+    constexpr ma_uint32 convertFrames = 1024;
+
+    // the narrowest device format that takes every sample of a file in this format unchanged
+    ma_format carrierFormat(ma_format native)
+    {
+        switch (native)
+        {
+        case ma_format_u8:
+        case ma_format_s16:
+            return ma_format_s16;
+        case ma_format_s24:
+            return ma_format_s24;
+        case ma_format_s32:
+            return ma_format_s32;
+        default:
+            return ma_format_f32;
+        }
+    }
+
+    // integer samples go out as integers, padded with zeros when the device is wider
+    bool carries(ma_format device, ma_format native)
+    {
+        switch (carrierFormat(native))
+        {
+        case ma_format_s16:
+            return device == ma_format_s16
+                || device == ma_format_s24
+                || device == ma_format_s32;
+        case ma_format_s24:
+            return device == ma_format_s24
+                || device == ma_format_s32;
+        default:
+            return device == carrierFormat(native);
+        }
+    }
+
+    std::filesystem::path filePath(const QString& path)
+    {
+#ifdef _WIN32
+        return std::filesystem::path(path.toStdWString());
+#else
+        return std::filesystem::path(path.toUtf8().constData());
+#endif
+    }
+
+    inline int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    // the device's buffer in engine frames, which is how long a written frame waits to be heard
+    ma_uint64 outputLatency(ma_engine& engine)
+    {
+        const ma_device* device = ma_engine_get_device(&engine);
+
+        if (!device
+            || device->playback.internalSampleRate == 0)
+        {
+            return 0;
+        }
+
+        const ma_uint64 frames = ma_uint64(device->playback.internalPeriodSizeInFrames) * device->playback.internalPeriods;
+
+        return frames * ma_engine_get_sample_rate(&engine) / device->playback.internalSampleRate;
+    }
+
+    // removable drives and network shares can stall for seconds, or spin down mid track
+    bool onSlowStorage(const QString& path)
+    {
+        const QStorageInfo si(QFileInfo(path).absolutePath());
+
+        if (!si.isValid())
+        {
+            return false;
+        }
+
+        const QByteArray fs = si.fileSystemType().toLower();
+
+        if (fs.startsWith("nfs")
+            || fs.startsWith("cifs")
+            || fs.startsWith("smb")
+            || fs.contains("sshfs")
+            || fs.contains("davfs"))
+        {
+            return true;
+        }
+
+#ifdef _WIN32
+        const std::wstring root = QDir::toNativeSeparators(si.rootPath()).toStdWString();
+        const UINT type = GetDriveTypeW(root.c_str());
+
+        return type == DRIVE_REMOVABLE
+            || type == DRIVE_REMOTE
+            || type == DRIVE_CDROM;
+#else
+        const QString root = si.rootPath();
+
+        return root.startsWith("/media/")
+            || root.startsWith("/run/media/")
+            || root.startsWith("/mnt/")
+            || root.startsWith("/Volumes/");
+#endif
+    }
+
+    // "uri symbol=value ...", a control whose value doesn't parse is left out
+    std::vector<PluginSpec> pluginSpecs(const QStringList& chain)
+    {
+        std::vector<PluginSpec> specs;
+
+        for (const QString& entry : chain)
+        {
+            const QStringList words = entry.split(' ', Qt::SkipEmptyParts);
+
+            if (words.isEmpty())
+            {
+                continue;
+            }
+
+            PluginSpec spec;
+
+            spec.uri = words[0].toStdString();
+
+            for (qsizetype i = 1; i < words.size(); ++i)
+            {
+                const qsizetype eq = words[i].indexOf('=');
+
+                bool ok = false;
+
+                const float value = eq > 0
+                    ? words[i].mid(eq + 1).toFloat(&ok)
+                    : 0.0f;
+
+                if (ok)
+                {
+                    spec.controls.emplace_back(words[i].left(eq).toStdString(), value);
+                }
+            }
+
+            specs.push_back(std::move(spec));
+        }
+
+        return specs;
+    }
+}
 
 AudioPlayer::~AudioPlayer()
 {
-    stop();
+    if (thread.joinable())
+    {
+        Command c;
+
+        c.type = Command::Quit;
+
+        post(c);
+
+        thread.join();
+    }
+}
+
+bool AudioPlayer::init(const OutputConfig& output)
+{
+    if (thread.joinable())
+    {
+        return true;
+    }
+
+    outputConfig = output;
+
+    std::binary_semaphore ready{ 0 };
+
+    thread = std::thread(
+        [this, &ready]
+        {
+            engineLoop(ready);
+        }
+    );
+
+    ready.acquire();
+
+    // the engine thread gives up right away when the device can't be opened
+    if (!engineInit)
+    {
+        thread.join();
+
+        return false;
+    }
+
+    return true;
+}
+
+void AudioPlayer::post(Command command)
+{
+    // a full queue only happens if the engine thread is stuck, let it catch up
+    while (!commands.push(command))
+    {
+        std::this_thread::yield();
+    }
+
+    wakeup.notify();
+}
+
+void AudioPlayer::play(const QString& path, float gain, unsigned int lengthMs)
+{
+    if (path.isEmpty())
+    {
+        return;
+    }
+
+    ++generation;
+
+    Command c;
+
+    c.type = Command::Play;
+    c.path = path;
+    c.value = gain;
+    c.lengthMs = lengthMs;
+    c.generation = generation;
+
+    post(c);
+}
+
+void AudioPlayer::queue(const QString& path, float gain, unsigned int lengthMs)
+{
+    Command c;
+
+    c.type = Command::Queue;
+    c.path = path;
+    c.value = gain;
+    c.lengthMs = lengthMs;
+
+    post(c);
+}
+
+void AudioPlayer::warm(const QStringList& paths, const QList<unsigned int>& lengthsMs)
+{
+    Command c;
+
+    c.type = Command::Warm;
+    c.paths = paths;
+    c.lengthsMs = lengthsMs;
+
+    post(c);
+}
+
+void AudioPlayer::stop()
+{
+    ++generation;
+
+    Command c;
+
+    c.type = Command::Stop;
+    c.generation = generation;
+
+    post(c);
+}
+
+void AudioPlayer::toggle()
+{
+    Command c;
+
+    c.type = Command::Toggle;
+
+    post(c);
+}
+
+void AudioPlayer::pause()
+{
+    Command c;
+
+    c.type = Command::Pause;
+
+    post(c);
+}
+
+void AudioPlayer::run()
+{
+    Command c;
+
+    c.type = Command::Run;
+
+    post(c);
+}
+
+void AudioPlayer::setVolume(float volume)
+{
+    Command c;
+
+    c.type = Command::Volume;
+    c.value = volume;
+
+    post(c);
+}
+
+void AudioPlayer::setCrossfade(double seconds, FadeCurve curve)
+{
+    Command c;
+
+    c.type = Command::Crossfade;
+    c.value = seconds;
+    c.arg = int(curve);
+
+    post(c);
+}
+
+void AudioPlayer::setSkipFade(bool enabled)
+{
+    Command c;
+
+    c.type = Command::SkipFade;
+    c.arg = enabled;
+
+    post(c);
+}
+
+void AudioPlayer::setReadAhead(int ms)
+{
+    Command c;
+
+    c.type = Command::ReadAhead;
+    c.arg = ms;
+
+    post(c);
+}
+
+void AudioPlayer::setPreload(PreloadMode mode)
+{
+    Command c;
+
+    c.type = Command::Preload;
+    c.arg = int(mode);
+
+    post(c);
+}
+
+void AudioPlayer::setResampler(ResamplerQuality quality)
+{
+    Command c;
+
+    c.type = Command::Resampler;
+    c.arg = int(quality);
+
+    post(c);
+}
+
+void AudioPlayer::setEqualizer(const EqSettings& eq)
+{
+    Command c;
+
+    c.type = Command::Equalizer;
+    c.eq = eq;
+
+    post(c);
+}
+
+void AudioPlayer::setConvolution(const QString& path)
+{
+    Command c;
+
+    c.type = Command::Convolution;
+    c.path = path;
+
+    post(c);
+}
+
+void AudioPlayer::setLimiter(bool enabled)
+{
+    Command c;
+
+    c.type = Command::Limiter;
+    c.arg = enabled;
+
+    post(c);
+}
+
+float AudioPlayer::limiterReduction() const
+{
+    return limiter.reduction();
+}
+
+void AudioPlayer::setPlugins(const QStringList& chain)
+{
+    Command c;
+
+    c.type = Command::Plugins;
+    c.paths = chain;
+
+    post(c);
+}
+
+void AudioPlayer::setPluginControl(int plugin, const QString& symbol, float value)
+{
+    Command c;
+
+    c.type = Command::PluginControl;
+    c.arg = plugin;
+    c.path = symbol;
+    c.value = value;
+
+    post(c);
+}
+
+QString AudioPlayer::pluginReport() const
+{
+    if (!PluginNode::available())
+    {
+        return "built without lv2 support";
+    }
+
+    std::lock_guard<std::mutex> guard(descriptionLock);
+
+    if (!pluginError.isEmpty())
+    {
+        return pluginError;
+    }
+
+    QStringList lines;
+
+    for (qsizetype i = 0; i < pluginNames.size(); ++i)
+    {
+        lines.append(QString("%1: %2 us a callback, at most %3 us").arg(
+            pluginNames[i]
+        ).arg(
+            plugins.lastCost(size_t(i)),
+            0,
+            'f',
+            0
+        ).arg(
+            plugins.peakCost(size_t(i)),
+            0,
+            'f',
+            0
+        ));
+    }
+
+    return lines.join('\n');
+}
+
+void AudioPlayer::seek(double seconds)
+{
+    Command c;
+
+    c.type = Command::Seek;
+    c.value = seconds;
+
+    post(c);
+}
+
+void AudioPlayer::scrub(double seconds)
+{
+    scrubTarget.store(seconds, std::memory_order_release);
+
+    // the engine reads the target when it gets to the seek, so a command already in flight covers this one
+    if (scrubPending.exchange(true, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    Command c;
+
+    c.type = Command::Scrub;
+
+    post(c);
+}
+
+void AudioPlayer::setScrubPreview(bool enabled)
+{
+    Command c;
+
+    c.type = Command::ScrubPreview;
+    c.arg = enabled;
+
+    post(c);
+}
+
+void AudioPlayer::setPositionRate(int hz)
+{
+    Command c;
+
+    c.type = Command::PositionRate;
+    c.arg = hz;
+
+    post(c);
+}
+
+void AudioPlayer::setCue(double fraction)
+{
+    Command c;
+
+    c.type = Command::Cue;
+    c.value = fraction;
+
+    post(c);
+}
+
+void AudioPlayer::setOutput(const OutputConfig& output)
+{
+    Command c;
+
+    c.type = Command::Output;
+    c.output = output;
+
+    post(c);
+}
+
+QString AudioPlayer::outputDescription() const
+{
+    std::lock_guard<std::mutex> guard(descriptionLock);
+
+    if (description.isEmpty()
+        || !nativeOpen.load(std::memory_order_relaxed))
+    {
+        return description;
+    }
+
+    return description + (bitPerfect()
+        ? ", bit-perfect"
+        : ", not bit-perfect");
+}
+
+bool AudioPlayer::bitPerfect() const
+{
+    return exactPath.load(std::memory_order_relaxed);
+}
+
+QStringList AudioPlayer::outputBackends()
+{
+    ma_backend backends[MA_BACKEND_COUNT];
+    size_t count = 0;
+
+    QStringList names;
+
+    if (ma_get_enabled_backends(
+        backends,
+        MA_BACKEND_COUNT,
+        &count) != MA_SUCCESS)
+    {
+        return names;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (backends[i] != ma_backend_custom)
+        {
+            names.append(ma_get_backend_name(backends[i]));
+        }
+    }
+
+    return names;
+}
+
+QStringList AudioPlayer::outputDevices(const QString& backendName)
+{
+    ma_backend backend = ma_backend_null;
+
+    const bool named = !backendName.isEmpty()
+        && ma_get_backend_from_name(backendName.toUtf8().constData(), &backend) == MA_SUCCESS;
+
+    QStringList names;
+
+    ma_context ctx;
+
+    if (ma_context_init(
+        named
+            ? &backend
+            : nullptr,
+        named
+            ? 1
+            : 0,
+        nullptr,
+        &ctx) != MA_SUCCESS)
+    {
+        return names;
+    }
+
+    ma_device_info* infos = nullptr;
+    ma_uint32 count = 0;
+
+    if (ma_context_get_devices(
+        &ctx,
+        &infos,
+        &count,
+        nullptr,
+        nullptr) == MA_SUCCESS)
+    {
+        for (ma_uint32 i = 0; i < count; ++i)
+        {
+            names.append(QString::fromUtf8(infos[i].name));
+        }
+    }
+
+    ma_context_uninit(&ctx);
+
+    return names;
+}
+
+double AudioPlayer::length() const
+{
+    const Snapshot s = state.load();
+
+    if (s.sampleRate == 0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(s.length) / s.sampleRate;
+}
+
+double AudioPlayer::clock() const
+{
+    const ClockPoint p = clockPoint.load();
+
+    if (p.rate == 0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(framesAt(p)) / p.rate;
+}
+
+double AudioPlayer::cursor() const
+{
+    return clock();
+}
+
+ma_uint64 AudioPlayer::clockFrames() const
+{
+    return framesAt(clockPoint.load());
+}
+
+ma_uint64 AudioPlayer::framesAt(const ClockPoint& p)
+{
+    const double pos = std::min(
+        p.base + double(nowNs() - p.at) * p.speed,
+        double(p.cap)
+    );
+
+    return pos > 0.0
+        ? ma_uint64(pos)
+        : 0;
+}
+
+bool AudioPlayer::_soundInit() const
+{
+    return state.load().soundInit;
+}
+
+bool AudioPlayer::playing() const
+{
+    const Snapshot s = state.load();
+
+    return s.soundInit
+        && s.playing;
+}
+
+void AudioPlayer::soundFinishedCallback(void* userData, ma_sound* /* sound */)
+{
+    auto* self = static_cast<AudioPlayer*>(userData);
+
+    if (self)
+    {
+        self->onSoundFinished();
+    }
+}
+
+void AudioPlayer::onSoundFinished()
+{
+    finishedFlag.store(true, std::memory_order_release);
+
+    wakeup.notify();
+}
+
+void AudioPlayer::dataCallback(ma_device* device, void* out, const void* /* in */, ma_uint32 frameCount)
+{
+    auto* self = static_cast<AudioPlayer*>(device->pUserData);
+
+    // raised before direct is looked at, leaveDirect() clears direct before it looks at this
+    self->directBusy.store(true);
+
+    if (self->direct.load())
+    {
+        self->readDirect(out, frameCount);
+    }
+    else
+    {
+        self->exactPath.store(false, std::memory_order_relaxed);
+
+        if (self->deviceFormat == ma_format_f32)
+        {
+            ma_engine_read_pcm_frames(
+                &self->engine,
+                out,
+                frameCount,
+                nullptr
+            );
+        }
+        else
+        {
+            self->readEngine(out, frameCount);
+        }
+    }
+
+    self->directBusy.store(false, std::memory_order_release);
+}
+
+void AudioPlayer::readDirect(void* out, ma_uint32 frameCount)
+{
+    const ma_uint32 channels = device.playback.channels;
+
+    ma_uint32 done = 0;
+
+    // the mixer would only have multiplied by one, the deck goes to the device as it is
+    while (done < frameCount
+        && ma_sound_is_playing(&sound))
+    {
+        const ma_uint32 n = std::min(frameCount - done, convertFrames);
+
+        ma_uint64 read = 0;
+
+        ma_data_source_read_pcm_frames(
+            deck.source(),
+            scratch.data(),
+            n,
+            &read
+        );
+
+        std::fill(scratch.begin() + read * channels, scratch.begin() + size_t(n) * channels, 0.0f);
+
+        // the graph isn't run, so the meters get the frames here
+        tap.push(scratch.data(), n);
+
+        toDevice(scratch.data(), out, done, n);
+
+        done += n;
+
+        if (read < n)
+        {
+            // the end of the chain, handled the way the sound handles it
+            ma_sound_stop(&sound);
+
+            onSoundFinished();
+
+            break;
+        }
+    }
+
+    if (done < frameCount)
+    {
+        ma_silence_pcm_frames(
+            ma_offset_pcm_frames_ptr(out, done, deviceFormat, channels),
+            frameCount - done,
+            deviceFormat,
+            channels
+        );
+    }
+
+    exactPath.store(deviceExact && deck.unaltered(), std::memory_order_relaxed);
+
+    // the engine isn't run, so its process callback doesn't come
+    stampClock(false);
+}
+
+void AudioPlayer::readEngine(void* out, ma_uint32 frameCount)
+{
+    for (ma_uint32 done = 0; done < frameCount;)
+    {
+        const ma_uint32 n = std::min(frameCount - done, convertFrames);
+
+        ma_engine_read_pcm_frames(
+            &engine,
+            scratch.data(),
+            n,
+            nullptr
+        );
+
+        toDevice(scratch.data(), out, done, n);
+
+        done += n;
+    }
+}
+
+void AudioPlayer::toDevice(const float* in, void* out, ma_uint32 offset, ma_uint32 frames)
+{
+    // miniaudio's own conversion scales by 32767 and truncates, these are exact for integer sources
+    const size_t channels = device.playback.channels;
+    const size_t samples = size_t(frames) * channels;
+    const size_t at = size_t(offset) * channels;
+
+    const DspKernels& k = dspKernels();
+
+    switch (deviceFormat)
+    {
+    case ma_format_s16:
+        k.f32ToS16(in, static_cast<int16_t*>(out) + at, samples);
+
+        break;
+    case ma_format_s24:
+        k.f32ToS24(in, static_cast<uint8_t*>(out) + at * 3, samples);
+
+        break;
+    case ma_format_s32:
+        k.f32ToS32(in, static_cast<int32_t*>(out) + at, samples);
+
+        break;
+    default:
+        std::memcpy(static_cast<float*>(out) + at, in, samples * sizeof(float));
+
+        break;
+    }
+}
+
+void AudioPlayer::processCallback(void* userData, float* /* frames */, ma_uint64 /* frameCount */)
+{
+    static_cast<AudioPlayer*>(userData)->stampClock(true);
+}
+
+void AudioPlayer::stampClock(bool throughGraph)
+{
+    const int64_t now = nowNs();
+    const ma_uint64 written = deck.lastCursor();
+    const uint64_t out = deck.framesOut();
+    const uint64_t read = out - clockOut;
+
+    clockOut = out;
+
+    ClockPoint p = clockLast;
+
+    const double nominal = double(clockRate) / 1e9;
+
+    // the device reopened at another rate, what was being heard carries over in seconds
+    if (p.rate != clockRate)
+    {
+        if (p.rate != 0)
+        {
+            const double scale = double(clockRate) / double(p.rate);
+
+            p.base *= scale;
+            p.cap = ma_uint64(double(p.cap) * scale);
+            p.speed = nominal;
+        }
+
+        p.rate = clockRate;
+    }
+
+    // where the last stamp says the speakers are now
+    double heard = std::min(
+        p.base + double(now - p.at) * p.speed,
+        double(p.cap)
+    );
+
+    const ma_uint64 jump = clockJump.exchange(noClockJump, std::memory_order_acq_rel);
+
+    if (jump != noClockJump)
+    {
+        heard = double(jump);
+
+        p.cap = jump;
+
+        clockWritten = jump;
+    }
+
+    if (read > 0)
+    {
+        const ma_uint64 behind = throughGraph
+            ? clockLatency
+                + limiter.latency()
+                + convolver.latency()
+                + equalizer.latency()
+                + plugins.latency()
+            : clockLatency;
+
+        const double latency = double(std::max<ma_uint64>(behind, read));
+        const double target = double(written) - double(behind);
+
+        if (written != clockWritten + read
+            || std::abs(target - heard) > 2.0 * latency)
+        {
+            // a seek or a splice, start over from what this callback wrote
+            p.base = target;
+            p.speed = nominal;
+        }
+        else
+        {
+            // callbacks come in bursts on some backends, so steer toward each estimate
+            // over a couple of buffers instead of jumping, and never backwards
+            p.base = heard;
+            p.speed = nominal * std::clamp(1.0 + (target - heard) / (2.0 * latency), 0.5, 1.5);
+        }
+
+        p.cap = written;
+    }
+    else
+    {
+        // paused or stopped, what is in the device buffer still plays out up to the cap
+        p.base = heard;
+        p.speed = nominal;
+    }
+
+    clockWritten = written;
+
+    p.at = now;
+
+    clockLast = p;
+    clockPoint.store(p);
+}
+
+void AudioPlayer::engineLoop(std::binary_semaphore& ready)
+{
+    deck.setWakeup(&wakeup);
+
+    engineInit = openOutput(outputConfig, ma_format_f32, 0, 0);
+
+    // a device that went away or a backend that isn't running, play through whatever works
+    if (!engineInit)
+    {
+        outputConfig = {};
+
+        engineInit = openOutput(outputConfig, ma_format_f32, 0, 0);
+    }
+
+    publish();
+
+    ready.release();
+
+    if (!engineInit)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        Command c;
+
+        while (commands.pop(c))
+        {
+            if (c.type == Command::Quit)
+            {
+                stopSound();
+                dropWarm();
+                closeOutput();
+
+                engineInit = false;
+
+                return;
+            }
+
+            execute(c);
+        }
+
+        serviceScrub();
+
+        deck.collect();
+        convolver.collect();
+        plugins.collect();
+
+        const Snapshot snapshot = publish();
+
+        report(snapshot);
+
+        const std::chrono::milliseconds wait = nextWake(snapshot);
+
+        if (wait.count() < 0)
+        {
+            wakeup.wait();
+        }
+        else
+        {
+            wakeup.wait(wait);
+        }
+    }
+}
+
+bool AudioPlayer::openOutput(const OutputConfig& config, ma_format format, ma_uint32 channels, ma_uint32 sampleRate)
+{
+    ma_backend backend = ma_backend_null;
+
+    const bool named = !config.backend.isEmpty()
+        && ma_get_backend_from_name(config.backend.toUtf8().constData(), &backend) == MA_SUCCESS;
+
+    if (ma_context_init(
+        named
+            ? &backend
+            : nullptr,
+        named
+            ? 1
+            : 0,
+        nullptr,
+        &context) != MA_SUCCESS)
+    {
+        return false;
+    }
+
+    contextInit = true;
+
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+
+    deviceConfig.playback.format = format;
+    deviceConfig.playback.channels = channels;
+    deviceConfig.sampleRate = sampleRate;
+    deviceConfig.dataCallback = &AudioPlayer::dataCallback;
+    deviceConfig.pUserData = this;
+
+    // as the engine sets up its own device, it writes every frame and clips by itself
+    deviceConfig.noPreSilencedOutputBuffer = MA_TRUE;
+    deviceConfig.noClip = MA_TRUE;
+
+    configureResampler(deviceConfig.resampling, resampler);
+
+    // shared, the system mixer may resample and convert behind miniaudio's back
+    deviceConfig.playback.shareMode = config.bitPerfect
+        ? ma_share_mode_exclusive
+        : ma_share_mode_shared;
+
+    switch (config.latency)
+    {
+    case LatencyProfile::Low:
+        deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+        deviceConfig.periodSizeInMilliseconds = 5;
+        deviceConfig.periods = 2;
+
+        break;
+    case LatencyProfile::Long:
+        // a few wakeups a second, the reader's ring is deeper than this anyway
+        deviceConfig.performanceProfile = ma_performance_profile_conservative;
+        deviceConfig.periodSizeInMilliseconds = 100;
+        deviceConfig.periods = 3;
+
+        break;
+    default:
+
+        break;
+    }
+
+    ma_device_id id{};
+
+    if (!config.device.isEmpty())
+    {
+        ma_device_info* infos = nullptr;
+        ma_uint32 count = 0;
+
+        if (ma_context_get_devices(
+            &context,
+            &infos,
+            &count,
+            nullptr,
+            nullptr) == MA_SUCCESS)
+        {
+            // ids don't survive a reboot on every backend, names do, a missing device means the default
+            for (ma_uint32 i = 0; i < count; ++i)
+            {
+                if (QString::fromUtf8(infos[i].name) == config.device)
+                {
+                    id = infos[i].id;
+
+                    deviceConfig.playback.pDeviceID = &id;
+
+                    break;
+                }
+            }
+        }
+    }
+
+    ma_result result = ma_device_init(
+        &context,
+        &deviceConfig,
+        &device
+    );
+
+    // pulseaudio and jack turn exclusive mode down outright, others when the device is busy
+    if (result != MA_SUCCESS
+        && deviceConfig.playback.shareMode == ma_share_mode_exclusive)
+    {
+        deviceConfig.playback.shareMode = ma_share_mode_shared;
+
+        result = ma_device_init(
+            &context,
+            &deviceConfig,
+            &device
+        );
+    }
+
+    if (result != MA_SUCCESS)
+    {
+        closeOutput();
+
+        return false;
+    }
+
+    deviceInit = true;
+    deviceFormat = device.playback.format;
+
+    // nothing between the callback and the backend
+    deviceExact = device.playback.internalFormat == device.playback.format
+        && device.playback.internalChannels == device.playback.channels
+        && device.playback.internalSampleRate == device.sampleRate;
+
+    scratch.assign(size_t(convertFrames) * device.playback.channels, 0.0f);
+
+    ma_engine_config engineConfig = ma_engine_config_init();
+
+    // the clock is stamped at the end of every device callback,
+    // started by hand so the latency and rate are in place before the first one
+    engineConfig.pDevice = &device;
+    engineConfig.onProcess = &AudioPlayer::processCallback;
+    engineConfig.pProcessUserData = this;
+    engineConfig.noAutoStart = MA_TRUE;
+
+    if (ma_engine_init(
+        &engineConfig,
+        &engine) != MA_SUCCESS)
+    {
+        closeOutput();
+
+        return false;
+    }
+
+    engineOpen = true;
+
+    if (!deck.init(
+        ma_engine_get_channels(&engine),
+        ma_engine_get_sample_rate(&engine))
+        || !tap.init(&engine, outputLatency(engine))
+        || !limiter.init(&engine, tap.node())
+        || !output.init(&engine, limiter.node())
+        || !convolver.init(&engine, output.node())
+        || !equalizer.init(&engine, convolver.node())
+        || !plugins.init(&engine, equalizer.node()))
+    {
+        closeOutput();
+
+        return false;
+    }
+
+    clockRate = ma_engine_get_sample_rate(&engine);
+    clockLatency = outputLatency(engine);
+
+    // instantiated again for this rate, a plugin gone since has taken the chain with it
+    publishPlugins(QString());
+
+    deck.setCrossfade(
+        ma_uint64(crossfadeSeconds * clockRate),
+        crossfadeCurve
+    );
+
+    nativeOpen.store(config.bitPerfect, std::memory_order_relaxed);
+
+    if (ma_engine_start(&engine) != MA_SUCCESS)
+    {
+        closeOutput();
+
+        return false;
+    }
+
+    const ma_uint32 period = device.playback.internalPeriodSizeInFrames;
+    const ma_uint32 periods = device.playback.internalPeriods;
+    const ma_uint32 rate = device.playback.internalSampleRate;
+
+    const QString opened = QString("%1, %2, %3%4, %5 x %6 frames at %7 Hz, %8 ms, %9 ms limiter lookahead").arg(
+        QString::fromUtf8(ma_get_backend_name(context.backend)),
+        QString::fromUtf8(device.playback.name),
+        QString::fromUtf8(ma_get_format_name(device.playback.internalFormat)),
+        device.playback.shareMode == ma_share_mode_exclusive
+            ? QString(" exclusive")
+            : QString()
+    ).arg(period).arg(periods).arg(rate).arg(
+        rate == 0
+            ? 0.0
+            : double(period) * periods * 1000.0 / rate,
+        0,
+        'f',
+        1
+    ).arg(
+        double(limiter.latency()) * 1000.0 / double(clockRate),
+        0,
+        'f',
+        1
+    );
+
+    {
+        std::lock_guard<std::mutex> guard(descriptionLock);
+
+        description = opened;
+    }
+
+    return true;
+}
+
+void AudioPlayer::closeOutput()
+{
+    // the device thread goes first, nothing may be reading the graph while it comes apart
+    if (deviceInit)
+    {
+        ma_device_stop(&device);
+    }
+
+    direct.store(false);
+    nativeOpen.store(false, std::memory_order_relaxed);
+
+    deviceExact = false;
+
+    plugins.uninit();
+    equalizer.uninit();
+    convolver.uninit();
+    output.uninit();
+    limiter.uninit();
+    tap.uninit();
+
+    if (engineOpen)
+    {
+        ma_engine_uninit(&engine);
+
+        engineOpen = false;
+    }
+
+    if (deviceInit)
+    {
+        ma_device_uninit(&device);
+
+        deviceInit = false;
+    }
+
+    if (contextInit)
+    {
+        ma_context_uninit(&context);
+
+        contextInit = false;
+    }
+
+    std::lock_guard<std::mutex> guard(descriptionLock);
+
+    description.clear();
+}
+
+void AudioPlayer::reopen(const OutputConfig& config)
+{
+    // the deck and every open track are in the engine's format, so the new device is asked for the
+    // same one and whatever it differs by is converted by miniaudio, nothing has to be reopened
+    const ma_uint32 channels = ma_engine_get_channels(&engine);
+    const ma_uint32 sampleRate = ma_engine_get_sample_rate(&engine);
+
+    endScrub();
+
+    // turned on mid track, the device is opened at the track's own rate and the track again with it
+    if (config.bitPerfect
+        && !nativeOpen.load(std::memory_order_relaxed)
+        && soundInit
+        && !playingPath.isEmpty())
+    {
+        replay(config);
+
+        return;
+    }
+
+    const bool resume = soundInit
+        && ma_sound_is_playing(&sound);
+
+    // what is still in the old device buffer goes with it, so carry on from what was heard
+    const ma_uint64 heard = clockFrames();
+
+    // the format follows the track in bit perfect mode and is left to the mixer otherwise
+    const ma_format format = deviceFormat;
+
+    leaveDirect();
+
+    if (soundInit)
+    {
+        ma_sound_stop(&sound);
+        ma_sound_uninit(&sound);
+    }
+
+    closeOutput();
+
+    if (openOutput(
+        config,
+        config.bitPerfect
+            ? format
+            : ma_format_f32,
+        channels,
+        sampleRate))
+    {
+        outputConfig = config;
+    }
+    else
+    {
+        engineInit = openOutput(
+            outputConfig,
+            outputConfig.bitPerfect
+                ? format
+                : ma_format_f32,
+            channels,
+            sampleRate
+        );
+    }
+
+    if (!engineInit
+        || !soundInit)
+    {
+        return;
+    }
+
+    if (!initSound())
+    {
+        soundInit = false;
+
+        deck.reset(nullptr);
+
+        queuedPath.clear();
+        playingPath.clear();
+
+        return;
+    }
+
+    deck.seek(heard);
+
+    clockJump.store(heard, std::memory_order_release);
+
+    if (resume)
+    {
+        ma_sound_start(&sound);
+    }
+
+    updateDirect();
+}
+
+void AudioPlayer::replay(const OutputConfig& config)
+{
+    const bool resume = ma_sound_is_playing(&sound);
+    const double seconds = double(clockFrames()) / ma_engine_get_sample_rate(&engine);
+
+    const QString path = playingPath;
+    const float gain = playingGain;
+
+    stopSound();
+
+    // read ahead at the old rate
+    dropWarm();
+
+    closeOutput();
+
+    ma_format format = ma_format_f32;
+    ma_uint32 channels = 0;
+    ma_uint32 sampleRate = 0;
+
+    if (TrackSource::probe(filePath(path), format, channels, sampleRate))
+    {
+        format = carrierFormat(format);
+    }
+
+    if (openOutput(config, format, channels, sampleRate))
+    {
+        outputConfig = config;
+    }
+    else
+    {
+        engineInit = openOutput(outputConfig, ma_format_f32, 0, 0);
+    }
+
+    if (!engineInit)
+    {
+        return;
+    }
+
+    TrackSource* track = openTrack(path);
+
+    if (!track)
+    {
+        return;
+    }
+
+    track->setGain(gain);
+
+    deck.reset(track);
+
+    if (!initSound())
+    {
+        deck.reset(nullptr);
+
+        return;
+    }
+
+    // in before the first read, so nothing plays from the start
+    const ma_uint64 frame = ma_uint64(seconds * ma_engine_get_sample_rate(&engine));
+
+    deck.seek(frame);
+
+    clockJump.store(frame, std::memory_order_release);
+
+    chainAdvances = deck.advances();
+    reportedAdvances = 0;
+
+    playingPath = path;
+    playingGain = gain;
+
+    soundInit = true;
+
+    if (resume)
+    {
+        ma_sound_start(&sound);
+    }
+
+    updateDirect();
+}
+
+bool AudioPlayer::fitsOutput(ma_format format, ma_uint32 channels, ma_uint32 sampleRate) const
+{
+    return nativeOpen.load(std::memory_order_relaxed)
+        && channels == ma_engine_get_channels(&engine)
+        && sampleRate == ma_engine_get_sample_rate(&engine)
+        && carries(deviceFormat, format);
+}
+
+void AudioPlayer::matchOutput(const QString& path)
+{
+    ma_format format = ma_format_unknown;
+    ma_uint32 channels = 0;
+    ma_uint32 sampleRate = 0;
+
+    // a file that can't be probed won't open either, that is left to the caller
+    if (!TrackSource::probe(filePath(path), format, channels, sampleRate)
+        || fitsOutput(format, channels, sampleRate))
+    {
+        return;
+    }
+
+    stopSound();
+    dropWarm();
+    closeOutput();
+
+    engineInit = openOutput(outputConfig, carrierFormat(format), channels, sampleRate)
+        || openOutput(outputConfig, ma_format_f32, 0, 0);
+}
+
+void AudioPlayer::updateDirect()
+{
+    // the mixer is only needed for the volume, the plugins, the eq, the convolution and the scrub preview's fades
+    if (outputConfig.bitPerfect
+        && soundInit
+        && volume == 1.0f
+        && !equalizer.enabled()
+        && !convolver.enabled()
+        && !plugins.enabled()
+        && !scrubbing)
+    {
+        direct.store(true);
+    }
+    else
+    {
+        leaveDirect();
+    }
+}
+
+void AudioPlayer::leaveDirect()
+{
+    if (!direct.exchange(false))
+    {
+        return;
+    }
+
+    // a callback that saw direct set is still in the deck, the sound can't change under it
+    while (directBusy.load())
+    {
+        std::this_thread::yield();
+    }
+}
+
+void AudioPlayer::loadPlugins(const QStringList& chain)
+{
+    std::string error;
+
+    publishPlugins(plugins.load(pluginSpecs(chain), error)
+        ? QString()
+        : QString::fromStdString(error));
+
+    // the direct path skips the graph, plugins included
+    updateDirect();
+}
+
+void AudioPlayer::publishPlugins(const QString& error)
+{
+    QStringList names;
+
+    for (const std::string& name : plugins.names())
+    {
+        names.append(QString::fromStdString(name));
+    }
+
+    std::lock_guard<std::mutex> guard(descriptionLock);
+
+    pluginNames = names;
+    pluginError = error;
+}
+
+void AudioPlayer::execute(const Command& c)
+{
+    // the device couldn't be reopened, only another output can help
+    if (!engineInit
+        && c.type != Command::Output)
+    {
+        return;
+    }
+
+    switch (c.type)
+    {
+    case Command::Play:
+        startTrack(c.path, c.generation, float(c.value), c.lengthMs);
+
+        break;
+    case Command::Queue:
+        queueTrack(c.path, float(c.value), c.lengthMs);
+
+        break;
+    case Command::Warm:
+        warmUp(c.paths, c.lengthsMs);
+
+        break;
+    case Command::Stop:
+        stopSound();
+
+        // nothing is adjacent any more, and open files would keep a drive from being ejected
+        dropWarm();
+
+        chainGeneration = c.generation;
+
+        break;
+    case Command::Toggle:
+        if (soundInit)
+        {
+            if (ma_sound_is_playing(&sound))
+            {
+                ma_sound_stop(&sound);
+            }
+            else
+            {
+                ma_sound_start(&sound);
+            }
+        }
+
+        break;
+    case Command::Pause:
+        if (soundInit)
+        {
+            ma_sound_stop(&sound);
+        }
+
+        break;
+    case Command::Run:
+        if (soundInit)
+        {
+            ma_sound_start(&sound);
+        }
+
+        break;
+    case Command::Seek:
+        // a scrub target still waiting is older than this
+        scrubPending.store(false, std::memory_order_release);
+
+        seekTo(c.value);
+
+        endScrub();
+
+        break;
+    case Command::Scrub:
+        if (!scrubbing)
+        {
+            beginScrub();
+        }
+
+        break;
+    case Command::ScrubPreview:
+        scrubPreview = c.arg != 0;
+
+        break;
+    case Command::Volume:
+        volume = float(c.value);
+
+        output.setVolume(volume);
+
+        updateDirect();
+
+        break;
+    case Command::Crossfade:
+        crossfadeSeconds = c.value;
+        crossfadeCurve = FadeCurve(c.arg);
+
+        deck.setCrossfade(
+            ma_uint64(crossfadeSeconds * ma_engine_get_sample_rate(&engine)),
+            crossfadeCurve
+        );
+
+        break;
+    case Command::SkipFade:
+        skipFade = c.arg != 0;
+
+        break;
+    case Command::ReadAhead:
+        readAheadMs = c.arg;
+
+        // reopened with the new depth on the next warm
+        dropWarm();
+
+        break;
+    case Command::Preload:
+        preload = PreloadMode(c.arg);
+
+        dropWarm();
+
+        break;
+    case Command::Resampler:
+        if (resampler != ResamplerQuality(c.arg))
+        {
+            resampler = ResamplerQuality(c.arg);
+
+            // warm tracks were decoded with the old filter, the playing one keeps it until it ends
+            dropWarm();
+
+            // a device that converts the engine's rate only picks a new filter up when it is opened again
+            if (deviceInit
+                && device.playback.internalSampleRate != device.sampleRate)
+            {
+                reopen(outputConfig);
+            }
+        }
+
+        break;
+    case Command::Equalizer:
+        equalizer.set(c.eq);
+
+        // the direct path skips the graph, so it can't carry the eq
+        updateDirect();
+
+        break;
+    case Command::Convolution:
+        // a file that can't be read leaves the response in use
+        if (filePath(c.path) != convolver.path())
+        {
+            convolver.load(filePath(c.path));
+
+            updateDirect();
+        }
+
+        break;
+    case Command::Limiter:
+        // the direct path never goes through it, bit perfect stays as it is
+        limiter.setEnabled(c.arg != 0);
+
+        break;
+    case Command::Plugins:
+        loadPlugins(c.paths);
+
+        break;
+    case Command::PluginControl:
+        plugins.setControl(size_t(c.arg), c.path.toStdString(), float(c.value));
+
+        break;
+    case Command::PositionRate:
+        positionRate = c.arg;
+
+        // a fresh position right away, the window may have just come back
+        reportedCursor = ~ma_uint64(0);
+
+        break;
+    case Command::Cue:
+        cueFraction = c.value;
+
+        break;
+    case Command::Output:
+        reopen(c.output);
+
+        break;
+    default:
+
+        break;
+    }
+}
+
+AudioPlayer::Snapshot AudioPlayer::publish()
+{
+    Snapshot s;
+
+    s.sampleRate = engineInit
+        ? ma_engine_get_sample_rate(&engine)
+        : 0;
+
+    s.generation = chainGeneration;
+    s.soundInit = soundInit;
+
+    if (soundInit)
+    {
+        // what is heard, not what was decoded, so the cue and the slider match the speakers
+        s.cursor = clockFrames();
+
+        ma_sound_get_length_in_pcm_frames(
+            &sound,
+            &s.length
+        );
+
+        s.playing = ma_sound_is_playing(&sound);
+        s.advances = deck.advances() - chainAdvances;
+    }
+
+    state.store(s);
+
+    return s;
+}
+
+void AudioPlayer::report(const Snapshot& s)
+{
+    if (s.advances != reportedAdvances)
+    {
+        reportedAdvances = s.advances;
+
+        takeQueued();
+
+        cueFired = false;
+
+        emitForChain(&AudioPlayer::trackAdvanced, playingPath);
+    }
+
+    if (finishedFlag.exchange(false, std::memory_order_acq_rel))
+    {
+        emitForChain(&AudioPlayer::trackFinished);
+    }
+
+    if (s.playing != reportedPlaying)
+    {
+        reportedPlaying = s.playing;
+
+        Q_EMIT playingChanged(s.playing);
+    }
+
+    if (!cueFired
+        && cueFraction > 0.0
+        && s.length > 0
+        && double(s.cursor) >= double(s.length) * cueFraction)
+    {
+        cueFired = true;
+
+        emitForChain(&AudioPlayer::cueReached);
+    }
 
-    if (engineInit)
+    if (positionRate > 0
+        && s.soundInit
+        && s.sampleRate != 0
+        && (s.cursor != reportedCursor || s.length != reportedLength))
     {
-        ma_engine_uninit(&engine);
+        reportedCursor = s.cursor;
+        reportedLength = s.length;
 
-        engineInit = false;
+        Q_EMIT positionChanged(
+            double(s.cursor) / s.sampleRate,
+            double(s.length) / s.sampleRate
+        );
     }
 }
 
-bool AudioPlayer::init()
+void AudioPlayer::emitForChain(void (AudioPlayer::*signal)())
+{
+    const uint32_t gen = chainGeneration;
+
+    // runs on the gui thread, where a newer play or stop makes the signal stale
+    QMetaObject::invokeMethod(
+        this,
+        [this, gen, signal]
+        {
+            if (gen == generation)
+            {
+                Q_EMIT (this->*signal)();
+            }
+        },
+        Qt::QueuedConnection
+    );
+}
+
+void AudioPlayer::emitForChain(void (AudioPlayer::*signal)(const QString&), const QString& path)
 {
-    if (engineInit)
+    const uint32_t gen = chainGeneration;
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, gen, signal, path]
+        {
+            if (gen == generation)
+            {
+                Q_EMIT (this->*signal)(path);
+            }
+        },
+        Qt::QueuedConnection
+    );
+}
+
+std::chrono::milliseconds AudioPlayer::nextWake(const Snapshot& s) const
+{
+    const long long scrubMs = scrubWake();
+
+    // paused or stopped, commands and the end callback are the only things that can change anything
+    if (!s.playing
+        || s.sampleRate == 0)
     {
-        return true;
+        return std::chrono::milliseconds(scrubMs);
     }
 
-    if (ma_engine_init(
-        nullptr,
-        &engine
-    ) != MA_SUCCESS)
+    long long ms = positionRate > 0
+        ? 1000 / positionRate
+        : -1;
+
+    // with position signals off the cue still needs one wake at the right time
+    if (!cueFired
+        && cueFraction > 0.0
+        && s.length > 0)
     {
-        return false;
+        const double cue = double(s.length) * cueFraction;
+
+        if (double(s.cursor) < cue)
+        {
+            const long long toCue = (long long)((cue - double(s.cursor)) * 1000.0 / s.sampleRate) + 1;
+
+            ms = ms < 0
+                ? toCue
+                : std::min(ms, toCue);
+        }
     }
 
-    engineInit = true;
+    if (scrubMs >= 0)
+    {
+        ms = ms < 0
+            ? scrubMs
+            : std::min(ms, scrubMs);
+    }
 
-    return true;
+    return std::chrono::milliseconds(ms);
 }
 
-bool AudioPlayer::play(const QString& path)
+long long AudioPlayer::scrubWake() const
 {
-    if (!engineInit
-        || path.isEmpty())
+    if (!scrubbing)
     {
-        return false;
+        return -1;
     }
 
-    stop();
+    using namespace std::chrono;
 
-    finishedFlag.store(false, std::memory_order_release);
+    const steady_clock::time_point now = steady_clock::now();
 
-#ifdef _WIN32
-    if (ma_sound_init_from_file_w(
-        &engine,
-        reinterpret_cast<const wchar_t*>(path.utf16()),
-        MA_SOUND_FLAG_STREAM,
-        nullptr,
-        nullptr,
-        &sound) != MA_SUCCESS)
+    long long ms = -1;
+
+    // a target held back by the rate limit
+    if (scrubPending.load(std::memory_order_acquire))
     {
-        return false;
+        ms = std::max(0ll, (long long)ceil<milliseconds>(scrubSeekAt + scrubInterval - now).count());
     }
-#else
-    const QByteArray utf8Path = path.toUtf8();
 
-    if (ma_sound_init_from_file(
-        &engine,
-        utf8Path.constData(),
-        MA_SOUND_FLAG_STREAM,
-        nullptr,
-        nullptr,
-        &sound) != MA_SUCCESS)
+    if (previewOn)
     {
-        return false;
+        const long long toEnd = std::max(0ll, (long long)ceil<milliseconds>(previewEnd - now).count());
+
+        ms = ms < 0
+            ? toEnd
+            : std::min(ms, toEnd);
     }
-#endif
 
-    ma_sound_set_end_callback(
-        &sound,
-        &AudioPlayer::soundFinishedCallback,
-        this
-    );
+    return ms;
+}
 
-    ma_sound_start(&sound);
+void AudioPlayer::seekTo(double seconds)
+{
+    if (!soundInit)
+    {
+        return;
+    }
 
-    soundInit = true;
+    const ma_uint64 frame = static_cast<ma_uint64>(seconds * ma_engine_get_sample_rate(&engine));
 
-    return true;
+    // taken by the deck's next read, whether that comes through the sound or straight from the device
+    deck.seek(frame);
+
+    // a paused sound isn't read, the clock would otherwise sit at the old position
+    clockJump.store(frame, std::memory_order_release);
+
+    finishedFlag.store(false, std::memory_order_release);
 }
 
-void AudioPlayer::soundFinishedCallback(void* userData, ma_sound* /* sound */)
+void AudioPlayer::beginScrub()
 {
-    auto* self = static_cast<AudioPlayer*>(userData);
+    scrubbing = true;
+    scrubResume = soundInit
+        && ma_sound_is_playing(&sound);
+    previewOn = false;
 
-    if (self)
+    // the preview bursts are faded by the sound
+    updateDirect();
+
+    // the first target of a drag goes through right away
+    scrubSeekAt = {};
+
+    if (!soundInit
+        || !scrubPreview)
     {
-        self->onSoundFinished();
+        return;
+    }
+
+    // quiet between bursts, a paused track runs silently so the bursts have something to play
+    if (scrubResume)
+    {
+        ma_sound_set_fade_in_milliseconds(&sound, -1.0f, 0.0f, previewFadeMs);
+    }
+    else
+    {
+        ma_sound_set_fade_in_pcm_frames(&sound, 0.0f, 0.0f, 0);
+        ma_sound_start(&sound);
     }
 }
 
-void AudioPlayer::onSoundFinished()
+void AudioPlayer::serviceScrub()
 {
-    finishedFlag.store(true, std::memory_order_release);
+    if (!scrubbing)
+    {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (previewOn
+        && now >= previewEnd)
+    {
+        ma_sound_set_fade_in_milliseconds(&sound, -1.0f, 0.0f, previewFadeMs);
+
+        previewOn = false;
+    }
+
+    if (!scrubPending.load(std::memory_order_acquire)
+        || now < scrubSeekAt + scrubInterval)
+    {
+        return;
+    }
+
+    // cleared before the target is read, so a newer target posts again instead of getting lost
+    scrubPending.store(false, std::memory_order_release);
+
+    seekTo(scrubTarget.load(std::memory_order_acquire));
+
+    scrubSeekAt = now;
+
+    if (soundInit
+        && scrubPreview)
+    {
+        ma_sound_set_fade_in_milliseconds(&sound, -1.0f, 1.0f, previewFadeMs);
+
+        previewOn = true;
+        previewEnd = now + previewLength;
+    }
 }
 
-void AudioPlayer::stop()
+void AudioPlayer::endScrub()
 {
-    if (soundInit)
+    if (!scrubbing)
     {
-        ma_sound_stop(&sound);
-        ma_sound_uninit(&sound);
+        return;
+    }
 
-        soundInit = false;
+    scrubbing = false;
+    previewOn = false;
 
-        finishedFlag.store(false, std::memory_order_release);
+    updateDirect();
+
+    if (!soundInit
+        || !scrubPreview)
+    {
+        return;
+    }
+
+    if (scrubResume)
+    {
+        ma_sound_set_fade_in_milliseconds(&sound, -1.0f, 1.0f, previewFadeMs);
+    }
+    else
+    {
+        ma_sound_stop(&sound);
+        ma_sound_set_fade_in_pcm_frames(&sound, 1.0f, 1.0f, 0);
     }
 }
 
-void AudioPlayer::toggle()
+void AudioPlayer::startTrack(const QString& path, uint32_t gen, float gain, unsigned int lengthMs)
 {
-    if (soundInit)
+    // a new track mid drag, put the sound back the way the drag found it first
+    endScrub();
+
+    // before anything is opened at the old rate
+    if (outputConfig.bitPerfect)
     {
-        if (ma_sound_is_playing(&sound))
-        {
-            ma_sound_stop(&sound);
-        }
-        else
+        matchOutput(path);
+
+        if (!engineInit)
         {
-            ma_sound_start(&sound);
+            return;
         }
     }
+
+    TrackSource* track = takeWarm(path);
+
+    if (!track)
+    {
+        track = openTrack(path, lengthMs);
+    }
+
+    chainGeneration = gen;
+
+    if (!track)
+    {
+        stopSound();
+
+        return;
+    }
+
+    // a warm track was opened before anyone knew its gain
+    track->setGain(gain);
+
+    playingPath = path;
+    playingGain = gain;
+
+    // while something is audible, switch on the audio thread and fade the old track out
+    if (skipFade
+        && soundInit
+        && ma_sound_is_playing(&sound))
+    {
+        deck.cut(
+            track,
+            ma_uint64(skipFadeSeconds * ma_engine_get_sample_rate(&engine))
+        );
+
+        queuedPath.clear();
+
+        chainAdvances = deck.advances();
+        reportedAdvances = 0;
+        cueFired = false;
+
+        finishedFlag.store(false, std::memory_order_release);
+
+        clockJump.store(0, std::memory_order_release);
+
+        return;
+    }
+
+    stopSound();
+
+    finishedFlag.store(false, std::memory_order_release);
+
+    deck.reset(track);
+
+    if (!initSound())
+    {
+        deck.reset(nullptr);
+
+        playingPath.clear();
+
+        return;
+    }
+
+    clockJump.store(0, std::memory_order_release);
+
+    ma_sound_start(&sound);
+
+    chainAdvances = deck.advances();
+    reportedAdvances = 0;
+    cueFired = false;
+
+    soundInit = true;
+
+    updateDirect();
 }
 
-void AudioPlayer::pause()
+void AudioPlayer::queueTrack(const QString& path, float gain, unsigned int lengthMs)
 {
-    if (soundInit)
+    if (!soundInit)
     {
-        ma_sound_stop(&sound);
+        return;
+    }
+
+    // the audio thread may have taken the queued track since it was set, it's the one playing then
+    takeQueued();
+
+    if (path == queuedPath)
+    {
+        return;
+    }
+
+    queuedPath = path;
+    queuedGain = gain;
+    queuedAt = deck.advances();
+
+    if (path.isEmpty())
+    {
+        deck.queue(nullptr);
+
+        return;
+    }
+
+    // another rate or a wider format needs the device reopened, so the chain ends here
+    // and the gui starts the track on its own once it hears the last one finished
+    if (outputConfig.bitPerfect)
+    {
+        ma_format format = ma_format_unknown;
+        ma_uint32 channels = 0;
+        ma_uint32 sampleRate = 0;
+
+        if (TrackSource::probe(filePath(path), format, channels, sampleRate)
+            && !fitsOutput(format, channels, sampleRate))
+        {
+            deck.queue(nullptr);
+
+            return;
+        }
+    }
+
+    TrackSource* track = openTrack(path, lengthMs);
+
+    if (track)
+    {
+        track->setGain(gain);
+    }
+
+    deck.queue(track);
+
+    if (!track)
+    {
+        queuedPath.clear();
     }
 }
 
-void AudioPlayer::run()
+void AudioPlayer::takeQueued()
 {
-    if (soundInit)
+    if (queuedPath.isEmpty()
+        || deck.advances() == queuedAt)
     {
-        ma_sound_start(&sound);
+        return;
     }
+
+    playingPath = queuedPath;
+    playingGain = queuedGain;
+
+    queuedPath.clear();
 }
 
-void AudioPlayer::setVolume(float volume)
+void AudioPlayer::warmUp(const QStringList& paths, const QList<unsigned int>& lengthsMs)
 {
-    if (engineInit)
+    std::erase_if(
+        warmTracks,
+        [&](const WarmTrack& w)
+        {
+            if (paths.contains(w.path))
+            {
+                return false;
+            }
+
+            delete w.track;
+
+            return true;
+        }
+    );
+
+    for (qsizetype i = 0; i < paths.size(); ++i)
     {
-        ma_engine_set_volume(
-            &engine,
-            volume
+        if (warmTracks.size() >= maxWarmTracks)
+        {
+            break;
+        }
+
+        const QString& path = paths[i];
+
+        const bool open = std::any_of(
+            warmTracks.begin(),
+            warmTracks.end(),
+            [&](const WarmTrack& w)
+            {
+                return w.path == path;
+            }
         );
+
+        if (open)
+        {
+            continue;
+        }
+
+        // the reader fills its ring in the background, like any other open track
+        const unsigned int lengthMs = i < lengthsMs.size()
+            ? lengthsMs[i]
+            : 0;
+
+        if (TrackSource* track = openTrack(path, lengthMs))
+        {
+            warmTracks.push_back({ path, track });
+        }
     }
 }
 
-void AudioPlayer::seek(double seconds)
+TrackSource* AudioPlayer::takeWarm(const QString& path)
 {
-    if (soundInit)
+    for (auto it = warmTracks.begin(); it != warmTracks.end(); ++it)
     {
-        const ma_uint32 sampleRate = ma_engine_get_sample_rate(&engine);
+        if (it->path == path)
+        {
+            TrackSource* track = it->track;
 
-        ma_sound_seek_to_pcm_frame(
-            &sound,
-            static_cast<ma_uint64>(seconds * sampleRate)
-        );
+            warmTracks.erase(it);
 
-        finishedFlag.store(false, std::memory_order_release);
+            return track;
+        }
     }
+
+    return nullptr;
 }
 
-double AudioPlayer::length() const
+void AudioPlayer::dropWarm()
 {
-    if (!soundInit)
+    for (const WarmTrack& w : warmTracks)
     {
-        return 0.0;
+        delete w.track;
     }
 
-    ma_uint64 frame = 0;
+    warmTracks.clear();
+}
 
-    ma_sound_get_length_in_pcm_frames(
-        &sound,
-        &frame
-    );
+void AudioPlayer::stopSound()
+{
+    if (soundInit)
+    {
+        leaveDirect();
+
+        ma_sound_stop(&sound);
+        ma_sound_uninit(&sound);
+
+        scrubbing = false;
+        previewOn = false;
+
+        // the sound no longer reads from the deck, so its tracks can go
+        deck.reset(nullptr);
+
+        queuedPath.clear();
+        playingPath.clear();
+
+        soundInit = false;
+
+        reportedAdvances = 0;
 
-    return static_cast<double>(frame) / ma_engine_get_sample_rate(&engine);
+        finishedFlag.store(false, std::memory_order_release);
+    }
 }
 
-double AudioPlayer::cursor() const
+bool AudioPlayer::initSound()
 {
-    if (!soundInit)
+    if (ma_sound_init_from_data_source(
+        &engine,
+        deck.source(),
+        0,
+        nullptr,
+        &sound) != MA_SUCCESS)
     {
-        return 0.0;
+        return false;
     }
 
-    ma_uint64 frame = 0;
+    ma_node_attach_output_bus(
+        &sound,
+        0,
+        plugins.node(),
+        0
+    );
 
-    ma_sound_get_cursor_in_pcm_frames(
+    ma_sound_set_end_callback(
         &sound,
-        &frame
+        &AudioPlayer::soundFinishedCallback,
+        this
     );
 
-    return static_cast<double>(frame) / ma_engine_get_sample_rate(&engine);
+    return true;
 }
 
-bool AudioPlayer::_soundInit() const
+TrackSource* AudioPlayer::openTrack(const QString& path, unsigned int lengthMs)
 {
-    return soundInit;
-}
+    const std::filesystem::path p = filePath(path);
 
-bool AudioPlayer::playing() const
-{
-    return soundInit
-        && ma_sound_is_playing(&sound);
-}
+    TrackSource::Options options;
 
-bool AudioPlayer::finished()
-{
-    return finishedFlag.exchange(false, std::memory_order_acquire);
+    options.channels = ma_engine_get_channels(&engine);
+    options.sampleRate = ma_engine_get_sample_rate(&engine);
+    options.readAheadFrames = ma_uint64(readAheadMs) * options.sampleRate / 1000;
+    options.preload = preload == PreloadMode::Always
+        || (preload == PreloadMode::Removable && onSlowStorage(path));
+    options.resampler = resampler;
+    options.lengthMs = lengthMs;
+
+    return TrackSource::open(
+        p,
+        options,
+        reader
+    );
 }
 
-QString AudioPlayer::formattedCursor() const
+QString AudioPlayer::formatCursor(double cursor, double length)
 {
-    const int len = int(length() + 0.5);
+    const int len = int(length + 0.5);
     const int lh = len / 3600;
     const int lm = (len % 3600) / 60;
-    const int cur = int(cursor() + 0.5);
+    const int cur = int(cursor + 0.5);
     const int h = cur / 3600;
     const int m = (cur % 3600) / 60;
     const int s = cur % 60;
@@ -267,9 +2377,9 @@ QString AudioPlayer::formattedCursor() const
     );
 }
 
-QString AudioPlayer::formattedLength() const
+QString AudioPlayer::formatLength(double length)
 {
-    const int len = int(length() + 0.5);
+    const int len = int(length + 0.5);
     const int h = len / 3600;
     const int m = (len % 3600) / 60;
     const int s = len % 60;
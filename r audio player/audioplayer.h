@@ -1,48 +1,474 @@
 #pragma once
 
+#include <QObject>
 #include <QString>
+#include <QStringList>
 
+#include "deck.h"
+#include "convolvernode.h"
+#include "eqnode.h"
+#include "limiternode.h"
 #include "miniaudio.h"
+#include "mpscqueue.h"
+#include "outputnode.h"
+#include "pluginnode.h"
+#include "resampler.h"
+#include "seqlock.h"
+#include "tapnode.h"
+#include "trackreader.h"
+#include "wakeup.h"
 
 #include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-class AudioPlayer
+class TrackSource;
+
+enum class PreloadMode
+{
+    Never,
+    Removable,
+    Always
+};
+
+// device buffer sizes, small for a quick response to play and seek, large to let the cpu sleep
+enum class LatencyProfile
 {
+    Low,
+    Standard,
+    Long
+};
+
+// where the engine plays to, empty names leave the choice to miniaudio and the system
+struct OutputConfig
+{
+    // miniaudio's backend name, e.g. "ALSA", "PulseAudio" (which also serves pipewire) or "JACK"
+    QString backend;
+    QString device;
+
+    LatencyProfile latency = LatencyProfile::Standard;
+
+    // the device follows each track's rate, channels and sample format, exclusively where the backend allows,
+    // and at unity volume the decoded frames skip the mixer
+    bool bitPerfect{};
+};
+
+// the engine, the sound and every file open live on one engine thread
+// the gui posts commands and reads back a snapshot, so it never waits on a disk or a decoder
+// changes come back as queued signals, and the engine thread only wakes when there is something to report
+class AudioPlayer : public QObject
+{
+    Q_OBJECT
 public:
-    ~AudioPlayer();
+    ~AudioPlayer() override;
+
+    // falls back to the default backend and device when the configured ones can't be opened
+    bool init(const OutputConfig& output = {});
+
+    // reopens the device, playback carries on from what was last heard
+    void setOutput(const OutputConfig& output);
+
+    // backend, device, format, buffer and latency as opened, which may differ from what was asked for,
+    // and in bit perfect mode whether it currently is
+    QString outputDescription() const;
+
+    // the last device callback handed over the file's samples unchanged, as far as miniaudio can see
+    bool bitPerfect() const;
 
-    bool init();
-    bool play(const QString& path);
+    // the backends built in and usable here, by miniaudio's name
+    static QStringList outputBackends();
+
+    // playback device names, an empty backend lists the one miniaudio would pick
+    static QStringList outputDevices(const QString& backend);
+
+    // gain is linear and stays with the track, so a queued track spliced in keeps its own
+    // lengthMs is the library's, 0 when unknown, a long mp3 then plays without a frame walk first
+    void play(const QString& path, float gain = 1.0f, unsigned int lengthMs = 0);
+
+    // opens the track to follow the current one without a gap, an empty path clears it
+    void queue(const QString& path, float gain = 1.0f, unsigned int lengthMs = 0);
+
+    // keeps these tracks open and read ahead, so playing one of them starts right away
+    // lengthsMs goes with paths, entry for entry, and may be left short
+    void warm(const QStringList& paths, const QList<unsigned int>& lengthsMs = {});
 
     void stop();
     void toggle();
     void pause();
     void run();
     void setVolume(float volume);
+    void setCrossfade(double seconds, FadeCurve curve);
+    void setSkipFade(bool enabled);
+    void setReadAhead(int ms);
+    void setPreload(PreloadMode mode);
+
+    // for tracks opened from now on, and the device when it converts the engine's rate
+    void setResampler(ResamplerQuality quality);
+
+    // off by default, a slider can call this on every step
+    void setEqualizer(const EqSettings& eq);
+
+    // an impulse response run over everything played, for headphone or room correction
+    // any file the decoders read, an empty path turns it off
+    void setConvolution(const QString& path);
+
+    // on by default, holds everything played under -1 dbtp, its lookahead is in the clock either way
+    void setLimiter(bool enabled);
+
+    // db the limiter took off during the last device period, any thread
+    float limiterReduction() const;
+
+    // lv2 plugins run ahead of the eq, each "uri symbol=value ...", an empty list turns them off
+    // the same plugins in the same order only get their controls set, one that can't be hosted keeps the chain in use
+    void setPlugins(const QStringList& chain);
+
+    // automates a control input of the plugin at that position by its lv2 symbol, without reloading anything
+    void setPluginControl(int plugin, const QString& symbol, float value);
+
+    // each plugin running with what it costs per device callback, or why the last chain didn't load, any thread
+    QString pluginReport() const;
+
+    // what goes to the device, for the meters, read from any thread without blocking the audio
+    const TapNode& analysisTap() const { return tap; }
+
     void seek(double seconds);
 
+    // seeks for a slider drag, only the latest target counts and the decoder is repositioned
+    // a limited number of times per second, the drag ends with a plain seek
+    void scrub(double seconds);
+
+    // short bursts of sound at each scrub position instead of playing on from it
+    void setScrubPreview(bool enabled);
+
+    // position signals per second while playing, 0 turns them off
+    void setPositionRate(int hz);
+
+    // fraction of a track at which cueReached fires once, 0 turns it off
+    void setCue(double fraction);
+
     double length() const;
+
+    // seconds into the current track that are coming out of the speakers right now
+    // interpolated between device callbacks with the output latency taken off,
+    // lock free from any thread, everything that shows or counts playback time reads this
+    double clock() const;
+
+    // same as clock()
     double cursor() const;
 
     bool _soundInit() const;
     bool playing() const;
-    bool finished();
 
-    QString formattedCursor() const;
-    QString formattedLength() const;
+    static QString formatCursor(double cursor, double length);
+    static QString formatLength(double length);
+Q_SIGNALS:
+    void positionChanged(double cursor, double length);
+    void playingChanged(bool playing);
+    void cueReached();
+
+    // the audio thread moved on to the queued track, the one it spliced in
+    // the gui may have queued another since, so it goes by the path rather than by what it queued last
+    void trackAdvanced(const QString& path);
+
+    // nothing was queued, playback stopped at the end of the track
+    void trackFinished();
 private:
+    struct Command
+    {
+        enum Type : uint8_t
+        {
+            None,
+            Play,
+            Queue,
+            Warm,
+            Stop,
+            Toggle,
+            Pause,
+            Run,
+            Seek,
+            Scrub,
+            ScrubPreview,
+            Volume,
+            Crossfade,
+            SkipFade,
+            ReadAhead,
+            Preload,
+            Resampler,
+            Equalizer,
+            Convolution,
+            Limiter,
+            Plugins,
+            PluginControl,
+            PositionRate,
+            Cue,
+            Output,
+            Quit
+        };
+
+        Type type = None;
+        QString path;
+        QStringList paths;
+        unsigned int lengthMs = 0;
+        QList<unsigned int> lengthsMs;
+        double value = 0.0;
+        int arg = 0;
+        uint32_t generation = 0;
+        OutputConfig output;
+        EqSettings eq;
+    };
+
+    // what the gui gets to see, published by the engine thread
+    struct Snapshot
+    {
+        ma_uint64 cursor = 0;
+        ma_uint64 length = 0;
+        ma_uint32 sampleRate = 0;
+
+        // bumped by every play, so stale finish and advance signals can be told apart
+        uint32_t generation = 0;
+        uint32_t advances = 0;
+
+        bool soundInit = false;
+        bool playing = false;
+    };
+
+    // stamped by the audio thread at the end of every device callback
+    struct ClockPoint
+    {
+        // frames into the track at the stamp, negative while a new position is still in the device buffer
+        double base = 0.0;
+
+        // frames per nanosecond, steered a little around the sample rate to follow the device
+        double speed = 0.0;
+
+        int64_t at = 0;
+
+        // the last frame handed to the device, the clock never runs past it
+        ma_uint64 cap = 0;
+
+        // the engine rate the frames above count in, published with them so a reader never pairs
+        // frames from before a reopen with the rate after it
+        ma_uint32 rate = 0;
+    };
+
+    // gui side
+    MpscQueue<Command, 256> commands;
+    Wakeup wakeup;
+    SeqLock<Snapshot> state;
+    SeqLock<ClockPoint> clockPoint;
+
+    uint32_t generation = 0;
+
+    std::thread thread;
+
+    std::atomic<bool> finishedFlag{ false };
+
+    // latest drag target, the pending flag keeps at most one scrub command in flight
+    std::atomic<double> scrubTarget{ 0.0 };
+    std::atomic<bool> scrubPending{ false };
+
+    // a seek or a new track, picked up by the next device callback so the clock doesn't wait for audio
+    static constexpr ma_uint64 noClockJump = ~ma_uint64(0);
+
+    std::atomic<ma_uint64> clockJump{ noClockJump };
+
+    // written by the engine thread while the device is stopped, read by the audio thread,
+    // readers on other threads go by the rate in the clock point
+    ma_uint32 clockRate = 0;
+
+    // audio thread only
+    ClockPoint clockLast;
+    ma_uint64 clockWritten = 0;
+    uint64_t clockOut = 0;
+
+    // device buffer in engine frames, what was written last is heard this much later
+    // the graph holds it back by the limiter's lookahead, the convolver's block, the eq's pipeline and what the plugins report on top, the direct path doesn't
+    ma_uint64 clockLatency = 0;
+
+    // the audio thread reads the deck itself instead of running the mixer
+    // cleared and waited out through directBusy by the engine thread before the sound changes
+    std::atomic<bool> direct{ false };
+    std::atomic<bool> directBusy{ false };
+    std::atomic<bool> exactPath{ false };
+
+    // opened for bit perfect playback
+    std::atomic<bool> nativeOpen{ false };
+
+    // set while the device is stopped
+    ma_format deviceFormat = ma_format_f32;
+    bool deviceExact{};
+
+    // f32 frames on their way to an integer device
+    std::vector<float> scratch;
+
+    void post(Command command);
+
+    // written by the engine thread whenever the device opens
+    mutable std::mutex descriptionLock;
+    QString description;
+
+    // under the same lock, the plugins running and why the last chain didn't load
+    QStringList pluginNames;
+    QString pluginError;
+
+    // engine thread side
     bool engineInit{};
+    bool contextInit{};
+    bool deviceInit{};
+    bool engineOpen{};
     bool soundInit{};
+    bool skipFade{};
+
+    int readAheadMs = 1500;
 
+    float volume = 1.0f;
+
+    // in seconds, the deck counts in frames and a device reopened at another rate needs it again
+    double crossfadeSeconds = 0.0;
+    FadeCurve crossfadeCurve = FadeCurve::EqualPower;
+
+    PreloadMode preload = PreloadMode::Removable;
+
+    ResamplerQuality resampler = ResamplerQuality::Sinc;
+
+    OutputConfig outputConfig;
+
+    // the device is ours rather than the engine's, so its backend and buffer can be chosen
+    ma_context context{};
+    ma_device device{};
     ma_engine engine{};
     ma_sound sound{};
 
-    std::atomic<bool> finishedFlag{ false };
+    // the last node before the endpoint, the direct path pushes into it itself
+    TapNode tap;
+
+    // between the output node and the tap
+    LimiterNode limiter;
+
+    // between the convolver and the limiter, carries the volume
+    OutputNode output;
+
+    // between the sound and the eq
+    PluginNode plugins;
+
+    // between the plugins and the convolver
+    EqNode equalizer;
+
+    // between the eq and the output node
+    ConvolverNode convolver;
+
+    // declared before the deck, its tracks unregister from the reader on the way out
+    TrackReader reader;
+
+    Deck deck;
+
+    QString queuedPath;
+    float queuedGain = 1.0f;
+
+    // what the deck is playing, to open it again when bit perfect is turned on mid track
+    QString playingPath;
+    float playingGain = 1.0f;
+
+    struct WarmTrack
+    {
+        QString path;
+        TrackSource* track = nullptr;
+    };
+
+    // opened and read ahead for the tracks next to the current one
+    std::vector<WarmTrack> warmTracks;
+
+    uint32_t queuedAt = 0;
+    uint32_t chainGeneration = 0;
+    uint32_t chainAdvances = 0;
+    uint32_t reportedAdvances = 0;
+
+    int positionRate = 0;
+
+    double cueFraction = 0.0;
+
+    ma_uint64 reportedCursor = 0;
+    ma_uint64 reportedLength = 0;
+
+    bool cueFired{};
+    bool reportedPlaying{};
+
+    bool scrubbing{};
+    bool scrubPreview = true;
+
+    // playing when the drag started
+    bool scrubResume{};
+
+    // a preview burst is audible until previewEnd
+    bool previewOn{};
+
+    std::chrono::steady_clock::time_point scrubSeekAt{};
+    std::chrono::steady_clock::time_point previewEnd{};
 
     static void soundFinishedCallback(
         void* userData,
         ma_sound* sound
     );
 
+    static void dataCallback(
+        ma_device* device,
+        void* out,
+        const void* in,
+        ma_uint32 frameCount
+    );
+
+    static void processCallback(
+        void* userData,
+        float* frames,
+        ma_uint64 frameCount
+    );
+
+    void readDirect(void* out, ma_uint32 frameCount);
+    void readEngine(void* out, ma_uint32 frameCount);
+    void toDevice(const float* in, void* out, ma_uint32 offset, ma_uint32 frames);
+
+    void stampClock(bool throughGraph);
+    ma_uint64 clockFrames() const;
+    static ma_uint64 framesAt(const ClockPoint& p);
+
     void onSoundFinished();
+
+    void engineLoop(std::binary_semaphore& ready);
+
+    // 0 channels and rate take the device's own
+    bool openOutput(const OutputConfig& config, ma_format format, ma_uint32 channels, ma_uint32 sampleRate);
+    void closeOutput();
+    void reopen(const OutputConfig& config);
+    void replay(const OutputConfig& config);
+    bool fitsOutput(ma_format format, ma_uint32 channels, ma_uint32 sampleRate) const;
+    void matchOutput(const QString& path);
+    void updateDirect();
+    void leaveDirect();
+    void loadPlugins(const QStringList& chain);
+    void publishPlugins(const QString& error);
+    void execute(const Command& command);
+    Snapshot publish();
+    void report(const Snapshot& s);
+    void emitForChain(void (AudioPlayer::*signal)());
+    void emitForChain(void (AudioPlayer::*signal)(const QString&), const QString& path);
+
+    // negative means sleep until woken
+    std::chrono::milliseconds nextWake(const Snapshot& s) const;
+    long long scrubWake() const;
+    void seekTo(double seconds);
+    void beginScrub();
+    void serviceScrub();
+    void endScrub();
+    void startTrack(const QString& path, uint32_t generation, float gain, unsigned int lengthMs);
+    void queueTrack(const QString& path, float gain, unsigned int lengthMs);
+    void takeQueued();
+    void warmUp(const QStringList& paths, const QList<unsigned int>& lengthsMs);
+    TrackSource* takeWarm(const QString& path);
+    void dropWarm();
+    void stopSound();
+    bool initSound();
+
+    TrackSource* openTrack(const QString& path, unsigned int lengthMs = 0);
 };
\ No newline at end of file
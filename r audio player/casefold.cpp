@@ -0,0 +1,368 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "casefold.h"
+
+namespace
+{
+    // simple case folding (CaseFolding.txt C + S) combined with diacritic stripping
+    // (canonical decomposition minus combining marks) for latin, greek and cyrillic
+    // absolute rules map every code point in the range to value, 0 drops it
+    struct FoldRule
+    {
+        char32_t first;
+        char32_t last;
+        unsigned char stride;
+        bool absolute;
+        std::int32_t value;
+    };
+
+    constexpr FoldRule foldRules[] =
+    {
+        { 0x0041, 0x005A, 1, false, 32 }, { 0x00B5, 0x00B5, 1, false, 775 }, { 0x00C0, 0x00C5, 1, true, 97 },
+        { 0x00C6, 0x00C6, 1, false, 32 }, { 0x00C7, 0x00C9, 2, false, -100 }, { 0x00C8, 0x00CA, 2, true, 101 },
+        { 0x00CB, 0x00CB, 1, false, -102 }, { 0x00CC, 0x00CF, 1, true, 105 }, { 0x00D0, 0x00D0, 1, false, 32 },
+        { 0x00D1, 0x00D2, 1, false, -99 }, { 0x00D3, 0x00D6, 1, true, 111 }, { 0x00D8, 0x00D8, 1, false, -105 },
+        { 0x00D9, 0x00DC, 1, true, 117 }, { 0x00DD, 0x00DD, 1, false, -100 }, { 0x00DE, 0x00DE, 1, false, 32 },
+        { 0x00E0, 0x00E5, 1, true, 97 }, { 0x00E7, 0x00E9, 2, false, -132 }, { 0x00E8, 0x00EA, 2, true, 101 },
+        { 0x00EB, 0x00EB, 1, false, -134 }, { 0x00EC, 0x00EF, 1, true, 105 }, { 0x00F1, 0x00F2, 1, false, -131 },
+        { 0x00F3, 0x00F6, 1, true, 111 }, { 0x00F8, 0x00F8, 1, false, -137 }, { 0x00F9, 0x00FC, 1, true, 117 },
+        { 0x00FD, 0x00FF, 2, true, 121 }, { 0x0100, 0x0105, 1, true, 97 }, { 0x0106, 0x010D, 1, true, 99 },
+        { 0x010E, 0x0111, 1, true, 100 }, { 0x0112, 0x011B, 1, true, 101 }, { 0x011C, 0x0123, 1, true, 103 },
+        { 0x0124, 0x0127, 1, true, 104 }, { 0x0128, 0x0131, 1, true, 105 }, { 0x0132, 0x0132, 1, false, 1 },
+        { 0x0134, 0x0135, 1, true, 106 }, { 0x0136, 0x0137, 1, true, 107 }, { 0x0139, 0x013E, 1, true, 108 },
+        { 0x013F, 0x013F, 1, false, 1 }, { 0x0141, 0x0143, 2, false, -213 }, { 0x0142, 0x0144, 2, false, -214 },
+        { 0x0145, 0x0148, 1, true, 110 }, { 0x014A, 0x014A, 1, false, 1 }, { 0x014C, 0x0151, 1, true, 111 },
+        { 0x0152, 0x0152, 1, false, 1 }, { 0x0154, 0x0159, 1, true, 114 }, { 0x015A, 0x0161, 1, true, 115 },
+        { 0x0162, 0x0167, 1, true, 116 }, { 0x0168, 0x0173, 1, true, 117 }, { 0x0174, 0x0176, 2, false, -253 },
+        { 0x0175, 0x0177, 2, false, -254 }, { 0x0178, 0x0179, 1, false, -255 }, { 0x017A, 0x017E, 1, true, 122 },
+        { 0x017F, 0x017F, 1, false, -268 }, { 0x0180, 0x0180, 1, false, -286 }, { 0x0181, 0x0181, 1, false, 210 },
+        { 0x0182, 0x0184, 2, false, 1 }, { 0x0186, 0x0186, 1, false, 206 }, { 0x0187, 0x0187, 1, false, 1 },
+        { 0x0189, 0x018A, 1, false, 205 }, { 0x018B, 0x018B, 1, false, 1 }, { 0x018E, 0x018E, 1, false, 79 },
+        { 0x018F, 0x018F, 1, false, 202 }, { 0x0190, 0x0190, 1, false, 203 }, { 0x0191, 0x0191, 1, false, 1 },
+        { 0x0193, 0x0193, 1, false, 205 }, { 0x0194, 0x0194, 1, false, 207 }, { 0x0196, 0x0196, 1, false, 211 },
+        { 0x0197, 0x0197, 1, false, -302 }, { 0x0198, 0x0198, 1, false, 1 }, { 0x019C, 0x019C, 1, false, 211 },
+        { 0x019D, 0x019D, 1, false, 213 }, { 0x019F, 0x019F, 1, false, 214 }, { 0x01A0, 0x01A1, 1, true, 111 },
+        { 0x01A2, 0x01A4, 2, false, 1 }, { 0x01A6, 0x01A6, 1, false, 218 }, { 0x01A7, 0x01A7, 1, false, 1 },
+        { 0x01A9, 0x01A9, 1, false, 218 }, { 0x01AC, 0x01AC, 1, false, 1 }, { 0x01AE, 0x01AE, 1, false, 218 },
+        { 0x01AF, 0x01B0, 1, true, 117 }, { 0x01B1, 0x01B2, 1, false, 217 }, { 0x01B3, 0x01B3, 1, false, 1 },
+        { 0x01B5, 0x01B6, 1, true, 122 }, { 0x01B7, 0x01B7, 1, false, 219 }, { 0x01B8, 0x01B8, 1, false, 1 },
+        { 0x01BC, 0x01BC, 1, false, 1 }, { 0x01C4, 0x01C5, 1, true, 454 }, { 0x01C7, 0x01C8, 1, true, 457 },
+        { 0x01CA, 0x01CB, 1, true, 460 }, { 0x01CD, 0x01CE, 1, true, 97 }, { 0x01CF, 0x01D0, 1, true, 105 },
+        { 0x01D1, 0x01D2, 1, true, 111 }, { 0x01D3, 0x01DC, 1, true, 117 }, { 0x01DE, 0x01E1, 1, true, 97 },
+        { 0x01E2, 0x01E3, 1, true, 230 }, { 0x01E4, 0x01E4, 1, false, 1 }, { 0x01E6, 0x01E7, 1, true, 103 },
+        { 0x01E8, 0x01E9, 1, true, 107 }, { 0x01EA, 0x01ED, 1, true, 111 }, { 0x01EE, 0x01EF, 1, true, 658 },
+        { 0x01F0, 0x01F0, 1, false, -390 }, { 0x01F1, 0x01F2, 1, true, 499 }, { 0x01F4, 0x01F5, 1, true, 103 },
+        { 0x01F6, 0x01F6, 1, false, -97 }, { 0x01F7, 0x01F7, 1, false, -56 }, { 0x01F8, 0x01F9, 1, true, 110 },
+        { 0x01FA, 0x01FB, 1, true, 97 }, { 0x01FC, 0x01FD, 1, true, 230 }, { 0x01FE, 0x01FF, 1, true, 111 },
+        { 0x0200, 0x0203, 1, true, 97 }, { 0x0204, 0x0207, 1, true, 101 }, { 0x0208, 0x020B, 1, true, 105 },
+        { 0x020C, 0x020F, 1, true, 111 }, { 0x0210, 0x0213, 1, true, 114 }, { 0x0214, 0x0217, 1, true, 117 },
+        { 0x0218, 0x0219, 1, true, 115 }, { 0x021A, 0x021B, 1, true, 116 }, { 0x021C, 0x021C, 1, false, 1 },
+        { 0x021E, 0x021F, 1, true, 104 }, { 0x0220, 0x0220, 1, false, -130 }, { 0x0222, 0x0222, 1, false, 1 },
+        { 0x0224, 0x0225, 1, true, 122 }, { 0x0226, 0x0227, 1, true, 97 }, { 0x0228, 0x0229, 1, true, 101 },
+        { 0x022A, 0x0231, 1, true, 111 }, { 0x0232, 0x0233, 1, true, 121 }, { 0x023A, 0x023A, 1, false, 10795 },
+        { 0x023B, 0x023B, 1, false, 1 }, { 0x023D, 0x023D, 1, false, -163 }, { 0x023E, 0x023E, 1, false, 10792 },
+        { 0x0241, 0x0241, 1, false, 1 }, { 0x0243, 0x0243, 1, false, -481 }, { 0x0244, 0x0244, 1, false, 69 },
+        { 0x0245, 0x0245, 1, false, 71 }, { 0x0246, 0x024E, 2, false, 1 }, { 0x0268, 0x0268, 1, false, -511 },
+        { 0x0300, 0x034E, 1, true, 0 }, { 0x0350, 0x036F, 1, true, 0 }, { 0x0370, 0x0372, 2, false, 1 },
+        { 0x0376, 0x0376, 1, false, 1 }, { 0x037F, 0x037F, 1, false, 116 }, { 0x0385, 0x0385, 1, false, -733 },
+        { 0x0386, 0x0386, 1, false, 43 }, { 0x0388, 0x0388, 1, false, 45 }, { 0x0389, 0x0389, 1, false, 46 },
+        { 0x038A, 0x038A, 1, false, 47 }, { 0x038C, 0x038C, 1, false, 51 }, { 0x038E, 0x038E, 1, false, 55 },
+        { 0x038F, 0x038F, 1, false, 58 }, { 0x0390, 0x0390, 1, false, 41 }, { 0x0391, 0x03A1, 1, false, 32 },
+        { 0x03A3, 0x03A9, 1, false, 32 }, { 0x03AA, 0x03AA, 1, false, 15 }, { 0x03AB, 0x03AB, 1, false, 26 },
+        { 0x03AC, 0x03AC, 1, false, 5 }, { 0x03AD, 0x03AD, 1, false, 8 }, { 0x03AE, 0x03AE, 1, false, 9 },
+        { 0x03AF, 0x03AF, 1, false, 10 }, { 0x03B0, 0x03B0, 1, false, 21 }, { 0x03C2, 0x03C2, 1, false, 1 },
+        { 0x03CA, 0x03CA, 1, false, -17 }, { 0x03CB, 0x03CD, 2, true, 965 }, { 0x03CC, 0x03CC, 1, false, -13 },
+        { 0x03CE, 0x03CE, 1, false, -5 }, { 0x03CF, 0x03CF, 1, false, 8 }, { 0x03D0, 0x03D0, 1, false, -30 },
+        { 0x03D1, 0x03D1, 1, false, -25 }, { 0x03D3, 0x03D4, 1, true, 978 }, { 0x03D5, 0x03D5, 1, false, -15 },
+        { 0x03D6, 0x03D6, 1, false, -22 }, { 0x03D8, 0x03EE, 2, false, 1 }, { 0x03F0, 0x03F0, 1, false, -54 },
+        { 0x03F1, 0x03F1, 1, false, -48 }, { 0x03F4, 0x03F4, 1, false, -60 }, { 0x03F5, 0x03F5, 1, false, -64 },
+        { 0x03F7, 0x03F7, 1, false, 1 }, { 0x03F9, 0x03F9, 1, false, -7 }, { 0x03FA, 0x03FA, 1, false, 1 },
+        { 0x03FD, 0x03FF, 1, false, -130 }, { 0x0400, 0x0401, 1, true, 1077 }, { 0x0402, 0x040A, 2, false, 80 },
+        { 0x0403, 0x0403, 1, false, 48 }, { 0x0405, 0x0405, 1, false, 80 }, { 0x0407, 0x0407, 1, false, 79 },
+        { 0x0409, 0x040B, 2, false, 80 }, { 0x040C, 0x040C, 1, false, 46 }, { 0x040D, 0x040D, 1, false, 43 },
+        { 0x040E, 0x040E, 1, false, 53 }, { 0x040F, 0x040F, 1, false, 80 }, { 0x0410, 0x042E, 2, false, 32 },
+        { 0x0411, 0x0417, 2, false, 32 }, { 0x0419, 0x0419, 1, false, 31 }, { 0x041B, 0x042F, 2, false, 32 },
+        { 0x0439, 0x0439, 1, false, -1 }, { 0x0450, 0x0451, 1, true, 1077 }, { 0x0453, 0x0453, 1, false, -32 },
+        { 0x0457, 0x0457, 1, false, -1 }, { 0x045C, 0x045C, 1, false, -34 }, { 0x045D, 0x045D, 1, false, -37 },
+        { 0x045E, 0x045E, 1, false, -27 }, { 0x0460, 0x0474, 2, false, 1 }, { 0x0476, 0x0477, 1, true, 1141 },
+        { 0x0478, 0x0480, 2, false, 1 }, { 0x048A, 0x04BE, 2, false, 1 }, { 0x04C0, 0x04C0, 1, false, 15 },
+        { 0x04C1, 0x04C2, 1, true, 1078 }, { 0x04C3, 0x04CD, 2, false, 1 }, { 0x04D0, 0x04D3, 1, true, 1072 },
+        { 0x04D4, 0x04D4, 1, false, 1 }, { 0x04D6, 0x04D7, 1, true, 1077 }, { 0x04D8, 0x04DA, 2, true, 1241 },
+        { 0x04DB, 0x04DB, 1, false, -2 }, { 0x04DC, 0x04DD, 1, true, 1078 }, { 0x04DE, 0x04DF, 1, true, 1079 },
+        { 0x04E0, 0x04E0, 1, false, 1 }, { 0x04E2, 0x04E5, 1, true, 1080 }, { 0x04E6, 0x04E7, 1, true, 1086 },
+        { 0x04E8, 0x04EA, 2, true, 1257 }, { 0x04EB, 0x04EB, 1, false, -2 }, { 0x04EC, 0x04ED, 1, true, 1101 },
+        { 0x04EE, 0x04F3, 1, true, 1091 }, { 0x04F4, 0x04F5, 1, true, 1095 }, { 0x04F6, 0x04F6, 1, false, 1 },
+        { 0x04F8, 0x04F9, 1, true, 1099 }, { 0x04FA, 0x052E, 2, false, 1 }, { 0x0531, 0x0556, 1, false, 48 },
+        { 0x10A0, 0x10C5, 1, false, 7264 }, { 0x10C7, 0x10C7, 1, false, 7264 }, { 0x10CD, 0x10CD, 1, false, 7264 },
+        { 0x13F8, 0x13FD, 1, false, -8 }, { 0x1AB0, 0x1ABD, 1, true, 0 }, { 0x1ABF, 0x1ACE, 1, true, 0 },
+        { 0x1C80, 0x1C80, 1, false, -6222 }, { 0x1C81, 0x1C81, 1, false, -6221 }, { 0x1C82, 0x1C82, 1, false, -6212 },
+        { 0x1C83, 0x1C84, 1, false, -6210 }, { 0x1C85, 0x1C85, 1, false, -6211 }, { 0x1C86, 0x1C86, 1, false, -6204 },
+        { 0x1C87, 0x1C87, 1, false, -6180 }, { 0x1C88, 0x1C88, 1, false, 35267 }, { 0x1C90, 0x1CBA, 1, false, -3008 },
+        { 0x1CBD, 0x1CBF, 1, false, -3008 }, { 0x1DC0, 0x1DFF, 1, true, 0 }, { 0x1E00, 0x1E01, 1, true, 97 },
+        { 0x1E02, 0x1E07, 1, true, 98 }, { 0x1E08, 0x1E09, 1, true, 99 }, { 0x1E0A, 0x1E13, 1, true, 100 },
+        { 0x1E14, 0x1E1D, 1, true, 101 }, { 0x1E1E, 0x1E1F, 1, true, 102 }, { 0x1E20, 0x1E21, 1, true, 103 },
+        { 0x1E22, 0x1E2B, 1, true, 104 }, { 0x1E2C, 0x1E2F, 1, true, 105 }, { 0x1E30, 0x1E35, 1, true, 107 },
+        { 0x1E36, 0x1E3D, 1, true, 108 }, { 0x1E3E, 0x1E43, 1, true, 109 }, { 0x1E44, 0x1E4B, 1, true, 110 },
+        { 0x1E4C, 0x1E53, 1, true, 111 }, { 0x1E54, 0x1E57, 1, true, 112 }, { 0x1E58, 0x1E5F, 1, true, 114 },
+        { 0x1E60, 0x1E69, 1, true, 115 }, { 0x1E6A, 0x1E71, 1, true, 116 }, { 0x1E72, 0x1E7B, 1, true, 117 },
+        { 0x1E7C, 0x1E7F, 1, true, 118 }, { 0x1E80, 0x1E89, 1, true, 119 }, { 0x1E8A, 0x1E8D, 1, true, 120 },
+        { 0x1E8E, 0x1E8F, 1, true, 121 }, { 0x1E90, 0x1E95, 1, true, 122 }, { 0x1E96, 0x1E96, 1, false, -7726 },
+        { 0x1E97, 0x1E97, 1, false, -7715 }, { 0x1E98, 0x1E98, 1, false, -7713 }, { 0x1E99, 0x1E99, 1, false, -7712 },
+        { 0x1E9B, 0x1E9B, 1, false, -7720 }, { 0x1E9E, 0x1E9E, 1, false, -7615 }, { 0x1EA0, 0x1EB7, 1, true, 97 },
+        { 0x1EB8, 0x1EC7, 1, true, 101 }, { 0x1EC8, 0x1ECB, 1, true, 105 }, { 0x1ECC, 0x1EE3, 1, true, 111 },
+        { 0x1EE4, 0x1EF1, 1, true, 117 }, { 0x1EF2, 0x1EF9, 1, true, 121 }, { 0x1EFA, 0x1EFE, 2, false, 1 },
+        { 0x1F00, 0x1F0F, 1, true, 945 }, { 0x1F10, 0x1F15, 1, true, 949 }, { 0x1F18, 0x1F1D, 1, true, 949 },
+        { 0x1F20, 0x1F2F, 1, true, 951 }, { 0x1F30, 0x1F3F, 1, true, 953 }, { 0x1F40, 0x1F45, 1, true, 959 },
+        { 0x1F48, 0x1F4D, 1, true, 959 }, { 0x1F50, 0x1F57, 1, true, 965 }, { 0x1F59, 0x1F5F, 2, true, 965 },
+        { 0x1F60, 0x1F6F, 1, true, 969 }, { 0x1F70, 0x1F71, 1, true, 945 }, { 0x1F72, 0x1F76, 2, false, -7101 },
+        { 0x1F73, 0x1F77, 2, false, -7102 }, { 0x1F78, 0x1F79, 1, true, 959 }, { 0x1F7A, 0x1F7B, 1, true, 965 },
+        { 0x1F7C, 0x1F7D, 1, true, 969 }, { 0x1F80, 0x1F8F, 1, true, 945 }, { 0x1F90, 0x1F9F, 1, true, 951 },
+        { 0x1FA0, 0x1FAF, 1, true, 969 }, { 0x1FB0, 0x1FBC, 2, true, 945 }, { 0x1FB1, 0x1FB3, 2, true, 945 },
+        { 0x1FB7, 0x1FBB, 2, true, 945 }, { 0x1FBE, 0x1FBE, 1, false, -7173 }, { 0x1FC1, 0x1FC1, 1, false, -7961 },
+        { 0x1FC2, 0x1FC4, 1, true, 951 }, { 0x1FC6, 0x1FC7, 1, true, 951 }, { 0x1FC8, 0x1FCA, 2, false, -7187 },
+        { 0x1FC9, 0x1FCB, 2, false, -7188 }, { 0x1FCC, 0x1FCC, 1, false, -7189 }, { 0x1FCD, 0x1FCF, 1, true, 8127 },
+        { 0x1FD0, 0x1FD3, 1, true, 953 }, { 0x1FD6, 0x1FDB, 1, true, 953 }, { 0x1FDD, 0x1FDF, 1, true, 8190 },
+        { 0x1FE0, 0x1FE3, 1, true, 965 }, { 0x1FE4, 0x1FE5, 1, true, 961 }, { 0x1FE6, 0x1FEB, 1, true, 965 },
+        { 0x1FEC, 0x1FEC, 1, false, -7211 }, { 0x1FED, 0x1FEE, 1, true, 168 }, { 0x1FF2, 0x1FF4, 1, true, 969 },
+        { 0x1FF6, 0x1FF7, 1, true, 969 }, { 0x1FF8, 0x1FF9, 1, true, 959 }, { 0x1FFA, 0x1FFC, 1, true, 969 },
+        { 0x20D0, 0x20DC, 1, true, 0 }, { 0x20E1, 0x20E1, 1, true, 0 }, { 0x20E5, 0x20F0, 1, true, 0 },
+        { 0x2126, 0x2126, 1, false, -7517 }, { 0x212A, 0x212A, 1, false, -8383 }, { 0x212B, 0x212B, 1, false, -8394 },
+        { 0x2132, 0x2132, 1, false, 28 }, { 0x2160, 0x216F, 1, false, 16 }, { 0x2183, 0x2183, 1, false, 1 },
+        { 0x24B6, 0x24CF, 1, false, 26 }, { 0x2C00, 0x2C2F, 1, false, 48 }, { 0x2C60, 0x2C60, 1, false, 1 },
+        { 0x2C62, 0x2C62, 1, false, -10743 }, { 0x2C63, 0x2C63, 1, false, -3814 }, { 0x2C64, 0x2C64, 1, false, -10727 },
+        { 0x2C67, 0x2C6B, 2, false, 1 }, { 0x2C6D, 0x2C6D, 1, false, -10780 }, { 0x2C6E, 0x2C6E, 1, false, -10749 },
+        { 0x2C6F, 0x2C6F, 1, false, -10783 }, { 0x2C70, 0x2C70, 1, false, -10782 }, { 0x2C72, 0x2C72, 1, false, 1 },
+        { 0x2C75, 0x2C75, 1, false, 1 }, { 0x2C7E, 0x2C7F, 1, false, -10815 }, { 0x2C80, 0x2CE2, 2, false, 1 },
+        { 0x2CEB, 0x2CED, 2, false, 1 }, { 0x2CF2, 0x2CF2, 1, false, 1 }, { 0xA640, 0xA66C, 2, false, 1 },
+        { 0xA680, 0xA69A, 2, false, 1 }, { 0xA722, 0xA72E, 2, false, 1 }, { 0xA732, 0xA76E, 2, false, 1 },
+        { 0xA779, 0xA77B, 2, false, 1 }, { 0xA77D, 0xA77D, 1, false, -35332 }, { 0xA77E, 0xA786, 2, false, 1 },
+        { 0xA78B, 0xA78B, 1, false, 1 }, { 0xA78D, 0xA78D, 1, false, -42280 }, { 0xA790, 0xA792, 2, false, 1 },
+        { 0xA796, 0xA7A8, 2, false, 1 }, { 0xA7AA, 0xA7AA, 1, false, -42308 }, { 0xA7AB, 0xA7AB, 1, false, -42319 },
+        { 0xA7AC, 0xA7AC, 1, false, -42315 }, { 0xA7AD, 0xA7AD, 1, false, -42305 }, { 0xA7AE, 0xA7AE, 1, false, -42308 },
+        { 0xA7B0, 0xA7B0, 1, false, -42258 }, { 0xA7B1, 0xA7B1, 1, false, -42282 }, { 0xA7B2, 0xA7B2, 1, false, -42261 },
+        { 0xA7B3, 0xA7B3, 1, false, 928 }, { 0xA7B4, 0xA7C2, 2, false, 1 }, { 0xA7C4, 0xA7C4, 1, false, -48 },
+        { 0xA7C5, 0xA7C5, 1, false, -42307 }, { 0xA7C6, 0xA7C6, 1, false, -35384 }, { 0xA7C7, 0xA7C9, 2, false, 1 },
+        { 0xA7D0, 0xA7D0, 1, false, 1 }, { 0xA7D6, 0xA7D8, 2, false, 1 }, { 0xA7F5, 0xA7F5, 1, false, 1 },
+        { 0xAB70, 0xABBF, 1, false, -38864 }, { 0xFE20, 0xFE2F, 1, true, 0 }, { 0xFF21, 0xFF3A, 1, false, 32 },
+        { 0x10400, 0x10427, 1, false, 40 }, { 0x104B0, 0x104D3, 1, false, 40 }, { 0x10570, 0x10594, 2, false, 39 },
+        { 0x10571, 0x10579, 2, false, 39 }, { 0x1057D, 0x10589, 2, false, 39 }, { 0x1058D, 0x10591, 2, false, 39 },
+        { 0x10595, 0x10595, 1, false, 39 }, { 0x10C80, 0x10CB2, 1, false, 64 }, { 0x118A0, 0x118BF, 1, false, 32 },
+        { 0x16E40, 0x16E5F, 1, false, 32 }, { 0x1E900, 0x1E921, 1, false, 34 },
+    };
+
+    constexpr char32_t foldLimit = 0x20000;
+    constexpr std::int32_t dropDelta = INT32_MIN;
+
+    constexpr size_t countFoldPages()
+    {
+        std::array<bool, foldLimit / 256> used{};
+
+        size_t n = 0;
+
+        for (const FoldRule& r : foldRules)
+        {
+            for (char32_t p = r.first / 256; p <= r.last / 256; ++p)
+            {
+                if (!used[p])
+                {
+                    used[p] = true;
+
+                    ++n;
+                }
+            }
+        }
+
+        return n;
+    }
+
+    // two stage table, page 0 of blocks is the identity block
+    struct FoldTable
+    {
+        std::array<std::uint8_t, foldLimit / 256> pages{};
+        std::array<std::array<std::int32_t, 256>, countFoldPages() + 1> blocks{};
+    };
+
+    constexpr FoldTable buildFoldTable()
+    {
+        FoldTable t{};
+
+        size_t next = 1;
+
+        for (const FoldRule& r : foldRules)
+        {
+            for (char32_t c = r.first; c <= r.last; c += r.stride)
+            {
+                std::uint8_t& page = t.pages[c / 256];
+
+                if (page == 0)
+                {
+                    page = static_cast<std::uint8_t>(next++);
+                }
+
+                std::int32_t delta = r.value;
+
+                if (r.absolute)
+                {
+                    delta = r.value == 0
+                        ? dropDelta
+                        : r.value - static_cast<std::int32_t>(c);
+                }
+
+                t.blocks[page][c % 256] = delta;
+            }
+        }
+
+        return t;
+    }
+
+    constexpr FoldTable foldTable = buildFoldTable();
+
+    static_assert(foldTable.blocks.size() <= 256);
+
+    void appendUtf8(std::string& out, char32_t c)
+    {
+        if (c < 0x80)
+        {
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    // returns the number of bytes consumed, 0 for an invalid sequence
+    size_t decodeUtf8(std::string_view s, size_t i, char32_t& c)
+    {
+        const unsigned char b = static_cast<unsigned char>(s[i]);
+
+        size_t n = 0;
+
+        if (b < 0x80)
+        {
+            c = b;
+
+            return 1;
+        }
+        else if ((b & 0xE0) == 0xC0)
+        {
+            c = b & 0x1F;
+            n = 2;
+        }
+        else if ((b & 0xF0) == 0xE0)
+        {
+            c = b & 0x0F;
+            n = 3;
+        }
+        else if ((b & 0xF8) == 0xF0)
+        {
+            c = b & 0x07;
+            n = 4;
+        }
+        else
+        {
+            return 0;
+        }
+
+        if (i + n > s.size())
+        {
+            return 0;
+        }
+
+        for (size_t k = 1; k < n; ++k)
+        {
+            const unsigned char cb = static_cast<unsigned char>(s[i + k]);
+
+            if ((cb & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+
+            c = (c << 6) | (cb & 0x3F);
+        }
+
+        return n;
+    }
+}
+
+char32_t foldCodePoint(char32_t c)
+{
+    if (c >= foldLimit)
+    {
+        return c;
+    }
+
+    const std::int32_t delta = foldTable.blocks[foldTable.pages[c / 256]][c % 256];
+
+    if (delta == dropDelta)
+    {
+        return 0;
+    }
+
+    return static_cast<char32_t>(static_cast<std::int32_t>(c) + delta);
+}
+
+std::string foldKey(std::string_view s)
+{
+    std::string out;
+
+    out.reserve(s.size());
+
+    for (size_t i = 0; i < s.size();)
+    {
+        const unsigned char b = static_cast<unsigned char>(s[i]);
+
+        if (b < 0x80)
+        {
+            out += (b >= 'A' && b <= 'Z')
+                ? static_cast<char>(b - 'A' + 'a')
+                : static_cast<char>(b);
+
+            ++i;
+
+            continue;
+        }
+
+        char32_t c = 0;
+
+        const size_t n = decodeUtf8(s, i, c);
+
+        if (n == 0)
+        {
+            // keep stray bytes so malformed tags still compare consistently
+            out += static_cast<char>(b);
+
+            ++i;
+
+            continue;
+        }
+
+        i += n;
+
+        const char32_t f = foldCodePoint(c);
+
+        if (f != 0)
+        {
+            appendUtf8(out, f);
+        }
+    }
+
+    return out;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// folds case and strips diacritics, e.g. "Björk" -> "bjork"
+// the result is meant for comparing and matching, never for display
+std::string foldKey(std::string_view s);
+
+// 0 means the code point is dropped (combining marks)
+char32_t foldCodePoint(char32_t c);
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "convolvernode.h"
+#include "dspkernels.h"
+
+namespace
+{
+    constexpr ma_uint32 channels = 2;
+
+    // an odd device period, so blocks and calls never line up
+    constexpr size_t callFrames = 441;
+
+    // of input, per timed response
+    constexpr double timedSeconds = 4.0;
+
+    struct TimedCase
+    {
+        ma_uint32 rate;
+        size_t taps;
+    };
+
+    const TimedCase timed[] =
+    {
+        { 48000, 8192 },
+        { 48000, 65536 },
+        { 96000, 65536 },
+        { 96000, 131072 }
+    };
+
+    std::vector<float> noise(size_t frames, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> sample(-0.5f, 0.5f);
+
+        std::vector<float> x(frames * channels);
+
+        for (float& v : x)
+        {
+            v = sample(rng);
+        }
+
+        return x;
+    }
+
+    // noise under an exponential decay, a different one per channel, like a measured room
+    std::vector<float> response(size_t taps, uint32_t seed)
+    {
+        std::vector<float> h = noise(taps, seed);
+
+        for (size_t i = 0; i < taps; ++i)
+        {
+            const float decay = std::exp(-6.0f * float(i) / float(taps));
+
+            for (ma_uint32 c = 0; c < channels; ++c)
+            {
+                h[i * channels + c] *= decay / 8.0f;
+            }
+        }
+
+        return h;
+    }
+
+    void run(ConvolverNode& node, std::vector<float>& x)
+    {
+        const size_t frames = x.size() / channels;
+
+        for (size_t i = 0; i < frames; i += callFrames)
+        {
+            node.process(x.data() + i * channels, std::min(callFrames, frames - i));
+        }
+    }
+
+    // what should come out at frame i, the node delays by a block
+    double direct(const std::vector<float>& x, const std::vector<float>& h, size_t i, ma_uint32 c)
+    {
+        const size_t taps = h.size() / channels;
+
+        double s = 0.0;
+
+        if (i < ConvolverNode::blockFrames)
+        {
+            return s;
+        }
+
+        const size_t t = i - ConvolverNode::blockFrames;
+
+        for (size_t k = 0; k < taps && k <= t; ++k)
+        {
+            s += double(h[k * channels + c]) * double(x[(t - k) * channels + c]);
+        }
+
+        return s;
+    }
+
+    // largest difference to a direct convolution once the fade in is over, relative to the output's peak
+    // the response is swapped for a second one half way, checked again once that crossfade is done
+    double checkOutput()
+    {
+        constexpr size_t taps = 3000;
+        constexpr size_t frames = 48000;
+        constexpr size_t swapAt = frames / 2;
+
+        const std::vector<float> in = noise(frames, 1);
+        const std::vector<float> first = response(taps, 2);
+        const std::vector<float> second = response(taps / 3, 3);
+
+        ConvolverNode node;
+
+        node.prepare(channels);
+        node.setImpulse(first.data(), taps, channels);
+
+        std::vector<float> out = in;
+
+        for (size_t i = 0; i < frames; i += callFrames)
+        {
+            const size_t n = std::min(callFrames, frames - i);
+
+            if (i <= swapAt
+                && swapAt < i + n)
+            {
+                node.setImpulse(second.data(), second.size() / channels, channels);
+            }
+
+            node.process(out.data() + i * channels, n);
+        }
+
+        node.collect();
+
+        double peak = 0.0;
+        double error = 0.0;
+
+        for (size_t i = 0; i < frames; ++i)
+        {
+            // the fade in, and the swap, which lands on the first block boundary after the call it came in and takes a block to cross
+            if (i < 2 * ConvolverNode::blockFrames
+                || (i + 2 * ConvolverNode::blockFrames >= swapAt && i < swapAt + 3 * ConvolverNode::blockFrames))
+            {
+                continue;
+            }
+
+            for (ma_uint32 c = 0; c < channels; ++c)
+            {
+                const double want = direct(
+                    in,
+                    i < swapAt
+                        ? first
+                        : second,
+                    i,
+                    c
+                );
+
+                peak = std::max(peak, std::abs(want));
+                error = std::max(error, std::abs(want - double(out[i * channels + c])));
+            }
+        }
+
+        return error / std::max(peak, 1e-30);
+    }
+
+    // ms of cpu per second of audio
+    double timeCase(const TimedCase& t)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const std::vector<float> h = response(t.taps, 4);
+
+        ConvolverNode node;
+
+        node.prepare(channels);
+        node.setImpulse(h.data(), t.taps, channels);
+
+        // fills the history, so every partition is worked through while timing
+        std::vector<float> warm = noise(t.taps + ConvolverNode::blockFrames, 5);
+
+        run(node, warm);
+
+        std::vector<float> x = noise(size_t(timedSeconds * t.rate), 6);
+
+        const auto start = clock::now();
+
+        run(node, x);
+
+        const double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        return ms / timedSeconds;
+    }
+}
+
+int runConvolverBenchmark()
+{
+    std::printf(
+        "convolution, %u channels, %zu frame partitions, %zu frames a call, kernels %s\n\n",
+        channels,
+        ConvolverNode::blockFrames,
+        callFrames,
+        dspKernels().name
+    );
+
+    const double error = checkOutput();
+    const bool ok = error <= 1e-5;
+
+    std::printf(
+        "against direct convolution, across a swap: %.3g of peak%s\n\n",
+        error,
+        ok
+            ? ""
+            : "  mismatch"
+    );
+
+    std::printf("%-8s %8s %10s %10s\n", "rate", "taps", "ms/s", "realtime");
+
+    for (const TimedCase& t : timed)
+    {
+        const double ms = timeCase(t);
+
+        std::printf("%-8u %8zu %10.3f %9.0fx\n", t.rate, t.taps, ms, 1000.0 / ms);
+    }
+
+    std::fflush(stdout);
+
+    return ok
+        ? 0
+        : 1;
+}
\ No newline at end of file
@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <cstring>
+
+#include "convolvernode.h"
+#include "dspkernels.h"
+#include "resampler.h"
+
+namespace
+{
+    // the whole response as interleaved f32 at the given rate, its own channels, cut at maxFrames
+    bool decodeResponse(const std::filesystem::path& path, ma_uint32 sampleRate, size_t maxFrames, std::vector<float>& samples, ma_uint32& channels)
+    {
+        ma_decoder_config config = ma_decoder_config_init(
+            ma_format_f32,
+            0,
+            sampleRate
+        );
+
+        // it is read once and then heard on everything, so it gets the best filter there is
+        configureResampler(config.resampling, ResamplerQuality::Best);
+
+        ma_decoder decoder;
+
+#ifdef _WIN32
+        if (ma_decoder_init_file_w(
+            path.c_str(),
+            &config,
+            &decoder) != MA_SUCCESS)
+#else
+        if (ma_decoder_init_file(
+            path.c_str(),
+            &config,
+            &decoder) != MA_SUCCESS)
+#endif
+        {
+            return false;
+        }
+
+        channels = decoder.outputChannels;
+
+        constexpr ma_uint64 chunk = 4096;
+
+        samples.clear();
+
+        size_t frames = 0;
+
+        while (frames < maxFrames)
+        {
+            const ma_uint64 want = std::min<ma_uint64>(chunk, maxFrames - frames);
+
+            samples.resize((frames + size_t(want)) * channels);
+
+            ma_uint64 read = 0;
+
+            ma_decoder_read_pcm_frames(
+                &decoder,
+                samples.data() + frames * channels,
+                want,
+                &read
+            );
+
+            frames += size_t(read);
+
+            if (read < want)
+            {
+                break;
+            }
+        }
+
+        ma_decoder_uninit(&decoder);
+
+        samples.resize(frames * channels);
+
+        return frames > 0
+            && channels > 0;
+    }
+}
+
+ConvolverNode::ConvolverNode() = default;
+
+ConvolverNode::~ConvolverNode()
+{
+    uninit();
+    reset();
+}
+
+bool ConvolverNode::init(ma_engine* engine, ma_node* next)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    sampleRate = ma_engine_get_sample_rate(engine);
+
+    prepare(ma_engine_get_channels(engine));
+
+    // the response was decoded for the old rate, and a file gone since leaves it off
+    if (!irPath.empty())
+    {
+        const std::filesystem::path path = irPath;
+
+        irPath.clear();
+
+        load(path);
+    }
+
+    return attach(engine, next);
+}
+
+bool ConvolverNode::load(const std::filesystem::path& path)
+{
+    if (path.empty())
+    {
+        irPath.clear();
+
+        publish(&off);
+
+        return true;
+    }
+
+    if (sampleRate == 0)
+    {
+        // picked up by init
+        irPath = path;
+
+        return true;
+    }
+
+    std::vector<float> samples;
+    ma_uint32 irChannels = 0;
+
+    if (!decodeResponse(
+        path,
+        sampleRate,
+        maxTaps,
+        samples,
+        irChannels))
+    {
+        return false;
+    }
+
+    irPath = path;
+
+    publish(build(samples.data(), samples.size() / irChannels, irChannels));
+
+    return true;
+}
+
+void ConvolverNode::prepare(ma_uint32 count)
+{
+    // nothing is running the node, whatever the audio thread held is ours again
+    reset();
+
+    channels = count;
+
+    window.assign(size_t(channels) * blockFrames * 2, 0.0f);
+    wet.assign(size_t(channels) * blockFrames, 0.0f);
+    incoming.assign(blockFrames, 0.0f);
+
+    accRe.assign(bins, 0.0f);
+    accIm.assign(bins, 0.0f);
+    timeDomain.assign(blockFrames * 2, 0.0f);
+
+    // sized by the first response
+    history.clear();
+
+    head = 0;
+    filled = 0;
+    fill = 0;
+
+    fadeFrom = 0.0f;
+    fadeTo = 0.0f;
+}
+
+void ConvolverNode::setImpulse(const float* samples, size_t frames, ma_uint32 irChannels)
+{
+    publish(build(samples, std::min(frames, maxTaps), irChannels));
+}
+
+void ConvolverNode::collect()
+{
+    Filter* f = retired.exchange(nullptr, std::memory_order_acquire);
+
+    while (f)
+    {
+        Filter* n = f->retiredNext;
+
+        delete f;
+
+        f = n;
+    }
+}
+
+void ConvolverNode::publish(Filter* filter)
+{
+    collect();
+
+    if (filter != &off
+        && history.empty())
+    {
+        history.assign(slots * channels * bins * 2, 0.0f);
+    }
+
+    Filter* untaken = pending.exchange(filter, std::memory_order_acq_rel);
+
+    // one the audio thread never got to
+    if (untaken != &off)
+    {
+        delete untaken;
+    }
+}
+
+ConvolverNode::Filter* ConvolverNode::build(const float* samples, size_t frames, ma_uint32 irChannels) const
+{
+    auto* f = new Filter();
+
+    f->channels = irChannels;
+    f->partitions = std::max<size_t>(1, (frames + blockFrames - 1) / blockFrames);
+    f->spectra.resize(size_t(irChannels) * f->partitions * bins * 2);
+
+    // the inverse comes out scaled up by the bin count
+    const float scale = 1.0f / float(bins);
+
+    std::vector<float> padded(blockFrames * 2);
+
+    for (ma_uint32 c = 0; c < irChannels; ++c)
+    {
+        for (size_t p = 0; p < f->partitions; ++p)
+        {
+            // a partition in the first half, zeros in the second, so the last half of each window wraps nothing
+            std::fill(padded.begin(), padded.end(), 0.0f);
+
+            const size_t from = p * blockFrames;
+            const size_t to = std::min(frames, from + blockFrames);
+
+            for (size_t i = from; i < to; ++i)
+            {
+                padded[i - from] = samples[i * irChannels + c] * scale;
+            }
+
+            float* re = f->spectra.data() + (size_t(c) * f->partitions + p) * bins * 2;
+
+            fft.forward(padded.data(), re, re + bins);
+        }
+    }
+
+    return f;
+}
+
+void ConvolverNode::reset()
+{
+    Filter* f = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (f != &off)
+    {
+        delete f;
+    }
+
+    delete current;
+
+    current = nullptr;
+
+    collect();
+}
+
+void ConvolverNode::process(float* frames, size_t count)
+{
+    size_t done = 0;
+
+    while (done < count)
+    {
+        const size_t n = std::min(count - done, blockFrames - fill);
+
+        float* p = frames + done * channels;
+
+        for (ma_uint32 ch = 0; ch < channels; ++ch)
+        {
+            float* in = window.data() + size_t(ch) * blockFrames * 2 + blockFrames + fill;
+            const float* out = wet.data() + size_t(ch) * blockFrames + fill;
+
+            if (fadeTo == 0.0f
+                && fadeFrom == 0.0f)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    in[i] = p[i * channels + ch];
+                }
+            }
+            else if (fadeTo == 1.0f
+                && fadeFrom == 1.0f)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    in[i] = p[i * channels + ch];
+                    p[i * channels + ch] = out[i];
+                }
+            }
+            else
+            {
+                // on or off, between the dry signal and the wet one a block behind it
+                const float step = (fadeTo - fadeFrom) / float(blockFrames);
+
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const float g = fadeFrom + step * float(fill + i);
+                    const float dry = p[i * channels + ch];
+
+                    in[i] = dry;
+                    p[i * channels + ch] = dry * (1.0f - g) + out[i] * g;
+                }
+            }
+        }
+
+        fill += n;
+        done += n;
+
+        if (fill == blockFrames)
+        {
+            runBlock();
+
+            fill = 0;
+        }
+    }
+}
+
+void ConvolverNode::runBlock()
+{
+    Filter* next = current;
+
+    Filter* request = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (request)
+    {
+        next = request == &off
+            ? nullptr
+            : request;
+    }
+
+    if (current
+        || next)
+    {
+        // history kept from before it was last turned off is long stale, it counts as silence
+        if (!current)
+        {
+            filled = 0;
+        }
+
+        head = (head + 1) % slots;
+        filled = std::min(filled + 1, slots);
+
+        for (ma_uint32 ch = 0; ch < channels; ++ch)
+        {
+            float* re = history.data() + (head * channels + ch) * bins * 2;
+
+            fft.forward(window.data() + size_t(ch) * blockFrames * 2, re, re + bins);
+        }
+
+        for (ma_uint32 ch = 0; ch < channels; ++ch)
+        {
+            float* out = wet.data() + size_t(ch) * blockFrames;
+
+            if (!current)
+            {
+                convolve(*next, ch, out);
+
+                continue;
+            }
+
+            convolve(*current, ch, out);
+
+            if (next
+                && next != current)
+            {
+                // both responses run over the same history, the new one takes over across the block
+                convolve(*next, ch, incoming.data());
+
+                for (size_t i = 0; i < blockFrames; ++i)
+                {
+                    const float g = float(i) / float(blockFrames);
+
+                    out[i] = out[i] * (1.0f - g) + incoming[i] * g;
+                }
+            }
+        }
+    }
+
+    fadeFrom = current
+        ? 1.0f
+        : 0.0f;
+
+    fadeTo = next
+        ? 1.0f
+        : 0.0f;
+
+    if (current
+        && current != next)
+    {
+        retire(current);
+    }
+
+    current = next;
+
+    for (ma_uint32 ch = 0; ch < channels; ++ch)
+    {
+        float* w = window.data() + size_t(ch) * blockFrames * 2;
+
+        std::memcpy(w, w + blockFrames, blockFrames * sizeof(float));
+    }
+}
+
+void ConvolverNode::convolve(const Filter& filter, ma_uint32 ch, float* out)
+{
+    const DspKernels& k = dspKernels();
+
+    const size_t parts = std::min(filter.partitions, filled);
+
+    const float* h = filter.spectra.data() + size_t(ch % filter.channels) * filter.partitions * bins * 2;
+
+    std::fill(accRe.begin(), accRe.end(), 0.0f);
+    std::fill(accIm.begin(), accIm.end(), 0.0f);
+
+    for (size_t p = 0; p < parts; ++p, h += bins * 2)
+    {
+        const float* x = history.data() + (((head + slots - p) % slots) * channels + ch) * bins * 2;
+
+        // dc and nyquist share bin 0 and are both real
+        accRe[0] += x[0] * h[0];
+        accIm[0] += x[bins] * h[bins];
+
+        k.complexMac(x + 1, x + bins + 1, h + 1, h + bins + 1, accRe.data() + 1, accIm.data() + 1, bins - 1);
+    }
+
+    fft.inverse(accRe.data(), accIm.data(), timeDomain.data());
+
+    // the first half wrapped around, the second is the linear convolution
+    std::memcpy(out, timeDomain.data() + blockFrames, blockFrames * sizeof(float));
+}
+
+void ConvolverNode::retire(Filter* filter)
+{
+    filter->retiredNext = retired.load(std::memory_order_relaxed);
+
+    while (!retired.compare_exchange_weak(
+        filter->retiredNext,
+        filter,
+        std::memory_order_release,
+        std::memory_order_relaxed))
+    {
+    }
+}
\ No newline at end of file
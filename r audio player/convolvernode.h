@@ -0,0 +1,120 @@
+#pragma once
+
+#include "fft.h"
+#include "graphnode.h"
+#include "miniaudio.h"
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// between the eq and the output node, runs the audio through an impulse response for headphone or room correction
+// uniformly partitioned overlap save: every block of input is transformed once into a ring of past spectra,
+// and each block of output is the sum of those times the matching partitions of the response
+// the response is transformed on the engine thread and handed over whole, a new one is crossfaded in over a block
+// and the old one freed on the engine thread again, so nothing on the audio thread locks or allocates
+class ConvolverNode : public GraphNode<ConvolverNode>
+{
+public:
+    // also the latency it adds while on
+    static constexpr size_t blockFrames = 512;
+
+    // longer responses are cut, about 5 s at 48 kHz
+    static constexpr size_t maxTaps = size_t(1) << 18;
+
+    ConvolverNode();
+    ~ConvolverNode();
+
+    ConvolverNode(const ConvolverNode&) = delete;
+    ConvolverNode& operator=(const ConvolverNode&) = delete;
+
+    // feeds 'next', a response already loaded is decoded again at the engine's rate
+    bool init(ma_engine* engine, ma_node* next);
+
+    // engine thread, any file the decoders read, an empty path turns it off
+    // false when it can't be read, the response in use then stays
+    bool load(const std::filesystem::path& path);
+    bool enabled() const { return !irPath.empty(); }
+    const std::filesystem::path& path() const { return irPath; }
+
+    // audio thread, frames the output is behind the input, a block while the response is in and none bypassed
+    size_t latency() const { return fadeTo > 0.0f ? blockFrames : 0; }
+
+    // frees responses the audio thread has finished with, engine thread only
+    void collect();
+
+    // for running it without a graph, the benchmark does: sized for the channels,
+    // then a response as interleaved samples already at the rate of the audio
+    void prepare(ma_uint32 channels);
+    void setImpulse(const float* samples, size_t frames, ma_uint32 irChannels);
+
+    // audio thread, in place on interleaved frames of prepare's channels
+    void process(float* frames, size_t count);
+private:
+    static constexpr size_t bins = blockFrames;
+    static constexpr size_t slots = maxTaps / blockFrames;
+
+    struct Filter
+    {
+        // of the response, engine channel c is run through c % channels
+        ma_uint32 channels = 0;
+        size_t partitions = 0;
+
+        // per channel and partition, bins real parts then bins imaginary ones, scaled for the inverse
+        std::vector<float> spectra;
+
+        Filter* retiredNext = nullptr;
+    };
+
+    ma_uint32 sampleRate = 0;
+
+    RealFft fft{ blockFrames * 2 };
+
+    // engine thread, kept so a device reopened at another rate gets the same response
+    std::filesystem::path irPath;
+
+    // set by the engine thread, taken by the audio thread at a block boundary, &off asks it to stop
+    std::atomic<Filter*> pending{ nullptr };
+    Filter off;
+
+    // lock free stack, pushed from the audio thread
+    std::atomic<Filter*> retired{ nullptr };
+
+    // spectra of the past input blocks, per slot and channel, allocated on the engine thread before the first response goes out
+    std::vector<float> history;
+
+    // audio thread only
+    Filter* current = nullptr;
+    size_t head = 0;
+    size_t filled = 0;
+
+    // per channel, the last two blocks of input, and the output of the block before
+    // incoming holds one channel of a response being swapped in
+    std::vector<float> window;
+    std::vector<float> wet;
+    std::vector<float> incoming;
+    size_t fill = 0;
+
+    // share of the wet signal at the start and end of the block playing out
+    float fadeFrom = 0.0f;
+    float fadeTo = 0.0f;
+
+    std::vector<float> accRe;
+    std::vector<float> accIm;
+    std::vector<float> timeDomain;
+
+    // engine thread
+    void publish(Filter* filter);
+    Filter* build(const float* samples, size_t frames, ma_uint32 irChannels) const;
+    void reset();
+
+    // audio thread
+    void runBlock();
+    void convolve(const Filter& filter, ma_uint32 ch, float* out);
+    void retire(Filter* filter);
+};
+
+// cpu time per second of audio for long responses at high rates, and the output checked against a direct convolution
+// prints a table, 0 when the output matches
+int runConvolverBenchmark();
\ No newline at end of file
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+#include "deck.h"
+#include "tracksource.h"
+#include "wakeup.h"
+
+const ma_data_source_vtable Deck::vtable =
+{
+    &Deck::onRead,
+    &Deck::onSeek,
+    &Deck::onGetDataFormat,
+    &Deck::onGetCursor,
+    &Deck::onGetLength,
+    nullptr,
+    0
+};
+
+namespace
+{
+    // miniaudio hands back a pointer to the base, which sits at the start of the deck
+    static_assert(std::is_standard_layout_v<Deck>);
+
+    inline Deck* deckOf(ma_data_source* ds)
+    {
+        return reinterpret_cast<Deck*>(ds);
+    }
+
+    // frames mixed per pass while two tracks overlap
+    constexpr ma_uint64 fadeBlock = 512;
+}
+
+Deck::Deck() = default;
+
+Deck::~Deck()
+{
+    reset(nullptr);
+
+    delete[] scratch;
+
+    if (baseInit)
+    {
+        ma_data_source_uninit(&base);
+    }
+}
+
+bool Deck::init(ma_uint32 ch, ma_uint32 rate)
+{
+    // a device reopened for another track may come back with a different channel count
+    if (!scratch
+        || ch != channels)
+    {
+        delete[] scratch;
+
+        scratch = new float[fadeBlock * ch];
+    }
+
+    channels = ch;
+    sampleRate = rate;
+
+    if (baseInit)
+    {
+        return true;
+    }
+
+    ma_data_source_config config = ma_data_source_config_init();
+
+    config.vtable = &vtable;
+
+    if (ma_data_source_init(&config, &base) != MA_SUCCESS)
+    {
+        return false;
+    }
+
+    baseInit = true;
+
+    return true;
+}
+
+void Deck::reset(TrackSource* track)
+{
+    delete current.exchange(track, std::memory_order_acq_rel);
+    delete next.exchange(nullptr, std::memory_order_acq_rel);
+    delete pendingCut.exchange(nullptr, std::memory_order_acq_rel);
+
+    pendingSeek.store(noSeek, std::memory_order_relaxed);
+
+    delete outgoing;
+
+    outgoing = nullptr;
+
+    collect();
+}
+
+void Deck::queue(TrackSource* track)
+{
+    collect();
+
+    // whatever was queued before is still ours, the audio thread only takes it via exchange
+    delete next.exchange(track, std::memory_order_acq_rel);
+}
+
+void Deck::cut(TrackSource* track, ma_uint64 fadeFrames)
+{
+    collect();
+
+    // the queued track belonged to the old position
+    delete next.exchange(nullptr, std::memory_order_acq_rel);
+
+    cutFrames.store(fadeFrames, std::memory_order_relaxed);
+
+    // a seek still waiting was meant for the old track
+    pendingSeek.store(noSeek, std::memory_order_relaxed);
+
+    delete pendingCut.exchange(track, std::memory_order_acq_rel);
+}
+
+void Deck::seek(ma_uint64 frame)
+{
+    pendingSeek.store(frame, std::memory_order_release);
+}
+
+bool Deck::unaltered() const
+{
+    const TrackSource* cur = current.load(std::memory_order_relaxed);
+
+    return cur
+        && !outgoing
+        && cur->unaltered();
+}
+
+void Deck::setCrossfade(ma_uint64 frames, FadeCurve curve)
+{
+    crossfadeCurve.store(curve, std::memory_order_relaxed);
+    crossfadeFrames.store(frames, std::memory_order_relaxed);
+}
+
+void Deck::collect()
+{
+    TrackSource* t = retired.exchange(nullptr, std::memory_order_acquire);
+
+    while (t)
+    {
+        TrackSource* n = t->retiredNext;
+
+        delete t;
+
+        t = n;
+    }
+}
+
+void Deck::retire(TrackSource* track)
+{
+    track->retiredNext = retired.load(std::memory_order_relaxed);
+
+    while (!retired.compare_exchange_weak(
+        track->retiredNext,
+        track,
+        std::memory_order_release,
+        std::memory_order_relaxed))
+    {
+    }
+}
+
+void Deck::takeCut()
+{
+    TrackSource* track = pendingCut.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (!track)
+    {
+        return;
+    }
+
+    TrackSource* cur = current.exchange(track, std::memory_order_acq_rel);
+
+    if (cur)
+    {
+        beginFade(cur, cutFrames.load(std::memory_order_relaxed), FadeCurve::EqualPower);
+    }
+}
+
+void Deck::takeSeek()
+{
+    const ma_uint64 frame = pendingSeek.exchange(noSeek, std::memory_order_acq_rel);
+
+    if (frame != noSeek)
+    {
+        onSeek(&base, frame);
+    }
+}
+
+void Deck::beginFade(TrackSource* from, ma_uint64 frames, FadeCurve curve)
+{
+    endFade();
+
+    if (frames == 0)
+    {
+        retire(from);
+
+        return;
+    }
+
+    outgoing = from;
+    fadeCurve = curve;
+    fadePos = 0;
+    fadeLength = frames;
+}
+
+void Deck::endFade()
+{
+    if (outgoing)
+    {
+        retire(outgoing);
+
+        outgoing = nullptr;
+    }
+}
+
+void Deck::advanced()
+{
+    advanceCount.fetch_add(1, std::memory_order_release);
+
+    if (wakeup)
+    {
+        wakeup->notify();
+    }
+}
+
+ma_uint64 Deck::mixFade(TrackSource* to, float* out, ma_uint64 frames)
+{
+    const ma_uint64 n = std::min({ frames, fadeBlock, fadeLength - fadePos });
+    const ma_uint64 samples = n * channels;
+
+    // either side may run out early, silence stands in for the rest
+    const ma_uint64 in = to->read(out, n);
+    const ma_uint64 old = outgoing->read(scratch, n);
+
+    std::fill(out + in * channels, out + samples, 0.0f);
+    std::fill(scratch + old * channels, scratch + samples, 0.0f);
+
+    const double step = 1.0 / double(fadeLength);
+
+    for (ma_uint64 i = 0; i < n; ++i)
+    {
+        const double x = (double(fadePos + i) + 0.5) * step;
+
+        float gainIn;
+        float gainOut;
+
+        if (fadeCurve == FadeCurve::EqualPower)
+        {
+            // constant summed power for uncorrelated material
+            gainIn = float(std::sin(x * std::numbers::pi / 2));
+            gainOut = float(std::cos(x * std::numbers::pi / 2));
+        }
+        else
+        {
+            gainIn = float(x);
+            gainOut = float(1.0 - x);
+        }
+
+        float* a = out + i * channels;
+        const float* b = scratch + i * channels;
+
+        for (ma_uint32 c = 0; c < channels; ++c)
+        {
+            a[c] = a[c] * gainIn + b[c] * gainOut;
+        }
+    }
+
+    fadePos += n;
+
+    if (fadePos >= fadeLength
+        || old < n)
+    {
+        endFade();
+    }
+
+    return n;
+}
+
+ma_result Deck::onRead(ma_data_source* ds, void* out, ma_uint64 frameCount, ma_uint64* framesRead)
+{
+    Deck* self = deckOf(ds);
+
+    self->takeCut();
+    self->takeSeek();
+
+    float* dst = static_cast<float*>(out);
+
+    ma_uint64 total = 0;
+
+    while (total < frameCount)
+    {
+        TrackSource* cur = self->current.load(std::memory_order_acquire);
+
+        if (!cur)
+        {
+            break;
+        }
+
+        float* at = dst + total * self->channels;
+
+        ma_uint64 want = frameCount - total;
+
+        if (self->outgoing)
+        {
+            total += self->mixFade(cur, at, want);
+
+            continue;
+        }
+
+        const ma_uint64 fade = self->crossfadeFrames.load(std::memory_order_relaxed);
+        const ma_uint64 length = cur->length();
+        const ma_uint64 pos = cur->cursor();
+
+        // with a crossfade the queued track comes in before the current one ends
+        if (fade > 0
+            && length > pos
+            && self->next.load(std::memory_order_acquire))
+        {
+            const ma_uint64 start = length > fade
+                ? length - fade
+                : 0;
+
+            if (pos < start)
+            {
+                want = std::min(want, start - pos);
+            }
+            else if (TrackSource* n = self->next.exchange(nullptr, std::memory_order_acq_rel))
+            {
+                self->current.store(n, std::memory_order_release);
+                self->beginFade(cur, length - pos, self->crossfadeCurve.load(std::memory_order_relaxed));
+                self->advanced();
+
+                continue;
+            }
+        }
+
+        const ma_uint64 n = cur->read(at, want);
+
+        total += n;
+
+        if (n == want)
+        {
+            continue;
+        }
+
+        // the current track ran dry, carry on with the queued one in this same buffer
+        TrackSource* queued = self->next.exchange(nullptr, std::memory_order_acq_rel);
+
+        if (!queued)
+        {
+            break;
+        }
+
+        self->current.store(queued, std::memory_order_release);
+        self->retire(cur);
+        self->advanced();
+    }
+
+    const TrackSource* cur = self->current.load(std::memory_order_relaxed);
+
+    self->readCursor = cur
+        ? cur->cursor()
+        : 0;
+
+    self->readFrames += total;
+
+    *framesRead = total;
+
+    return total == 0
+        ? MA_AT_END
+        : MA_SUCCESS;
+}
+
+ma_result Deck::onSeek(ma_data_source* ds, ma_uint64 frame)
+{
+    Deck* self = deckOf(ds);
+
+    // a seek lands in the current track only, drop whatever is still fading out
+    self->endFade();
+
+    TrackSource* cur = self->current.load(std::memory_order_acquire);
+
+    if (!cur)
+    {
+        return MA_INVALID_OPERATION;
+    }
+
+    return cur->seek(frame);
+}
+
+ma_result Deck::onGetDataFormat(ma_data_source* ds, ma_format* format, ma_uint32* channels, ma_uint32* sampleRate, ma_channel* channelMap, size_t channelMapCap)
+{
+    const Deck* self = deckOf(ds);
+
+    *format = ma_format_f32;
+    *channels = self->channels;
+    *sampleRate = self->sampleRate;
+
+    ma_channel_map_init_standard(
+        ma_standard_channel_map_default,
+        channelMap,
+        channelMapCap,
+        self->channels
+    );
+
+    return MA_SUCCESS;
+}
+
+ma_result Deck::onGetCursor(ma_data_source* ds, ma_uint64* cursor)
+{
+    const TrackSource* cur = deckOf(ds)->current.load(std::memory_order_acquire);
+
+    *cursor = cur
+        ? cur->cursor()
+        : 0;
+
+    return MA_SUCCESS;
+}
+
+ma_result Deck::onGetLength(ma_data_source* ds, ma_uint64* length)
+{
+    const TrackSource* cur = deckOf(ds)->current.load(std::memory_order_acquire);
+
+    *length = cur
+        ? cur->length()
+        : 0;
+
+    return MA_SUCCESS;
+}
\ No newline at end of file
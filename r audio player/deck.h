@@ -0,0 +1,122 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <cstdint>
+
+class TrackSource;
+class Wakeup;
+
+enum class FadeCurve
+{
+    Linear,
+    EqualPower
+};
+
+// a data source that plays tracks back to back
+// when the current track runs dry the audio thread splices in the queued one
+// within the same read, so there is no gap and no round trip through the gui
+// with a crossfade set, the queued track starts that many frames early and the two are mixed
+class Deck
+{
+public:
+    Deck();
+    ~Deck();
+
+    Deck(const Deck&) = delete;
+    Deck& operator=(const Deck&) = delete;
+
+    bool init(ma_uint32 channels, ma_uint32 sampleRate);
+
+    ma_data_source* source() { return &base; }
+
+    // only while no sound is reading from the deck
+    void reset(TrackSource* track);
+
+    // the track to continue with, replaces any earlier one not yet started
+    void queue(TrackSource* track);
+
+    // switches to the track right away, fading the current one out over the given frames
+    void cut(TrackSource* track, ma_uint64 fadeFrames);
+
+    // applied at the start of the next read, for a reader that isn't a sound, any thread
+    void seek(ma_uint64 frame);
+
+    // 0 frames plays gapless
+    void setCrossfade(ma_uint64 frames, FadeCurve curve);
+
+    // bumped by the audio thread on every splice or crossfade start
+    uint32_t advances() const { return advanceCount.load(std::memory_order_acquire); }
+
+    // frees tracks the audio thread has finished with, owner thread only
+    void collect();
+
+    // notified from the audio thread on every advance, set before any sound reads from the deck
+    void setWakeup(Wakeup* w) { wakeup = w; }
+
+    // where the last read left the current track, and every frame handed out so far
+    // audio thread only, for the playback clock
+    ma_uint64 lastCursor() const { return readCursor; }
+    uint64_t framesOut() const { return readFrames; }
+
+    // the current track comes out exactly as decoded, with nothing fading and no gain on it
+    // audio thread only
+    bool unaltered() const;
+private:
+    ma_data_source_base base{};
+
+    bool baseInit{};
+
+    ma_uint32 channels = 0;
+    ma_uint32 sampleRate = 0;
+
+    std::atomic<TrackSource*> current{ nullptr };
+    std::atomic<TrackSource*> next{ nullptr };
+    std::atomic<TrackSource*> pendingCut{ nullptr };
+
+    std::atomic<ma_uint64> crossfadeFrames{ 0 };
+    std::atomic<ma_uint64> cutFrames{ 0 };
+
+    static constexpr ma_uint64 noSeek = ~ma_uint64(0);
+
+    std::atomic<ma_uint64> pendingSeek{ noSeek };
+    std::atomic<FadeCurve> crossfadeCurve{ FadeCurve::EqualPower };
+
+    // audio thread only, the track fading out under the current one
+    TrackSource* outgoing = nullptr;
+    FadeCurve fadeCurve = FadeCurve::EqualPower;
+    ma_uint64 fadePos = 0;
+    ma_uint64 fadeLength = 0;
+
+    // outgoing track's frames for one mix block
+    float* scratch = nullptr;
+
+    // lock free stack, pushed from the audio thread
+    std::atomic<TrackSource*> retired{ nullptr };
+
+    std::atomic<uint32_t> advanceCount{ 0 };
+
+    // audio thread only
+    ma_uint64 readCursor = 0;
+    uint64_t readFrames = 0;
+
+    Wakeup* wakeup = nullptr;
+
+    void retire(TrackSource* track);
+
+    void takeCut();
+    void takeSeek();
+    void beginFade(TrackSource* from, ma_uint64 frames, FadeCurve curve);
+    void endFade();
+    void advanced();
+    ma_uint64 mixFade(TrackSource* to, float* out, ma_uint64 frames);
+
+    static const ma_data_source_vtable vtable;
+
+    static ma_result onRead(ma_data_source* ds, void* out, ma_uint64 frameCount, ma_uint64* framesRead);
+    static ma_result onSeek(ma_data_source* ds, ma_uint64 frame);
+    static ma_result onGetDataFormat(ma_data_source* ds, ma_format* format, ma_uint32* channels, ma_uint32* sampleRate, ma_channel* channelMap, size_t channelMapCap);
+    static ma_result onGetCursor(ma_data_source* ds, ma_uint64* cursor);
+    static ma_result onGetLength(ma_data_source* ds, ma_uint64* length);
+};
\ No newline at end of file
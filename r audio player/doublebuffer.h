@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// one writer hands whole values to one reader without either side waiting or allocating
+// the writer fills the back slot and publishes it, the reader switches to it at the next read()
+// whoever clears the fresh flag first owns the back slot, so a value the reader never took is
+// simply written over, and one it did take leaves the writer the slot it just let go of
+template <typename T>
+class DoubleBuffer
+{
+public:
+    // writer, the slot to fill before publish(), it holds whatever was written two values ago
+    T& edit()
+    {
+        if (pending)
+        {
+            if (!fresh.exchange(false, std::memory_order_acq_rel))
+            {
+                back ^= 1;
+            }
+
+            pending = false;
+        }
+
+        return slots[back];
+    }
+
+    void publish()
+    {
+        pending = true;
+
+        fresh.store(true, std::memory_order_release);
+    }
+
+    // reader, the newest published value, which stays put until the next call
+    const T& read()
+    {
+        if (fresh.load(std::memory_order_relaxed)
+            && fresh.exchange(false, std::memory_order_acq_rel))
+        {
+            front ^= 1;
+        }
+
+        return slots[front];
+    }
+private:
+    T slots[2]{};
+
+    std::atomic<bool> fresh{ false };
+
+    // writer only
+    uint32_t back = 1;
+    bool pending = false;
+
+    // reader only
+    uint32_t front = 0;
+};
\ No newline at end of file
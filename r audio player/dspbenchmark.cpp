@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+#include "dspkernels.h"
+
+namespace
+{
+    // about one device period of stereo, odd so every tail loop runs too
+    constexpr size_t blockFrames = 1021;
+    constexpr size_t blockSamples = blockFrames * 2;
+
+    // per kernel and variant, long enough to ride over timer resolution and frequency ramps
+    constexpr std::chrono::milliseconds runTime{ 200 };
+
+    struct Inputs
+    {
+        std::vector<float> f32;
+        std::vector<int16_t> s16;
+        std::vector<uint8_t> s24;
+        std::vector<int32_t> s32;
+    };
+
+    Inputs makeInputs()
+    {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+        std::uniform_int_distribution<uint32_t> bits;
+
+        Inputs in;
+
+        in.f32.resize(blockSamples);
+        in.s16.resize(blockSamples);
+        in.s24.resize(blockSamples * 3);
+        in.s32.resize(blockSamples);
+
+        for (size_t i = 0; i < blockSamples; ++i)
+        {
+            const uint32_t r = bits(rng);
+
+            in.f32[i] = sample(rng);
+            in.s16[i] = int16_t(r);
+            in.s32[i] = int32_t(r);
+            in.s24[i * 3] = uint8_t(r);
+            in.s24[i * 3 + 1] = uint8_t(r >> 8);
+            in.s24[i * 3 + 2] = uint8_t(r >> 16);
+        }
+
+        return in;
+    }
+
+    // one kernel call over a block, writing what it produced to out
+    using Run = std::function<void(const DspKernels&, const Inputs&, std::vector<float>& out)>;
+
+    struct Case
+    {
+        const char* name;
+        Run run;
+
+        // the time is shared out over this many units of work a sample, so a cascade reads per band
+        size_t units = 1;
+    };
+
+    // mild, stable and a little different on every lane
+    BiquadCoefficients benchCoefficients()
+    {
+        BiquadCoefficients c;
+
+        for (size_t k = 0; k < biquadLanes; ++k)
+        {
+            c.b0[k] = 0.9f + 0.01f * float(k);
+            c.b1[k] = -0.6f;
+            c.b2[k] = 0.1f;
+            c.a1[k] = -0.7f + 0.02f * float(k);
+            c.a2[k] = 0.2f;
+        }
+
+        return c;
+    }
+
+    // any spread of taps will do for timing and agreement
+    TruePeakFilter benchTruePeak()
+    {
+        TruePeakFilter f;
+
+        for (size_t p = 0; p < truePeakPhases; ++p)
+        {
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                f.h[p][k] = std::sin(float(p * truePeakTaps + k) * 0.37f) / float(k + 1);
+            }
+        }
+
+        return f;
+    }
+
+    std::vector<Case> cases()
+    {
+        return {
+            {
+                "gain",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out = in.f32;
+
+                    k.gain(out.data(), blockSamples, 0.7f);
+                }
+            },
+            {
+                "gain ramp",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out = in.f32;
+
+                    k.gainRamp(out.data(), blockFrames, 2, 0.2f, 0.9f);
+                }
+            },
+            {
+                "s16 to f32",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out.resize(blockSamples);
+
+                    k.s16ToF32(in.s16.data(), out.data(), blockSamples);
+                }
+            },
+            {
+                "s24 to f32",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out.resize(blockSamples);
+
+                    k.s24ToF32(in.s24.data(), out.data(), blockSamples);
+                }
+            },
+            {
+                "s32 to f32",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out.resize(blockSamples);
+
+                    k.s32ToF32(in.s32.data(), out.data(), blockSamples);
+                }
+            },
+            {
+                "f32 to s16",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    std::vector<int16_t> s(blockSamples);
+
+                    k.f32ToS16(in.f32.data(), s.data(), blockSamples);
+
+                    out.assign(s.begin(), s.end());
+                }
+            },
+            {
+                "f32 to s24",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    std::vector<uint8_t> s(blockSamples * 3);
+
+                    k.f32ToS24(in.f32.data(), s.data(), blockSamples);
+
+                    out.assign(s.begin(), s.end());
+                }
+            },
+            {
+                "f32 to s32",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    std::vector<int32_t> s(blockSamples);
+
+                    k.f32ToS32(in.f32.data(), s.data(), blockSamples);
+
+                    out.assign(s.begin(), s.end());
+                }
+            },
+            {
+                "interleave",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out.resize(blockSamples);
+
+                    k.interleave2(in.f32.data(), in.f32.data() + blockFrames, out.data(), blockFrames);
+                }
+            },
+            {
+                "deinterleave",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    out.resize(blockSamples);
+
+                    k.deinterleave2(in.f32.data(), out.data(), out.data() + blockFrames, blockFrames);
+                }
+            },
+            {
+                "peak/rms",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    float peak = 0.0f;
+                    double sum = 0.0;
+
+                    k.peakRms(in.f32.data(), blockSamples, peak, sum);
+
+                    out = { peak, float(std::sqrt(sum / double(blockSamples))) };
+                }
+            },
+            {
+                // a 36 tap filter slid along the block, so the tail is covered too
+                "dot",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    constexpr size_t taps = 36;
+
+                    out.resize(blockSamples - taps);
+
+                    for (size_t i = 0; i < out.size(); ++i)
+                    {
+                        out[i] = k.dot(in.f32.data() + i, in.f32.data() + blockSamples - taps, taps);
+                    }
+                }
+            },
+            {
+                // a full cascade from rest each call, timed per band
+                "biquad/band",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    static const BiquadCoefficients c = benchCoefficients();
+
+                    BiquadState state[2]{};
+
+                    out = in.f32;
+
+                    k.biquadCascade(out.data(), blockFrames, 2, c, state);
+                },
+                biquadLanes
+            },
+            {
+                // the block split in four, the first half of it as a spectrum times the second
+                "complex mac",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    constexpr size_t bins = blockSamples / 4;
+
+                    const float* x = in.f32.data();
+
+                    out.assign(bins * 2, 0.0f);
+
+                    k.complexMac(x, x + bins, x + bins * 2, x + bins * 3, out.data(), out.data() + bins, bins);
+                }
+            },
+            {
+                // one pass over the block split into the same four arrays, the twiddles taken from the input as they are
+                "fft pass",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    constexpr size_t bins = blockSamples / 4;
+
+                    out = in.f32;
+
+                    float* x = out.data();
+
+                    k.fftButterflies(x, x + bins, x + bins * 2, x + bins * 3, in.f32.data(), in.f32.data() + bins, bins);
+                }
+            },
+            {
+                // the block as one channel, its first samples as the history
+                "true peak",
+                [](const DspKernels& k, const Inputs& in, std::vector<float>& out)
+                {
+                    static const TruePeakFilter f = benchTruePeak();
+
+                    constexpr size_t history = truePeakTaps - 1;
+
+                    out.assign(blockSamples - history, 0.0f);
+
+                    k.truePeak(in.f32.data() + history, out.size(), f, out.data());
+                }
+            }
+        };
+    }
+
+    // ns per sample and unit
+    double timeCase(const Case& c, const DspKernels& k, const Inputs& in, std::vector<float>& out)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // warm the caches and the branch predictor first
+        for (int i = 0; i < 100; ++i)
+        {
+            c.run(k, in, out);
+        }
+
+        size_t calls = 0;
+
+        const auto start = clock::now();
+
+        auto now = start;
+
+        while (now - start < runTime)
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                c.run(k, in, out);
+            }
+
+            calls += 100;
+            now = clock::now();
+        }
+
+        const double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+
+        return ns / double(calls * blockSamples * c.units);
+    }
+
+    float maxError(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return INFINITY;
+        }
+
+        float e = 0.0f;
+
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            // relative above 1, absolute below
+            e = std::max(e, std::abs(a[i] - b[i]) / std::max(1.0f, std::abs(b[i])));
+        }
+
+        return e;
+    }
+}
+
+int runDspBenchmark()
+{
+    const Inputs in = makeInputs();
+    const std::vector<const DspKernels*> variants = dspVariants();
+
+    std::printf("dsp kernels, %zu stereo frames a call, dispatching to %s\n\n", blockFrames, dspKernels().name);
+    std::printf("%-14s %-8s %12s %9s %12s\n", "kernel", "variant", "ns/sample", "speedup", "max error");
+
+    int failed = 0;
+
+    for (const Case& c : cases())
+    {
+        std::vector<float> reference;
+        std::vector<float> out;
+
+        const double base = timeCase(c, *scalarKernels(), in, reference);
+
+        for (const DspKernels* k : variants)
+        {
+            const double ns = k == scalarKernels()
+                ? base
+                : timeCase(c, *k, in, out);
+
+            const float error = k == scalarKernels()
+                ? 0.0f
+                : maxError(out, reference);
+
+            // the rms is summed in a different order, everything else should match to the bit or close to it
+            const bool ok = error <= 1e-6f;
+
+            if (!ok)
+            {
+                ++failed;
+            }
+
+            std::printf(
+                "%-14s %-8s %12.4f %8.2fx %12.3g%s\n",
+                c.name,
+                k->name,
+                ns,
+                base / ns,
+                double(error),
+                ok
+                    ? ""
+                    : "  mismatch"
+            );
+        }
+    }
+
+    std::fflush(stdout);
+
+    return failed == 0
+        ? 0
+        : 1;
+}
\ No newline at end of file
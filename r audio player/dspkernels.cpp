@@ -0,0 +1,1325 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dspkernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DSP_X86 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    constexpr float s16Scale = 1.0f / 32768.0f;
+    constexpr float s32Scale = 1.0f / 2147483648.0f;
+
+    // the largest float under 2^31, +1.0 would wrap
+    constexpr float s32Max = 2147483520.0f;
+
+    // scalar, the reference every other variant is checked against
+
+    void gainScalar(float* x, size_t n, float g)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] *= g;
+        }
+    }
+
+    void gainRampScalar(float* x, size_t frames, uint32_t channels, float from, float to)
+    {
+        if (frames == 0)
+        {
+            return;
+        }
+
+        const float step = (to - from) / float(frames);
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            const float g = from + step * float(f);
+
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                x[f * channels + c] *= g;
+            }
+        }
+    }
+
+    void s16ToF32Scalar(const int16_t* in, float* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = float(in[i]) * s16Scale;
+        }
+    }
+
+    inline int32_t loadS24(const uint8_t* p)
+    {
+        // into the top three bytes, so the sign comes along and it scales like s32
+        return int32_t(
+            uint32_t(p[0]) << 8
+            | uint32_t(p[1]) << 16
+            | uint32_t(p[2]) << 24
+        );
+    }
+
+    void s24ToF32Scalar(const uint8_t* in, float* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = float(loadS24(in + i * 3)) * s32Scale;
+        }
+    }
+
+    void s32ToF32Scalar(const int32_t* in, float* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = float(in[i]) * s32Scale;
+        }
+    }
+
+    // ties to even, like the vector conversions
+    inline int32_t roundClamp(float x, float lo, float hi)
+    {
+        return int32_t(std::nearbyint(std::clamp(x, lo, hi)));
+    }
+
+    void f32ToS16Scalar(const float* in, int16_t* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = int16_t(roundClamp(in[i] * 32768.0f, -32768.0f, 32767.0f));
+        }
+    }
+
+    inline void storeS24(uint8_t* p, int32_t v)
+    {
+        p[0] = uint8_t(v);
+        p[1] = uint8_t(v >> 8);
+        p[2] = uint8_t(v >> 16);
+    }
+
+    void f32ToS24Scalar(const float* in, uint8_t* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            storeS24(out + i * 3, roundClamp(in[i] * 8388608.0f, -8388608.0f, 8388607.0f));
+        }
+    }
+
+    void f32ToS32Scalar(const float* in, int32_t* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = roundClamp(in[i] * 2147483648.0f, -2147483648.0f, s32Max);
+        }
+    }
+
+    void interleave2Scalar(const float* left, const float* right, float* out, size_t frames)
+    {
+        for (size_t i = 0; i < frames; ++i)
+        {
+            out[i * 2] = left[i];
+            out[i * 2 + 1] = right[i];
+        }
+    }
+
+    void deinterleave2Scalar(const float* in, float* left, float* right, size_t frames)
+    {
+        for (size_t i = 0; i < frames; ++i)
+        {
+            left[i] = in[i * 2];
+            right[i] = in[i * 2 + 1];
+        }
+    }
+
+    void peakRmsScalar(const float* x, size_t n, float& peak, double& sumSquares)
+    {
+        float p = peak;
+        double s = 0.0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            p = std::max(p, std::abs(x[i]));
+            s += double(x[i]) * double(x[i]);
+        }
+
+        peak = p;
+        sumSquares += s;
+    }
+
+    float dotScalar(const float* a, const float* b, size_t n)
+    {
+        float acc[8] = {};
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            for (size_t k = 0; k < 8; ++k)
+            {
+                acc[k] += a[i + k] * b[i + k];
+            }
+        }
+
+        // lanes k and k + 4 first, then the way a horizontal add folds them
+        float s = ((acc[0] + acc[4]) + (acc[2] + acc[6])) + ((acc[1] + acc[5]) + (acc[3] + acc[7]));
+
+        for (; i < n; ++i)
+        {
+            s += a[i] * b[i];
+        }
+
+        return s;
+    }
+
+    void biquadCascadeScalar(float* x, size_t frames, uint32_t channels, const BiquadCoefficients& c, BiquadState* state)
+    {
+        for (uint32_t ch = 0; ch < channels; ++ch)
+        {
+            BiquadState& s = state[ch];
+
+            float* p = x + ch;
+
+            for (size_t i = 0; i < frames; ++i, p += channels)
+            {
+                float in[biquadLanes];
+
+                // everything moves one band down the chain
+                in[0] = *p;
+
+                for (size_t k = 1; k < biquadLanes; ++k)
+                {
+                    in[k] = s.y[k - 1];
+                }
+
+                for (size_t k = 0; k < biquadLanes; ++k)
+                {
+                    const float y = c.b0[k] * in[k] + s.s1[k];
+
+                    s.s1[k] = (c.b1[k] * in[k] - c.a1[k] * y) + s.s2[k];
+                    s.s2[k] = c.b2[k] * in[k] - c.a2[k] * y;
+                    s.y[k] = y;
+                }
+
+                *p = s.y[biquadLanes - 1];
+            }
+        }
+    }
+
+    void complexMacScalar(const float* aRe, const float* aIm, const float* bRe, const float* bIm, float* accRe, float* accIm, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+            accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+        }
+    }
+
+    void fftButterfliesScalar(float* re0, float* im0, float* re1, float* im1, const float* wRe, const float* wIm, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float tr = re1[i] * wRe[i] - im1[i] * wIm[i];
+            const float ti = re1[i] * wIm[i] + im1[i] * wRe[i];
+
+            re1[i] = re0[i] - tr;
+            im1[i] = im0[i] - ti;
+            re0[i] = re0[i] + tr;
+            im0[i] = im0[i] + ti;
+        }
+    }
+
+    void truePeakScalar(const float* x, size_t n, const TruePeakFilter& f, float* peak)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            float a0 = 0.0f;
+            float a1 = 0.0f;
+            float a2 = 0.0f;
+            float a3 = 0.0f;
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                const float v = x[ptrdiff_t(i) - ptrdiff_t(k)];
+
+                a0 += f.h[0][k] * v;
+                a1 += f.h[1][k] * v;
+                a2 += f.h[2][k] * v;
+                a3 += f.h[3][k] * v;
+            }
+
+            const float m = std::max(
+                std::max(std::abs(a0), std::abs(a1)),
+                std::max(std::abs(a2), std::abs(a3))
+            );
+
+            peak[i] = std::max(peak[i], m);
+        }
+    }
+
+    const DspKernels scalar =
+    {
+        "scalar",
+        &gainScalar,
+        &gainRampScalar,
+        &s16ToF32Scalar,
+        &s24ToF32Scalar,
+        &s32ToF32Scalar,
+        &f32ToS16Scalar,
+        &f32ToS24Scalar,
+        &f32ToS32Scalar,
+        &interleave2Scalar,
+        &deinterleave2Scalar,
+        &peakRmsScalar,
+        &dotScalar,
+        &biquadCascadeScalar,
+        &complexMacScalar,
+        &fftButterfliesScalar,
+        &truePeakScalar
+    };
+
+#ifdef DSP_X86
+    // sse2, always there on x86-64
+
+    void gainSse2(float* x, size_t n, float g)
+    {
+        const __m128 v = _mm_set1_ps(g);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), v));
+        }
+
+        gainScalar(x + i, n - i, g);
+    }
+
+    void gainRampSse2(float* x, size_t frames, uint32_t channels, float from, float to)
+    {
+        // four lanes hold whole frames only for mono and stereo
+        if (frames == 0
+            || (channels != 1 && channels != 2))
+        {
+            gainRampScalar(x, frames, channels, from, to);
+
+            return;
+        }
+
+        const float step = (to - from) / float(frames);
+        const size_t n = frames * channels;
+
+        // frame index of each lane, and how far it moves per vector
+        __m128 index = channels == 1
+            ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)
+            : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+
+        const __m128 advance = _mm_set1_ps(float(4 / channels));
+        const __m128 vstep = _mm_set1_ps(step);
+        const __m128 vfrom = _mm_set1_ps(from);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 g = _mm_add_ps(vfrom, _mm_mul_ps(vstep, index));
+
+            _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), g));
+
+            index = _mm_add_ps(index, advance);
+        }
+
+        for (; i < n; ++i)
+        {
+            x[i] *= from + step * float(i / channels);
+        }
+    }
+
+    void s16ToF32Sse2(const int16_t* in, float* out, size_t n)
+    {
+        const __m128 scale = _mm_set1_ps(s16Scale);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+            // sign extend by unpacking into the high halves and shifting back down
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+
+        s16ToF32Scalar(in + i, out + i, n - i);
+    }
+
+    void s24ToF32Sse2(const uint8_t* in, float* out, size_t n)
+    {
+        // no byte shuffle before ssse3, the samples are gathered one by one and converted four at a time
+        const __m128 scale = _mm_set1_ps(s32Scale);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const uint8_t* p = in + i * 3;
+
+            const __m128i v = _mm_setr_epi32(
+                loadS24(p),
+                loadS24(p + 3),
+                loadS24(p + 6),
+                loadS24(p + 9)
+            );
+
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+        }
+
+        s24ToF32Scalar(in + i * 3, out + i, n - i);
+    }
+
+    void s32ToF32Sse2(const int32_t* in, float* out, size_t n)
+    {
+        const __m128 scale = _mm_set1_ps(s32Scale);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+        }
+
+        s32ToF32Scalar(in + i, out + i, n - i);
+    }
+
+    // scaled, clamped and rounded by the current mode, which is to nearest unless someone changed it
+    inline __m128i toIntSse2(const float* p, __m128 scale, __m128 lo, __m128 hi)
+    {
+        const __m128 v = _mm_mul_ps(_mm_loadu_ps(p), scale);
+
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+    }
+
+    void f32ToS16Sse2(const float* in, int16_t* out, size_t n)
+    {
+        const __m128 scale = _mm_set1_ps(32768.0f);
+        const __m128 lo = _mm_set1_ps(-32768.0f);
+        const __m128 hi = _mm_set1_ps(32767.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m128i a = toIntSse2(in + i, scale, lo, hi);
+            const __m128i b = toIntSse2(in + i + 4, scale, lo, hi);
+
+            // already in range, the saturating pack only narrows
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+        }
+
+        f32ToS16Scalar(in + i, out + i, n - i);
+    }
+
+    void f32ToS24Sse2(const float* in, uint8_t* out, size_t n)
+    {
+        const __m128 scale = _mm_set1_ps(8388608.0f);
+        const __m128 lo = _mm_set1_ps(-8388608.0f);
+        const __m128 hi = _mm_set1_ps(8388607.0f);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            alignas(16) int32_t v[4];
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(v), toIntSse2(in + i, scale, lo, hi));
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                storeS24(out + (i + k) * 3, v[k]);
+            }
+        }
+
+        f32ToS24Scalar(in + i, out + i * 3, n - i);
+    }
+
+    void f32ToS32Sse2(const float* in, int32_t* out, size_t n)
+    {
+        const __m128 scale = _mm_set1_ps(2147483648.0f);
+        const __m128 lo = _mm_set1_ps(-2147483648.0f);
+        const __m128 hi = _mm_set1_ps(s32Max);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), toIntSse2(in + i, scale, lo, hi));
+        }
+
+        f32ToS32Scalar(in + i, out + i, n - i);
+    }
+
+    void interleave2Sse2(const float* left, const float* right, float* out, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 l = _mm_loadu_ps(left + i);
+            const __m128 r = _mm_loadu_ps(right + i);
+
+            _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+        }
+
+        interleave2Scalar(left + i, right + i, out + i * 2, frames - i);
+    }
+
+    void deinterleave2Sse2(const float* in, float* left, float* right, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(in + i * 2);
+            const __m128 b = _mm_loadu_ps(in + i * 2 + 4);
+
+            _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+
+        deinterleave2Scalar(in + i * 2, left + i, right + i, frames - i);
+    }
+
+    void peakRmsSse2(const float* x, size_t n, float& peak, double& sumSquares)
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+        __m128 p = _mm_set1_ps(peak);
+        __m128d s0 = _mm_setzero_pd();
+        __m128d s1 = _mm_setzero_pd();
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(x + i);
+
+            p = _mm_max_ps(p, _mm_and_ps(v, absMask));
+
+            // squares summed in double like the scalar version, a long block would drift in float
+            const __m128d lo = _mm_cvtps_pd(v);
+            const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+
+            s0 = _mm_add_pd(s0, _mm_mul_pd(lo, lo));
+            s1 = _mm_add_pd(s1, _mm_mul_pd(hi, hi));
+        }
+
+        alignas(16) float lanes[4];
+        alignas(16) double sums[2];
+
+        _mm_store_ps(lanes, p);
+        _mm_store_pd(sums, _mm_add_pd(s0, s1));
+
+        peak = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+        sumSquares += sums[0] + sums[1];
+
+        peakRmsScalar(x + i, n - i, peak, sumSquares);
+    }
+
+    float dotSse2(const float* a, const float* b, size_t n)
+    {
+        __m128 lo = _mm_setzero_ps();
+        __m128 hi = _mm_setzero_ps();
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        __m128 v = _mm_add_ps(lo, hi);
+
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+
+        float s = _mm_cvtss_f32(v);
+
+        for (; i < n; ++i)
+        {
+            s += a[i] * b[i];
+        }
+
+        return s;
+    }
+
+    void biquadCascadeSse2(float* x, size_t frames, uint32_t channels, const BiquadCoefficients& c, BiquadState* state)
+    {
+        constexpr size_t vectors = biquadLanes / 4;
+
+        for (uint32_t ch = 0; ch < channels; ++ch)
+        {
+            BiquadState& s = state[ch];
+
+            __m128 y[vectors];
+            __m128 s1[vectors];
+            __m128 s2[vectors];
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                y[v] = _mm_loadu_ps(s.y + v * 4);
+                s1[v] = _mm_loadu_ps(s.s1 + v * 4);
+                s2[v] = _mm_loadu_ps(s.s2 + v * 4);
+            }
+
+            float* p = x + ch;
+
+            for (size_t i = 0; i < frames; ++i, p += channels)
+            {
+                // each vector rotated up a lane, lane 0 then comes from the top of the one before
+                __m128 carry = _mm_set_ss(*p);
+
+                for (size_t v = 0; v < vectors; ++v)
+                {
+                    const __m128 rotated = _mm_shuffle_ps(y[v], y[v], _MM_SHUFFLE(2, 1, 0, 3));
+                    const __m128 in = _mm_move_ss(rotated, carry);
+
+                    carry = rotated;
+
+                    const __m128 out = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(c.b0 + v * 4), in), s1[v]);
+
+                    s1[v] = _mm_add_ps(
+                        _mm_sub_ps(
+                            _mm_mul_ps(_mm_loadu_ps(c.b1 + v * 4), in),
+                            _mm_mul_ps(_mm_loadu_ps(c.a1 + v * 4), out)),
+                        s2[v]);
+
+                    s2[v] = _mm_sub_ps(
+                        _mm_mul_ps(_mm_loadu_ps(c.b2 + v * 4), in),
+                        _mm_mul_ps(_mm_loadu_ps(c.a2 + v * 4), out));
+
+                    y[v] = out;
+                }
+
+                *p = _mm_cvtss_f32(_mm_shuffle_ps(y[vectors - 1], y[vectors - 1], _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                _mm_storeu_ps(s.y + v * 4, y[v]);
+                _mm_storeu_ps(s.s1 + v * 4, s1[v]);
+                _mm_storeu_ps(s.s2 + v * 4, s2[v]);
+            }
+        }
+    }
+
+    void complexMacSse2(const float* aRe, const float* aIm, const float* bRe, const float* bIm, float* accRe, float* accIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 ar = _mm_loadu_ps(aRe + i);
+            const __m128 ai = _mm_loadu_ps(aIm + i);
+            const __m128 br = _mm_loadu_ps(bRe + i);
+            const __m128 bi = _mm_loadu_ps(bIm + i);
+
+            _mm_storeu_ps(accRe + i, _mm_add_ps(_mm_loadu_ps(accRe + i), _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+            _mm_storeu_ps(accIm + i, _mm_add_ps(_mm_loadu_ps(accIm + i), _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))));
+        }
+
+        complexMacScalar(aRe + i, aIm + i, bRe + i, bIm + i, accRe + i, accIm + i, n - i);
+    }
+
+    void fftButterfliesSse2(float* re0, float* im0, float* re1, float* im1, const float* wRe, const float* wIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 xr = _mm_loadu_ps(re1 + i);
+            const __m128 xi = _mm_loadu_ps(im1 + i);
+            const __m128 wr = _mm_loadu_ps(wRe + i);
+            const __m128 wi = _mm_loadu_ps(wIm + i);
+
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+
+            const __m128 ar = _mm_loadu_ps(re0 + i);
+            const __m128 ai = _mm_loadu_ps(im0 + i);
+
+            _mm_storeu_ps(re1 + i, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(im1 + i, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(re0 + i, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(im0 + i, _mm_add_ps(ai, ti));
+        }
+
+        fftButterfliesScalar(re0 + i, im0 + i, re1 + i, im1 + i, wRe + i, wIm + i, n - i);
+    }
+
+    void truePeakSse2(const float* x, size_t n, const TruePeakFilter& f, float* peak)
+    {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+
+        size_t i = 0;
+
+        // four outputs at a time, each tap a broadcast coefficient times four neighbouring inputs,
+        // the phases summed side by side so they don't wait on each other, written out for truePeakPhases = 4
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 a0 = _mm_setzero_ps();
+            __m128 a1 = _mm_setzero_ps();
+            __m128 a2 = _mm_setzero_ps();
+            __m128 a3 = _mm_setzero_ps();
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                const __m128 v = _mm_loadu_ps(x + i - k);
+
+                a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_set1_ps(f.h[0][k]), v));
+                a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_set1_ps(f.h[1][k]), v));
+                a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_set1_ps(f.h[2][k]), v));
+                a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_set1_ps(f.h[3][k]), v));
+            }
+
+            const __m128 m = _mm_max_ps(
+                _mm_max_ps(_mm_andnot_ps(sign, a0), _mm_andnot_ps(sign, a1)),
+                _mm_max_ps(_mm_andnot_ps(sign, a2), _mm_andnot_ps(sign, a3))
+            );
+
+            _mm_storeu_ps(peak + i, _mm_max_ps(_mm_loadu_ps(peak + i), m));
+        }
+
+        truePeakScalar(x + i, n - i, f, peak + i);
+    }
+
+    const DspKernels sse2 =
+    {
+        "sse2",
+        &gainSse2,
+        &gainRampSse2,
+        &s16ToF32Sse2,
+        &s24ToF32Sse2,
+        &s32ToF32Sse2,
+        &f32ToS16Sse2,
+        &f32ToS24Sse2,
+        &f32ToS32Sse2,
+        &interleave2Sse2,
+        &deinterleave2Sse2,
+        &peakRmsSse2,
+        &dotSse2,
+        &biquadCascadeSse2,
+        &complexMacSse2,
+        &fftButterfliesSse2,
+        &truePeakSse2
+    };
+
+    void cpuid(int leaf, int sub, unsigned int (&r)[4])
+    {
+#ifdef _MSC_VER
+        int v[4];
+
+        __cpuidex(v, leaf, sub);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            r[i] = unsigned(v[i]);
+        }
+#else
+        r[0] = r[1] = r[2] = r[3] = 0;
+
+        __get_cpuid_count(unsigned(leaf), unsigned(sub), &r[0], &r[1], &r[2], &r[3]);
+#endif
+    }
+
+    bool hasSse2()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#else
+        unsigned int r[4];
+
+        cpuid(1, 0, r);
+
+        return (r[3] >> 26) & 1;
+#endif
+    }
+
+    bool hasAvx2()
+    {
+        unsigned int r[4];
+
+        cpuid(0, 0, r);
+
+        if (r[0] < 7)
+        {
+            return false;
+        }
+
+        cpuid(1, 0, r);
+
+        // the os has to save the ymm registers too, not just the cpu have them
+        const bool osxsave = (r[2] >> 27) & 1;
+        const bool avx = (r[2] >> 28) & 1;
+
+        if (!osxsave
+            || !avx)
+        {
+            return false;
+        }
+
+#ifdef _MSC_VER
+        const unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int lo = 0;
+        unsigned int hi = 0;
+
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+
+        const unsigned long long xcr0 = (unsigned long long)hi << 32 | lo;
+#endif
+
+        if ((xcr0 & 6) != 6)
+        {
+            return false;
+        }
+
+        cpuid(7, 0, r);
+
+        return (r[1] >> 5) & 1;
+    }
+#endif
+
+#ifdef DSP_NEON
+    // neon, always there on arm64
+
+    void gainNeon(float* x, size_t n, float g)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_f32(x + i, vmulq_n_f32(vld1q_f32(x + i), g));
+        }
+
+        gainScalar(x + i, n - i, g);
+    }
+
+    void gainRampNeon(float* x, size_t frames, uint32_t channels, float from, float to)
+    {
+        if (frames == 0
+            || (channels != 1 && channels != 2))
+        {
+            gainRampScalar(x, frames, channels, from, to);
+
+            return;
+        }
+
+        const float step = (to - from) / float(frames);
+        const size_t n = frames * channels;
+
+        static const float mono[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        static const float stereo[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+        float32x4_t index = vld1q_f32(channels == 1 ? mono : stereo);
+
+        const float32x4_t advance = vdupq_n_f32(float(4 / channels));
+        const float32x4_t vfrom = vdupq_n_f32(from);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            // a separate multiply and add, a fused one would round differently from the scalar loop
+            const float32x4_t g = vaddq_f32(vfrom, vmulq_n_f32(index, step));
+
+            vst1q_f32(x + i, vmulq_f32(vld1q_f32(x + i), g));
+
+            index = vaddq_f32(index, advance);
+        }
+
+        for (; i < n; ++i)
+        {
+            x[i] *= from + step * float(i / channels);
+        }
+    }
+
+    void s16ToF32Neon(const int16_t* in, float* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const int16x8_t v = vld1q_s16(in + i);
+
+            vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), s16Scale));
+            vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), s16Scale));
+        }
+
+        s16ToF32Scalar(in + i, out + i, n - i);
+    }
+
+    void s24ToF32Neon(const uint8_t* in, float* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            // splits eight samples into their low, middle and high bytes
+            const uint8x8x3_t b = vld3_u8(in + i * 3);
+
+            // high and middle bytes as one 16 bit word, then the low byte shifted in under it
+            const uint16x8_t top = vorrq_u16(vshll_n_u8(b.val[2], 8), vmovl_u8(b.val[1]));
+            const uint16x8_t low = vmovl_u8(b.val[0]);
+
+            const uint32x4_t a = vorrq_u32(vshll_n_u16(vget_low_u16(top), 16), vshll_n_u16(vget_low_u16(low), 8));
+            const uint32x4_t c = vorrq_u32(vshll_n_u16(vget_high_u16(top), 16), vshll_n_u16(vget_high_u16(low), 8));
+
+            vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(a)), s32Scale));
+            vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(c)), s32Scale));
+        }
+
+        s24ToF32Scalar(in + i * 3, out + i, n - i);
+    }
+
+    void s32ToF32Neon(const int32_t* in, float* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), s32Scale));
+        }
+
+        s32ToF32Scalar(in + i, out + i, n - i);
+    }
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+    inline int32x4_t toIntNeon(const float* p, float scale, float32x4_t lo, float32x4_t hi)
+    {
+        const float32x4_t v = vmulq_n_f32(vld1q_f32(p), scale);
+
+        return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(v, lo), hi));
+    }
+
+    void f32ToS16Neon(const float* in, int16_t* out, size_t n)
+    {
+        const float32x4_t lo = vdupq_n_f32(-32768.0f);
+        const float32x4_t hi = vdupq_n_f32(32767.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const int16x4_t a = vmovn_s32(toIntNeon(in + i, 32768.0f, lo, hi));
+            const int16x4_t b = vmovn_s32(toIntNeon(in + i + 4, 32768.0f, lo, hi));
+
+            vst1q_s16(out + i, vcombine_s16(a, b));
+        }
+
+        f32ToS16Scalar(in + i, out + i, n - i);
+    }
+
+    void f32ToS24Neon(const float* in, uint8_t* out, size_t n)
+    {
+        const float32x4_t lo = vdupq_n_f32(-8388608.0f);
+        const float32x4_t hi = vdupq_n_f32(8388607.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const uint32x4_t a = vreinterpretq_u32_s32(toIntNeon(in + i, 8388608.0f, lo, hi));
+            const uint32x4_t b = vreinterpretq_u32_s32(toIntNeon(in + i + 4, 8388608.0f, lo, hi));
+
+            // the three low bytes of each sample as separate planes, stored interleaved
+            const uint16x8_t low16 = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+            const uint16x8_t high16 = vcombine_u16(vmovn_u32(vshrq_n_u32(a, 16)), vmovn_u32(vshrq_n_u32(b, 16)));
+
+            uint8x8x3_t planes;
+
+            planes.val[0] = vmovn_u16(low16);
+            planes.val[1] = vshrn_n_u16(low16, 8);
+            planes.val[2] = vmovn_u16(high16);
+
+            vst3_u8(out + i * 3, planes);
+        }
+
+        f32ToS24Scalar(in + i, out + i * 3, n - i);
+    }
+
+    void f32ToS32Neon(const float* in, int32_t* out, size_t n)
+    {
+        const float32x4_t lo = vdupq_n_f32(-2147483648.0f);
+        const float32x4_t hi = vdupq_n_f32(s32Max);
+
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_s32(out + i, toIntNeon(in + i, 2147483648.0f, lo, hi));
+        }
+
+        f32ToS32Scalar(in + i, out + i, n - i);
+    }
+#else
+    // 32 bit arm only converts towards zero, the scalar loops round the same way as everywhere else
+    void f32ToS16Neon(const float* in, int16_t* out, size_t n)
+    {
+        f32ToS16Scalar(in, out, n);
+    }
+
+    void f32ToS24Neon(const float* in, uint8_t* out, size_t n)
+    {
+        f32ToS24Scalar(in, out, n);
+    }
+
+    void f32ToS32Neon(const float* in, int32_t* out, size_t n)
+    {
+        f32ToS32Scalar(in, out, n);
+    }
+#endif
+
+    void interleave2Neon(const float* left, const float* right, float* out, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= frames; i += 4)
+        {
+            float32x4x2_t v;
+
+            v.val[0] = vld1q_f32(left + i);
+            v.val[1] = vld1q_f32(right + i);
+
+            vst2q_f32(out + i * 2, v);
+        }
+
+        interleave2Scalar(left + i, right + i, out + i * 2, frames - i);
+    }
+
+    void deinterleave2Neon(const float* in, float* left, float* right, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= frames; i += 4)
+        {
+            const float32x4x2_t v = vld2q_f32(in + i * 2);
+
+            vst1q_f32(left + i, v.val[0]);
+            vst1q_f32(right + i, v.val[1]);
+        }
+
+        deinterleave2Scalar(in + i * 2, left + i, right + i, frames - i);
+    }
+
+    void peakRmsNeon(const float* x, size_t n, float& peak, double& sumSquares)
+    {
+        float32x4_t p = vdupq_n_f32(peak);
+
+        size_t i = 0;
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+        float64x2_t s0 = vdupq_n_f64(0.0);
+        float64x2_t s1 = vdupq_n_f64(0.0);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const float32x4_t v = vld1q_f32(x + i);
+
+            p = vmaxq_f32(p, vabsq_f32(v));
+
+            const float64x2_t lo = vcvt_f64_f32(vget_low_f32(v));
+            const float64x2_t hi = vcvt_high_f64_f32(v);
+
+            s0 = vaddq_f64(s0, vmulq_f64(lo, lo));
+            s1 = vaddq_f64(s1, vmulq_f64(hi, hi));
+        }
+
+        sumSquares += vaddvq_f64(vaddq_f64(s0, s1));
+#else
+        // no double lanes on 32 bit arm, only the peak is vectorised
+        for (; i + 4 <= n; i += 4)
+        {
+            const float32x4_t v = vld1q_f32(x + i);
+
+            p = vmaxq_f32(p, vabsq_f32(v));
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                sumSquares += double(x[i + k]) * double(x[i + k]);
+            }
+        }
+#endif
+
+        float lanes[4];
+
+        vst1q_f32(lanes, p);
+
+        peak = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+
+        peakRmsScalar(x + i, n - i, peak, sumSquares);
+    }
+
+    float dotNeon(const float* a, const float* b, size_t n)
+    {
+        float32x4_t lo = vdupq_n_f32(0.0f);
+        float32x4_t hi = vdupq_n_f32(0.0f);
+
+        size_t i = 0;
+
+        // multiply then add, a fused multiply add would round differently from the scalar loop
+        for (; i + 8 <= n; i += 8)
+        {
+            lo = vaddq_f32(lo, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+            hi = vaddq_f32(hi, vmulq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4)));
+        }
+
+        const float32x4_t v = vaddq_f32(lo, hi);
+        const float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+
+        float s = vget_lane_f32(pair, 0) + vget_lane_f32(pair, 1);
+
+        for (; i < n; ++i)
+        {
+            s += a[i] * b[i];
+        }
+
+        return s;
+    }
+
+    void biquadCascadeNeon(float* x, size_t frames, uint32_t channels, const BiquadCoefficients& c, BiquadState* state)
+    {
+        constexpr size_t vectors = biquadLanes / 4;
+
+        for (uint32_t ch = 0; ch < channels; ++ch)
+        {
+            BiquadState& s = state[ch];
+
+            float32x4_t y[vectors];
+            float32x4_t s1[vectors];
+            float32x4_t s2[vectors];
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                y[v] = vld1q_f32(s.y + v * 4);
+                s1[v] = vld1q_f32(s.s1 + v * 4);
+                s2[v] = vld1q_f32(s.s2 + v * 4);
+            }
+
+            float* p = x + ch;
+
+            for (size_t i = 0; i < frames; ++i, p += channels)
+            {
+                // the top lane of the vector before followed by the bottom three of this one
+                float32x4_t carry = vdupq_n_f32(*p);
+
+                for (size_t v = 0; v < vectors; ++v)
+                {
+                    const float32x4_t in = vextq_f32(carry, y[v], 3);
+
+                    carry = y[v];
+
+                    const float32x4_t out = vaddq_f32(vmulq_f32(vld1q_f32(c.b0 + v * 4), in), s1[v]);
+
+                    s1[v] = vaddq_f32(
+                        vsubq_f32(
+                            vmulq_f32(vld1q_f32(c.b1 + v * 4), in),
+                            vmulq_f32(vld1q_f32(c.a1 + v * 4), out)),
+                        s2[v]);
+
+                    s2[v] = vsubq_f32(
+                        vmulq_f32(vld1q_f32(c.b2 + v * 4), in),
+                        vmulq_f32(vld1q_f32(c.a2 + v * 4), out));
+
+                    y[v] = out;
+                }
+
+                *p = vgetq_lane_f32(y[vectors - 1], 3);
+            }
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                vst1q_f32(s.y + v * 4, y[v]);
+                vst1q_f32(s.s1 + v * 4, s1[v]);
+                vst1q_f32(s.s2 + v * 4, s2[v]);
+            }
+        }
+    }
+
+    void complexMacNeon(const float* aRe, const float* aIm, const float* bRe, const float* bIm, float* accRe, float* accIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const float32x4_t ar = vld1q_f32(aRe + i);
+            const float32x4_t ai = vld1q_f32(aIm + i);
+            const float32x4_t br = vld1q_f32(bRe + i);
+            const float32x4_t bi = vld1q_f32(bIm + i);
+
+            vst1q_f32(accRe + i, vaddq_f32(vld1q_f32(accRe + i), vsubq_f32(vmulq_f32(ar, br), vmulq_f32(ai, bi))));
+            vst1q_f32(accIm + i, vaddq_f32(vld1q_f32(accIm + i), vaddq_f32(vmulq_f32(ar, bi), vmulq_f32(ai, br))));
+        }
+
+        complexMacScalar(aRe + i, aIm + i, bRe + i, bIm + i, accRe + i, accIm + i, n - i);
+    }
+
+    void fftButterfliesNeon(float* re0, float* im0, float* re1, float* im1, const float* wRe, const float* wIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const float32x4_t xr = vld1q_f32(re1 + i);
+            const float32x4_t xi = vld1q_f32(im1 + i);
+            const float32x4_t wr = vld1q_f32(wRe + i);
+            const float32x4_t wi = vld1q_f32(wIm + i);
+
+            const float32x4_t tr = vsubq_f32(vmulq_f32(xr, wr), vmulq_f32(xi, wi));
+            const float32x4_t ti = vaddq_f32(vmulq_f32(xr, wi), vmulq_f32(xi, wr));
+
+            const float32x4_t ar = vld1q_f32(re0 + i);
+            const float32x4_t ai = vld1q_f32(im0 + i);
+
+            vst1q_f32(re1 + i, vsubq_f32(ar, tr));
+            vst1q_f32(im1 + i, vsubq_f32(ai, ti));
+            vst1q_f32(re0 + i, vaddq_f32(ar, tr));
+            vst1q_f32(im0 + i, vaddq_f32(ai, ti));
+        }
+
+        fftButterfliesScalar(re0 + i, im0 + i, re1 + i, im1 + i, wRe + i, wIm + i, n - i);
+    }
+
+    void truePeakNeon(const float* x, size_t n, const TruePeakFilter& f, float* peak)
+    {
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t a0 = vdupq_n_f32(0.0f);
+            float32x4_t a1 = vdupq_n_f32(0.0f);
+            float32x4_t a2 = vdupq_n_f32(0.0f);
+            float32x4_t a3 = vdupq_n_f32(0.0f);
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                const float32x4_t v = vld1q_f32(x + i - k);
+
+                a0 = vaddq_f32(a0, vmulq_f32(vdupq_n_f32(f.h[0][k]), v));
+                a1 = vaddq_f32(a1, vmulq_f32(vdupq_n_f32(f.h[1][k]), v));
+                a2 = vaddq_f32(a2, vmulq_f32(vdupq_n_f32(f.h[2][k]), v));
+                a3 = vaddq_f32(a3, vmulq_f32(vdupq_n_f32(f.h[3][k]), v));
+            }
+
+            const float32x4_t m = vmaxq_f32(
+                vmaxq_f32(vabsq_f32(a0), vabsq_f32(a1)),
+                vmaxq_f32(vabsq_f32(a2), vabsq_f32(a3))
+            );
+
+            vst1q_f32(peak + i, vmaxq_f32(vld1q_f32(peak + i), m));
+        }
+
+        truePeakScalar(x + i, n - i, f, peak + i);
+    }
+
+    const DspKernels neon =
+    {
+        "neon",
+        &gainNeon,
+        &gainRampNeon,
+        &s16ToF32Neon,
+        &s24ToF32Neon,
+        &s32ToF32Neon,
+        &f32ToS16Neon,
+        &f32ToS24Neon,
+        &f32ToS32Neon,
+        &interleave2Neon,
+        &deinterleave2Neon,
+        &peakRmsNeon,
+        &dotNeon,
+        &biquadCascadeNeon,
+        &complexMacNeon,
+        &fftButterfliesNeon,
+        &truePeakNeon
+    };
+#endif
+
+    const DspKernels* pick()
+    {
+        const std::vector<const DspKernels*> v = dspVariants();
+
+        return v.back();
+    }
+}
+
+const DspKernels* scalarKernels()
+{
+    return &scalar;
+}
+
+const DspKernels* sse2Kernels()
+{
+#ifdef DSP_X86
+    return &sse2;
+#else
+    return nullptr;
+#endif
+}
+
+const DspKernels* neonKernels()
+{
+#ifdef DSP_NEON
+    return &neon;
+#else
+    return nullptr;
+#endif
+}
+
+std::vector<const DspKernels*> dspVariants()
+{
+    std::vector<const DspKernels*> v{ &scalar };
+
+#ifdef DSP_X86
+    if (hasSse2())
+    {
+        v.push_back(&sse2);
+    }
+
+    if (avx2Kernels()
+        && hasAvx2())
+    {
+        v.push_back(avx2Kernels());
+    }
+#endif
+
+#ifdef DSP_NEON
+    v.push_back(&neon);
+#endif
+
+    return v;
+}
+
+const DspKernels& dspKernels()
+{
+    // decided once, before the device starts, so the audio thread never sees it change
+    static const DspKernels* const chosen = pick();
+
+    return *chosen;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// bands in one biquad cascade, the ones a caller doesn't need are set to pass through
+constexpr size_t biquadLanes = 16;
+
+// normalised by a0, one band a lane
+struct BiquadCoefficients
+{
+    alignas(32) float b0[biquadLanes];
+    alignas(32) float b1[biquadLanes];
+    alignas(32) float b2[biquadLanes];
+    alignas(32) float a1[biquadLanes];
+    alignas(32) float a2[biquadLanes];
+};
+
+// one channel's cascade, the last output of every band and the transposed direct form ii terms
+struct BiquadState
+{
+    alignas(32) float y[biquadLanes];
+    alignas(32) float s1[biquadLanes];
+    alignas(32) float s2[biquadLanes];
+};
+
+// 4x oversampling for true peak metering, the interpolation filter split into its phases
+constexpr size_t truePeakPhases = 4;
+constexpr size_t truePeakTaps = 12;
+
+// the kernels keep one running sum per phase by name
+static_assert(truePeakPhases == 4);
+
+struct TruePeakFilter
+{
+    alignas(32) float h[truePeakPhases][truePeakTaps];
+};
+
+// the inner loops of the audio path, one table per instruction set
+// dspKernels() picks the widest one the cpu and os support the first time it is called,
+// every variant gives the same result as the scalar one to within float rounding
+struct DspKernels
+{
+    const char* name;
+
+    // x *= g over n samples
+    void (*gain)(float* x, size_t n, float g);
+
+    // interleaved frames, the gain moves linearly from 'from' towards 'to', reaching it one frame past the end
+    void (*gainRamp)(float* x, size_t frames, uint32_t channels, float from, float to);
+
+    // full scale integers to [-1, 1), s24 is packed little endian, 3 bytes a sample
+    void (*s16ToF32)(const int16_t* in, float* out, size_t n);
+    void (*s24ToF32)(const uint8_t* in, float* out, size_t n);
+    void (*s32ToF32)(const int32_t* in, float* out, size_t n);
+
+    // back to integers, rounded to nearest and clamped, exact for samples that came from the same width or narrower
+    void (*f32ToS16)(const float* in, int16_t* out, size_t n);
+    void (*f32ToS24)(const float* in, uint8_t* out, size_t n);
+    void (*f32ToS32)(const float* in, int32_t* out, size_t n);
+
+    void (*interleave2)(const float* left, const float* right, float* out, size_t frames);
+    void (*deinterleave2)(const float* in, float* left, float* right, size_t frames);
+
+    // largest magnitude and sum of squares, the caller keeps running totals
+    void (*peakRms)(const float* x, size_t n, float& peak, double& sumSquares);
+
+    // sum of a[i] * b[i], eight running sums added up in a fixed order so every variant agrees to the bit
+    float (*dot)(const float* a, const float* b, size_t n);
+
+    // interleaved frames through biquadLanes bands in series, in place, with one state per channel
+    // run as a pipeline, every band takes the output the band before it produced a frame earlier,
+    // so all of them work at once and the output lags the input by biquadLanes - 1 frames
+    void (*biquadCascade)(float* x, size_t frames, uint32_t channels, const BiquadCoefficients& c, BiquadState* state);
+
+    // split complex arrays, acc += a * b
+    void (*complexMac)(const float* aRe, const float* aIm, const float* bRe, const float* bIm, float* accRe, float* accIm, size_t n);
+
+    // one radix 2 fft pass over n butterflies, x0 += w * x1 and x1 = x0 - w * x1 with the old x0
+    void (*fftButterflies)(float* re0, float* im0, float* re1, float* im1, const float* wRe, const float* wIm, size_t n);
+
+    // one channel, peak[i] = max(peak[i], |sum of h[p][k] * x[i - k]|) over every phase p,
+    // so channels can share the peaks, x needs truePeakTaps - 1 samples of history before it
+    void (*truePeak)(const float* x, size_t n, const TruePeakFilter& f, float* peak);
+};
+
+const DspKernels& dspKernels();
+
+// every variant this machine can run, scalar first
+std::vector<const DspKernels*> dspVariants();
+
+// per instruction set, nullptr when not built in, the caller checks the cpu
+const DspKernels* scalarKernels();
+const DspKernels* sse2Kernels();
+const DspKernels* avx2Kernels();
+const DspKernels* neonKernels();
+
+// times each variant against the scalar one and checks they agree, prints a table, 0 when all agree
+int runDspBenchmark();
\ No newline at end of file
@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dspkernels.h"
+
+// built with avx2 code generation for this file alone, only reached once the cpu check passed
+// msvc takes the intrinsics without a flag, gcc and clang need -mavx2 (set in CMakeLists.txt)
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__AVX2__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace
+{
+    constexpr float s16Scale = 1.0f / 32768.0f;
+    constexpr float s32Scale = 1.0f / 2147483648.0f;
+    constexpr float s32Max = 2147483520.0f;
+
+    inline int32_t roundClamp(float x, float lo, float hi)
+    {
+        return int32_t(std::nearbyint(std::clamp(x, lo, hi)));
+    }
+
+    inline __m256i toIntAvx2(const float* p, __m256 scale, __m256 lo, __m256 hi)
+    {
+        const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(p), scale);
+
+        return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(v, lo), hi));
+    }
+
+    // the tails go through the same formulas as the scalar kernels
+
+    void gainAvx2(float* x, size_t n, float g)
+    {
+        const __m256 v = _mm256_set1_ps(g);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), v));
+        }
+
+        for (; i < n; ++i)
+        {
+            x[i] *= g;
+        }
+    }
+
+    void gainRampAvx2(float* x, size_t frames, uint32_t channels, float from, float to)
+    {
+        if (frames == 0)
+        {
+            return;
+        }
+
+        const float step = (to - from) / float(frames);
+
+        // eight lanes hold whole frames for 1, 2, 4 and 8 channels
+        if (channels == 0
+            || 8 % channels != 0)
+        {
+            for (size_t f = 0; f < frames; ++f)
+            {
+                const float g = from + step * float(f);
+
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    x[f * channels + c] *= g;
+                }
+            }
+
+            return;
+        }
+
+        const size_t n = frames * channels;
+
+        alignas(32) float first[8];
+
+        for (size_t k = 0; k < 8; ++k)
+        {
+            first[k] = float(k / channels);
+        }
+
+        __m256 index = _mm256_load_ps(first);
+
+        const __m256 advance = _mm256_set1_ps(float(8 / channels));
+        const __m256 vstep = _mm256_set1_ps(step);
+        const __m256 vfrom = _mm256_set1_ps(from);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            // kept apart from the multiply, a fused add would round differently from the scalar loop
+            const __m256 g = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, index));
+
+            _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), g));
+
+            index = _mm256_add_ps(index, advance);
+        }
+
+        for (; i < n; ++i)
+        {
+            x[i] *= from + step * float(i / channels);
+        }
+    }
+
+    void s16ToF32Avx2(const int16_t* in, float* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(s16Scale);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), scale));
+        }
+
+        for (; i < n; ++i)
+        {
+            out[i] = float(in[i]) * s16Scale;
+        }
+    }
+
+    void s24ToF32Avx2(const uint8_t* in, float* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(s32Scale);
+
+        // four packed samples per 128 bit lane, each into the top three bytes of an int
+        const __m256i shuffle = _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11
+        );
+
+        size_t i = 0;
+
+        // the second load reads 4 bytes past the 8 samples, so 10 have to be left
+        for (; i + 10 <= n; i += 8)
+        {
+            const uint8_t* p = in + i * 3;
+
+            const __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)),
+                1
+            );
+
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, shuffle)), scale));
+        }
+
+        for (; i < n; ++i)
+        {
+            const uint8_t* p = in + i * 3;
+
+            const int32_t s = int32_t(
+                uint32_t(p[0]) << 8
+                | uint32_t(p[1]) << 16
+                | uint32_t(p[2]) << 24
+            );
+
+            out[i] = float(s) * s32Scale;
+        }
+    }
+
+    void s32ToF32Avx2(const int32_t* in, float* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(s32Scale);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+
+        for (; i < n; ++i)
+        {
+            out[i] = float(in[i]) * s32Scale;
+        }
+    }
+
+    void f32ToS16Avx2(const float* in, int16_t* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(32768.0f);
+        const __m256 lo = _mm256_set1_ps(-32768.0f);
+        const __m256 hi = _mm256_set1_ps(32767.0f);
+
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16)
+        {
+            const __m256i a = toIntAvx2(in + i, scale, lo, hi);
+            const __m256i b = toIntAvx2(in + i + 8, scale, lo, hi);
+
+            // the pack interleaves the lanes, the permute puts them back in order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+        }
+
+        for (; i < n; ++i)
+        {
+            out[i] = int16_t(roundClamp(in[i] * 32768.0f, -32768.0f, 32767.0f));
+        }
+    }
+
+    void f32ToS24Avx2(const float* in, uint8_t* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(8388608.0f);
+        const __m256 lo = _mm256_set1_ps(-8388608.0f);
+        const __m256 hi = _mm256_set1_ps(8388607.0f);
+
+        // the low three bytes of each int packed to the front of each 128 bit lane
+        const __m256i shuffle = _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+        );
+
+        size_t i = 0;
+
+        // each lane is stored 16 bytes wide, the second one reaches 4 bytes past the 8 samples
+        for (; i + 10 <= n; i += 8)
+        {
+            const __m256i v = _mm256_shuffle_epi8(toIntAvx2(in + i, scale, lo, hi), shuffle);
+
+            uint8_t* p = out + i * 3;
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(v));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 12), _mm256_extracti128_si256(v, 1));
+        }
+
+        for (; i < n; ++i)
+        {
+            const int32_t v = roundClamp(in[i] * 8388608.0f, -8388608.0f, 8388607.0f);
+
+            uint8_t* p = out + i * 3;
+
+            p[0] = uint8_t(v);
+            p[1] = uint8_t(v >> 8);
+            p[2] = uint8_t(v >> 16);
+        }
+    }
+
+    void f32ToS32Avx2(const float* in, int32_t* out, size_t n)
+    {
+        const __m256 scale = _mm256_set1_ps(2147483648.0f);
+        const __m256 lo = _mm256_set1_ps(-2147483648.0f);
+        const __m256 hi = _mm256_set1_ps(s32Max);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), toIntAvx2(in + i, scale, lo, hi));
+        }
+
+        for (; i < n; ++i)
+        {
+            out[i] = roundClamp(in[i] * 2147483648.0f, -2147483648.0f, s32Max);
+        }
+    }
+
+    void interleave2Avx2(const float* left, const float* right, float* out, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= frames; i += 8)
+        {
+            const __m256 l = _mm256_loadu_ps(left + i);
+            const __m256 r = _mm256_loadu_ps(right + i);
+
+            // unpack works per 128 bit lane, the permutes put the halves back in order
+            const __m256 lo = _mm256_unpacklo_ps(l, r);
+            const __m256 hi = _mm256_unpackhi_ps(l, r);
+
+            _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+        }
+
+        for (; i < frames; ++i)
+        {
+            out[i * 2] = left[i];
+            out[i * 2 + 1] = right[i];
+        }
+    }
+
+    void deinterleave2Avx2(const float* in, float* left, float* right, size_t frames)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= frames; i += 8)
+        {
+            const __m256 a = _mm256_loadu_ps(in + i * 2);
+            const __m256 b = _mm256_loadu_ps(in + i * 2 + 8);
+
+            // per lane: l0 l1 l4 l5 and r0 r1 r4 r5, then the 64 bit pairs swapped into place
+            const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+            _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+            _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+
+        for (; i < frames; ++i)
+        {
+            left[i] = in[i * 2];
+            right[i] = in[i * 2 + 1];
+        }
+    }
+
+    void peakRmsAvx2(const float* x, size_t n, float& peak, double& sumSquares)
+    {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+        __m256 p = _mm256_set1_ps(peak);
+        __m256d s0 = _mm256_setzero_pd();
+        __m256d s1 = _mm256_setzero_pd();
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(x + i);
+
+            p = _mm256_max_ps(p, _mm256_and_ps(v, absMask));
+
+            const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+            const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+
+            s0 = _mm256_add_pd(s0, _mm256_mul_pd(lo, lo));
+            s1 = _mm256_add_pd(s1, _mm256_mul_pd(hi, hi));
+        }
+
+        alignas(32) float lanes[8];
+        alignas(32) double sums[4];
+
+        _mm256_store_ps(lanes, p);
+        _mm256_store_pd(sums, _mm256_add_pd(s0, s1));
+
+        float pk = *std::max_element(lanes, lanes + 8);
+        double s = sums[0] + sums[1] + sums[2] + sums[3];
+
+        for (; i < n; ++i)
+        {
+            pk = std::max(pk, std::abs(x[i]));
+            s += double(x[i]) * double(x[i]);
+        }
+
+        peak = pk;
+        sumSquares += s;
+    }
+
+    float dotAvx2(const float* a, const float* b, size_t n)
+    {
+        __m256 acc = _mm256_setzero_ps();
+
+        size_t i = 0;
+
+        // built without fma, so the multiply and the add round separately like the scalar loop
+        for (; i + 8 <= n; i += 8)
+        {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        }
+
+        __m128 v = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+
+        float s = _mm_cvtss_f32(v);
+
+        for (; i < n; ++i)
+        {
+            s += a[i] * b[i];
+        }
+
+        return s;
+    }
+
+    void biquadCascadeAvx2(float* x, size_t frames, uint32_t channels, const BiquadCoefficients& c, BiquadState* state)
+    {
+        constexpr size_t vectors = biquadLanes / 8;
+
+        const __m256i up = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+
+        for (uint32_t ch = 0; ch < channels; ++ch)
+        {
+            BiquadState& s = state[ch];
+
+            __m256 y[vectors];
+            __m256 s1[vectors];
+            __m256 s2[vectors];
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                y[v] = _mm256_loadu_ps(s.y + v * 8);
+                s1[v] = _mm256_loadu_ps(s.s1 + v * 8);
+                s2[v] = _mm256_loadu_ps(s.s2 + v * 8);
+            }
+
+            float* p = x + ch;
+
+            for (size_t i = 0; i < frames; ++i, p += channels)
+            {
+                // each vector rotated up a lane, lane 0 then comes from the top of the one before
+                __m256 carry = _mm256_set1_ps(*p);
+
+                for (size_t v = 0; v < vectors; ++v)
+                {
+                    const __m256 rotated = _mm256_permutevar8x32_ps(y[v], up);
+                    const __m256 in = _mm256_blend_ps(rotated, carry, 1);
+
+                    carry = rotated;
+
+                    const __m256 out = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(c.b0 + v * 8), in), s1[v]);
+
+                    s1[v] = _mm256_add_ps(
+                        _mm256_sub_ps(
+                            _mm256_mul_ps(_mm256_loadu_ps(c.b1 + v * 8), in),
+                            _mm256_mul_ps(_mm256_loadu_ps(c.a1 + v * 8), out)),
+                        s2[v]);
+
+                    s2[v] = _mm256_sub_ps(
+                        _mm256_mul_ps(_mm256_loadu_ps(c.b2 + v * 8), in),
+                        _mm256_mul_ps(_mm256_loadu_ps(c.a2 + v * 8), out));
+
+                    y[v] = out;
+                }
+
+                const __m128 top = _mm256_extractf128_ps(y[vectors - 1], 1);
+
+                *p = _mm_cvtss_f32(_mm_shuffle_ps(top, top, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+
+            for (size_t v = 0; v < vectors; ++v)
+            {
+                _mm256_storeu_ps(s.y + v * 8, y[v]);
+                _mm256_storeu_ps(s.s1 + v * 8, s1[v]);
+                _mm256_storeu_ps(s.s2 + v * 8, s2[v]);
+            }
+        }
+    }
+
+    void complexMacAvx2(const float* aRe, const float* aIm, const float* bRe, const float* bIm, float* accRe, float* accIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256 ar = _mm256_loadu_ps(aRe + i);
+            const __m256 ai = _mm256_loadu_ps(aIm + i);
+            const __m256 br = _mm256_loadu_ps(bRe + i);
+            const __m256 bi = _mm256_loadu_ps(bIm + i);
+
+            _mm256_storeu_ps(accRe + i, _mm256_add_ps(_mm256_loadu_ps(accRe + i), _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi))));
+            _mm256_storeu_ps(accIm + i, _mm256_add_ps(_mm256_loadu_ps(accIm + i), _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br))));
+        }
+
+        for (; i < n; ++i)
+        {
+            accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+            accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+        }
+    }
+
+    void fftButterfliesAvx2(float* re0, float* im0, float* re1, float* im1, const float* wRe, const float* wIm, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256 xr = _mm256_loadu_ps(re1 + i);
+            const __m256 xi = _mm256_loadu_ps(im1 + i);
+            const __m256 wr = _mm256_loadu_ps(wRe + i);
+            const __m256 wi = _mm256_loadu_ps(wIm + i);
+
+            const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, wr), _mm256_mul_ps(xi, wi));
+            const __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, wi), _mm256_mul_ps(xi, wr));
+
+            const __m256 ar = _mm256_loadu_ps(re0 + i);
+            const __m256 ai = _mm256_loadu_ps(im0 + i);
+
+            _mm256_storeu_ps(re1 + i, _mm256_sub_ps(ar, tr));
+            _mm256_storeu_ps(im1 + i, _mm256_sub_ps(ai, ti));
+            _mm256_storeu_ps(re0 + i, _mm256_add_ps(ar, tr));
+            _mm256_storeu_ps(im0 + i, _mm256_add_ps(ai, ti));
+        }
+
+        // the four butterfly pass of a small fft lands here whole
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 xr = _mm_loadu_ps(re1 + i);
+            const __m128 xi = _mm_loadu_ps(im1 + i);
+            const __m128 wr = _mm_loadu_ps(wRe + i);
+            const __m128 wi = _mm_loadu_ps(wIm + i);
+
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+
+            const __m128 ar = _mm_loadu_ps(re0 + i);
+            const __m128 ai = _mm_loadu_ps(im0 + i);
+
+            _mm_storeu_ps(re1 + i, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(im1 + i, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(re0 + i, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(im0 + i, _mm_add_ps(ai, ti));
+        }
+
+        for (; i < n; ++i)
+        {
+            const float tr = re1[i] * wRe[i] - im1[i] * wIm[i];
+            const float ti = re1[i] * wIm[i] + im1[i] * wRe[i];
+
+            re1[i] = re0[i] - tr;
+            im1[i] = im0[i] - ti;
+            re0[i] = re0[i] + tr;
+            im0[i] = im0[i] + ti;
+        }
+    }
+
+    void truePeakAvx2(const float* x, size_t n, const TruePeakFilter& f, float* peak)
+    {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 a0 = _mm256_setzero_ps();
+            __m256 a1 = _mm256_setzero_ps();
+            __m256 a2 = _mm256_setzero_ps();
+            __m256 a3 = _mm256_setzero_ps();
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                const __m256 v = _mm256_loadu_ps(x + i - k);
+
+                a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_broadcast_ss(&f.h[0][k]), v));
+                a1 = _mm256_add_ps(a1, _mm256_mul_ps(_mm256_broadcast_ss(&f.h[1][k]), v));
+                a2 = _mm256_add_ps(a2, _mm256_mul_ps(_mm256_broadcast_ss(&f.h[2][k]), v));
+                a3 = _mm256_add_ps(a3, _mm256_mul_ps(_mm256_broadcast_ss(&f.h[3][k]), v));
+            }
+
+            const __m256 m = _mm256_max_ps(
+                _mm256_max_ps(_mm256_andnot_ps(sign, a0), _mm256_andnot_ps(sign, a1)),
+                _mm256_max_ps(_mm256_andnot_ps(sign, a2), _mm256_andnot_ps(sign, a3))
+            );
+
+            _mm256_storeu_ps(peak + i, _mm256_max_ps(_mm256_loadu_ps(peak + i), m));
+        }
+
+        for (; i < n; ++i)
+        {
+            float a0 = 0.0f;
+            float a1 = 0.0f;
+            float a2 = 0.0f;
+            float a3 = 0.0f;
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                const float v = x[ptrdiff_t(i) - ptrdiff_t(k)];
+
+                a0 += f.h[0][k] * v;
+                a1 += f.h[1][k] * v;
+                a2 += f.h[2][k] * v;
+                a3 += f.h[3][k] * v;
+            }
+
+            const float m = std::max(
+                std::max(std::abs(a0), std::abs(a1)),
+                std::max(std::abs(a2), std::abs(a3))
+            );
+
+            peak[i] = std::max(peak[i], m);
+        }
+    }
+
+    const DspKernels avx2 =
+    {
+        "avx2",
+        &gainAvx2,
+        &gainRampAvx2,
+        &s16ToF32Avx2,
+        &s24ToF32Avx2,
+        &s32ToF32Avx2,
+        &f32ToS16Avx2,
+        &f32ToS24Avx2,
+        &f32ToS32Avx2,
+        &interleave2Avx2,
+        &deinterleave2Avx2,
+        &peakRmsAvx2,
+        &dotAvx2,
+        &biquadCascadeAvx2,
+        &complexMacAvx2,
+        &fftButterfliesAvx2,
+        &truePeakAvx2
+    };
+}
+
+const DspKernels* avx2Kernels()
+{
+    return &avx2;
+}
+#else
+const DspKernels* avx2Kernels()
+{
+    return nullptr;
+}
+#endif
\ No newline at end of file
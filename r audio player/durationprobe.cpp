@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "durationprobe.h"
+
+namespace
+{
+    struct Reader
+    {
+        std::ifstream f;
+        uint64_t size = 0;
+
+        // clipped at the end of the file, empty past it
+        std::vector<uint8_t> read(uint64_t at, size_t n)
+        {
+            std::vector<uint8_t> out;
+
+            if (at >= size)
+            {
+                return out;
+            }
+
+            out.resize(size_t(std::min<uint64_t>(n, size - at)));
+
+            f.clear();
+            f.seekg(std::streamoff(at));
+            f.read(
+                reinterpret_cast<char*>(out.data()),
+                std::streamsize(out.size())
+            );
+
+            out.resize(size_t(std::max<std::streamsize>(f.gcount(), 0)));
+
+            return out;
+        }
+    };
+
+    inline uint32_t be32(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24)
+            | (uint32_t(p[1]) << 16)
+            | (uint32_t(p[2]) << 8)
+            | uint32_t(p[3]);
+    }
+
+    inline uint16_t le16(const uint8_t* p)
+    {
+        return uint16_t(p[0] | (p[1] << 8));
+    }
+
+    inline uint32_t le32(const uint8_t* p)
+    {
+        return uint32_t(le16(p)) | (uint32_t(le16(p + 2)) << 16);
+    }
+
+    inline uint64_t le64(const uint8_t* p)
+    {
+        return uint64_t(le32(p)) | (uint64_t(le32(p + 4)) << 32);
+    }
+
+    unsigned int toMs(uint64_t frames, uint32_t rate)
+    {
+        if (rate == 0)
+        {
+            return 0;
+        }
+
+        return unsigned(std::min<uint64_t>((frames * 1000 + rate / 2) / rate, UINT32_MAX));
+    }
+
+    // some taggers stack several id3v2 tags
+    uint64_t skipId3v2(Reader& r)
+    {
+        uint64_t at = 0;
+
+        for (;;)
+        {
+            const auto h = r.read(at, 10);
+
+            if (h.size() < 10
+                || std::memcmp(h.data(), "ID3", 3) != 0
+                || ((h[6] | h[7] | h[8] | h[9]) & 0x80))
+            {
+                return at;
+            }
+
+            at += 10
+                + ((uint64_t(h[6]) << 21) | (h[7] << 14) | (h[8] << 7) | h[9])
+                + ((h[5] & 0x10) ? 10 : 0);
+        }
+    }
+
+    unsigned int probeFlac(Reader& r, uint64_t at)
+    {
+        const auto b = r.read(at, 42);
+
+        if (b.size() < 42
+            || std::memcmp(b.data(), "fLaC", 4) != 0
+            || (b[4] & 0x7F) != 0)
+        {
+            return 0;
+        }
+
+        // streaminfo: block and frame size bounds, then 20 bits rate, 3 channels, 5 depth, 36 samples
+        const uint8_t* s = b.data() + 8;
+
+        const uint32_t rate = (uint32_t(s[10]) << 12) | (s[11] << 4) | (s[12] >> 4);
+        const uint64_t samples = (uint64_t(s[13] & 0x0F) << 32) | be32(s + 14);
+
+        return toMs(samples, rate);
+    }
+
+    unsigned int probeWav(Reader& r)
+    {
+        const auto h = r.read(0, 12);
+
+        if (h.size() < 12
+            || std::memcmp(h.data(), "RIFF", 4) != 0
+            || std::memcmp(h.data() + 8, "WAVE", 4) != 0)
+        {
+            return 0;
+        }
+
+        uint32_t rate = 0;
+        uint32_t align = 0;
+        uint64_t at = 12;
+
+        while (at + 8 <= r.size)
+        {
+            const auto c = r.read(at, 8);
+
+            if (c.size() < 8)
+            {
+                break;
+            }
+
+            const uint64_t size = le32(c.data() + 4);
+
+            if (std::memcmp(c.data(), "fmt ", 4) == 0)
+            {
+                const auto fmt = r.read(at + 8, 16);
+
+                if (fmt.size() < 16)
+                {
+                    return 0;
+                }
+
+                rate = le32(fmt.data() + 4);
+                align = le16(fmt.data() + 12);
+            }
+            else if (std::memcmp(c.data(), "data", 4) == 0)
+            {
+                if (align == 0)
+                {
+                    return 0;
+                }
+
+                // a recorder that never finished leaves the size open, the data runs to the end
+                const uint64_t bytes = std::min(size, r.size - (at + 8));
+
+                return toMs(bytes / align, rate);
+            }
+
+            at += 8 + size + (size & 1);
+        }
+
+        return 0;
+    }
+
+    unsigned int probeOgg(Reader& r)
+    {
+        const auto h = r.read(0, 27 + 255 + 16);
+
+        if (h.size() < 27
+            || std::memcmp(h.data(), "OggS", 4) != 0)
+        {
+            return 0;
+        }
+
+        const size_t packet = 27 + size_t(h[26]);
+
+        if (h.size() < packet + 16
+            || std::memcmp(h.data() + packet, "\x01vorbis", 7) != 0)
+        {
+            return 0;
+        }
+
+        const uint32_t serial = le32(h.data() + 14);
+        const uint32_t rate = le32(h.data() + packet + 12);
+
+        // the last page's granule position is the stream's sample count, a page is at most ~64k
+        constexpr uint64_t tail = 65536 + 27;
+
+        const uint64_t from = r.size > tail
+            ? r.size - tail
+            : 0;
+
+        const auto t = r.read(from, size_t(r.size - from));
+
+        if (t.size() < 27)
+        {
+            return 0;
+        }
+
+        for (size_t i = t.size() - 27 + 1; i-- > 0;)
+        {
+            if (std::memcmp(t.data() + i, "OggS", 4) != 0
+                || t[i + 4] != 0
+                || le32(t.data() + i + 14) != serial)
+            {
+                continue;
+            }
+
+            const uint64_t granule = le64(t.data() + i + 6);
+
+            // no packet ends on this page
+            if (granule == UINT64_MAX)
+            {
+                continue;
+            }
+
+            return toMs(granule, rate);
+        }
+
+        return 0;
+    }
+
+    struct Mp3Frame
+    {
+        uint32_t rate = 0;
+        uint32_t bitrate = 0;
+        uint32_t samples = 0;
+        uint32_t bytes = 0;
+
+        // where a xing/info tag starts: header, crc, side info
+        uint32_t sideInfo = 0;
+
+        // version, layer and rate bits, equal across every frame of a stream
+        uint32_t id = 0;
+
+        bool layer3 = false;
+    };
+
+    bool parseFrame(const uint8_t* h, Mp3Frame& out)
+    {
+        if (h[0] != 0xFF
+            || (h[1] & 0xE0) != 0xE0)
+        {
+            return false;
+        }
+
+        // 3 is mpeg 1, 2 is mpeg 2, 0 is mpeg 2.5
+        const int version = (h[1] >> 3) & 3;
+        const int layer = 4 - ((h[1] >> 1) & 3);
+        const int index = h[2] >> 4;
+        const int rateIndex = (h[2] >> 2) & 3;
+
+        // free format streams carry no bitrate to size frames by
+        if (version == 1
+            || layer == 4
+            || index == 0
+            || index == 15
+            || rateIndex == 3)
+        {
+            return false;
+        }
+
+        static const uint16_t kbps[2][3][15] =
+        {
+            {
+                { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+                { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+                { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+            },
+            {
+                { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+                { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+                { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+            }
+        };
+
+        static const uint32_t rates[3] = { 44100, 48000, 32000 };
+
+        const bool mpeg1 = version == 3;
+        const bool mono = (h[3] >> 6) == 3;
+        const uint32_t padding = (h[2] >> 1) & 1;
+
+        out.rate = rates[rateIndex] >> (mpeg1
+            ? 0
+            : version == 2
+            ? 1
+            : 2);
+
+        out.bitrate = kbps[mpeg1 ? 0 : 1][layer - 1][index] * 1000u;
+
+        out.samples = layer == 1
+            ? 384
+            : layer == 2 || mpeg1
+            ? 1152
+            : 576;
+
+        out.bytes = layer == 1
+            ? (12 * out.bitrate / out.rate + padding) * 4
+            : out.samples / 8 * out.bitrate / out.rate + padding;
+
+        out.sideInfo = 4
+            + ((h[1] & 1) ? 0 : 2)
+            + (mpeg1
+                ? (mono ? 17 : 32)
+                : (mono ? 9 : 17));
+
+        out.id = (uint32_t(h[1] & 0xFE) << 8) | (h[2] & 0x0C);
+        out.layer3 = layer == 3;
+
+        return true;
+    }
+
+    // the lengths dr_mp3 reports, so the library agrees with the player
+    unsigned int probeMp3(Reader& r, uint64_t start)
+    {
+        const auto head = r.read(start, 64 * 1024);
+
+        Mp3Frame first{};
+
+        size_t at = 0;
+        bool found = false;
+
+        // a sync pattern counts once the frame after it parses too
+        for (; at + 4 <= head.size(); ++at)
+        {
+            if (!parseFrame(head.data() + at, first))
+            {
+                continue;
+            }
+
+            const size_t next = at + first.bytes;
+
+            Mp3Frame second{};
+
+            if (next + 4 <= head.size()
+                && parseFrame(head.data() + next, second)
+                && second.id == first.id)
+            {
+                found = true;
+
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            return 0;
+        }
+
+        const uint8_t* frame = head.data() + at;
+        const uint8_t* frameEnd = frame + first.bytes;
+
+        if (first.layer3
+            && first.sideInfo + 16 <= first.bytes)
+        {
+            const uint8_t* x = frame + first.sideInfo;
+
+            if (std::memcmp(x, "Xing", 4) == 0
+                || std::memcmp(x, "Info", 4) == 0)
+            {
+                const uint32_t flags = x[7];
+
+                if (flags & 0x01)
+                {
+                    uint64_t samples = uint64_t(be32(x + 8)) * first.samples;
+
+                    const uint8_t* lame = x + 12
+                        + ((flags & 0x02) ? 4 : 0)
+                        + ((flags & 0x04) ? 100 : 0)
+                        + ((flags & 0x08) ? 4 : 0);
+
+                    // encoder delay and padding, 12 bits each, counted with the decoder's own 529
+                    if (lame + 21 + 3 < frameEnd
+                        && lame[0] != 0)
+                    {
+                        const uint8_t* d = lame + 21;
+
+                        const int delay = int((d[0] << 4) | (d[1] >> 4)) + 529;
+                        const int padding = std::max(0, int(((d[1] & 0x0F) << 8) | d[2]) - 529);
+
+                        samples -= std::min<uint64_t>(samples, uint64_t(delay) + uint64_t(padding));
+                    }
+
+                    return toMs(samples, first.rate);
+                }
+            }
+        }
+
+        // fraunhofer's vbri sits at a fixed offset instead
+        if (first.layer3
+            && 4 + 32 + 18 <= first.bytes)
+        {
+            const uint8_t* v = frame + 4 + 32;
+
+            if (std::memcmp(v, "VBRI", 4) == 0)
+            {
+                return toMs(uint64_t(be32(v + 14)) * first.samples, first.rate);
+            }
+        }
+
+        uint64_t end = r.size;
+
+        const auto id3v1 = r.read(r.size >= 128 ? r.size - 128 : 0, 3);
+
+        if (r.size >= 128
+            && id3v1.size() == 3
+            && std::memcmp(id3v1.data(), "TAG", 3) == 0)
+        {
+            end -= 128;
+        }
+
+        const uint64_t frameAt = start + at;
+
+        if (end <= frameAt)
+        {
+            return 0;
+        }
+
+        // no tag, an even bitrate over the first frames is taken as cbr and sized from the file
+        bool cbr = true;
+
+        size_t pos = at;
+
+        for (int n = 0; n < 8 && pos + 4 <= head.size(); ++n)
+        {
+            Mp3Frame f{};
+
+            if (!parseFrame(head.data() + pos, f)
+                || f.id != first.id
+                || f.bitrate != first.bitrate)
+            {
+                cbr = false;
+
+                break;
+            }
+
+            pos += f.bytes;
+        }
+
+        if (cbr)
+        {
+            return unsigned(std::min<uint64_t>((end - frameAt) * 8000 / first.bitrate, UINT32_MAX));
+        }
+
+        // headerless vbr, every frame header is read but nothing is decoded
+        uint64_t samples = 0;
+        uint64_t p = frameAt;
+
+        std::vector<uint8_t> buf;
+        uint64_t bufAt = 0;
+
+        while (p + 4 <= end)
+        {
+            if (p < bufAt
+                || p + 4 > bufAt + buf.size())
+            {
+                buf = r.read(p, 64 * 1024);
+                bufAt = p;
+
+                if (buf.size() < 4)
+                {
+                    break;
+                }
+            }
+
+            Mp3Frame f{};
+
+            if (!parseFrame(buf.data() + (p - bufAt), f)
+                || f.id != first.id)
+            {
+                break;
+            }
+
+            samples += f.samples;
+            p += f.bytes;
+        }
+
+        return toMs(samples, first.rate);
+    }
+
+    std::string lowerExtension(const std::filesystem::path& path)
+    {
+        const std::u8string u8 = path.extension().u8string();
+
+        std::string ext(u8.begin(), u8.end());
+
+        for (char& c : ext)
+        {
+            if (c >= 'A'
+                && c <= 'Z')
+            {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+
+        return ext;
+    }
+}
+
+unsigned int probeDurationMs(const std::filesystem::path& path)
+{
+    std::error_code ec;
+
+    Reader r;
+
+    r.size = std::filesystem::file_size(path, ec);
+
+    if (ec)
+    {
+        return 0;
+    }
+
+    r.f.open(
+        path,
+        std::ios::binary
+    );
+
+    if (!r.f)
+    {
+        return 0;
+    }
+
+    const std::string ext = lowerExtension(path);
+
+    if (ext == ".wav")
+    {
+        return probeWav(r);
+    }
+
+    if (ext == ".ogg")
+    {
+        return probeOgg(r);
+    }
+
+    // flac files sometimes carry an id3v2 tag up front as well
+    const uint64_t start = skipId3v2(r);
+
+    if (ext == ".flac")
+    {
+        return probeFlac(r, start);
+    }
+
+    if (ext == ".mp3")
+    {
+        return probeMp3(r, start);
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// exact length in ms from the stream headers alone, 0 when the headers don't say
+// flac streaminfo, mp3 xing/info/vbri (with the lame encoder delay and padding),
+// the last ogg granule position and the riff data size, nothing is decoded
+// taglib estimates a vbr mp3 without a xing header from the first frame's bitrate
+unsigned int probeDurationMs(const std::filesystem::path& path);
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "eqnode.h"
+
+namespace
+{
+    const float frequencies[eqBands] = { 31.0f, 62.0f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f };
+
+    // state this small is flushed to zero between callbacks, so a decaying tail never turns denormal
+    constexpr float flushBelow = 1e-15f;
+
+    void passThrough(BiquadCoefficients& c, size_t lane)
+    {
+        c.b0[lane] = 1.0f;
+        c.b1[lane] = 0.0f;
+        c.b2[lane] = 0.0f;
+        c.a1[lane] = 0.0f;
+        c.a2[lane] = 0.0f;
+    }
+
+    // the audio eq cookbook's peak and shelves, scaled by 'scale' so the headroom costs no extra band
+    void design(const EqBand& band, double rate, double scale, BiquadCoefficients& c, size_t lane)
+    {
+        const double f = std::clamp(double(band.frequency), 10.0, rate * 0.45);
+        const double q = std::max(double(band.q), 0.1);
+
+        const double a = std::pow(10.0, double(band.gain) / 40.0);
+        const double w = 2.0 * std::numbers::pi * f / rate;
+        const double cw = std::cos(w);
+        const double alpha = std::sin(w) / (2.0 * q);
+        const double root = 2.0 * std::sqrt(a) * alpha;
+
+        double b0;
+        double b1;
+        double b2;
+        double a0;
+        double a1;
+        double a2;
+
+        switch (band.type)
+        {
+        case EqBandType::LowShelf:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cw + root);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cw);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cw - root);
+            a0 = (a + 1.0) + (a - 1.0) * cw + root;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cw);
+            a2 = (a + 1.0) + (a - 1.0) * cw - root;
+
+            break;
+        case EqBandType::HighShelf:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cw + root);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cw);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cw - root);
+            a0 = (a + 1.0) - (a - 1.0) * cw + root;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cw);
+            a2 = (a + 1.0) - (a - 1.0) * cw - root;
+
+            break;
+        default:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cw;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha / a;
+
+            break;
+        }
+
+        c.b0[lane] = float(scale * b0 / a0);
+        c.b1[lane] = float(scale * b1 / a0);
+        c.b2[lane] = float(scale * b2 / a0);
+        c.a1[lane] = float(a1 / a0);
+        c.a2[lane] = float(a2 / a0);
+    }
+}
+
+EqSettings eqCurve(const float (&gains)[eqBands])
+{
+    EqSettings s;
+
+    for (size_t i = 0; i < eqBands; ++i)
+    {
+        EqBand& b = s.bands[i];
+
+        b.type = i == 0
+            ? EqBandType::LowShelf
+            : i == eqBands - 1
+            ? EqBandType::HighShelf
+            : EqBandType::Peak;
+
+        b.frequency = frequencies[i];
+        b.gain = gains[i];
+
+        // shelves at the gentlest slope that doesn't overshoot
+        b.q = b.type == EqBandType::Peak
+            ? 1.41f
+            : 0.71f;
+    }
+
+    return s;
+}
+
+float eqFrequency(size_t band)
+{
+    return frequencies[std::min(band, eqBands - 1)];
+}
+
+const std::vector<EqPreset>& eqPresets()
+{
+    static const std::vector<EqPreset> presets =
+    {
+        { "flat", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+        { "bass boost", { 6, 5, 4, 2, 0, 0, 0, 0, 0, 0 } },
+        { "treble boost", { 0, 0, 0, 0, 0, 0, 1, 3, 5, 6 } },
+        { "loudness", { 6, 4, 2, 0, -1, -1, 0, 1, 3, 4 } },
+        { "vocal", { -3, -2, -1, 0, 2, 3, 3, 2, 0, -1 } },
+        { "rock", { 4, 3, 2, 0, -1, -1, 0, 2, 3, 4 } },
+        { "classical", { 0, 0, 0, 0, 0, 0, -1, -2, -2, -3 } },
+        { "electronic", { 5, 4, 1, 0, -2, 1, 0, 1, 4, 5 } },
+        { "headphones", { 3, 2, 0, -1, 0, 1, 2, -1, 1, 2 } }
+    };
+
+    return presets;
+}
+
+EqNode::EqNode() = default;
+
+EqNode::~EqNode()
+{
+    uninit();
+}
+
+bool EqNode::init(ma_engine* engine, ma_node* next)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    // resolved here rather than on the first callback
+    dspKernels();
+
+    channels = ma_engine_get_channels(engine);
+    sampleRate = ma_engine_get_sample_rate(engine);
+
+    state.assign(channels, BiquadState{});
+    running = false;
+
+    // out before the graph can call in
+    publish();
+
+    return attach(engine, next);
+}
+
+void EqNode::set(const EqSettings& settings)
+{
+    current = settings;
+
+    if (sampleRate != 0)
+    {
+        publish();
+    }
+}
+
+void EqNode::publish()
+{
+    Bank& bank = banks.edit();
+
+    bank.enabled = current.enabled;
+
+    // boosts are taken back up front, so a curve that only lifts can't push a full scale track into clipping
+    float boost = 0.0f;
+
+    for (const EqBand& b : current.bands)
+    {
+        boost = std::max(boost, b.gain);
+    }
+
+    const double headroom = std::pow(10.0, -double(boost) / 20.0);
+
+    for (size_t i = 0; i < biquadLanes; ++i)
+    {
+        if (i < eqBands
+            && (current.bands[i].gain != 0.0f || i == 0))
+        {
+            design(
+                current.bands[i],
+                double(sampleRate),
+                i == 0
+                    ? headroom
+                    : 1.0,
+                bank.c,
+                i
+            );
+        }
+        else
+        {
+            passThrough(bank.c, i);
+        }
+    }
+
+    banks.publish();
+}
+
+void EqNode::process(float* frames, size_t count)
+{
+    const Bank& bank = banks.read();
+
+    if (!bank.enabled)
+    {
+        running = false;
+
+        return;
+    }
+
+    // coming back on, whatever was left in the pipeline belongs to audio long gone
+    if (!running)
+    {
+        std::fill(state.begin(), state.end(), BiquadState{});
+
+        running = true;
+    }
+
+    dspKernels().biquadCascade(frames, count, channels, bank.c, state.data());
+
+    for (BiquadState& s : state)
+    {
+        for (size_t i = 0; i < biquadLanes; ++i)
+        {
+            if (std::abs(s.s1[i]) < flushBelow)
+            {
+                s.s1[i] = 0.0f;
+            }
+
+            if (std::abs(s.s2[i]) < flushBelow)
+            {
+                s.s2[i] = 0.0f;
+            }
+
+            if (std::abs(s.y[i]) < flushBelow)
+            {
+                s.y[i] = 0.0f;
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "doublebuffer.h"
+#include "dspkernels.h"
+#include "graphnode.h"
+#include "miniaudio.h"
+
+#include <cstddef>
+#include <vector>
+
+constexpr size_t eqBands = 10;
+
+static_assert(eqBands <= biquadLanes);
+
+enum class EqBandType
+{
+    Peak,
+    LowShelf,
+    HighShelf
+};
+
+struct EqBand
+{
+    EqBandType type = EqBandType::Peak;
+
+    float frequency = 1000.0f;
+
+    // db
+    float gain = 0.0f;
+
+    // the slope of a shelf, the width of a peak
+    float q = 1.41f;
+};
+
+struct EqSettings
+{
+    bool enabled = false;
+
+    EqBand bands[eqBands];
+};
+
+struct EqPreset
+{
+    const char* name;
+    float gains[eqBands];
+};
+
+// a low shelf, eight peaks an octave apart and a high shelf, carrying the given gains
+EqSettings eqCurve(const float (&gains)[eqBands]);
+
+// centre of each band of eqCurve, for labels
+float eqFrequency(size_t band);
+
+const std::vector<EqPreset>& eqPresets();
+
+// between the sounds and the output node, a cascade of biquads run through the dspKernels pipeline
+// settings are turned into coefficients on the engine thread and handed over through a double buffer,
+// so the audio thread never locks or allocates however fast they change
+class EqNode : public GraphNode<EqNode>
+{
+public:
+    EqNode();
+    ~EqNode();
+
+    EqNode(const EqNode&) = delete;
+    EqNode& operator=(const EqNode&) = delete;
+
+    // feeds 'next', the coefficients are worked out for the engine's rate
+    bool init(ma_engine* engine, ma_node* next);
+
+    // engine thread
+    void set(const EqSettings& settings);
+    bool enabled() const { return current.enabled; }
+
+    // audio thread, frames the output is behind the input, the pipeline's depth while on and none bypassed
+    size_t latency() const { return running ? biquadLanes - 1 : 0; }
+private:
+    struct Bank
+    {
+        BiquadCoefficients c;
+
+        bool enabled = false;
+    };
+
+    ma_uint32 sampleRate = 0;
+
+    // engine thread, kept so a device reopened at another rate gets the same curve
+    EqSettings current;
+
+    DoubleBuffer<Bank> banks;
+
+    // audio thread only
+    std::vector<BiquadState> state;
+    bool running = false;
+
+    void publish();
+
+    // audio thread, run by the graph on frames already copied to the output
+    void process(float* frames, size_t count);
+
+    friend class GraphNode<EqNode>;
+};
\ No newline at end of file
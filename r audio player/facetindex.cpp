@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+
+#include "casefold.h"
+#include "facetindex.h"
+#include "library.h"
+
+namespace
+{
+    struct Pending
+    {
+        std::string text;
+        std::vector<uint32_t> albums;
+    };
+
+    void add(std::map<std::string, Pending>& m, const std::string& key, const std::string& text, uint32_t album)
+    {
+        if (key.empty())
+        {
+            return;
+        }
+
+        Pending& p = m[key];
+
+        if (p.text.empty())
+        {
+            p.text = text;
+        }
+
+        if (p.albums.empty()
+            || p.albums.back() != album)
+        {
+            p.albums.push_back(album);
+        }
+    }
+}
+
+void FacetIndex::build(const std::vector<Album>& albums)
+{
+    std::map<std::string, Pending> pending[facetCount];
+
+    for (uint32_t a = 0; a < uint32_t(albums.size()); ++a)
+    {
+        const Album& album = albums[a];
+
+        auto& artists = pending[size_t(Facet::Artist)];
+
+        if (album.variousArtists)
+        {
+            add(artists, album.artistKey, "various artists", a);
+
+            for (const auto& t : album.tracks)
+            {
+                for (const auto& name : t.artists)
+                {
+                    add(artists, foldKey(name), name, a);
+                }
+            }
+        }
+        else
+        {
+            add(artists, album.artistKey, album.artists.front(), a);
+        }
+
+        if (album.year != 0)
+        {
+            // zero padded so the map orders years numerically
+            char key[8]{};
+
+            std::snprintf(key, sizeof(key), "%05u", album.year);
+
+            add(pending[size_t(Facet::Year)], key, std::to_string(album.year), a);
+        }
+
+        for (const auto& g : album.genres)
+        {
+            add(pending[size_t(Facet::Genre)], foldKey(g), g, a);
+        }
+    }
+
+    for (size_t f = 0; f < facetCount; ++f)
+    {
+        facets[f].clear();
+        byAlbum[f].assign(albums.size(), {});
+
+        for (auto& [key, p] : pending[f])
+        {
+            const uint32_t v = uint32_t(facets[f].size());
+
+            for (uint32_t a : p.albums)
+            {
+                byAlbum[f][a].push_back(v);
+            }
+
+            facets[f].push_back({ std::move(p.text), std::move(p.albums) });
+        }
+    }
+}
+
+std::vector<uint32_t> FacetIndex::filter(std::vector<uint32_t> albums, const Selection& selection, int skip) const
+{
+    for (size_t f = 0; f < facetCount; ++f)
+    {
+        const int v = selection[f];
+
+        if (int(f) == skip
+            || v < 0
+            || v >= int(facets[f].size()))
+        {
+            continue;
+        }
+
+        const auto& ids = facets[f][v].albums;
+
+        std::vector<uint32_t> out;
+
+        std::set_intersection(
+            albums.begin(),
+            albums.end(),
+            ids.begin(),
+            ids.end(),
+            std::back_inserter(out)
+        );
+
+        albums.swap(out);
+    }
+
+    return albums;
+}
+
+std::vector<uint32_t> FacetIndex::counts(Facet facet, const std::vector<uint32_t>& albums) const
+{
+    const size_t f = size_t(facet);
+
+    std::vector<uint32_t> out(facets[f].size(), 0);
+
+    for (uint32_t a : albums)
+    {
+        for (uint32_t v : byAlbum[f][a])
+        {
+            ++out[v];
+        }
+    }
+
+    return out;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Album;
+
+enum class Facet
+{
+    Artist,
+    Year,
+    Genre
+};
+
+constexpr size_t facetCount = 3;
+
+// value -> sorted album ids, per facet, built once per scan
+class FacetIndex
+{
+public:
+    struct Value
+    {
+        std::string text;
+        std::vector<uint32_t> albums;
+    };
+
+    // -1 means no value selected for that facet
+    using Selection = std::array<int, facetCount>;
+
+    void build(const std::vector<Album>& albums);
+
+    const std::vector<Value>& values(Facet facet) const { return facets[size_t(facet)]; }
+
+    // narrows a sorted album id list to the albums carrying every selected value
+    // skip leaves one facet out, which is what that facet's own counts are based on
+    std::vector<uint32_t> filter(std::vector<uint32_t> albums, const Selection& selection, int skip = -1) const;
+
+    // how many of the given albums carry each value of the facet
+    std::vector<uint32_t> counts(Facet facet, const std::vector<uint32_t>& albums) const;
+private:
+    std::vector<Value> facets[facetCount];
+
+    // album id -> value indices, for counting
+    std::vector<std::vector<uint32_t>> byAlbum[facetCount];
+};
\ No newline at end of file
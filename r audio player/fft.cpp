@@ -0,0 +1,226 @@
+#include <cassert>
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+#include "dspkernels.h"
+#include "fft.h"
+
+namespace
+{
+    // x[k] of the real signal from z[k] and z[m - k] of the packed one, w = exp(-2 i pi k / n)
+    inline void untangle(float ar, float ai, float br, float bi, float wr, float wi, float& xr, float& xi)
+    {
+        const float er = 0.5f * (ar + br);
+        const float ei = 0.5f * (ai - bi);
+        const float dr = 0.5f * (ar - br);
+        const float di = 0.5f * (ai + bi);
+
+        xr = er + (di * wr + dr * wi);
+        xi = ei + (di * wi - dr * wr);
+    }
+
+    // the other way round, the conjugate of z[k] from x[k] and x[m - k], ready to go through the forward transform
+    inline void tangle(float pr, float pi, float qr, float qi, float wr, float wi, float& zr, float& zi)
+    {
+        const float er = 0.5f * (pr + qr);
+        const float ei = 0.5f * (pi - qi);
+        const float gr = 0.5f * (pr - qr);
+        const float gi = 0.5f * (pi + qi);
+
+        const float fr = gr * wr + gi * wi;
+        const float fi = gi * wr - gr * wi;
+
+        zr = er - fi;
+        zi = -(ei + fr);
+    }
+}
+
+RealFft::RealFft(size_t size)
+    : n(size)
+{
+    assert(n >= 8 && (n & (n - 1)) == 0);
+
+    const size_t m = n / 2;
+
+    size_t bits = 0;
+
+    while ((size_t(1) << bits) < m)
+    {
+        ++bits;
+    }
+
+    reversed.resize(m);
+
+    for (size_t j = 0; j < m; ++j)
+    {
+        uint32_t r = 0;
+
+        for (size_t b = 0; b < bits; ++b)
+        {
+            r |= uint32_t((j >> b) & 1) << (bits - 1 - b);
+        }
+
+        reversed[j] = r;
+    }
+
+    twiddleRe.assign(m, 0.0f);
+    twiddleIm.assign(m, 0.0f);
+
+    for (size_t h = 1; h < m; h *= 2)
+    {
+        for (size_t j = 0; j < h; ++j)
+        {
+            const double a = -std::numbers::pi * double(j) / double(h);
+
+            twiddleRe[h + j] = float(std::cos(a));
+            twiddleIm[h + j] = float(std::sin(a));
+        }
+    }
+
+    splitRe.resize(m / 2 + 1);
+    splitIm.resize(m / 2 + 1);
+
+    for (size_t k = 0; k <= m / 2; ++k)
+    {
+        const double a = -2.0 * std::numbers::pi * double(k) / double(n);
+
+        splitRe[k] = float(std::cos(a));
+        splitIm[k] = float(std::sin(a));
+    }
+}
+
+void RealFft::transform(float* re, float* im) const
+{
+    const size_t m = n / 2;
+
+    // the first two passes have twiddles of 1 and -i, so they're done in one go
+    for (size_t g = 0; g < m; g += 4)
+    {
+        const float r0 = re[g] + re[g + 1];
+        const float i0 = im[g] + im[g + 1];
+        const float r1 = re[g] - re[g + 1];
+        const float i1 = im[g] - im[g + 1];
+        const float r2 = re[g + 2] + re[g + 3];
+        const float i2 = im[g + 2] + im[g + 3];
+        const float r3 = re[g + 2] - re[g + 3];
+        const float i3 = im[g + 2] - im[g + 3];
+
+        re[g] = r0 + r2;
+        im[g] = i0 + i2;
+        re[g + 2] = r0 - r2;
+        im[g + 2] = i0 - i2;
+
+        // r3 + i i3 times -i
+        re[g + 1] = r1 + i3;
+        im[g + 1] = i1 - r3;
+        re[g + 3] = r1 - i3;
+        im[g + 3] = i1 + r3;
+    }
+
+    const DspKernels& k = dspKernels();
+
+    for (size_t h = 4; h < m; h *= 2)
+    {
+        for (size_t g = 0; g < m; g += 2 * h)
+        {
+            k.fftButterflies(
+                re + g,
+                im + g,
+                re + g + h,
+                im + g + h,
+                twiddleRe.data() + h,
+                twiddleIm.data() + h,
+                h
+            );
+        }
+    }
+}
+
+void RealFft::forward(const float* in, float* re, float* im) const
+{
+    const size_t m = n / 2;
+
+    // even samples as the real part, odd as the imaginary, in bit reversed order
+    for (size_t j = 0; j < m; ++j)
+    {
+        const size_t r = reversed[j];
+
+        re[j] = in[2 * r];
+        im[j] = in[2 * r + 1];
+    }
+
+    transform(re, im);
+
+    const float r0 = re[0];
+    const float i0 = im[0];
+
+    re[0] = r0 + i0;
+    im[0] = r0 - i0;
+
+    for (size_t k = 1; k <= m / 2; ++k)
+    {
+        const size_t kk = m - k;
+
+        const float ar = re[k];
+        const float ai = im[k];
+        const float br = re[kk];
+        const float bi = im[kk];
+
+        untangle(ar, ai, br, bi, splitRe[k], splitIm[k], re[k], im[k]);
+
+        if (kk != k)
+        {
+            // exp(-2 i pi (m - k) / n) is minus the conjugate of exp(-2 i pi k / n)
+            untangle(br, bi, ar, ai, -splitRe[k], splitIm[k], re[kk], im[kk]);
+        }
+    }
+}
+
+void RealFft::inverse(float* re, float* im, float* out) const
+{
+    const size_t m = n / 2;
+
+    const float dc = re[0];
+    const float nyquist = im[0];
+
+    re[0] = 0.5f * (dc + nyquist);
+    im[0] = 0.5f * (nyquist - dc);
+
+    for (size_t k = 1; k <= m / 2; ++k)
+    {
+        const size_t kk = m - k;
+
+        const float pr = re[k];
+        const float pi = im[k];
+        const float qr = re[kk];
+        const float qi = im[kk];
+
+        tangle(pr, pi, qr, qi, splitRe[k], splitIm[k], re[k], im[k]);
+
+        if (kk != k)
+        {
+            tangle(qr, qi, pr, pi, -splitRe[k], splitIm[k], re[kk], im[kk]);
+        }
+    }
+
+    // the inverse as a forward transform of the conjugate, conjugated again on the way out
+    for (size_t j = 0; j < m; ++j)
+    {
+        const size_t r = reversed[j];
+
+        if (j < r)
+        {
+            std::swap(re[j], re[r]);
+            std::swap(im[j], im[r]);
+        }
+    }
+
+    transform(re, im);
+
+    for (size_t j = 0; j < m; ++j)
+    {
+        out[2 * j] = re[j];
+        out[2 * j + 1] = -im[j];
+    }
+}
\ No newline at end of file
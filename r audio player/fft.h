@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// real fft of a power of two size, run as a half size complex fft on split arrays
+// the spectrum comes out as size / 2 bins, bin 0 carrying dc in re and nyquist in im
+// the butterfly passes go through the dspKernels, the first two are done here without twiddles
+class RealFft
+{
+public:
+    explicit RealFft(size_t size);
+
+    size_t size() const { return n; }
+    size_t bins() const { return n / 2; }
+
+    // in holds size() samples, re and im bins() each
+    void forward(const float* in, float* re, float* im) const;
+
+    // back from a spectrum laid out like forward's, scaled up by bins(), re and im are used as scratch
+    void inverse(float* re, float* im, float* out) const;
+private:
+    size_t n;
+
+    std::vector<uint32_t> reversed;
+
+    // per pass of half length h, at h + j, exp(-i pi j / h)
+    std::vector<float> twiddleRe;
+    std::vector<float> twiddleIm;
+
+    // exp(-2 i pi k / n) for untangling the two real halves
+    std::vector<float> splitRe;
+    std::vector<float> splitIm;
+
+    void transform(float* re, float* im) const;
+};
\ No newline at end of file
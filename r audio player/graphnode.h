@@ -0,0 +1,105 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// what the nodes of the engine graph have in common: the miniaudio base with one bus in and one out of the same
+// channels, and a callback that copies the input to the output and hands it to Node::process(float*, size_t)
+// to work on in place, on the audio thread
+// a node's destructor calls uninit itself, by the time this one runs its members are gone
+template <typename Node>
+class GraphNode
+{
+public:
+    GraphNode(const GraphNode&) = delete;
+    GraphNode& operator=(const GraphNode&) = delete;
+
+    ma_node* node() { return &base; }
+
+    void uninit()
+    {
+        if (!baseInit)
+        {
+            return;
+        }
+
+        ma_node_uninit(&base, nullptr);
+
+        baseInit = false;
+    }
+protected:
+    ma_node_base base{};
+
+    bool baseInit{};
+
+    ma_uint32 channels = 0;
+
+    GraphNode() = default;
+    ~GraphNode() = default;
+
+    // once channels is set, feeds 'next'
+    bool attach(ma_engine* engine, ma_node* next)
+    {
+        ma_node_config config = ma_node_config_init();
+
+        config.vtable = &vtable;
+        config.pInputChannels = &channels;
+        config.pOutputChannels = &channels;
+
+        if (ma_node_init(
+            ma_engine_get_node_graph(engine),
+            &config,
+            nullptr,
+            &base) != MA_SUCCESS)
+        {
+            return false;
+        }
+
+        if (ma_node_attach_output_bus(
+            &base,
+            0,
+            next,
+            0) != MA_SUCCESS)
+        {
+            ma_node_uninit(&base, nullptr);
+
+            return false;
+        }
+
+        baseInit = true;
+
+        return true;
+    }
+private:
+    static void onProcess(ma_node* node, const float** framesIn, ma_uint32* frameCountIn, float** framesOut, ma_uint32* frameCountOut)
+    {
+        // miniaudio hands back a pointer to the base, which sits at the start of this
+        static_assert(std::is_standard_layout_v<GraphNode>);
+
+        Node* self = static_cast<Node*>(reinterpret_cast<GraphNode*>(node));
+
+        const ma_uint32 frames = std::min(*frameCountIn, *frameCountOut);
+
+        float* out = framesOut[0];
+
+        std::memcpy(out, framesIn[0], size_t(frames) * self->channels * sizeof(float));
+
+        *frameCountIn = frames;
+        *frameCountOut = frames;
+
+        self->process(out, frames);
+    }
+
+    static constexpr ma_node_vtable vtable =
+    {
+        &onProcess,
+        nullptr,
+        1,
+        1,
+        0
+    };
+};
\ No newline at end of file
@@ -2,7 +2,13 @@
 #include <fstream>
 #include <string>
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <map>
 #include <set>
+#include <sstream>
 #include <system_error>
 
 #include <taglib/fileref.h>
@@ -12,6 +18,8 @@
 #include <taglib/oggfile.h>
 #include <taglib/vorbisfile.h>
 
+#include "casefold.h"
+#include "durationprobe.h"
 #include "library.h"
 
 namespace fs = std::filesystem; // YOU DESERVE DEATH FOR THIS - some senior dev, probably
@@ -124,16 +132,16 @@ namespace
             || ext == ".ogg";
     }
 
-    TagLib::FileRef openFileRef(const fs::path& p)
+    TagLib::FileRef openFileRef(const fs::path& p, bool readProperties)
     {
 #ifdef _WIN32
         const std::wstring wp = p.wstring();
 
-        return TagLib::FileRef(wp.c_str());
+        return TagLib::FileRef(wp.c_str(), readProperties);
 #else
         const std::string up = u8ToString(p);
 
-        return TagLib::FileRef(up.c_str());
+        return TagLib::FileRef(up.c_str(), readProperties);
 #endif
     }
 
@@ -204,6 +212,150 @@ namespace
     {
         return u8ToString(p);
     }
+
+    void readDuration(const TagLib::AudioProperties* props, Track& track)
+    {
+        if (props)
+        {
+            track.durationMs = unsigned(std::max(0, props->lengthInMilliseconds()));
+        }
+    }
+
+    // "-6.52 dB" or "0.988", from_chars so the locale's decimal comma doesn't get in the way
+    bool parseTagNumber(const TagLib::PropertyMap& props, const char* key, float& out)
+    {
+        const auto it = props.find(key);
+
+        if (it == props.end()
+            || it->second.isEmpty())
+        {
+            return false;
+        }
+
+        std::string v = trimAscii(toUtf8(it->second.front()));
+
+        if (!v.empty()
+            && v.front() == '+')
+        {
+            v.erase(0, 1);
+        }
+
+        return std::from_chars(v.data(), v.data() + v.size(), out).ec == std::errc();
+    }
+
+    void readReplayGain(const TagLib::PropertyMap& props, Track& track)
+    {
+        Gain g;
+
+        if (parseTagNumber(props, "REPLAYGAIN_TRACK_GAIN", g.db))
+        {
+            parseTagNumber(props, "REPLAYGAIN_TRACK_PEAK", g.peak);
+
+            g.known = true;
+
+            track.trackGain = g;
+        }
+
+        g = {};
+
+        if (parseTagNumber(props, "REPLAYGAIN_ALBUM_GAIN", g.db))
+        {
+            parseTagNumber(props, "REPLAYGAIN_ALBUM_PEAK", g.peak);
+
+            g.known = true;
+
+            track.albumGain = g;
+        }
+    }
+
+    void combineAlbumGain(Album& album)
+    {
+        album.gain = {};
+
+        // a tagger that wrote album gains saw the whole album, take its word
+        for (const auto& t : album.tracks)
+        {
+            if (t.albumGain.known)
+            {
+                album.gain = t.albumGain;
+
+                for (const auto& u : album.tracks)
+                {
+                    album.gain.peak = std::max(album.gain.peak, u.albumGain.peak);
+                }
+
+                return;
+            }
+        }
+
+        // otherwise the tracks' loudness, power averaged and weighted by length
+        double energy = 0.0;
+        double weight = 0.0;
+        float peak = 0.0f;
+
+        for (const auto& t : album.tracks)
+        {
+            if (!t.trackGain.known)
+            {
+                return;
+            }
+
+            const double w = double(std::max(t.durationMs, 1u));
+
+            energy += w * std::pow(10.0, (-18.0 - t.trackGain.db) / 10.0);
+            weight += w;
+            peak = std::max(peak, t.trackGain.peak);
+        }
+
+        if (weight <= 0.0)
+        {
+            return;
+        }
+
+        album.gain.db = float(-18.0 - 10.0 * std::log10(energy / weight));
+        album.gain.peak = peak;
+        album.gain.known = true;
+    }
+
+    void readFacetTags(const TagLib::Tag* tag, Track& track)
+    {
+        track.year = tag->year();
+
+        const TagLib::PropertyMap props = tag->properties();
+        const auto it = props.find("GENRE");
+
+        if (it == props.end())
+        {
+            return;
+        }
+
+        // multi-valued fields arrive as a list, id3v2 writers often use "a; b" instead
+        for (const auto& value : it->second)
+        {
+            const std::string genres = toUtf8(value);
+
+            size_t b = 0;
+
+            while (b <= genres.size())
+            {
+                size_t e = genres.find(';', b);
+
+                if (e == std::string::npos)
+                {
+                    e = genres.size();
+                }
+
+                std::string g = trimAscii(genres.substr(b, e - b));
+
+                if (!g.empty())
+                {
+                    track.genres.push_back(std::move(g));
+                }
+
+                b = e + 1;
+            }
+        }
+    }
 }
 
 void Library::scan(const std::vector<fs::path>& roots)
@@ -216,6 +368,32 @@ void Library::scan(const std::vector<fs::path>& roots)
         scanFolderRecursive(root);
     }
 
+    // files no longer in the library drop out of the cache
+    std::unordered_map<std::string, CachedDuration> kept;
+
+    for (const auto& album : albums)
+    {
+        for (const auto& track : album.tracks)
+        {
+            const auto it = durations.find(track.path);
+
+            if (it != durations.end())
+            {
+                kept.insert(*it);
+            }
+        }
+    }
+
+    durationsChanged = durationsChanged || kept.size() != durations.size();
+    durations.swap(kept);
+
+    if (durationsChanged)
+    {
+        saveDurations();
+
+        durationsChanged = false;
+    }
+
     for (auto& album : albums)
     {
         std::set<std::string> artistSet;
@@ -244,6 +422,75 @@ void Library::scan(const std::vector<fs::path>& roots)
                 return a.trackNo < b.trackNo;
             }
         );
+
+        for (auto& track : album.tracks)
+        {
+            std::string artists;
+
+            for (const auto& a : track.artists)
+            {
+                if (!artists.empty())
+                {
+                    artists += ", ";
+                }
+
+                artists += a;
+            }
+
+            track.titleKey = foldKey(track.title);
+            track.artistKey = foldKey(artists);
+        }
+
+        album.artistKey = foldKey(album.variousArtists
+            ? "various artists"
+            : album.artists.front());
+
+        album.titleKey = foldKey(album.title);
+        album.sortKey = album.artistKey + " - " + album.titleKey;
+
+        // the most common year wins, so a late bonus track doesn't move the album
+        std::map<unsigned int, size_t> years;
+        std::set<std::string> genreKeys;
+
+        album.year = 0;
+        album.genres.clear();
+        album.durationMs = 0;
+        album.added = 0;
+        album.playCount = 0;
+
+        for (auto& track : album.tracks)
+        {
+            const auto pc = playCounts.find(track.path);
+
+            track.playCount = pc == playCounts.end()
+                ? 0
+                : pc->second;
+
+            album.playCount += track.playCount;
+            album.durationMs += track.durationMs;
+            album.added = std::max(album.added, track.modified);
+
+            if (track.year != 0)
+            {
+                const size_t n = ++years[track.year];
+
+                if (album.year == 0
+                    || n > years[album.year])
+                {
+                    album.year = track.year;
+                }
+            }
+
+            for (const auto& g : track.genres)
+            {
+                if (genreKeys.insert(foldKey(g)).second)
+                {
+                    album.genres.push_back(g);
+                }
+            }
+        }
+
+        combineAlbumGain(album);
     }
 
     std::sort(
@@ -251,18 +498,448 @@ void Library::scan(const std::vector<fs::path>& roots)
         albums.end(),
         [](const Album& a, const Album& b)
         {
-            const auto key = [](const Album& x)
+            return a.sortKey < b.sortKey;
+        }
+    );
+
+    trackIndex.clear();
+
+    for (uint32_t a = 0; a < uint32_t(albums.size()); ++a)
+    {
+        for (uint32_t t = 0; t < uint32_t(albums[a].tracks.size()); ++t)
+        {
+            trackIndex[albums[a].tracks[t].path] = { a, t };
+        }
+    }
+
+    // measurements of files no longer in the library drop out
+    const size_t measured = gains.size();
+
+    std::erase_if(
+        gains,
+        [this](const auto& g)
+        {
+            return !trackIndex.contains(g.first);
+        }
+    );
+
+    if (gains.size() != measured)
+    {
+        saveLoudness();
+    }
+
+    index.build(albums);
+    terms.build(albums);
+    facets.build(albums);
+
+    buildOrders();
+}
+
+bool Library::albumBefore(SortOrder o, uint32_t a, uint32_t b) const
+{
+    const Album& x = albums[a];
+    const Album& y = albums[b];
+
+    // ties fall back to album id, which is the artist order
+    switch (o)
+    {
+    case SortOrder::Title:
+        if (x.titleKey != y.titleKey)
+        {
+            return x.titleKey < y.titleKey;
+        }
+
+        break;
+    case SortOrder::Year:
+        // albums without a year go last
+        if (x.year != y.year)
+        {
+            return x.year - 1 < y.year - 1;
+        }
+
+        break;
+    case SortOrder::Added:
+        if (x.added != y.added)
+        {
+            return x.added > y.added;
+        }
+
+        break;
+    case SortOrder::Duration:
+        if (x.durationMs != y.durationMs)
+        {
+            return x.durationMs < y.durationMs;
+        }
+
+        break;
+    case SortOrder::PlayCount:
+        if (x.playCount != y.playCount)
+        {
+            return x.playCount > y.playCount;
+        }
+
+        break;
+    default:
+        break;
+    }
+
+    return a < b;
+}
+
+void Library::buildOrders()
+{
+    const uint32_t n = uint32_t(albums.size());
+
+    std::vector<std::future<void>> jobs;
+
+    for (size_t o = 0; o < sortOrderCount; ++o)
+    {
+        jobs.push_back(std::async(
+            std::launch::async,
+            [this, o, n]
+            {
+                auto& order = orders[o];
+                auto& rank = ranks[o];
+
+                order.resize(n);
+
+                for (uint32_t i = 0; i < n; ++i)
+                {
+                    order[i] = i;
+                }
+
+                // albums are already in artist order
+                if (SortOrder(o) != SortOrder::Artist)
                 {
-                    const std::string artist = x.variousArtists
-                        ? "various artists"
-                        : x.artists.front();
+                    std::sort(
+                        order.begin(),
+                        order.end(),
+                        [this, o](uint32_t a, uint32_t b)
+                        {
+                            return albumBefore(SortOrder(o), a, b);
+                        }
+                    );
+                }
+
+                rank.resize(n);
+
+                for (uint32_t i = 0; i < n; ++i)
+                {
+                    rank[order[i]] = i;
+                }
+            }
+        ));
+    }
+
+    for (auto& j : jobs)
+    {
+        j.get();
+    }
+}
+
+void Library::addPlay(size_t album, size_t track)
+{
+    if (album >= albums.size()
+        || track >= albums[album].tracks.size())
+    {
+        return;
+    }
+
+    Track& t = albums[album].tracks[track];
+
+    ++t.playCount;
+    ++albums[album].playCount;
 
-                    return toLowerAscii(artist + " - " + x.title);
-                };
+    playCounts[t.path] = t.playCount;
 
-            return key(a) < key(b);
+    // only this album can have moved, and only towards the front
+    auto& order = orders[size_t(SortOrder::PlayCount)];
+    auto& rank = ranks[size_t(SortOrder::PlayCount)];
+
+    const uint32_t id = uint32_t(album);
+    const uint32_t from = rank[id];
+
+    const auto to = std::upper_bound(
+        order.begin(),
+        order.begin() + from,
+        id,
+        [this](uint32_t a, uint32_t b)
+        {
+            return albumBefore(SortOrder::PlayCount, a, b);
+        }
+    );
+
+    const uint32_t dest = uint32_t(to - order.begin());
+
+    std::move_backward(order.begin() + dest, order.begin() + from, order.begin() + from + 1);
+
+    order[dest] = id;
+
+    for (uint32_t i = dest; i <= from; ++i)
+    {
+        rank[order[i]] = i;
+    }
+}
+
+void Library::loadPlayCounts(const fs::path& file)
+{
+    playCounts.clear();
+
+    std::ifstream in(
+        file,
+        std::ios::binary
+    );
+
+    std::string line;
+
+    // "<count> <utf-8 path>" per line
+    while (std::getline(in, line))
+    {
+        const size_t sp = line.find(' ');
+
+        if (sp == std::string::npos)
+        {
+            continue;
+        }
+
+        unsigned int count = 0;
+
+        std::istringstream(line.substr(0, sp)) >> count;
+
+        if (count > 0)
+        {
+            playCounts[line.substr(sp + 1)] = count;
+        }
+    }
+}
+
+void Library::savePlayCounts(const fs::path& file) const
+{
+    std::error_code ec;
+
+    fs::create_directories(file.parent_path(), ec);
+
+    fs::path tmp = file;
+
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(
+            tmp,
+            std::ios::binary | std::ios::trunc
+        );
+
+        if (!out)
+        {
+            return;
+        }
+
+        for (const auto& [path, count] : playCounts)
+        {
+            out << count << ' ' << path << '\n';
+        }
+    }
+
+    fs::rename(tmp, file, ec);
+}
+
+void Library::setDurationCache(const fs::path& file)
+{
+    durationFile = file;
+    durations.clear();
+    durationsChanged = false;
+
+    std::ifstream in(
+        file,
+        std::ios::binary
+    );
+
+    std::string line;
+
+    // "<modified> <ms> <utf-8 path>" per line
+    while (std::getline(in, line))
+    {
+        const size_t a = line.find(' ');
+        const size_t b = a == std::string::npos
+            ? std::string::npos
+            : line.find(' ', a + 1);
+
+        if (b == std::string::npos)
+        {
+            continue;
+        }
+
+        CachedDuration d;
+
+        std::istringstream(line.substr(0, b)) >> d.modified >> d.ms;
+
+        if (d.ms > 0)
+        {
+            durations[line.substr(b + 1)] = d;
+        }
+    }
+}
+
+void Library::saveDurations() const
+{
+    if (durationFile.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+
+    fs::create_directories(durationFile.parent_path(), ec);
+
+    fs::path tmp = durationFile;
+
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(
+            tmp,
+            std::ios::binary | std::ios::trunc
+        );
+
+        if (!out)
+        {
+            return;
+        }
+
+        for (const auto& [path, d] : durations)
+        {
+            out << d.modified << ' ' << d.ms << ' ' << path << '\n';
         }
+    }
+
+    fs::rename(tmp, durationFile, ec);
+}
+
+void Library::setLoudnessCache(const fs::path& file)
+{
+    loudnessFile = file;
+    gains.clear();
+
+    std::ifstream in(
+        file,
+        std::ios::binary
     );
+
+    std::string line;
+
+    // "<modified> <gain db> <peak> <utf-8 path>" per line
+    while (std::getline(in, line))
+    {
+        const size_t a = line.find(' ');
+        const size_t b = a == std::string::npos
+            ? std::string::npos
+            : line.find(' ', a + 1);
+        const size_t c = b == std::string::npos
+            ? std::string::npos
+            : line.find(' ', b + 1);
+
+        if (c == std::string::npos)
+        {
+            continue;
+        }
+
+        CachedGain g;
+
+        std::istringstream fields(line.substr(0, c));
+
+        if (fields >> g.modified >> g.gain.db >> g.gain.peak)
+        {
+            g.gain.known = true;
+
+            gains[line.substr(c + 1)] = g;
+        }
+    }
+}
+
+void Library::saveLoudness() const
+{
+    if (loudnessFile.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+
+    fs::create_directories(loudnessFile.parent_path(), ec);
+
+    fs::path tmp = loudnessFile;
+
+    tmp += ".tmp";
+
+    {
+        std::ofstream out(
+            tmp,
+            std::ios::binary | std::ios::trunc
+        );
+
+        if (!out)
+        {
+            return;
+        }
+
+        for (const auto& [path, g] : gains)
+        {
+            out << g.modified << ' ' << g.gain.db << ' ' << g.gain.peak << ' ' << path << '\n';
+        }
+    }
+
+    fs::rename(tmp, loudnessFile, ec);
+}
+
+std::vector<std::pair<std::string, int64_t>> Library::unmeasured() const
+{
+    std::vector<std::pair<std::string, int64_t>> out;
+
+    // album by album, so whole albums get their album gain as early as possible
+    for (const auto& album : albums)
+    {
+        for (const auto& track : album.tracks)
+        {
+            if (!track.trackGain.known)
+            {
+                out.emplace_back(track.path, track.modified);
+            }
+        }
+    }
+
+    return out;
+}
+
+bool Library::setMeasuredGain(const std::string& path, int64_t modified, Gain gain)
+{
+    const auto it = trackIndex.find(path);
+
+    if (it == trackIndex.end())
+    {
+        return false;
+    }
+
+    Album& album = albums[it->second.first];
+    Track& track = album.tracks[it->second.second];
+
+    if (track.modified != modified)
+    {
+        return false;
+    }
+
+    gain.known = true;
+
+    gains[path] = { modified, gain };
+
+    // a tag that turned up in the meantime wins
+    if (!track.trackGain.known)
+    {
+        track.trackGain = gain;
+
+        combineAlbumGain(album);
+    }
+
+    return true;
 }
 
 void Library::scanFolderRecursive(const fs::path& folder)
@@ -308,18 +985,43 @@ void Library::scanFolderRecursive(const fs::path& folder)
 
         track.path = pathToUtf8String(path);
 
+        const auto mtime = it->last_write_time(ec);
+
+        if (!ec)
+        {
+            track.modified = std::chrono::duration_cast<std::chrono::seconds>(mtime.time_since_epoch()).count();
+        }
+
+        // the headers give the exact length, taglib's audio properties are only read when they don't
+        const auto cached = durations.find(track.path);
+
+        if (cached != durations.end()
+            && cached->second.modified == track.modified)
+        {
+            track.durationMs = cached->second.ms;
+        }
+        else
+        {
+            track.durationMs = probeDurationMs(path);
+        }
+
+        const bool readProperties = track.durationMs == 0;
+
         if (ext == ".wav")
         {
 #ifdef _WIN32
-            TagLib::RIFF::WAV::File file(path.wstring().c_str());
+            TagLib::RIFF::WAV::File file(path.wstring().c_str(), readProperties);
 #else
-            TagLib::RIFF::WAV::File file(u8ToString(path).c_str());
+            TagLib::RIFF::WAV::File file(u8ToString(path).c_str(), readProperties);
 #endif
             if (!file.isValid())
             {
                 continue;
             }
 
+            readDuration(file.audioProperties(), track);
+            readReplayGain(file.properties(), track);
+
             std::string artist;
 
             if (file.tag())
@@ -329,6 +1031,8 @@ void Library::scanFolderRecursive(const fs::path& folder)
                 track.title = trimAscii(toUtf8(file.tag()->title()));
                 track.trackNo = file.tag()->track();
                 track.album = trimAscii(toUtf8(file.tag()->album()));
+
+                readFacetTags(file.tag(), track);
             }
 
             if (artist.empty()
@@ -360,15 +1064,18 @@ void Library::scanFolderRecursive(const fs::path& folder)
         else if (ext == ".ogg")
         {
 #ifdef _WIN32
-            TagLib::Ogg::Vorbis::File file(path.wstring().c_str());
+            TagLib::Ogg::Vorbis::File file(path.wstring().c_str(), readProperties);
 #else
-            TagLib::Ogg::Vorbis::File file(u8ToString(path).c_str());
+            TagLib::Ogg::Vorbis::File file(u8ToString(path).c_str(), readProperties);
 #endif
             if (!file.isValid())
             {
                 continue;
             }
 
+            readDuration(file.audioProperties(), track);
+            readReplayGain(file.properties(), track);
+
             std::string artist;
 
             if (file.tag())
@@ -378,6 +1085,8 @@ void Library::scanFolderRecursive(const fs::path& folder)
                 track.title = trimAscii(toUtf8(file.tag()->title()));
                 track.trackNo = file.tag()->track();
                 track.album = trimAscii(toUtf8(file.tag()->album()));
+
+                readFacetTags(file.tag(), track);
             }
 
             if (artist.empty()
@@ -408,13 +1117,20 @@ void Library::scanFolderRecursive(const fs::path& folder)
         }
         else
         {
-            TagLib::FileRef ref = openFileRef(path);
+            TagLib::FileRef ref = openFileRef(path, readProperties);
 
             if (ref.isNull())
             {
                 continue;
             }
 
+            readDuration(ref.audioProperties(), track);
+
+            if (ref.file())
+            {
+                readReplayGain(ref.file()->properties(), track);
+            }
+
             const std::string artist = extractArtistLiteral(ref);
 
             if (artist.empty())
@@ -431,6 +1147,8 @@ void Library::scanFolderRecursive(const fs::path& folder)
                 track.title = trimAscii(toUtf8(tag->title()));
                 track.trackNo = tag->track();
                 track.album = trimAscii(toUtf8(tag->album()));
+
+                readFacetTags(tag, track);
             }
         }
 
@@ -457,6 +1175,29 @@ void Library::scanFolderRecursive(const fs::path& folder)
             track.album = track.title;
         }
 
+        if (!track.trackGain.known)
+        {
+            const auto g = gains.find(track.path);
+
+            if (g != gains.end()
+                && g->second.modified == track.modified)
+            {
+                track.trackGain = g->second.gain;
+            }
+        }
+
+        if (track.durationMs > 0)
+        {
+            CachedDuration& d = durations[track.path];
+
+            if (d.modified != track.modified
+                || d.ms != track.durationMs)
+            {
+                d = { track.modified, track.durationMs };
+                durationsChanged = true;
+            }
+        }
+
         addTrack(std::move(track));
     }
 }
@@ -1,39 +1,152 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <unordered_map>
+#include <utility>
+
+#include "facetindex.h"
+#include "searchindex.h"
+#include "termdictionary.h"
+
+// replaygain 2.0: db against -18 lufs and the linear peak it may not push past 1
+struct Gain
+{
+    float db = 0.0f;
+    float peak = 0.0f;
+    bool known = false;
+};
 
 struct Track
 {
     unsigned int trackNo = 0;
+    unsigned int year = 0;
+    unsigned int durationMs = 0;
+    unsigned int playCount = 0;
+    int64_t modified = 0;
 
     std::string album;
     std::vector<std::string> artists;
     std::string path;
     std::string title;
+    std::vector<std::string> genres;
+
+    // from replaygain tags, or our own analysis when the file has none
+    Gain trackGain;
+
+    // tags only, a computed album gain lives on the album
+    Gain albumGain;
+
+    // folded with foldKey at scan time
+    std::string titleKey;
+    std::string artistKey;
 };
 
 struct Album
 {
     bool variousArtists = false;
+    unsigned int year = 0;
+    unsigned int playCount = 0;
+    uint64_t durationMs = 0;
+    int64_t added = 0;
 
     std::vector<std::string> artists;
     std::string title;
     std::vector<Track> tracks;
+    std::vector<std::string> genres;
+
+    // the tagged album gain, else combined from the track gains once every track has one
+    Gain gain;
+
+    // folded with foldKey at scan time
+    std::string artistKey;
+    std::string titleKey;
+    std::string sortKey;
+};
+
+enum class SortOrder
+{
+    Artist,
+    Title,
+    Year,
+    Added,
+    Duration,
+    PlayCount
 };
 
+constexpr size_t sortOrderCount = 6;
+
 class Library
 {
 public:
     void scan(const std::vector<std::filesystem::path>& roots);
 
+    // play counts are keyed by path, so they survive rescans
+    void loadPlayCounts(const std::filesystem::path& file);
+    void savePlayCounts(const std::filesystem::path& file) const;
+    void addPlay(size_t album, size_t track);
+
+    // lengths read from the stream headers, keyed by path and modification time
+    // so a rescan only probes new or changed files, saved by scan when anything changed
+    void setDurationCache(const std::filesystem::path& file);
+
+    // measured gains are cached the same way, tagged ones are read on every scan
+    void setLoudnessCache(const std::filesystem::path& file);
+    void saveLoudness() const;
+
+    // path and modification time of each track with neither a tag nor a measurement
+    std::vector<std::pair<std::string, int64_t>> unmeasured() const;
+
+    // a measurement finished, false when the file changed or left the library meanwhile
+    bool setMeasuredGain(const std::string& path, int64_t modified, Gain gain);
+
+    // album ids in the given order, and each album's position in it
+    const std::vector<uint32_t>& order(SortOrder o) const { return orders[size_t(o)]; }
+    uint32_t rank(SortOrder o, size_t album) const { return ranks[size_t(o)][album]; }
+
     const std::vector<Album>& getAlbums() const { return albums; }
+    const SearchIndex& getIndex() const { return index; }
+    const TermDictionary& getTerms() const { return terms; }
+    const FacetIndex& getFacets() const { return facets; }
 private:
     std::vector<Album> albums;
+    SearchIndex index;
+    TermDictionary terms;
+    FacetIndex facets;
     std::unordered_map<std::string, size_t> albumIndex;
+    std::unordered_map<std::string, unsigned int> playCounts;
+
+    struct CachedDuration
+    {
+        int64_t modified = 0;
+        unsigned int ms = 0;
+    };
+
+    std::filesystem::path durationFile;
+    std::unordered_map<std::string, CachedDuration> durations;
+    bool durationsChanged = false;
+
+    struct CachedGain
+    {
+        int64_t modified = 0;
+        Gain gain;
+    };
+
+    std::filesystem::path loudnessFile;
+    std::unordered_map<std::string, CachedGain> gains;
+
+    // path -> album and track index, rebuilt by every scan
+    std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> trackIndex;
+
+    std::array<std::vector<uint32_t>, sortOrderCount> orders;
+    std::array<std::vector<uint32_t>, sortOrderCount> ranks;
 
+    bool albumBefore(SortOrder o, uint32_t a, uint32_t b) const;
+    void buildOrders();
     void scanFolderRecursive(const std::filesystem::path& folder);
     void addTrack(Track&& track);
+    void saveDurations() const;
 };
\ No newline at end of file
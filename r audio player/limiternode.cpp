@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include "limiternode.h"
+
+namespace
+{
+    constexpr float attackMs = 1.5f;
+    constexpr float releaseMs = 80.0f;
+
+    // frames run through the detector at a time, callbacks longer than this are split
+    constexpr size_t chunkFrames = 256;
+
+    constexpr size_t history = truePeakTaps - 1;
+
+    double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // kaiser windowed sinc cut at the input's nyquist, split so phase p, tap k is prototype tap 4k + p
+    // centred on a tap, so phase 0 is the samples themselves and the others fall between them,
+    // each phase scaled to unity gain so a steady level reads the same on all of them
+    TruePeakFilter interpolator()
+    {
+        constexpr size_t length = truePeakPhases * truePeakTaps;
+        constexpr double beta = 6.0;
+
+        // the last tap is left at zero
+        const double centre = double(length / 2);
+
+        double proto[length];
+
+        for (size_t n = 0; n < length; ++n)
+        {
+            const double x = (double(n) - centre) / double(truePeakPhases);
+            const double sinc = x == 0.0
+                ? 1.0
+                : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+
+            const double r = (double(n) - centre) / centre;
+            const double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+
+            proto[n] = sinc * window;
+        }
+
+        TruePeakFilter f;
+
+        for (size_t p = 0; p < truePeakPhases; ++p)
+        {
+            double sum = 0.0;
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                sum += proto[k * truePeakPhases + p];
+            }
+
+            for (size_t k = 0; k < truePeakTaps; ++k)
+            {
+                f.h[p][k] = float(proto[k * truePeakPhases + p] / sum);
+            }
+        }
+
+        return f;
+    }
+
+    const float ceiling = std::pow(10.0f, LimiterNode::ceilingDb / 20.0f);
+}
+
+LimiterNode::LimiterNode() = default;
+
+LimiterNode::~LimiterNode()
+{
+    uninit();
+}
+
+bool LimiterNode::init(ma_engine* engine, ma_node* next)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    prepare(
+        ma_engine_get_channels(engine),
+        ma_engine_get_sample_rate(engine)
+    );
+
+    return attach(engine, next);
+}
+
+void LimiterNode::prepare(ma_uint32 count, ma_uint32 sampleRate)
+{
+    // resolved here rather than on the first callback
+    dspKernels();
+
+    channels = count;
+
+    attack = std::max<ma_uint32>(1, ma_uint32(std::lround(attackMs * float(sampleRate) / 1000.0f)));
+
+    // the detector's peaks lie between the samples half its length back and the ones after them
+    lookahead = attack + ma_uint32(truePeakTaps / 2);
+
+    release = 1.0f - std::exp(-1000.0f / (releaseMs * float(std::max<ma_uint32>(sampleRate, 1))));
+
+    filter = interpolator();
+
+    detector.assign(size_t(channels) * (history + chunkFrames), 0.0f);
+    peaks.assign(chunkFrames, 0.0f);
+
+    delay.assign(size_t(lookahead) * channels, 0.0f);
+    delayPos = 0;
+
+    holdLength = size_t(attack) + 2;
+    holdValue.assign(holdLength, 1.0f);
+    holdAt.assign(holdLength, 0);
+    holdFront = 0;
+    holdCount = 0;
+    frameIndex = 0;
+
+    held.assign(attack, 1.0f);
+    heldPos = 0;
+    heldSum = double(attack);
+
+    gain = 1.0f;
+
+    lastReduction.store(0.0f, std::memory_order_relaxed);
+}
+
+void LimiterNode::process(float* frames, size_t count)
+{
+    float lowest = 1.0f;
+
+    for (size_t done = 0; done < count; done += chunkFrames)
+    {
+        const size_t n = std::min(chunkFrames, count - done);
+
+        processChunk(frames + done * channels, n);
+
+        lowest = std::min(lowest, gain);
+    }
+
+    lastReduction.store(
+        lowest < 1.0f
+            ? -20.0f * std::log10(lowest)
+            : 0.0f,
+        std::memory_order_relaxed
+    );
+}
+
+void LimiterNode::processChunk(float* frames, size_t count)
+{
+    const DspKernels& k = dspKernels();
+
+    std::fill(peaks.begin(), peaks.begin() + count, 0.0f);
+
+    for (ma_uint32 ch = 0; ch < channels; ++ch)
+    {
+        float* d = detector.data() + size_t(ch) * (history + chunkFrames);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            d[history + i] = frames[i * channels + ch];
+        }
+
+        k.truePeak(d + history, count, filter, peaks.data());
+
+        std::memmove(d, d + count, history * sizeof(float));
+    }
+
+    const bool on = enabled.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float needed = on && peaks[i] > ceiling
+            ? ceiling / peaks[i]
+            : 1.0f;
+
+        // held long enough that the average below is all the way down for the frames around the peak
+        const float h = hold(needed);
+
+        heldSum += double(h) - double(held[heldPos]);
+        held[heldPos] = h;
+        heldPos = (heldPos + 1) % held.size();
+
+        const float target = std::min(1.0f, float(heldSum / double(attack)));
+
+        // down as fast as the average goes, back up slowly, and onto the target once the step is below audible
+        if (target < gain
+            || target - gain < 1e-6f)
+        {
+            gain = target;
+        }
+        else
+        {
+            gain += (target - gain) * release;
+        }
+
+        float* f = frames + i * channels;
+        float* late = delay.data() + delayPos * channels;
+
+        for (ma_uint32 ch = 0; ch < channels; ++ch)
+        {
+            const float in = f[ch];
+
+            f[ch] = late[ch] * gain;
+            late[ch] = in;
+        }
+
+        delayPos = (delayPos + 1) % lookahead;
+    }
+}
+
+float LimiterNode::hold(float needed)
+{
+    if (holdCount > 0
+        && frameIndex - holdAt[holdFront] >= holdLength)
+    {
+        holdFront = (holdFront + 1) % holdLength;
+        --holdCount;
+    }
+
+    // rising values from the front, anything not below the new one can never be the minimum again
+    while (holdCount > 0
+        && holdValue[(holdFront + holdCount - 1) % holdLength] >= needed)
+    {
+        --holdCount;
+    }
+
+    const size_t back = (holdFront + holdCount) % holdLength;
+
+    holdValue[back] = needed;
+    holdAt[back] = frameIndex;
+    ++holdCount;
+
+    ++frameIndex;
+
+    return holdValue[holdFront];
+}
\ No newline at end of file
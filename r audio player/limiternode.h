@@ -0,0 +1,82 @@
+#pragma once
+
+#include "dspkernels.h"
+#include "graphnode.h"
+#include "miniaudio.h"
+
+#include <atomic>
+#include <vector>
+
+// the last processing node, ahead of the analysis tap, keeps the output under a ceiling measured on the 4x oversampled signal,
+// so volume, replaygain and eq boosts can't clip in the device or in its resampler
+// the audio runs a short lookahead behind the detector, the gain comes down over that time before a peak
+// arrives and recovers slowly after, gain and peaks are taken over all channels at once so the image holds
+// 4x finds inter-sample peaks to within about half a db at the top of the audio band, the ceiling leaves room for that
+class LimiterNode : public GraphNode<LimiterNode>
+{
+public:
+    // dbtp
+    static constexpr float ceilingDb = -1.0f;
+
+    LimiterNode();
+    ~LimiterNode();
+
+    LimiterNode(const LimiterNode&) = delete;
+    LimiterNode& operator=(const LimiterNode&) = delete;
+
+    // feeds 'next'
+    bool init(ma_engine* engine, ma_node* next);
+
+    // any thread, off still delays by the lookahead so the clock doesn't move, a reduction in progress recovers as usual
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // engine frames the audio is held back, fixed by init
+    ma_uint32 latency() const { return lookahead; }
+
+    // db taken off at the deepest point of the last device period, 0 when nothing was touched, any thread
+    float reduction() const { return lastReduction.load(std::memory_order_relaxed); }
+
+    // for running it without a graph: sized for the channels and rate, then interleaved frames in place
+    void prepare(ma_uint32 channels, ma_uint32 sampleRate);
+    void process(float* frames, size_t count);
+private:
+    // frames the gain takes to come down, and the detector's own delay on top
+    ma_uint32 attack = 1;
+    ma_uint32 lookahead = 1;
+
+    // share of the remaining distance the gain recovers each frame
+    float release = 0.0f;
+
+    std::atomic<bool> enabled{ true };
+    std::atomic<float> lastReduction{ 0.0f };
+
+    TruePeakFilter filter{};
+
+    // audio thread only
+
+    // per channel, the filter's history then a chunk of input
+    std::vector<float> detector;
+    std::vector<float> peaks;
+
+    // interleaved lookahead frames
+    std::vector<float> delay;
+    size_t delayPos = 0;
+
+    // the gain each frame needs, held at its minimum over attack + 2 frames, then averaged over attack frames
+    // the minimum is kept as a ring of candidates rising from the front, with the frame each came in
+    std::vector<float> holdValue;
+    std::vector<ma_uint64> holdAt;
+    size_t holdLength = 1;
+    size_t holdFront = 0;
+    size_t holdCount = 0;
+    ma_uint64 frameIndex = 0;
+
+    std::vector<float> held;
+    size_t heldPos = 0;
+    double heldSum = 0.0;
+
+    float gain = 1.0f;
+
+    void processChunk(float* frames, size_t count);
+    float hold(float needed);
+};
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "loudness.h"
+
+namespace
+{
+    constexpr size_t phases = 4;
+    constexpr size_t phaseTaps = 12;
+
+    // blocks quieter than -70 lufs never count
+    const double absoluteGate = std::pow(10.0, (-70.0 + 0.691) / 10.0);
+
+    inline double run(const double b0, const double b1, const double b2, const double a1, const double a2, double (&s)[2], double x)
+    {
+        const double y = b0 * x + s[0];
+
+        s[0] = b1 * x - a1 * y + s[1];
+        s[1] = b2 * x - a2 * y;
+
+        return y;
+    }
+
+    inline double toLufs(double meanSquare)
+    {
+        return -0.691 + 10.0 * std::log10(meanSquare);
+    }
+
+    // the bs.1770 pre-filter and rlb high pass, recomputed for the rate
+    void kWeighting(double fs, KWeightingStage& shelf, KWeightingStage& highpass)
+    {
+        {
+            const double f0 = 1681.974450955533;
+            const double gain = 3.999843853973347;
+            const double q = 0.7071752369554196;
+
+            const double k = std::tan(std::numbers::pi * f0 / fs);
+            const double vh = std::pow(10.0, gain / 20.0);
+            const double vb = std::pow(vh, 0.4996667741545416);
+            const double a0 = 1.0 + k / q + k * k;
+
+            shelf.b0 = (vh + vb * k / q + k * k) / a0;
+            shelf.b1 = 2.0 * (k * k - vh) / a0;
+            shelf.b2 = (vh - vb * k / q + k * k) / a0;
+            shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+            shelf.a2 = (1.0 - k / q + k * k) / a0;
+        }
+
+        {
+            const double f0 = 38.13547087602444;
+            const double q = 0.5003270373238773;
+
+            const double k = std::tan(std::numbers::pi * f0 / fs);
+            const double a0 = 1.0 + k / q + k * k;
+
+            highpass.b0 = 1.0;
+            highpass.b1 = -2.0;
+            highpass.b2 = 1.0;
+            highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+            highpass.a2 = (1.0 - k / q + k * k) / a0;
+        }
+    }
+
+    // 5.1: no lfe, surrounds weighted up
+    double channelWeight(uint32_t c, uint32_t count)
+    {
+        if (count != 6)
+        {
+            return 1.0;
+        }
+
+        return c == 3
+            ? 0.0
+            : c >= 4
+            ? 1.41
+            : 1.0;
+    }
+}
+
+LoudnessMeter::LoudnessMeter(uint32_t ch, uint32_t rate)
+    : channelCount(ch)
+{
+    const double fs = double(std::max<uint32_t>(rate, 1));
+
+    kWeighting(fs, shelf, highpass);
+
+    channels.resize(channelCount);
+
+    for (uint32_t c = 0; c < channelCount; ++c)
+    {
+        channels[c].history.assign(phaseTaps, 0.0f);
+        channels[c].weight = channelWeight(c, channelCount);
+    }
+
+    // hann windowed sinc, phase 0 lands on the input samples themselves
+    taps.resize(phases * phaseTaps);
+
+    const double center = double(taps.size()) / 2.0;
+
+    for (size_t i = 0; i < taps.size(); ++i)
+    {
+        const double t = (double(i) - center) / double(phases);
+        const double sinc = t == 0.0
+            ? 1.0
+            : std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+        const double window = 0.5 * (1.0 - std::cos(2.0 * std::numbers::pi * double(i) / double(taps.size())));
+
+        taps[i] = float(sinc * window);
+    }
+
+    // unity gain per phase
+    for (size_t p = 0; p < phases; ++p)
+    {
+        double sum = 0.0;
+
+        for (size_t k = 0; k < phaseTaps; ++k)
+        {
+            sum += taps[k * phases + p];
+        }
+
+        for (size_t k = 0; k < phaseTaps; ++k)
+        {
+            taps[k * phases + p] = float(taps[k * phases + p] / sum);
+        }
+    }
+
+    subLength = std::max<size_t>((size_t(fs) + 5) / 10, 1);
+}
+
+void LoudnessMeter::add(const float* frames, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            Channel& ch = channels[c];
+
+            const float x = frames[i * channelCount + c];
+
+            std::copy(ch.history.begin() + 1, ch.history.end(), ch.history.begin());
+
+            ch.history.back() = x;
+
+            for (size_t p = 0; p < phases; ++p)
+            {
+                double y = 0.0;
+
+                for (size_t k = 0; k < phaseTaps; ++k)
+                {
+                    y += double(taps[k * phases + p]) * ch.history[phaseTaps - 1 - k];
+                }
+
+                peak = std::max(peak, std::abs(y));
+            }
+
+            double v = run(shelf.b0, shelf.b1, shelf.b2, shelf.a1, shelf.a2, ch.s[0], x);
+
+            v = run(highpass.b0, highpass.b1, highpass.b2, highpass.a1, highpass.a2, ch.s[1], v);
+
+            ch.energy += v * v;
+        }
+
+        if (++subFill == subLength)
+        {
+            endSub();
+        }
+    }
+}
+
+void LoudnessMeter::endSub()
+{
+    double sum = 0.0;
+
+    for (Channel& ch : channels)
+    {
+        sum += ch.weight * ch.energy;
+
+        ch.energy = 0.0;
+    }
+
+    subFill = 0;
+
+    subs[subCount % 4] = sum;
+
+    if (++subCount < 4)
+    {
+        return;
+    }
+
+    const double z = (subs[0] + subs[1] + subs[2] + subs[3]) / double(4 * subLength);
+
+    if (z > absoluteGate)
+    {
+        blocks.push_back(z);
+    }
+}
+
+double LoudnessMeter::integrated() const
+{
+    if (blocks.empty())
+    {
+        return -70.0;
+    }
+
+    double mean = 0.0;
+
+    for (const double z : blocks)
+    {
+        mean += z;
+    }
+
+    mean /= double(blocks.size());
+
+    // the relative gate sits 10 lu under the loudness of what passed the absolute one
+    const double relativeGate = mean / 10.0;
+
+    double sum = 0.0;
+    size_t n = 0;
+
+    for (const double z : blocks)
+    {
+        if (z > relativeGate)
+        {
+            sum += z;
+            ++n;
+        }
+    }
+
+    return n == 0
+        ? -70.0
+        : toLufs(sum / double(n));
+}
+
+MomentaryLoudness::MomentaryLoudness(uint32_t ch, uint32_t rate)
+    : channelCount(ch)
+{
+    const double fs = double(std::max<uint32_t>(rate, 1));
+
+    kWeighting(fs, shelf, highpass);
+
+    channels.resize(channelCount);
+
+    for (uint32_t c = 0; c < channelCount; ++c)
+    {
+        channels[c].weight = channelWeight(c, channelCount);
+    }
+
+    subLength = std::max<size_t>((size_t(fs) + 5) / 10, 1);
+}
+
+void MomentaryLoudness::add(const float* frames, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            Channel& ch = channels[c];
+
+            double v = run(shelf.b0, shelf.b1, shelf.b2, shelf.a1, shelf.a2, ch.s[0], frames[i * channelCount + c]);
+
+            v = run(highpass.b0, highpass.b1, highpass.b2, highpass.a1, highpass.a2, ch.s[1], v);
+
+            sub += ch.weight * v * v;
+        }
+
+        if (++subFill == subLength)
+        {
+            subs[subCount % 4] = sub;
+
+            ++subCount;
+
+            sub = 0.0;
+            subFill = 0;
+        }
+    }
+}
+
+void MomentaryLoudness::reset()
+{
+    for (Channel& ch : channels)
+    {
+        ch = Channel{ ch.weight };
+    }
+
+    sub = 0.0;
+    subFill = 0;
+    subCount = 0;
+}
+
+double MomentaryLoudness::lufs() const
+{
+    if (subCount < 4)
+    {
+        return -70.0;
+    }
+
+    const double z = (subs[0] + subs[1] + subs[2] + subs[3]) / double(4 * subLength);
+
+    return z > absoluteGate
+        ? toLufs(z)
+        : -70.0;
+}
\ No newline at end of file
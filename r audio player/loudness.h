@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one stage of the bs.1770 k-weighting, normalised so a0 is 1
+struct KWeightingStage
+{
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+};
+
+// ebu r128 integrated loudness and true peak of one track, fed interleaved float frames
+// k-weighted 400 ms blocks every 100 ms, gated at -70 lufs and again 10 lu under the ungated mean
+// the peak is taken on a 4x oversampled signal, so intersample overs count
+class LoudnessMeter
+{
+public:
+    LoudnessMeter(uint32_t channels, uint32_t sampleRate);
+
+    void add(const float* frames, size_t count);
+
+    // lufs, or -70 when every block was gated out (silence, or shorter than one block)
+    double integrated() const;
+
+    // linear
+    double truePeak() const { return peak; }
+private:
+    struct Channel
+    {
+        double weight = 1.0;
+
+        // state of both k-weighting stages
+        double s[2][2]{};
+
+        // input history for the oversampling filter, newest last
+        std::vector<float> history;
+
+        double energy = 0.0;
+    };
+
+    uint32_t channelCount = 0;
+
+    KWeightingStage shelf;
+    KWeightingStage highpass;
+
+    std::vector<Channel> channels;
+
+    // 4 phases of the interpolation filter
+    std::vector<float> taps;
+
+    size_t subLength = 0;
+    size_t subFill = 0;
+
+    // the last four 100 ms sub blocks, summed over channels
+    double subs[4]{};
+    size_t subCount = 0;
+
+    // mean square of each full block that passed the absolute gate
+    std::vector<double> blocks;
+
+    double peak = 0.0;
+
+    void endSub();
+};
+
+// ebu r128 momentary loudness for a meter, the k-weighted mean square of the last 400 ms, moving in 100 ms steps
+class MomentaryLoudness
+{
+public:
+    MomentaryLoudness(uint32_t channels, uint32_t sampleRate);
+
+    void add(const float* frames, size_t count);
+
+    // forgets everything, for a gap in what was fed
+    void reset();
+
+    // lufs, -70 at the quietest and until the first 400 ms are in
+    double lufs() const;
+private:
+    uint32_t channelCount = 0;
+
+    KWeightingStage shelf;
+    KWeightingStage highpass;
+
+    struct Channel
+    {
+        double weight = 1.0;
+
+        // state of both k-weighting stages
+        double s[2][2]{};
+    };
+
+    std::vector<Channel> channels;
+
+    size_t subLength = 0;
+    size_t subFill = 0;
+    double sub = 0.0;
+
+    // the last four 100 ms sub blocks, summed over channels
+    double subs[4]{};
+    size_t subCount = 0;
+};
\ No newline at end of file
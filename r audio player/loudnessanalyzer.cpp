@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "loudness.h"
+#include "loudnessanalyzer.h"
+#include "miniaudio.h"
+
+namespace
+{
+    constexpr ma_uint64 chunkFrames = 16384;
+
+    // per chunk while something plays, one thread then decodes at a few dozen times real time
+    constexpr std::chrono::milliseconds playingRest{ 10 };
+
+    // replaygain 2.0 reference
+    constexpr double referenceLufs = -18.0;
+
+    // silence would otherwise ask for unbounded gain
+    constexpr double maxGain = 24.0;
+
+    void lowerPriority()
+    {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(__linux__)
+        // linux takes the calling thread here, not the process
+        setpriority(PRIO_PROCESS, 0, 19);
+#endif
+    }
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer(QObject* parent)
+    : QObject(parent)
+{
+    // half the cores at most, the scan and the gui keep the rest
+    const size_t count = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        workers.emplace_back(
+            [this, i]
+            {
+                run(i);
+            }
+        );
+    }
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        quit.store(true, std::memory_order_release);
+    }
+
+    wake.notify_all();
+
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+}
+
+void LoudnessAnalyzer::analyse(std::vector<Job> list)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        jobs.assign(
+            std::make_move_iterator(list.begin()),
+            std::make_move_iterator(list.end())
+        );
+    }
+
+    wake.notify_all();
+}
+
+void LoudnessAnalyzer::setPlaying(bool p)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        playing.store(p, std::memory_order_release);
+    }
+
+    // the other threads pick up again once playback stops
+    wake.notify_all();
+}
+
+void LoudnessAnalyzer::run(size_t index)
+{
+    lowerPriority();
+
+    for (;;)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+
+            wake.wait(
+                guard,
+                [&]
+                {
+                    return quit.load(std::memory_order_acquire)
+                        || (!jobs.empty()
+                            && (index == 0 || !playing.load(std::memory_order_acquire)));
+                }
+            );
+
+            if (quit.load(std::memory_order_acquire))
+            {
+                return;
+            }
+
+            job = std::move(jobs.front());
+
+            jobs.pop_front();
+        }
+
+        measure(job);
+    }
+}
+
+void LoudnessAnalyzer::measure(const Job& job)
+{
+    // the file's own format, nothing is resampled or mixed down
+    ma_decoder_config config = ma_decoder_config_init(
+        ma_format_f32,
+        0,
+        0
+    );
+
+    ma_decoder decoder;
+
+#ifdef _WIN32
+    const ma_result result = ma_decoder_init_file_w(
+        reinterpret_cast<const wchar_t*>(job.path.utf16()),
+        &config,
+        &decoder
+    );
+#else
+    const ma_result result = ma_decoder_init_file(
+        job.path.toUtf8().constData(),
+        &config,
+        &decoder
+    );
+#endif
+
+    if (result != MA_SUCCESS)
+    {
+        return;
+    }
+
+    ma_uint32 channels = 0;
+    ma_uint32 sampleRate = 0;
+
+    ma_decoder_get_data_format(
+        &decoder,
+        nullptr,
+        &channels,
+        &sampleRate,
+        nullptr,
+        0
+    );
+
+    if (channels == 0
+        || sampleRate == 0)
+    {
+        ma_decoder_uninit(&decoder);
+
+        return;
+    }
+
+    LoudnessMeter meter(channels, sampleRate);
+
+    std::vector<float> buffer(size_t(chunkFrames) * channels);
+
+    for (;;)
+    {
+        if (quit.load(std::memory_order_acquire))
+        {
+            ma_decoder_uninit(&decoder);
+
+            return;
+        }
+
+        ma_uint64 read = 0;
+
+        ma_decoder_read_pcm_frames(
+            &decoder,
+            buffer.data(),
+            chunkFrames,
+            &read
+        );
+
+        if (read == 0)
+        {
+            break;
+        }
+
+        meter.add(buffer.data(), size_t(read));
+
+        if (playing.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(playingRest);
+        }
+    }
+
+    ma_decoder_uninit(&decoder);
+
+    const double gain = std::clamp(referenceLufs - meter.integrated(), -maxGain, maxGain);
+
+    Q_EMIT analysed(job.path, job.modified, gain, meter.truePeak());
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// measures tracks that carry no replaygain on a few low priority threads, decoding each with ma_decoder
+// while something plays only one thread keeps going and it rests between chunks, so the reader and
+// the audio callback never wait on it, results are keyed by path and modification time so a
+// restart just carries on with whatever is still unmeasured
+class LoudnessAnalyzer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Job
+    {
+        QString path;
+        qint64 modified = 0;
+    };
+
+    explicit LoudnessAnalyzer(QObject* parent = nullptr);
+    ~LoudnessAnalyzer() override;
+
+    // replaces whatever is still waiting, a track being measured finishes
+    void analyse(std::vector<Job> jobs);
+
+    void setPlaying(bool playing);
+Q_SIGNALS:
+    // from a worker thread, gain in db against -18 lufs and the linear true peak
+    void analysed(const QString& path, qint64 modified, double gain, double peak);
+private:
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+
+    std::atomic<bool> quit{ false };
+    std::atomic<bool> playing{ false };
+
+    std::vector<std::thread> workers;
+
+    void run(size_t index);
+    void measure(const Job& job);
+};
\ No newline at end of file
@@ -8,7 +8,18 @@
 #include <QScreen>
 #include <QGuiApplication>
 
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "convolvernode.h"
+#include "dspkernels.h"
+#include "resampler.h"
 #include "settings.h"
+#include "tapnode.h"
 #include "mainwindow.h"
 
 // silence intellisense
@@ -18,6 +29,42 @@
 
 int main(int argc, char** argv)
 {
+    // times the dsp kernel variants against the scalar ones, the resampler tiers, the convolver against a direct convolution
+    // and what the analysis tap costs the audio thread, then exits, no window and no lock
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--benchmark") == 0)
+        {
+#ifdef _WIN32
+            // a gui subsystem program has no console of its own
+            if (AttachConsole(ATTACH_PARENT_PROCESS))
+            {
+                FILE* out = nullptr;
+
+                freopen_s(&out, "CONOUT$", "w", stdout);
+            }
+#endif
+
+            const int kernels = runDspBenchmark();
+
+            std::printf("\n");
+
+            const int resamplers = runResamplerBenchmark();
+
+            std::printf("\n");
+
+            const int convolution = runConvolverBenchmark();
+
+            std::printf("\n");
+
+            const int tap = runTapBenchmark();
+
+            return kernels != 0 || resamplers != 0 || convolution != 0 || tap != 0
+                ? 1
+                : 0;
+        }
+    }
+
     QApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
 
     QApplication app(argc, argv);
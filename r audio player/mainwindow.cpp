@@ -1,5 +1,6 @@
 ﻿// includes are alphabetical in files > 1000 lines
 
+#include <QAbstractItemView>
 #include <QApplication>
 #include <QDir>
 #include <QEvent>
@@ -16,6 +17,8 @@
 #include <QPushButton>
 #include <QScreen>
 #include <QShortcut>
+#include <QSignalBlocker>
+#include <QStandardPaths>
 #include <QStorageInfo>
 #include <QStringList>
 #include <QVBoxLayout>
@@ -33,6 +36,8 @@
 #include <taglib/vorbisfile.h>
 #include <taglib/xiphcomment.h>
 
+#include <cmath>
+
 #include "clickslider.h"
 #include "folderdialog.h"
 #include "mainwindow.h"
@@ -598,6 +603,63 @@ static QString qs(const std::wstring& w)
     return QString::fromStdWString(w);
 }
 
+static EqSettings eqSettings(bool enabled, const QList<double>& gains)
+{
+    float g[eqBands]{};
+
+    for (size_t i = 0; i < eqBands && i < size_t(gains.size()); ++i)
+    {
+        g[i] = float(std::clamp(gains[int(i)], -12.0, 12.0));
+    }
+
+    EqSettings eq = eqCurve(g);
+
+    eq.enabled = enabled;
+
+    return eq;
+}
+
+static std::filesystem::path appDataFile(const char* name)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+
+#ifdef _WIN32
+    return std::filesystem::path(dir.toStdWString()) / name;
+#else
+    return std::filesystem::path(dir.toStdString()) / name;
+#endif
+}
+
+namespace
+{
+    // reorders by the library's precomputed ranks, so switching the sort only
+    // moves existing items around instead of rebuilding the list
+    struct AlbumItem final : QListWidgetItem
+    {
+        const Library* library = nullptr;
+        const SortOrder* order = nullptr;
+
+        uint32_t album = 0;
+
+        AlbumItem(const QString& text, uint32_t a, const Library* l, const SortOrder* o)
+            :
+            QListWidgetItem(text),
+            library(l),
+            order(o),
+            album(a)
+        {
+            setData(Qt::UserRole, int(a));
+        }
+
+        bool operator<(const QListWidgetItem& other) const override
+        {
+            const auto& o = static_cast<const AlbumItem&>(other);
+
+            return library->rank(*order, album) < library->rank(*order, o.album);
+        }
+    };
+}
+
 static void showCoverFullscreen(const QPixmap& pix, bool pip, const QString& title, const QWidget* centerOn)
 {
     if (pix.isNull())
@@ -1125,6 +1187,33 @@ MainWindow::MainWindow(Settings* s) : settings(s)
             height: 0px;
         }
 
+        QComboBox
+        {
+            background-color: #1a1a1a;
+            border: 1px solid #333333;
+            padding: 6px;
+            selection-background-color: #333333;
+            selection-color: #e6e6e6;
+        }
+
+        QComboBox:hover
+        {
+            background-color: #333333;
+        }
+
+        QComboBox::drop-down
+        {
+            border: none;
+            width: 0px;
+        }
+
+        QComboBox QAbstractItemView
+        {
+            background-color: #1a1a1a;
+            border: 1px solid #333333;
+            outline: none;
+        }
+
         QCheckBox
         {
             spacing: 6px;
@@ -1271,8 +1360,11 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     setAttribute(Qt::WA_OpaquePaintEvent);
     setAttribute(Qt::WA_StyledBackground, true);
 
-    audio.init();
+    audio.init(outputSettings());
     audio.setVolume(settings->volume);
+    audio.setCue(scrobbleThreshold);
+
+    applyPlaybackSettings();
 
     if (settings->folders.isEmpty())
     {
@@ -1294,6 +1386,10 @@ MainWindow::MainWindow(Settings* s) : settings(s)
         roots.emplace_back(std::filesystem::path(f.toUtf8().constData()));
     }
 
+    library.loadPlayCounts(appDataFile("playcounts"));
+    library.setDurationCache(appDataFile("durations"));
+    library.setLoudnessCache(appDataFile("loudness"));
+
     QApplication::setOverrideCursor(Qt::WaitCursor);
 
     library.scan(roots);
@@ -1305,6 +1401,37 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     search->setClearButtonEnabled(true);
     search->setMinimumHeight(28);
 
+    completions = new QStringListModel(this);
+
+    completer = new QCompleter(completions, this);
+    completer->setWidget(search);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setMaxVisibleItems(8);
+
+    auto facetRow = new QHBoxLayout;
+    facetRow->setSpacing(6);
+
+    for (int f = 0; f < int(facetCount); ++f)
+    {
+        auto* box = new QComboBox(this);
+        box->setMinimumHeight(28);
+        box->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+        box->setMinimumContentsLength(8);
+
+        facetRow->addWidget(box, 1);
+
+        facetBoxes << box;
+    }
+
+    sortOrder = SortOrder(std::clamp(settings->sortOrder, 0, int(sortOrderCount) - 1));
+
+    sortBox = new QComboBox(this);
+    sortBox->setMinimumHeight(28);
+    sortBox->addItems({ "artist", "album", "year", "date added", "duration", "play count" });
+    sortBox->setCurrentIndex(int(sortOrder));
+
+    facetRow->addWidget(sortBox);
+
     albums = new QListWidget(this);
     tracks = new QListWidget(this);
 
@@ -1320,6 +1447,18 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     coverLabel->setScaledContents(false);
     coverLabel->hide();
 
+    // as tall as the cover, wide enough for the spectrum to read
+    meters = new MeterWidget(
+        audio.analysisTap(),
+        [this]
+        {
+            return audio.limiterReduction();
+        },
+        this
+    );
+    meters->setFixedSize(settings->coverSize * 3, settings->coverSize);
+    meters->setVisible(settings->meters);
+
     nowPlaying = new QLabel("nothing playing", this);
     nowPlaying->setAlignment(Qt::AlignVCenter | Qt::AlignRight);
     nowPlaying->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
@@ -1328,6 +1467,7 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     nowPlayingLayout->setSpacing(6);
     nowPlayingLayout->setAlignment(Qt::AlignCenter);
     nowPlayingLayout->addWidget(coverLabel);
+    nowPlayingLayout->addWidget(meters);
     nowPlayingLayout->addWidget(nowPlaying);
 
     auto nowPlayingContainer = new QWidget(this);
@@ -1387,13 +1527,19 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     auto root = new QVBoxLayout(this);
     root->setSpacing(6);
     root->addWidget(search);
+    root->addLayout(facetRow);
     root->addLayout(lists);
     root->addWidget(nowPlayingContainer);
     root->addLayout(controls);
 
     search->setObjectName("search");
+    facetBoxes[int(Facet::Artist)]->setObjectName("artistFacet");
+    facetBoxes[int(Facet::Year)]->setObjectName("yearFacet");
+    facetBoxes[int(Facet::Genre)]->setObjectName("genreFacet");
+    sortBox->setObjectName("sortBox");
     albums->setObjectName("albums");
     tracks->setObjectName("tracks");
+    meters->setObjectName("meters");
     nowPlaying->setObjectName("nowPlaying");
     nowPlayingContainer->setObjectName("nowPlayingContainer");
     backwardButton->setObjectName("backwardButton");
@@ -1406,8 +1552,39 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     settingsButton->setObjectName("settingsButton");
 
     updateBackground();
+    populateFacets();
     populateAlbums();
 
+    for (QComboBox* box : facetBoxes)
+    {
+        connect(
+            box,
+            &QComboBox::currentIndexChanged,
+            this,
+            &MainWindow::populateAlbums
+        );
+    }
+
+    connect(
+        sortBox,
+        &QComboBox::currentIndexChanged,
+        this,
+        [&](int i)
+        {
+            sortOrder = SortOrder(i);
+
+            settings->sortOrder = i;
+            settings->save();
+
+            albums->sortItems();
+
+            if (auto* item = albums->currentItem())
+            {
+                albums->scrollToItem(item);
+            }
+        }
+    );
+
     connect(
         search,
         &QLineEdit::textChanged,
@@ -1420,6 +1597,23 @@ MainWindow::MainWindow(Settings* s) : settings(s)
         }
     );
 
+    connect(
+        search,
+        &QLineEdit::textEdited,
+        this,
+        &MainWindow::updateCompletions
+    );
+
+    connect(
+        completer,
+        qOverload<const QString&>(&QCompleter::activated),
+        this,
+        [&](const QString& text)
+        {
+            search->setText(text);
+        }
+    );
+
     connect(
         albums,
         &QListWidget::itemClicked,
@@ -1549,6 +1743,8 @@ MainWindow::MainWindow(Settings* s) : settings(s)
         {
             settings->autoplay = enabled;
             settings->save();
+
+            queueNext();
         }
     );
 
@@ -1561,7 +1757,9 @@ MainWindow::MainWindow(Settings* s) : settings(s)
             if (audio._soundInit()
                 && cursorSlider->isSliderDown())
             {
-                audio.seek((v / double(cursorSlider->maximum())) * audio.length());
+                audio.scrub((v / double(cursorSlider->maximum())) * audio.length());
+
+                scrubbed = true;
             }
         }
     );
@@ -1574,11 +1772,30 @@ MainWindow::MainWindow(Settings* s) : settings(s)
         {
             if (audio._soundInit())
             {
-                audio.seek((v / double(cursorSlider->maximum())) * audio.length());
+                audio.scrub((v / double(cursorSlider->maximum())) * audio.length());
+
+                scrubbed = true;
             }
         }
     );
 
+    // the drag is over, land exactly where the handle was let go
+    connect(
+        cursorSlider,
+        &QSlider::sliderReleased,
+        this,
+        [&]
+        {
+            if (audio._soundInit()
+                && scrubbed)
+            {
+                audio.seek((cursorSlider->sliderPosition() / double(cursorSlider->maximum())) * audio.length());
+            }
+
+            scrubbed = false;
+        }
+    );
+
     connect(
         volumeSlider,
         &QSlider::valueChanged,
@@ -1602,100 +1819,182 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     nam = new QNetworkAccessManager(this);
 
     connect(
-        &timer,
-        &QTimer::timeout,
+        &audio,
+        &AudioPlayer::cueReached,
         this,
         [&]
         {
-            if (audio._soundInit())
+            if (scrobbledThisTrack)
             {
-                const double len = audio.length();
-                const double pos = audio.cursor();
+                return;
+            }
 
-                if (!scrobbledThisTrack
-                    && len > 0.0)
-                {
-                    const double frac = pos / len;
+            if (curAlbum >= 0 && curTrack >= 0)
+            {
+                countPlay(curAlbum, curTrack);
+                lastfmScrobbleTrack(library.getAlbums()[curAlbum].tracks[curTrack]);
+            }
 
-                    if (frac >= scrobbleThreshold)
-                    {
-                        if (curAlbum >= 0 && curTrack >= 0)
-                        {
-                            lastfmScrobbleTrack(library.getAlbums()[curAlbum].tracks[curTrack]);
-                        }
+            scrobbledThisTrack = true;
+        }
+    );
 
-                        scrobbledThisTrack = true;
-                    }
-                }
+    connect(
+        &audio,
+        &AudioPlayer::trackAdvanced,
+        this,
+        [&](const QString& path)
+        {
+            // the audio thread already moved on, to the track it names, a search or sort may have queued another since
+            if (!rebindCurrentByPath(path))
+            {
+                return;
+            }
+
+            selAlbum = curAlbum;
+            selTrack = curTrack;
+
+            trackStarted();
+
+            if (viewedAlbumIndex() == curAlbum)
+            {
+                tracks->setCurrentRow(visibleRowForTrackIndex(curTrack));
+            }
+        }
+    );
+
+    connect(
+        &audio,
+        &AudioPlayer::trackFinished,
+        this,
+        [&]
+        {
+            if (!settings->autoplay)
+            {
+                return;
+            }
+
+            const int nt = nextTrackIndex();
 
-                if (audio.finished())
+            if (nt >= 0)
+            {
+                play(curAlbum, nt);
+
+                if (viewedAlbumIndex() == curAlbum)
                 {
-                    if (settings->autoplay)
-                    {
-                        const int viewedAlbum = viewedAlbumIndex();
+                    tracks->setCurrentRow(visibleRowForTrackIndex(nt));
+                }
+            }
+            else
+            {
+                audio.stop();
 
-                        if (viewedAlbum != curAlbum)
-                        {
-                            const auto& album = library.getAlbums()[curAlbum];
+                curAlbum = -1;
+                curTrack = -1;
 
-                            const int nt = curTrack + 1;
+                //lastfmUpdateNowPlaying();
+                updateNowPlaying();
+            }
+        }
+    );
 
-                            if (nt < int(album.tracks.size()))
-                            {
-                                play(curAlbum, nt);
-                            }
-                            else
-                            {
-                                audio.stop();
+    connect(
+        &audio,
+        &AudioPlayer::playingChanged,
+        this,
+        [&](bool playing)
+        {
+            analyzer.setPlaying(playing);
+        }
+    );
 
-                                curAlbum = -1;
-                                curTrack = -1;
+    // batched, a large library reports many results a second
+    loudnessSaveTimer.setInterval(5000);
+    loudnessSaveTimer.setSingleShot(true);
 
-                                updateNowPlaying();
-                            }
+    connect(
+        &loudnessSaveTimer,
+        &QTimer::timeout,
+        this,
+        [&]
+        {
+            library.saveLoudness();
+        }
+    );
 
-                            return;
-                        }
+    // results still waiting on the timer would be lost with the window
+    connect(
+        qApp,
+        &QCoreApplication::aboutToQuit,
+        this,
+        [&]
+        {
+            if (loudnessSaveTimer.isActive())
+            {
+                loudnessSaveTimer.stop();
 
-                        const int row = visibleRowForTrackIndex(curTrack);
+                library.saveLoudness();
+            }
+        }
+    );
 
-                        if (row >= 0
-                            && row + 1 < int(searchTrackOrder.size()))
-                        {
-                            const int nextTrackIndex = searchTrackOrder[row + 1];
+    connect(
+        &analyzer,
+        &LoudnessAnalyzer::analysed,
+        this,
+        [&](const QString& path, qint64 modified, double gain, double peak)
+        {
+            Gain g;
 
-                            play(curAlbum, nextTrackIndex);
+            g.db = float(gain);
+            g.peak = float(peak);
 
-                            tracks->setCurrentRow(row + 1);
-                        }
-                        else
-                        {
-                            audio.stop();
+            if (!library.setMeasuredGain(path.toStdString(), modified, g))
+            {
+                return;
+            }
 
-                            curAlbum = -1;
-                            curTrack = -1;
+            if (!loudnessSaveTimer.isActive())
+            {
+                loudnessSaveTimer.start();
+            }
+        }
+    );
 
-                            //lastfmUpdateNowPlaying();
-                            updateNowPlaying();
-                        }
-                    }
+    startAnalysis();
 
-                    return;
-                }
+    connect(
+        &audio,
+        &AudioPlayer::positionChanged,
+        this,
+        [&](double pos, double len)
+        {
+            if (len <= 0)
+            {
+                cursorText->setText("");
 
-                if (audio.length() > 0)
-                {
-                    cursorText->setText(audio.formattedCursor() + " / " + audio.formattedLength());
+                return;
+            }
 
-                    if (!cursorSlider->isSliderDown())
-                    {
-                        cursorSlider->setValue(int(audio.cursor() / audio.length() * cursorSlider->maximum()));
-                    }
-                }
-                else
-                {
-                    cursorText->setText("");
-                }
+            const QString lengthText = AudioPlayer::formatLength(len);
+
+            // the engine reports the new length a moment after play, size the label once it does
+            if (len != shownLength)
+            {
+                shownLength = len;
+
+                const QString cursorTextLength = lengthText + " / " + lengthText;
+
+                const int cursorTextWidth = cursorText->fontMetrics().horizontalAdvance(cursorTextLength);
+
+                cursorText->setMinimumWidth(cursorTextWidth);
+            }
+
+            cursorText->setText(AudioPlayer::formatCursor(pos, len) + " / " + lengthText);
+
+            if (!cursorSlider->isSliderDown())
+            {
+                cursorSlider->setValue(int(pos / len * cursorSlider->maximum()));
             }
         }
     );
@@ -1715,8 +2014,6 @@ MainWindow::MainWindow(Settings* s) : settings(s)
     );
 
     initDriveWatcher();
-
-    timer.start(10);
 }
 
 void MainWindow::updateControlsText()
@@ -1751,6 +2048,10 @@ void MainWindow::updateControlsText()
 
 const QString MainWindow::customBackgroundStyleSheet = R"(
     #search,
+    #artistFacet,
+    #yearFacet,
+    #genreFacet,
+    #sortBox,
     #albums,
     #tracks,
     #nowPlaying,
@@ -1858,16 +2159,164 @@ void MainWindow::updateBackground()
     qApp->setStyleSheet(mainStyleSheet + customBackgroundStyleSheet);
 }
 
-static QString joinArtists(const std::vector<std::string>& artists)
+void MainWindow::updateCompletions(const QString& text)
+{
+    // only the term under the cursor is completed, quoted phrases count as one term
+    int cut = 0;
+    bool quoted = false;
+
+    for (int i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == QChar('"'))
+        {
+            quoted = !quoted;
+        }
+        else if (text[i] == QChar(' ')
+            && !quoted)
+        {
+            cut = i + 1;
+        }
+    }
+
+    const QString head = text.left(cut);
+
+    QString tail = text.mid(cut);
+    QString sign;
+
+    if (tail.startsWith('-'))
+    {
+        sign = "-";
+
+        tail.remove(0, 1);
+    }
+
+    uint8_t kinds = TermDictionary::Artist | TermDictionary::AlbumTitle;
+
+    const int colon = tail.indexOf(':');
+
+    if (colon >= 0)
+    {
+        const QString field = tail.left(colon).toLower();
+
+        if (field == "artist")
+        {
+            kinds = TermDictionary::Artist;
+        }
+        else if (field == "album")
+        {
+            kinds = TermDictionary::AlbumTitle;
+        }
+        else
+        {
+            kinds = 0;
+        }
+
+        tail.remove(0, colon + 1);
+    }
+
+    if (tail.startsWith('"'))
+    {
+        tail.remove(0, 1);
+    }
+
+    QStringList rows;
+
+    if (kinds != 0
+        && !tail.trimmed().isEmpty())
+    {
+        const auto suggestions = library.getTerms().complete(
+            tail.toStdString(),
+            8,
+            kinds
+        );
+
+        for (const auto& s : suggestions)
+        {
+            rows << head + sign
+                + (s.kind == TermDictionary::Artist
+                    ? "artist:\""
+                    : "album:\"")
+                + qs(s.text) + "\"";
+        }
+    }
+
+    completions->setStringList(rows);
+
+    if (rows.isEmpty())
+    {
+        completer->popup()->hide();
+
+        return;
+    }
+
+    completer->complete();
+}
+
+static const char* const facetAllText[facetCount] =
 {
-    QStringList o;
+    "all artists",
+    "all years",
+    "all genres"
+};
 
-    for (const auto& a : artists)
+void MainWindow::populateFacets()
+{
+    const auto& facets = library.getFacets();
+
+    for (int f = 0; f < int(facetCount); ++f)
     {
-        o << qs(a);
+        QComboBox* box = facetBoxes[f];
+
+        // a rescan rebuilds the value lists, keep whatever was picked if it still exists
+        const QString previous = box->currentIndex() > 0
+            ? box->currentData(Qt::UserRole + 1).toString()
+            : QString();
+
+        const QSignalBlocker blocker(box);
+
+        box->clear();
+        box->addItem(facetAllText[f], -1);
+
+        const auto& values = facets.values(Facet(f));
+
+        for (int v = 0; v < int(values.size()); ++v)
+        {
+            const QString text = qs(values[v].text);
+
+            box->addItem(text, v);
+            box->setItemData(v + 1, text, Qt::UserRole + 1);
+        }
+
+        const int keep = previous.isEmpty()
+            ? -1
+            : box->findData(previous, Qt::UserRole + 1);
+
+        box->setCurrentIndex(keep > 0
+            ? keep
+            : 0);
     }
+}
 
-    return o.join(", ");
+void MainWindow::updateFacetCounts(const std::vector<uint32_t>& hitAlbums, const FacetIndex::Selection& selection)
+{
+    const auto& facets = library.getFacets();
+
+    for (int f = 0; f < int(facetCount); ++f)
+    {
+        QComboBox* box = facetBoxes[f];
+
+        // each facet counts against the search and the other facets, not itself,
+        // so every value shows what picking it would leave
+        const std::vector<uint32_t> base = facets.filter(hitAlbums, selection, f);
+        const std::vector<uint32_t> counts = facets.counts(Facet(f), base);
+
+        box->setItemText(0, QString("%1 (%2)").arg(facetAllText[f]).arg(base.size()));
+
+        for (int v = 0; v < int(counts.size()) && v + 1 < box->count(); ++v)
+        {
+            box->setItemText(v + 1, QString("%1 (%2)").arg(box->itemData(v + 1, Qt::UserRole + 1).toString()).arg(counts[v]));
+        }
+    }
 }
 
 void MainWindow::populateAlbums()
@@ -1878,53 +2327,82 @@ void MainWindow::populateAlbums()
     albums->clear();
     tracks->clear();
 
-    albumMatchedByAlbum.clear();
-
-    const QString q = searchText.trimmed().toLower();
+    const auto& index = library.getIndex();
     const auto& albumsVec = library.getAlbums();
 
-    for (int i = 0; i < int(albumsVec.size()); ++i)
+    searchHits = index.run(Query::parse(searchText.toStdString()));
+
+    std::vector<uint32_t> hitAlbums;
+
+    // hits are sorted by track id, so each album's hits are one contiguous run
+    for (size_t k = 0; k < searchHits.size();)
     {
-        const auto& a = albumsVec[i];
+        const uint32_t a = index.albumOf(searchHits[k]);
+        const uint32_t next = index.firstTrack(a + 1);
 
-        QString artistText = a.variousArtists
-            ? "various artists"
-            : qs(a.artists.front());
+        hitAlbums.push_back(a);
 
-        bool artistMatch = q.isEmpty()
-            || artistText.toLower().contains(q);
+        while (k < searchHits.size()
+            && searchHits[k] < next)
+        {
+            ++k;
+        }
+    }
 
-        bool albumMatch = q.isEmpty()
-            || qs(a.title).toLower().contains(q);
+    FacetIndex::Selection selection{};
 
-        bool trackMatch = false;
+    for (int f = 0; f < int(facetCount); ++f)
+    {
+        selection[f] = facetBoxes[f]->currentData().toInt();
+    }
+
+    std::vector<uint32_t> shown = library.getFacets().filter(hitAlbums, selection);
 
-        for (const auto& t : a.tracks)
+    std::sort(
+        shown.begin(),
+        shown.end(),
+        [&](uint32_t a, uint32_t b)
         {
-            const QString trackTitle = qs(t.title).toLower();
-            const QString trackArtists = joinArtists(t.artists).toLower();
+            return library.rank(sortOrder, a) < library.rank(sortOrder, b);
+        }
+    );
 
-            if (trackTitle.contains(q)
-                || trackArtists.contains(q))
-            {
-                trackMatch = true;
+    for (const uint32_t ai : shown)
+    {
+        const auto& a = albumsVec[ai];
 
-                break;
-            }
-        }
+        QString artistText = a.variousArtists
+            ? "various artists"
+            : qs(a.artists.front());
 
-        if (artistMatch || albumMatch)
+        QString displayText = artistText + " - " + qs(a.title);
+
+        // the total comes from the lengths read at scan time, nothing is opened here
+        if (settings->durations
+            && a.durationMs > 0)
         {
-            albumMatchedByAlbum.insert(i);
+            displayText += " (" + AudioPlayer::formatLength(a.durationMs / 1000.0) + ")";
         }
 
-        if (artistMatch || albumMatch || trackMatch)
-        {
-            auto* item = new QListWidgetItem(artistText + " - " + qs(a.title));
-            item->setData(Qt::UserRole, i);
+        albums->addItem(new AlbumItem(
+            displayText,
+            ai,
+            &library,
+            &sortOrder
+        ));
+    }
 
-            albums->addItem(item);
-        }
+    updateFacetCounts(hitAlbums, selection);
+}
+
+void MainWindow::countPlay(int albumIndex, int trackIndex)
+{
+    library.addPlay(albumIndex, trackIndex);
+    library.savePlayCounts(appDataFile("playcounts"));
+
+    if (sortOrder == SortOrder::PlayCount)
+    {
+        albums->sortItems();
     }
 }
 
@@ -1934,11 +2412,19 @@ void MainWindow::populateTracks(int albumIndex)
 
     searchTrackOrder.clear();
 
-    const QString q = searchText.trimmed().toLower();
+    const auto& index = library.getIndex();
     const auto& album = library.getAlbums()[albumIndex];
+    const uint32_t first = index.firstTrack(albumIndex);
 
-    for (int i = 0; i < int(album.tracks.size()); ++i)
+    auto it = std::lower_bound(
+        searchHits.begin(),
+        searchHits.end(),
+        first
+    );
+
+    for (; it != searchHits.end() && *it < index.firstTrack(albumIndex + 1); ++it)
     {
+        const int i = int(*it - first);
         const auto& t = album.tracks[i];
 
         QString artistText = album.variousArtists
@@ -1963,13 +2449,10 @@ void MainWindow::populateTracks(int albumIndex)
             displayText = num + " - " + displayText;
         }
 
-        const QString matchText = (qs(t.title) + " " + joinArtists(t.artists)).toLower();
-
-        if (!q.isEmpty()
-            && !albumMatchedByAlbum.contains(albumIndex)
-            && !matchText.contains(q))
+        if (settings->durations
+            && t.durationMs > 0)
         {
-            continue;
+            displayText += " (" + AudioPlayer::formatLength(t.durationMs / 1000.0) + ")";
         }
 
         searchTrackOrder.push_back(i);
@@ -1979,6 +2462,9 @@ void MainWindow::populateTracks(int albumIndex)
 
         tracks->addItem(item);
     }
+
+    // the visible order decides what autoplay picks next
+    queueNext();
 }
 
 void MainWindow::playFirstOfAlbum(int albumIndex)
@@ -2009,22 +2495,116 @@ void MainWindow::play(int a, int t)
     curAlbum = a;
     curTrack = t;
 
+    audio.play(
+        QString::fromUtf8(album.tracks[t].path.data(), int(album.tracks[t].path.size())),
+        playbackGain(a, t),
+        album.tracks[t].durationMs
+    );
+
+    trackStarted();
+}
+
+void MainWindow::trackStarted()
+{
     scrobbledThisTrack = false;
 
-    audio.play(QString::fromUtf8(album.tracks[t].path.data(), int(album.tracks[t].path.size())));
+    updateNowPlaying();
 
-    const QString cursorTextLength = audio.formattedLength() + " / " + audio.formattedLength();
+    if (!settings->lastfmSessionKey.isEmpty())
+    {
+        lastfmUpdateNowPlaying(library.getAlbums()[curAlbum].tracks[curTrack]);
+    }
 
-    const int cursorTextWidth = cursorText->fontMetrics().horizontalAdvance(cursorTextLength);
+    queueNext();
+}
 
-    cursorText->setMinimumWidth(cursorTextWidth);
+int MainWindow::nextTrackIndex() const
+{
+    const auto& albumsVec = library.getAlbums();
 
-    updateNowPlaying();
+    if (!settings->autoplay
+        || curAlbum < 0
+        || curAlbum >= int(albumsVec.size())
+        || curTrack < 0)
+    {
+        return -1;
+    }
 
-    if (!settings->lastfmSessionKey.isEmpty())
+    // outside the viewed album the whole album plays in order
+    if (viewedAlbumIndex() != curAlbum)
     {
-        lastfmUpdateNowPlaying(album.tracks[t]);
+        const int nt = curTrack + 1;
+
+        return nt < int(albumsVec[curAlbum].tracks.size())
+            ? nt
+            : -1;
     }
+
+    const int row = visibleRowForTrackIndex(curTrack);
+
+    if (row >= 0
+        && row + 1 < int(searchTrackOrder.size()))
+    {
+        return searchTrackOrder[row + 1];
+    }
+
+    return -1;
+}
+
+void MainWindow::queueNext()
+{
+    queuedTrack = nextTrackIndex();
+
+    if (queuedTrack < 0)
+    {
+        audio.queue(QString());
+    }
+    else
+    {
+        const auto& t = library.getAlbums()[curAlbum].tracks[queuedTrack];
+
+        audio.queue(
+            qs(t.path),
+            playbackGain(curAlbum, queuedTrack),
+            t.durationMs
+        );
+    }
+
+    warmAdjacent();
+}
+
+void MainWindow::warmAdjacent()
+{
+    QStringList paths;
+    QList<unsigned int> lengthsMs;
+
+    if (curAlbum >= 0
+        && curAlbum < int(library.getAlbums().size())
+        && curTrack >= 0)
+    {
+        const auto& album = library.getAlbums()[curAlbum];
+
+        // whatever backward, forward or autoplay would start next
+        for (int t : { curTrack - 1, curTrack + 1, queuedTrack })
+        {
+            if (t < 0
+                || t >= int(album.tracks.size())
+                || t == curTrack)
+            {
+                continue;
+            }
+
+            const QString p = qs(album.tracks[t].path);
+
+            if (!paths.contains(p))
+            {
+                paths.push_back(p);
+                lengthsMs.push_back(album.tracks[t].durationMs);
+            }
+        }
+    }
+
+    audio.warm(paths, lengthsMs);
 }
 
 void MainWindow::playSelected()
@@ -2067,6 +2647,143 @@ void MainWindow::playSelected()
     }
 }
 
+float MainWindow::playbackGain(int albumIndex, int trackIndex) const
+{
+    const auto& album = library.getAlbums()[albumIndex];
+    const auto& track = album.tracks[trackIndex];
+
+    Gain g;
+
+    switch (std::clamp(settings->replayGain, 0, 2))
+    {
+    case 1:
+        g = track.trackGain;
+
+        break;
+    case 2:
+        // a track of an album still being measured plays at its own gain meanwhile
+        g = album.gain.known
+            ? album.gain
+            : track.trackGain;
+
+        break;
+    default:
+
+        break;
+    }
+
+    if (!g.known)
+    {
+        return 1.0f;
+    }
+
+    float gain = std::pow(10.0f, g.db / 20.0f);
+
+    // never pushed into clipping
+    if (g.peak > 0.0f)
+    {
+        gain = std::min(gain, 1.0f / g.peak);
+    }
+
+    return gain;
+}
+
+void MainWindow::startAnalysis()
+{
+    std::vector<LoudnessAnalyzer::Job> jobs;
+
+    for (const auto& [path, modified] : library.unmeasured())
+    {
+        jobs.push_back({ qs(path), modified });
+    }
+
+    analyzer.analyse(std::move(jobs));
+}
+
+OutputConfig MainWindow::outputSettings() const
+{
+    OutputConfig c;
+
+    c.backend = settings->outputBackend;
+    c.device = settings->outputDevice;
+    c.latency = LatencyProfile(std::clamp(settings->latencyProfile, 0, 2));
+    c.bitPerfect = settings->bitPerfect;
+
+    return c;
+}
+
+void MainWindow::applyPlaybackSettings()
+{
+    audio.setCrossfade(
+        settings->crossfade,
+        settings->fadeCurve == 0
+        ? FadeCurve::Linear
+        : FadeCurve::EqualPower
+    );
+
+    audio.setSkipFade(settings->skipFade);
+    audio.setScrubPreview(settings->scrubPreview);
+    audio.setReadAhead(settings->readAhead);
+    audio.setPreload(PreloadMode(std::clamp(settings->preloadMode, 0, 2)));
+    audio.setResampler(ResamplerQuality(std::clamp(settings->resampler, 0, 2)));
+    audio.setEqualizer(eqSettings(settings->eqEnabled, settings->eqGains));
+    audio.setConvolution(
+        settings->convolution
+            ? settings->convolutionPath
+            : QString()
+    );
+
+    audio.setLimiter(settings->limiter);
+    audio.setPlugins(
+        settings->plugins
+            ? settings->pluginChain.split(';', Qt::SkipEmptyParts)
+            : QStringList()
+    );
+
+    updatePositionRate();
+}
+
+void MainWindow::updatePositionRate()
+{
+    // nobody sees the cursor or the meters while minimized or hidden, so the engine can sleep until something happens
+    const bool visible = isVisible()
+        && !isMinimized();
+
+    audio.setPositionRate(visible
+        ? settings->positionRate
+        : 0);
+
+    // the playback settings are applied before the widgets exist
+    if (meters)
+    {
+        meters->setActive(visible);
+    }
+}
+
+void MainWindow::changeEvent(QEvent* e)
+{
+    QWidget::changeEvent(e);
+
+    if (e->type() == QEvent::WindowStateChange)
+    {
+        updatePositionRate();
+    }
+}
+
+void MainWindow::showEvent(QShowEvent* e)
+{
+    QWidget::showEvent(e);
+
+    updatePositionRate();
+}
+
+void MainWindow::hideEvent(QHideEvent* e)
+{
+    QWidget::hideEvent(e);
+
+    updatePositionRate();
+}
+
 void MainWindow::openSettings()
 {
     auto refreshUi =
@@ -2128,11 +2845,50 @@ void MainWindow::openSettings()
         settings->iconButtons,
         settings->coverNewWindow,
         settings->trackNumbers,
+        settings->durations,
+        settings->meters,
+        settings->crossfade,
+        settings->fadeCurve,
+        settings->skipFade,
+        settings->scrubPreview,
+        settings->replayGain,
+        settings->readAhead,
+        settings->preloadMode,
+        settings->positionRate,
+        settings->outputBackend,
+        settings->outputDevice,
+        settings->latencyProfile,
+        settings->bitPerfect,
+        settings->resampler,
+        settings->eqEnabled,
+        settings->eqPreset,
+        settings->eqGains,
+        settings->convolution,
+        settings->convolutionPath,
+        settings->limiter,
+        settings->plugins,
+        settings->pluginChain,
+        audio.pluginReport(),
+        audio.outputDescription(),
         settings->lastfmUsername,
         settings->lastfmSessionKey,
         this
     );
 
+    // heard while the dialog is open, put back if it is cancelled
+    connect(
+        &dlg,
+        &SettingsDialog::equalizerChanged,
+        this,
+        [&]
+        {
+            audio.setEqualizer(eqSettings(
+                dlg.selectedEqEnabled(),
+                dlg.selectedEqGains()
+            ));
+        }
+    );
+
     connect(
         &dlg,
         &SettingsDialog::rescanRequested,
@@ -2154,6 +2910,9 @@ void MainWindow::openSettings()
 
             QApplication::restoreOverrideCursor();
 
+            startAnalysis();
+
+            populateFacets();
             populateAlbums();
 
             if (!rebindCurrentByPath(playingPath))
@@ -2162,6 +2921,8 @@ void MainWindow::openSettings()
                 curTrack = -1;
             }
 
+            queueNext();
+
             updateNowPlaying();
         }
     );
@@ -2192,10 +2953,17 @@ void MainWindow::openSettings()
 
     if (dlg.exec() != QDialog::Accepted)
     {
+        audio.setEqualizer(eqSettings(settings->eqEnabled, settings->eqGains));
+
         return;
     }
 
     const bool foldersChanged = dlg.selectedFolders() != settings->folders;
+    const bool durationsToggled = dlg.selectedDurations() != settings->durations;
+    const bool outputChanged = dlg.selectedOutputBackend() != settings->outputBackend
+        || dlg.selectedOutputDevice() != settings->outputDevice
+        || dlg.selectedLatencyProfile() != settings->latencyProfile
+        || dlg.selectedBitPerfect() != settings->bitPerfect;
 
     settings->folders = dlg.selectedFolders();
     settings->coverSize = dlg.selectedCoverSize();
@@ -2205,6 +2973,36 @@ void MainWindow::openSettings()
     settings->iconButtons = dlg.selectedIconButtons();
     settings->coverNewWindow = dlg.selectedCoverNewWindow();
     settings->trackNumbers = dlg.selectedTrackNumbers();
+    settings->durations = dlg.selectedDurations();
+    settings->meters = dlg.selectedMeters();
+    settings->crossfade = dlg.selectedCrossfade();
+    settings->fadeCurve = dlg.selectedFadeCurve();
+    settings->skipFade = dlg.selectedSkipFade();
+    settings->scrubPreview = dlg.selectedScrubPreview();
+    settings->replayGain = dlg.selectedReplayGain();
+    settings->readAhead = dlg.selectedReadAhead();
+    settings->preloadMode = dlg.selectedPreloadMode();
+    settings->positionRate = dlg.selectedPositionRate();
+    settings->outputBackend = dlg.selectedOutputBackend();
+    settings->outputDevice = dlg.selectedOutputDevice();
+    settings->latencyProfile = dlg.selectedLatencyProfile();
+    settings->bitPerfect = dlg.selectedBitPerfect();
+    settings->resampler = dlg.selectedResampler();
+    settings->eqEnabled = dlg.selectedEqEnabled();
+    settings->eqPreset = dlg.selectedEqPreset();
+    settings->eqGains = dlg.selectedEqGains();
+    settings->convolution = dlg.selectedConvolution();
+    settings->convolutionPath = dlg.selectedConvolutionPath();
+    settings->limiter = dlg.selectedLimiter();
+    settings->plugins = dlg.selectedPlugins();
+    settings->pluginChain = dlg.selectedPluginChain();
+
+    if (outputChanged)
+    {
+        audio.setOutput(outputSettings());
+    }
+
+    applyPlaybackSettings();
 
     //if (settings->trackFormat.isEmpty())
     //{
@@ -2237,6 +3035,9 @@ void MainWindow::openSettings()
 
         QApplication::restoreOverrideCursor();
 
+        startAnalysis();
+
+        populateFacets();
         populateAlbums();
 
         if (!rebindCurrentByPath(playingPath))
@@ -2244,11 +3045,20 @@ void MainWindow::openSettings()
             curAlbum = -1;
             curTrack = -1;
         }
+
+        queueNext();
+    }
+    else if (durationsToggled)
+    {
+        populateAlbums();
     }
 
     refreshUi();
 
     coverLabel->setFixedHeight(settings->coverSize);
+
+    meters->setFixedSize(settings->coverSize * 3, settings->coverSize);
+    meters->setVisible(settings->meters);
 }
 
 bool MainWindow::showCoverEnabled() const
@@ -2576,6 +3386,9 @@ void MainWindow::initDriveWatcher()
 
             QApplication::restoreOverrideCursor();
 
+            startAnalysis();
+
+            populateFacets();
             populateAlbums();
 
             if (!rebindCurrentByPath(playingPath))
@@ -2584,6 +3397,8 @@ void MainWindow::initDriveWatcher()
                 curTrack = -1;
             }
 
+            queueNext();
+
             updateNowPlaying();
         }
     );
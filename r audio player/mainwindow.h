@@ -1,15 +1,18 @@
 #pragma once
 
 #include <QWidget>
+#include <QCompleter>
 #include <QLineEdit>
 #include <QListWidget>
 #include <QLabel>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QPushButton>
 #include <QTimer>
 #include <QSet>
 #include <QSlider>
 #include <QString>
+#include <QStringListModel>
 
 #include <QDateTime> // for nam
 #include <QNetworkAccessManager>
@@ -21,34 +24,46 @@
 #include "settings.h"
 #include "library.h"
 #include "audioplayer.h"
+#include "loudnessanalyzer.h"
+#include "meterwidget.h"
 
 class MainWindow : public QWidget
 {
     Q_OBJECT
 public:
     explicit MainWindow(Settings* settings);
+protected:
+    void changeEvent(QEvent* e) override;
+    void showEvent(QShowEvent* e) override;
+    void hideEvent(QHideEvent* e) override;
 private:
     Settings* settings = nullptr;
     Library library;
     AudioPlayer audio;
+    LoudnessAnalyzer analyzer;
 
     QString mainStyleSheet;
     QLineEdit* search = nullptr;
+    QCompleter* completer = nullptr;
+    QStringListModel* completions = nullptr;
     QString searchText;
     QVector<int> searchTrackOrder;
-    QSet<int> albumMatchedByAlbum;
+    std::vector<uint32_t> searchHits;
+    QVector<QComboBox*> facetBoxes;
+    QComboBox* sortBox = nullptr;
+    SortOrder sortOrder = SortOrder::Artist;
     QListWidget* albums = nullptr;
     QString formatTrack(const Track& t) const;
     QListWidget* tracks = nullptr;
     QPixmap currentCover;
     ClickLabel* coverLabel = nullptr;
+    MeterWidget* meters = nullptr;
     QLabel* nowPlaying = nullptr;
     QVector<QPushButton*> iconButtonsList;
     QIcon backwardIcon;
     QIcon playPauseIcon;
     QIcon forwardIcon;
     QCheckBox* autoplay = nullptr;
-    QTimer timer;
     QSlider* cursorSlider = nullptr;
     QLabel* cursorText = nullptr;
     QSlider* volumeSlider = nullptr;
@@ -56,6 +71,7 @@ private:
     QString currentPlayingPath() const;
     QTimer drivePollTimer;
     QTimer rescanDebounceTimer;
+    QTimer loudnessSaveTimer;
     QSet<QString> lastMountedRoots;
     QSet<QString> getLibraryMountRoots() const;
 
@@ -67,24 +83,40 @@ private:
     int selTrack = -1;
     int curAlbum = -1;
     int curTrack = -1;
+    int queuedTrack = -1;
+    int nextTrackIndex() const;
 
     void lastfmUpdateNowPlaying(const Track& t);
     void lastfmScrobbleTrack(const Track& t);
     void updateControlsText();
     void updateBackground();
+    void updateCompletions(const QString& text);
+    void populateFacets();
+    void updateFacetCounts(const std::vector<uint32_t>& hitAlbums, const FacetIndex::Selection& selection);
     void populateAlbums();
+    void countPlay(int albumIndex, int trackIndex);
     void populateTracks(int albumIndex);
     void playFirstOfAlbum(int albumIndex);
     void play(int albumIndex, int trackIndex);
+    void trackStarted();
+    void queueNext();
     void playSelected();
     void openSettings();
+    void applyPlaybackSettings();
+    OutputConfig outputSettings() const;
+    float playbackGain(int albumIndex, int trackIndex) const;
+    void startAnalysis();
+    void warmAdjacent();
+    void updatePositionRate();
     void updateNowPlaying();
     void initDriveWatcher();
     void checkMountedVolumes();
 
     double scrobbleThreshold = 0.9;
+    double shownLength = -1.0;
 
     bool scrobbledThisTrack = false;
+    bool scrubbed = false;
     bool showCoverEnabled() const;
     bool rebindCurrentByPath(const QString& path);
 };
\ No newline at end of file
@@ -0,0 +1,482 @@
+#include <QHideEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScreen>
+#include <QShowEvent>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "dspkernels.h"
+#include "meterwidget.h"
+
+namespace
+{
+    constexpr size_t bandCount = 40;
+
+    constexpr double lowHz = 30.0;
+    constexpr double highHz = 18000.0;
+
+    // db under full scale at the bottom of the bars
+    constexpr float spectrumFloor = -84.0f;
+    constexpr float levelFloor = -60.0f;
+
+    // db a second a bar falls once its level has gone, it rises at once
+    constexpr float spectrumFall = 48.0f;
+    constexpr float peakFall = 20.0f;
+
+    // time constant of the rms bars
+    constexpr double rmsSeconds = 0.3;
+
+    // nothing heard for this long, a pause in direct playback or a stopped device, and the loudness starts over
+    constexpr qint64 quietMs = 500;
+
+    constexpr double lufsFloor = -70.0;
+
+    constexpr int channelWidth = 6;
+    constexpr int gap = 2;
+
+    float toDb(double power, float floor)
+    {
+        return power > 0.0
+            ? std::max(floor, float(10.0 * std::log10(power)))
+            : floor;
+    }
+
+    float settle(float shown, float level, float fall)
+    {
+        return std::max(level, shown - fall);
+    }
+
+    // 4096 up to 48 kHz, twice that above, so the bins stay about as narrow
+    size_t fftSize(ma_uint32 sampleRate)
+    {
+        return sampleRate > 48000
+            ? 8192
+            : 4096;
+    }
+}
+
+MeterWidget::MeterWidget(const TapNode& tap, std::function<float()> reduction, QWidget* parent)
+    : QWidget(parent),
+    tap(tap),
+    reduction(std::move(reduction))
+{
+    bands.assign(bandCount, spectrumFloor);
+    bandPower.assign(bandCount, 0.0f);
+
+    timer.setTimerType(Qt::PreciseTimer);
+
+    connect(
+        &timer,
+        &QTimer::timeout,
+        this,
+        &MeterWidget::tick
+    );
+}
+
+void MeterWidget::setActive(bool on)
+{
+    active = on;
+
+    updateTimer();
+}
+
+void MeterWidget::showEvent(QShowEvent* e)
+{
+    QWidget::showEvent(e);
+
+    updateTimer();
+}
+
+void MeterWidget::hideEvent(QHideEvent* e)
+{
+    QWidget::hideEvent(e);
+
+    updateTimer();
+}
+
+void MeterWidget::updateTimer()
+{
+    if (!active
+        || !isVisible())
+    {
+        timer.stop();
+
+        return;
+    }
+
+    if (timer.isActive())
+    {
+        return;
+    }
+
+    const qreal hz = screen()
+        ? screen()->refreshRate()
+        : 60.0;
+
+    timer.setInterval(std::max(1, int(std::lround(1000.0 / std::max<qreal>(hz, 1.0)))));
+
+    sinceTick.start();
+    sinceHeard.start();
+
+    timer.start();
+}
+
+void MeterWidget::reformat(const TapNode::Format& f)
+{
+    format = f;
+    consumed = f.start;
+
+    const size_t channels = f.channels;
+
+    tickPeak.assign(channels, 0.0f);
+    tickSquares.assign(channels, 0.0);
+    peaks.assign(channels, levelFloor);
+    squares.assign(channels, 0.0);
+    levels.assign(channels, levelFloor);
+
+    if (channels == 0
+        || f.sampleRate == 0)
+    {
+        loudness.reset();
+        fft.reset();
+
+        return;
+    }
+
+    maxTake = TapNode::ringSamples / channels / 2;
+
+    frames.assign(maxTake * channels, 0.0f);
+    lane.assign(maxTake, 0.0f);
+
+    loudness = std::make_unique<MomentaryLoudness>(f.channels, f.sampleRate);
+
+    const size_t n = fftSize(f.sampleRate);
+
+    if (!fft
+        || fft->size() != n)
+    {
+        fft = std::make_unique<RealFft>(n);
+
+        window.resize(n);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            window[i] = float(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * double(i) / double(n)));
+        }
+
+        mono.assign(n, 0.0f);
+        re.assign(fft->bins(), 0.0f);
+        im.assign(fft->bins(), 0.0f);
+    }
+
+    block.assign(n * channels, 0.0f);
+
+    // log spaced, a band narrower than a bin at the bottom still gets one
+    const double hz = double(f.sampleRate) / double(n);
+    const double top = std::min(highHz, 0.45 * double(f.sampleRate));
+
+    bandBins.resize(bandCount);
+
+    for (size_t b = 0; b < bandCount; ++b)
+    {
+        const double from = lowHz * std::pow(top / lowHz, double(b) / double(bandCount));
+        const double to = lowHz * std::pow(top / lowHz, double(b + 1) / double(bandCount));
+
+        const size_t first = std::clamp<size_t>(size_t(std::lround(from / hz)), 1, fft->bins() - 1);
+        const size_t last = std::clamp<size_t>(size_t(std::lround(to / hz)), first + 1, fft->bins());
+
+        bandBins[b] = { first, last };
+    }
+}
+
+void MeterWidget::tick()
+{
+    const float seconds = float(sinceTick.restart()) / 1000.0f;
+
+    const TapNode::Format f = tap.format();
+
+    if (f.start != format.start
+        || f.channels != format.channels
+        || f.sampleRate != format.sampleRate)
+    {
+        reformat(f);
+    }
+
+    const bool heard = take();
+
+    if (heard)
+    {
+        sinceHeard.restart();
+    }
+    else if (loudness
+        && sinceHeard.hasExpired(quietMs))
+    {
+        loudness->reset();
+    }
+
+    bool changed = false;
+
+    for (size_t b = 0; b < bandCount; ++b)
+    {
+        const float v = settle(
+            bands[b],
+            heard
+                ? toDb(bandPower[b], spectrumFloor)
+                : spectrumFloor,
+            spectrumFall * seconds
+        );
+
+        changed = changed || v != bands[b];
+
+        bands[b] = v;
+    }
+
+    const double follow = 1.0 - std::exp(-double(seconds) / rmsSeconds);
+
+    for (size_t c = 0; c < peaks.size(); ++c)
+    {
+        const float peak = settle(
+            peaks[c],
+            heard
+                ? toDb(double(tickPeak[c]) * tickPeak[c], levelFloor)
+                : levelFloor,
+            peakFall * seconds
+        );
+
+        squares[c] += ((heard
+            ? tickSquares[c]
+            : 0.0) - squares[c]) * follow;
+
+        // no point following it down into denormals
+        if (squares[c] < 1e-9)
+        {
+            squares[c] = 0.0;
+        }
+
+        const float level = toDb(squares[c], levelFloor);
+
+        changed = changed
+            || peak != peaks[c]
+            || level != levels[c];
+
+        peaks[c] = peak;
+        levels[c] = level;
+    }
+
+    // to the tenth the readout shows
+    const double l = loudness
+        ? std::round(std::max(lufsFloor, loudness->lufs()) * 10.0) / 10.0
+        : lufsFloor;
+
+    changed = changed || l != lufs;
+
+    lufs = l;
+
+    // held and let fall like a peak, a grab lasts one device period and would never be seen
+    const float r = settle(
+        limiting,
+        heard
+            ? reduction()
+            : 0.0f,
+        peakFall * seconds
+    );
+
+    changed = changed
+        || std::round(r * 10.0f) != std::round(limiting * 10.0f);
+
+    limiting = std::max(0.0f, r);
+
+    if (changed)
+    {
+        update();
+    }
+}
+
+bool MeterWidget::take()
+{
+    if (!loudness)
+    {
+        return false;
+    }
+
+    const uint64_t written = tap.written();
+
+    // still in the device's buffer past this
+    if (written < format.start + format.latency)
+    {
+        return false;
+    }
+
+    const uint64_t heard = written - format.latency;
+
+    if (heard <= consumed)
+    {
+        return false;
+    }
+
+    size_t count = size_t(std::min<uint64_t>(heard - consumed, maxTake));
+
+    // the gui thread fell further behind than the ring reaches, the loudness starts from what's left
+    if (heard - consumed > maxTake)
+    {
+        loudness->reset();
+    }
+
+    consumed = heard;
+
+    if (!tap.read(format, heard, count, frames.data()))
+    {
+        loudness->reset();
+
+        return false;
+    }
+
+    loudness->add(frames.data(), count);
+
+    const DspKernels& k = dspKernels();
+    const size_t channels = format.channels;
+
+    for (size_t c = 0; c < channels; ++c)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            lane[i] = frames[i * channels + c];
+        }
+
+        float peak = 0.0f;
+        double sum = 0.0;
+
+        k.peakRms(lane.data(), count, peak, sum);
+
+        tickPeak[c] = peak;
+        tickSquares[c] = sum / double(count);
+    }
+
+    measureSpectrum(heard);
+
+    return true;
+}
+
+void MeterWidget::measureSpectrum(uint64_t heard)
+{
+    const size_t n = fft->size();
+    const size_t channels = format.channels;
+
+    // the window ending at the frame being heard, silence before the device opened
+    if (heard - format.start < n
+        || !tap.read(format, heard, n, block.data()))
+    {
+        std::fill(bandPower.begin(), bandPower.end(), 0.0f);
+
+        return;
+    }
+
+    const float scale = 1.0f / float(channels);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        float sum = 0.0f;
+
+        for (size_t c = 0; c < channels; ++c)
+        {
+            sum += block[i * channels + c];
+        }
+
+        mono[i] = sum * scale * window[i];
+    }
+
+    fft->forward(mono.data(), re.data(), im.data());
+
+    // a full scale sine puts n / 4 in its bin through the hann window, and half that again into the two beside it
+    const double quarter = double(n) / 4.0;
+    const double norm = 1.0 / (1.5 * quarter * quarter);
+
+    for (size_t b = 0; b < bandCount; ++b)
+    {
+        double power = 0.0;
+
+        for (size_t j = bandBins[b].first; j < bandBins[b].second; ++j)
+        {
+            power += double(re[j]) * re[j] + double(im[j]) * im[j];
+        }
+
+        bandPower[b] = float(power * norm);
+    }
+}
+
+void MeterWidget::paintEvent(QPaintEvent* /* e */)
+{
+    QPainter p(this);
+
+    const QColor ink = palette().color(QPalette::WindowText);
+
+    QColor faint = ink;
+    faint.setAlpha(140);
+
+    const int text = fontMetrics().height();
+    const int channels = int(peaks.size());
+    const int meterWidth = channels * (channelWidth + gap);
+
+    const QRect spectrum(0, 0, std::max(0, width() - meterWidth - gap), std::max(0, height() - text));
+
+    // spectrum, one bar a band with a pixel between
+    const double bandWidth = double(spectrum.width()) / double(bandCount);
+
+    for (size_t b = 0; b < bandCount; ++b)
+    {
+        const double fill = double(bands[b] - spectrumFloor) / double(-spectrumFloor);
+        const int h = int(std::lround(fill * spectrum.height()));
+
+        if (h <= 0)
+        {
+            continue;
+        }
+
+        const int x0 = int(std::lround(double(b) * bandWidth));
+        const int x1 = int(std::lround(double(b + 1) * bandWidth)) - 1;
+
+        p.fillRect(QRect(x0, spectrum.bottom() - h + 1, std::max(1, x1 - x0), h), faint);
+    }
+
+    // a bar a channel, rms filled, peak as a line
+    for (int c = 0; c < channels; ++c)
+    {
+        const int x = width() - meterWidth + c * (channelWidth + gap);
+
+        const int rms = int(std::lround(double(levels[c] - levelFloor) / double(-levelFloor) * height()));
+        const int peak = int(std::lround(double(peaks[c] - levelFloor) / double(-levelFloor) * height()));
+
+        if (rms > 0)
+        {
+            p.fillRect(QRect(x, height() - rms, channelWidth, rms), faint);
+        }
+
+        if (peak > 0)
+        {
+            p.fillRect(QRect(x, height() - peak, channelWidth, 1), ink);
+        }
+    }
+
+    p.setPen(ink);
+
+    p.drawText(
+        QRect(0, height() - text, spectrum.width(), text),
+        Qt::AlignLeft | Qt::AlignVCenter,
+        lufs <= lufsFloor
+            ? QString("-inf lufs")
+            : QString("%1 lufs").arg(lufs, 0, 'f', 1)
+    );
+
+    // to the tenth, nothing while the limiter leaves the signal alone
+    if (limiting >= 0.05f)
+    {
+        p.drawText(
+            QRect(0, height() - text, spectrum.width(), text),
+            Qt::AlignRight | Qt::AlignVCenter,
+            QString("limiter -%1 db").arg(double(limiting), 0, 'f', 1)
+        );
+    }
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QWidget>
+
+#include "fft.h"
+#include "loudness.h"
+#include "tapnode.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// spectrum, peak and rms per channel and momentary loudness of what the speakers are playing, and what the limiter takes off
+// reads the audio player's tap on the gui thread at the screen's refresh rate, only while it can be seen,
+// and repaints only when a bar or the readout moved
+class MeterWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    // reduction is the limiter's, db taken off in the last device period, asked every tick
+    MeterWidget(const TapNode& tap, std::function<float()> reduction, QWidget* parent = nullptr);
+
+    // false while the window is minimized, which a widget isn't told about
+    void setActive(bool active);
+protected:
+    void showEvent(QShowEvent* e) override;
+    void hideEvent(QHideEvent* e) override;
+    void paintEvent(QPaintEvent* e) override;
+private:
+    const TapNode& tap;
+    std::function<float()> reduction;
+
+    QTimer timer;
+
+    // since the last tick, and since frames last came in
+    QElapsedTimer sinceTick;
+    QElapsedTimer sinceHeard;
+
+    bool active{};
+
+    // the one being read, a new start means the device reopened
+    TapNode::Format format;
+
+    // the frame up to which everything heard has been measured
+    uint64_t consumed = 0;
+
+    // the most frames taken in one tick, half the ring so a read isn't lapped while it copies
+    size_t maxTake = 0;
+
+    std::vector<float> frames;
+    std::vector<float> lane;
+
+    std::unique_ptr<RealFft> fft;
+    std::vector<float> window;
+    std::vector<float> block;
+    std::vector<float> mono;
+    std::vector<float> re;
+    std::vector<float> im;
+
+    // bins [first, second) of each band
+    std::vector<std::pair<size_t, size_t>> bandBins;
+
+    std::unique_ptr<MomentaryLoudness> loudness;
+
+    // measured this tick, linear
+    std::vector<float> bandPower;
+    std::vector<float> tickPeak;
+    std::vector<double> tickSquares;
+
+    // shown, db, and the rms bars' running mean square
+    std::vector<float> bands;
+    std::vector<float> peaks;
+    std::vector<double> squares;
+    std::vector<float> levels;
+    double lufs = -70.0;
+    float limiting = 0.0f;
+
+    void updateTimer();
+    void reformat(const TapNode::Format& f);
+    void tick();
+
+    // reads what was heard since the last tick into the measurements, false when nothing was
+    bool take();
+    void measureSpectrum(uint64_t heard);
+};
\ No newline at end of file
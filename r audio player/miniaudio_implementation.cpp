@@ -10,4 +10,7 @@
 
 #include "miniaudio.h"
 
-#include "stb_vorbis.c"
\ No newline at end of file
+#include "stb_vorbis.c"
+
+// needs the dr_mp3 declarations that only exist in here
+#include "mp3stream.cpp"
\ No newline at end of file
@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// built inside miniaudio_implementation.cpp, see mp3stream.h
+#include "miniaudio.h"
+#include "mp3stream.h"
+
+// named, State holds these and is declared in the header
+namespace mp3stream
+{
+    struct SeekTable
+    {
+        std::vector<ma_dr_mp3_seek_point> points;
+        ma_uint64 frames = 0;
+    };
+
+    // one per file being scanned, every open of it while the scan runs waits on the same one
+    struct IndexJob
+    {
+        // what the length was taken to be when the scan started, the table carries the exact count
+        ma_uint64 frames = 0;
+
+        // filled in by the build thread
+        std::shared_ptr<const SeekTable> table;
+        std::atomic<bool> done{ false };
+    };
+}
+
+namespace
+{
+    using mp3stream::IndexJob;
+    using mp3stream::SeekTable;
+
+    // one point per half second, what is left after a jump is decoded forward
+    constexpr ma_uint64 pointsPerSecond = 2;
+
+    // shorter tracks decode forward to any point quickly enough
+    constexpr ma_uint64 indexMinSeconds = 600;
+
+    constexpr size_t cacheLimit = 64;
+
+    struct Cache
+    {
+        std::mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<const SeekTable>> tables;
+        std::deque<std::string> order;
+
+        // scans still running, a key is in here or in tables but never both
+        std::unordered_map<std::string, std::shared_ptr<IndexJob>> building;
+    };
+
+    // never destroyed, an index build may still be running when the app exits
+    Cache& cache()
+    {
+        static Cache* c = new Cache;
+
+        return *c;
+    }
+
+    // a file that changed on disk gets a new key, so a stale table is never bound
+    std::string cacheKey(const std::filesystem::path& path)
+    {
+        std::error_code ec;
+
+        const std::uintmax_t size = std::filesystem::file_size(path, ec);
+
+        if (ec)
+        {
+            return {};
+        }
+
+        const auto time = std::filesystem::last_write_time(path, ec);
+
+        if (ec)
+        {
+            return {};
+        }
+
+        const std::u8string p = path.u8string();
+
+        return std::string(p.begin(), p.end())
+            + '|' + std::to_string(size)
+            + '|' + std::to_string(time.time_since_epoch().count());
+    }
+
+    // the table cached for the file, or else the scan running for it, or neither
+    void findTable(const std::string& key, std::shared_ptr<const SeekTable>& table, std::shared_ptr<IndexJob>& job)
+    {
+        Cache& c = cache();
+
+        std::lock_guard<std::mutex> guard(c.lock);
+
+        const auto it = c.tables.find(key);
+
+        if (it != c.tables.end())
+        {
+            table = it->second;
+
+            return;
+        }
+
+        const auto running = c.building.find(key);
+
+        if (running != c.building.end())
+        {
+            job = running->second;
+        }
+    }
+
+    // the scan that finished leaves building and its table, if it made one, goes in under the same lock
+    void storeTable(const std::string& key, std::shared_ptr<const SeekTable> table)
+    {
+        Cache& c = cache();
+
+        std::lock_guard<std::mutex> guard(c.lock);
+
+        c.building.erase(key);
+
+        if (!table
+            || !c.tables.emplace(key, std::move(table)).second)
+        {
+            return;
+        }
+
+        c.order.push_back(key);
+
+        while (c.order.size() > cacheLimit)
+        {
+            c.tables.erase(c.order.front());
+            c.order.pop_front();
+        }
+    }
+
+    bool openFile(ma_dr_mp3& dr, const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        return ma_dr_mp3_init_file_w(&dr, path.c_str(), nullptr);
+#else
+        return ma_dr_mp3_init_file(&dr, path.c_str(), nullptr);
+#endif
+    }
+
+    // walks the frame headers, nothing is decoded, the exact length comes from the same scan
+    std::shared_ptr<const SeekTable> buildTable(ma_dr_mp3& scan)
+    {
+        const ma_uint64 frames = ma_dr_mp3_get_pcm_frame_count(&scan);
+
+        if (frames == 0)
+        {
+            return nullptr;
+        }
+
+        auto table = std::make_shared<SeekTable>();
+
+        table->frames = frames;
+
+        ma_uint32 count = ma_uint32(std::min<ma_uint64>(frames * pointsPerSecond / scan.sampleRate + 1, UINT32_MAX));
+
+        table->points.resize(count);
+
+        if (!ma_dr_mp3_calculate_seek_points(&scan, &count, table->points.data()))
+        {
+            return nullptr;
+        }
+
+        table->points.resize(count);
+
+        return table;
+    }
+}
+
+struct Mp3Stream::State
+{
+    ma_dr_mp3 dr{};
+
+    ma_uint64 frames = 0;
+
+    bool framesKnown{};
+
+    std::filesystem::path path;
+    std::string key;
+
+    // set when the decoder reads a preloaded copy
+    const void* data = nullptr;
+    size_t size = 0;
+
+    // from the library's scan, in frames of the file's rate, 0 when it didn't know
+    ma_uint64 hint = 0;
+
+    std::shared_ptr<const mp3stream::SeekTable> table;
+    std::shared_ptr<mp3stream::IndexJob> job;
+};
+
+const ma_data_source_vtable Mp3Stream::vtable =
+{
+    &Mp3Stream::onRead,
+    &Mp3Stream::onSeek,
+    &Mp3Stream::onGetDataFormat,
+    &Mp3Stream::onGetCursor,
+    &Mp3Stream::onGetLength,
+    nullptr,
+    0
+};
+
+namespace
+{
+    // miniaudio hands back a pointer to the base, which sits at the start of the stream
+    static_assert(std::is_standard_layout_v<Mp3Stream>);
+
+    inline Mp3Stream* streamOf(ma_data_source* ds)
+    {
+        return reinterpret_cast<Mp3Stream*>(ds);
+    }
+}
+
+ma_decoding_backend_vtable* Mp3Stream::backend()
+{
+    static ma_decoding_backend_vtable b =
+    {
+        nullptr,
+        &Mp3Stream::onInitFile,
+        &Mp3Stream::onInitFileW,
+        &Mp3Stream::onInitMemory,
+        &Mp3Stream::onUninit
+    };
+
+    return &b;
+}
+
+Mp3Stream* Mp3Stream::of(ma_decoder& decoder)
+{
+    return decoder.pBackendVTable == backend()
+        ? streamOf(decoder.pBackend)
+        : nullptr;
+}
+
+ma_result Mp3Stream::finish(Mp3Stream* s, void* user, const void* data, size_t size, ma_data_source** out)
+{
+    ma_data_source_config config = ma_data_source_config_init();
+
+    config.vtable = &vtable;
+
+    const ma_result result = ma_data_source_init(&config, &s->base);
+
+    if (result != MA_SUCCESS)
+    {
+        ma_dr_mp3_uninit(&s->state->dr);
+
+        delete s->state;
+        delete s;
+
+        return result;
+    }
+
+    State& st = *s->state;
+
+    if (user)
+    {
+        st.path = *static_cast<const std::filesystem::path*>(user);
+        st.key = cacheKey(st.path);
+    }
+
+    st.data = data;
+    st.size = size;
+
+    if (!st.key.empty())
+    {
+        findTable(st.key, st.table, st.job);
+
+        if (st.table)
+        {
+            s->bind();
+        }
+    }
+
+    *out = &s->base;
+
+    return MA_SUCCESS;
+}
+
+void Mp3Stream::bind()
+{
+    state->frames = state->table->frames;
+    state->framesKnown = true;
+
+    // dr_mp3 only reads the points, the shared table outlives the binding
+    ma_dr_mp3_bind_seek_table(
+        &state->dr,
+        ma_uint32(state->table->points.size()),
+        const_cast<ma_dr_mp3_seek_point*>(state->table->points.data())
+    );
+}
+
+void Mp3Stream::expect(unsigned int lengthMs)
+{
+    state->hint = ma_uint64(lengthMs) * state->dr.sampleRate / 1000;
+}
+
+void Mp3Stream::index()
+{
+    State& st = *state;
+
+    if (st.table
+        || st.job
+        || st.key.empty()
+        || st.dr.sampleRate == 0)
+    {
+        return;
+    }
+
+    ma_uint64 length = 0;
+
+    onGetLength(&base, &length);
+
+    if (length < indexMinSeconds * st.dr.sampleRate)
+    {
+        return;
+    }
+
+    // a preloaded copy is scanned right here, it is all in memory already
+    if (st.data)
+    {
+        ma_dr_mp3 scan{};
+
+        if (!ma_dr_mp3_init_memory(&scan, st.data, st.size, nullptr))
+        {
+            return;
+        }
+
+        st.table = buildTable(scan);
+
+        ma_dr_mp3_uninit(&scan);
+
+        if (st.table)
+        {
+            storeTable(st.key, st.table);
+
+            bind();
+        }
+
+        return;
+    }
+
+    auto job = std::make_shared<IndexJob>();
+
+    job->frames = length;
+
+    {
+        Cache& c = cache();
+
+        std::lock_guard<std::mutex> guard(c.lock);
+
+        // another open of the file may have got here first since this one looked
+        const auto done = c.tables.find(st.key);
+
+        if (done != c.tables.end())
+        {
+            st.table = done->second;
+
+            bind();
+
+            return;
+        }
+
+        const auto [it, added] = c.building.try_emplace(st.key, job);
+
+        st.job = it->second;
+
+        if (!added)
+        {
+            return;
+        }
+    }
+
+    // a scan of a long file on a slow drive could starve the reader, so it gets its own thread
+    // and its own handle, the playing decoder keeps its position
+    std::thread(
+        [job, path = st.path, key = st.key]
+        {
+            ma_dr_mp3 scan{};
+
+            if (openFile(scan, path))
+            {
+                job->table = buildTable(scan);
+
+                ma_dr_mp3_uninit(&scan);
+            }
+
+            storeTable(key, job->table);
+
+            job->done.store(true, std::memory_order_release);
+        }
+    ).detach();
+}
+
+bool Mp3Stream::poll()
+{
+    State& st = *state;
+
+    if (!st.job
+        || !st.job->done.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    st.table = st.job->table;
+    st.job.reset();
+
+    if (!st.table)
+    {
+        return false;
+    }
+
+    bind();
+
+    return true;
+}
+
+ma_result Mp3Stream::onRead(ma_data_source* ds, void* out, ma_uint64 count, ma_uint64* read)
+{
+    const ma_uint64 n = ma_dr_mp3_read_pcm_frames_f32(
+        &streamOf(ds)->state->dr,
+        count,
+        static_cast<float*>(out)
+    );
+
+    *read = n;
+
+    return n == 0
+        ? MA_AT_END
+        : MA_SUCCESS;
+}
+
+ma_result Mp3Stream::onSeek(ma_data_source* ds, ma_uint64 frame)
+{
+    return ma_dr_mp3_seek_to_pcm_frame(&streamOf(ds)->state->dr, frame)
+        ? MA_SUCCESS
+        : MA_ERROR;
+}
+
+ma_result Mp3Stream::onGetDataFormat(ma_data_source* ds, ma_format* format, ma_uint32* channels, ma_uint32* sampleRate, ma_channel* channelMap, size_t channelMapCap)
+{
+    const ma_dr_mp3& dr = streamOf(ds)->state->dr;
+
+    if (format)
+    {
+        *format = ma_format_f32;
+    }
+
+    if (channels)
+    {
+        *channels = dr.channels;
+    }
+
+    if (sampleRate)
+    {
+        *sampleRate = dr.sampleRate;
+    }
+
+    if (channelMap)
+    {
+        ma_channel_map_init_standard(
+            ma_standard_channel_map_default,
+            channelMap,
+            channelMapCap,
+            dr.channels
+        );
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result Mp3Stream::onGetCursor(ma_data_source* ds, ma_uint64* cursor)
+{
+    *cursor = streamOf(ds)->state->dr.currentPCMFrame;
+
+    return MA_SUCCESS;
+}
+
+ma_result Mp3Stream::onGetLength(ma_data_source* ds, ma_uint64* length)
+{
+    State& st = *streamOf(ds)->state;
+
+    // without a toc dr_mp3 counts every frame, once is enough
+    if (!st.framesKnown)
+    {
+        // a file long enough to be indexed goes by the scan's length instead, the one running for it
+        // or the library's, until the seek table brings the exact count
+        const ma_uint64 estimate = st.job
+            ? st.job->frames
+            : st.hint;
+
+        if (st.dr.totalPCMFrameCount == MA_UINT64_MAX
+            && estimate >= indexMinSeconds * st.dr.sampleRate)
+        {
+            *length = estimate;
+
+            return MA_SUCCESS;
+        }
+
+        st.frames = ma_dr_mp3_get_pcm_frame_count(&st.dr);
+        st.framesKnown = true;
+    }
+
+    *length = st.frames;
+
+    return MA_SUCCESS;
+}
+
+ma_result Mp3Stream::onInitFile(void* user, const char* path, const ma_decoding_backend_config*, const ma_allocation_callbacks* alloc, ma_data_source** out)
+{
+    auto* s = new Mp3Stream();
+
+    s->state = new State();
+
+    if (!ma_dr_mp3_init_file(&s->state->dr, path, alloc))
+    {
+        delete s->state;
+        delete s;
+
+        return MA_INVALID_FILE;
+    }
+
+    return finish(s, user, nullptr, 0, out);
+}
+
+ma_result Mp3Stream::onInitFileW(void* user, const wchar_t* path, const ma_decoding_backend_config*, const ma_allocation_callbacks* alloc, ma_data_source** out)
+{
+    auto* s = new Mp3Stream();
+
+    s->state = new State();
+
+    if (!ma_dr_mp3_init_file_w(&s->state->dr, path, alloc))
+    {
+        delete s->state;
+        delete s;
+
+        return MA_INVALID_FILE;
+    }
+
+    return finish(s, user, nullptr, 0, out);
+}
+
+ma_result Mp3Stream::onInitMemory(void* user, const void* data, size_t size, const ma_decoding_backend_config*, const ma_allocation_callbacks* alloc, ma_data_source** out)
+{
+    auto* s = new Mp3Stream();
+
+    s->state = new State();
+
+    if (!ma_dr_mp3_init_memory(&s->state->dr, data, size, alloc))
+    {
+        delete s->state;
+        delete s;
+
+        return MA_INVALID_FILE;
+    }
+
+    return finish(s, user, data, size, out);
+}
+
+void Mp3Stream::onUninit(void*, ma_data_source* ds, const ma_allocation_callbacks*)
+{
+    Mp3Stream* s = streamOf(ds);
+
+    // a running build holds its own job and still fills the cache
+    ma_dr_mp3_uninit(&s->state->dr);
+
+    ma_data_source_uninit(&s->base);
+
+    delete s->state;
+    delete s;
+}
\ No newline at end of file
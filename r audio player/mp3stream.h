@@ -0,0 +1,51 @@
+#pragma once
+
+#include "miniaudio.h"
+
+// an mp3 decoding backend for ma_decoder that seeks through a table of frame offsets
+// without one dr_mp3 seeks by decoding forward from the start of the file,
+// which takes seconds in a long vbr mix that carries no xing toc
+// tables are built once per file off the audio path and reused on later opens
+// dr_mp3 is only declared inside the miniaudio implementation, so the source is compiled as part of it
+class Mp3Stream
+{
+public:
+    // for ma_decoder_config, the backend user data is the std::filesystem::path being opened
+    static ma_decoding_backend_vtable* backend();
+
+    // the stream behind a decoder, null when another backend opened the file
+    static Mp3Stream* of(ma_decoder& decoder);
+
+    // the length the library found when it scanned the file, 0 when it doesn't know
+    // a long file without a toc then isn't walked frame by frame just to learn it, call before asking
+    void expect(unsigned int lengthMs);
+
+    // starts building a seek table if the file has none cached yet, call once the length is known
+    void index();
+
+    // binds a table built in the background, reader thread, true when that brought the exact length
+    bool poll();
+private:
+    struct State;
+
+    ma_data_source_base base{};
+
+    State* state = nullptr;
+
+    static const ma_data_source_vtable vtable;
+
+    static ma_result finish(Mp3Stream* s, void* user, const void* data, size_t size, ma_data_source** out);
+
+    void bind();
+
+    static ma_result onRead(ma_data_source* ds, void* out, ma_uint64 frames, ma_uint64* read);
+    static ma_result onSeek(ma_data_source* ds, ma_uint64 frame);
+    static ma_result onGetDataFormat(ma_data_source* ds, ma_format* format, ma_uint32* channels, ma_uint32* sampleRate, ma_channel* channelMap, size_t channelMapCap);
+    static ma_result onGetCursor(ma_data_source* ds, ma_uint64* cursor);
+    static ma_result onGetLength(ma_data_source* ds, ma_uint64* length);
+
+    static ma_result onInitFile(void* user, const char* path, const ma_decoding_backend_config* config, const ma_allocation_callbacks* alloc, ma_data_source** out);
+    static ma_result onInitFileW(void* user, const wchar_t* path, const ma_decoding_backend_config* config, const ma_allocation_callbacks* alloc, ma_data_source** out);
+    static ma_result onInitMemory(void* user, const void* data, size_t size, const ma_decoding_backend_config* config, const ma_allocation_callbacks* alloc, ma_data_source** out);
+    static void onUninit(void* user, ma_data_source* ds, const ma_allocation_callbacks* alloc);
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// bounded lock free queue, any number of producers and one consumer
+// every cell carries a sequence number that says whose turn it is,
+// so producers only contend on the tail and the consumer never waits on them
+template <typename T, size_t Capacity>
+class MpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0);
+public:
+    MpscQueue()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // false when full
+    bool push(T value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell& c = cells[pos & (Capacity - 1)];
+
+            const size_t seq = c.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.value = std::move(value);
+                    c.sequence.store(pos + 1, std::memory_order_release);
+
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer only
+    bool pop(T& out)
+    {
+        Cell& c = cells[head & (Capacity - 1)];
+
+        if (c.sequence.load(std::memory_order_acquire) != head + 1)
+        {
+            return false;
+        }
+
+        out = std::move(c.value);
+
+        c.sequence.store(head + Capacity, std::memory_order_release);
+
+        ++head;
+
+        return true;
+    }
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{ 0 };
+        T value{};
+    };
+
+    Cell cells[Capacity];
+
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    alignas(64) size_t head = 0;
+};
\ No newline at end of file
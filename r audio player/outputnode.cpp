@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dspkernels.h"
+#include "outputnode.h"
+
+namespace
+{
+    constexpr float rampMs = 20.0f;
+}
+
+OutputNode::OutputNode() = default;
+
+OutputNode::~OutputNode()
+{
+    uninit();
+}
+
+bool OutputNode::init(ma_engine* engine, ma_node* next)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    // resolved here rather than on the first callback
+    dspKernels();
+
+    channels = ma_engine_get_channels(engine);
+    rampFrames = std::max(1.0f, rampMs * float(ma_engine_get_sample_rate(engine)) / 1000.0f);
+    current = target.load(std::memory_order_relaxed);
+
+    return attach(engine, next);
+}
+
+void OutputNode::process(float* frames, size_t count)
+{
+    const DspKernels& k = dspKernels();
+
+    const float want = target.load(std::memory_order_relaxed);
+    const float from = current;
+
+    if (from == want)
+    {
+        if (want != 1.0f)
+        {
+            k.gain(frames, count * channels, want);
+        }
+
+        return;
+    }
+
+    // moves at a fixed rate, a small change settles sooner than a big one
+    const float reach = float(count) / rampFrames;
+    const float to = std::abs(want - from) <= reach
+        ? want
+        : from + std::clamp(want - from, -reach, reach);
+
+    k.gainRamp(frames, count, channels, from, to);
+
+    current = to;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "graphnode.h"
+#include "miniaudio.h"
+
+#include <atomic>
+
+// every sound is routed through it, on its way to the limiter
+// applies the volume with a short ramp, so dragging the slider doesn't zipper
+class OutputNode : public GraphNode<OutputNode>
+{
+public:
+    OutputNode();
+    ~OutputNode();
+
+    OutputNode(const OutputNode&) = delete;
+    OutputNode& operator=(const OutputNode&) = delete;
+
+    // feeds 'next'
+    bool init(ma_engine* engine, ma_node* next);
+
+    // linear, any thread
+    void setVolume(float v) { target.store(v, std::memory_order_relaxed); }
+private:
+    // frames for a full swing from silence to unity
+    float rampFrames = 1.0f;
+
+    std::atomic<float> target{ 1.0f };
+
+    // audio thread only
+    float current = 1.0f;
+
+    // audio thread, run by the graph on frames already copied to the output
+    void process(float* frames, size_t count);
+
+    friend class GraphNode<OutputNode>;
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// single producer, single consumer ring of interleaved float frames
+// positions only ever grow, so the consumer can jump to a position the producer published
+class PcmRing
+{
+public:
+    void init(size_t frames, uint32_t ch)
+    {
+        size_t capacity = 1;
+
+        while (capacity < frames)
+        {
+            capacity *= 2;
+        }
+
+        channels = ch;
+        mask = capacity - 1;
+
+        data.assign(capacity * ch, 0.0f);
+
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // producer side
+
+    uint64_t writePosition() const { return head.load(std::memory_order_relaxed); }
+
+    // contiguous free space at the write position, may be shorter than the total free space
+    float* writeSpan(size_t& frames)
+    {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        const uint64_t t = tail.load(std::memory_order_acquire);
+        const size_t at = size_t(h & mask);
+
+        frames = std::min(capacity() - size_t(h - t), capacity() - at);
+
+        return data.data() + at * channels;
+    }
+
+    void commit(size_t frames)
+    {
+        head.store(head.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    // consumer side
+
+    size_t readable() const
+    {
+        return size_t(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+    }
+
+    size_t read(float* out, size_t frames)
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+
+        frames = std::min(frames, size_t(head.load(std::memory_order_acquire) - t));
+
+        const size_t at = size_t(t & mask);
+        const size_t first = std::min(frames, capacity() - at);
+
+        std::memcpy(out, data.data() + at * channels, first * channels * sizeof(float));
+        std::memcpy(out + first * channels, data.data(), (frames - first) * channels * sizeof(float));
+
+        tail.store(t + frames, std::memory_order_release);
+
+        return frames;
+    }
+
+    // drops everything written before the given position
+    void skipTo(uint64_t position)
+    {
+        if (position > tail.load(std::memory_order_relaxed))
+        {
+            tail.store(position, std::memory_order_release);
+        }
+    }
+private:
+    std::vector<float> data;
+
+    uint32_t channels = 0;
+    size_t mask = 0;
+
+    // producer owns head, consumer owns tail
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+};
\ No newline at end of file
@@ -0,0 +1,874 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include "pluginnode.h"
+
+#ifdef HAVE_LILV
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include <lilv/lilv.h>
+#include <lv2/atom/atom.h>
+#include <lv2/buf-size/buf-size.h>
+#include <lv2/core/lv2.h>
+#include <lv2/options/options.h>
+#include <lv2/parameters/parameters.h>
+#include <lv2/urid/urid.h>
+#endif
+
+struct PluginNode::Chain
+{
+    struct Plugin
+    {
+#ifdef HAVE_LILV
+        // one per channel for a mono plugin, otherwise one taking all of them
+        std::vector<LilvInstance*> instances;
+#endif
+
+        // control inputs: what the ports read, and what they are set to from the engine thread
+        std::vector<std::string> symbols;
+        std::vector<float> lows;
+        std::vector<float> highs;
+        std::vector<float> controls;
+        std::unique_ptr<std::atomic<float>[]> targets;
+
+        // control outputs, only the one reporting the plugin's latency is read, none is npos
+        std::vector<float> sink;
+        size_t latencyOut = std::string::npos;
+    };
+
+    std::vector<Plugin> plugins;
+
+    // planar, two sets of a block per channel, plugin i reads set i % 2 and writes the other
+    std::vector<float> buffers;
+
+#ifdef HAVE_LILV
+    // handed to the plugins at instantiation, so they live as long as the instances do
+    int32_t minBlock = 1;
+    int32_t maxBlock = int32_t(blockFrames);
+    float rate = 0.0f;
+
+    LV2_Options_Option options[5]{};
+    LV2_Feature optionsFeature{};
+    const LV2_Feature* features[5]{};
+#endif
+
+    Chain* retiredNext = nullptr;
+
+    Chain() = default;
+    ~Chain();
+
+    Chain(const Chain&) = delete;
+    Chain& operator=(const Chain&) = delete;
+};
+
+PluginNode::Chain::~Chain()
+{
+#ifdef HAVE_LILV
+    for (Plugin& p : plugins)
+    {
+        for (LilvInstance* instance : p.instances)
+        {
+            lilv_instance_deactivate(instance);
+            lilv_instance_free(instance);
+        }
+    }
+#endif
+}
+
+PluginNode::Chain PluginNode::off;
+
+#ifdef HAVE_LILV
+namespace
+{
+    // plugins map uris while they are instantiated, on the engine thread, the lock is for any that do it later
+    class Urids
+    {
+    public:
+        LV2_URID map(const char* uri)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            const auto [it, added] = ids.try_emplace(uri, LV2_URID(uris.size() + 1));
+
+            if (added)
+            {
+                uris.push_back(it->first);
+            }
+
+            return it->second;
+        }
+
+        const char* unmap(LV2_URID id)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            return id == 0 || id > uris.size()
+                ? nullptr
+                : uris[id - 1].c_str();
+        }
+    private:
+        std::mutex lock;
+        std::unordered_map<std::string, LV2_URID> ids;
+
+        // a deque, so the strings handed out never move
+        std::deque<std::string> uris;
+    };
+
+    // the installed plugins, scanned once on first use and kept for the life of the program
+    struct Host
+    {
+        LilvWorld* world = nullptr;
+
+        Urids urids;
+
+        LV2_URID_Map map{};
+        LV2_URID_Unmap unmap{};
+
+        LV2_Feature mapFeature{};
+        LV2_Feature unmapFeature{};
+        LV2_Feature boundedFeature{};
+
+        LilvNode* audioPort = nullptr;
+        LilvNode* controlPort = nullptr;
+        LilvNode* inputPort = nullptr;
+        LilvNode* outputPort = nullptr;
+        LilvNode* optional = nullptr;
+        LilvNode* reportsLatency = nullptr;
+
+        Host()
+        {
+            world = lilv_world_new();
+
+            lilv_world_load_all(world);
+
+            map.handle = &urids;
+            map.map = [](LV2_URID_Map_Handle handle, const char* uri)
+            {
+                return static_cast<Urids*>(handle)->map(uri);
+            };
+
+            unmap.handle = &urids;
+            unmap.unmap = [](LV2_URID_Unmap_Handle handle, LV2_URID id)
+            {
+                return static_cast<Urids*>(handle)->unmap(id);
+            };
+
+            mapFeature = { LV2_URID__map, &map };
+            unmapFeature = { LV2_URID__unmap, &unmap };
+            boundedFeature = { LV2_BUF_SIZE__boundedBlockLength, nullptr };
+
+            audioPort = lilv_new_uri(world, LV2_CORE__AudioPort);
+            controlPort = lilv_new_uri(world, LV2_CORE__ControlPort);
+            inputPort = lilv_new_uri(world, LV2_CORE__InputPort);
+            outputPort = lilv_new_uri(world, LV2_CORE__OutputPort);
+            optional = lilv_new_uri(world, LV2_CORE__connectionOptional);
+            reportsLatency = lilv_new_uri(world, LV2_CORE__reportsLatency);
+        }
+
+        bool supports(const char* feature) const
+        {
+            return std::strcmp(feature, LV2_URID__map) == 0
+                || std::strcmp(feature, LV2_URID__unmap) == 0
+                || std::strcmp(feature, LV2_OPTIONS__options) == 0
+                || std::strcmp(feature, LV2_BUF_SIZE__boundedBlockLength) == 0;
+        }
+    };
+
+    Host& host()
+    {
+        static Host h;
+
+        return h;
+    }
+}
+#endif
+
+bool PluginNode::available()
+{
+#ifdef HAVE_LILV
+    return true;
+#else
+    return false;
+#endif
+}
+
+PluginNode::PluginNode() = default;
+
+PluginNode::~PluginNode()
+{
+    uninit();
+    reset();
+}
+
+bool PluginNode::init(ma_engine* engine, ma_node* next)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    // nothing is running the node, whatever the audio thread held is ours again
+    reset();
+
+    channels = ma_engine_get_channels(engine);
+    sampleRate = ma_engine_get_sample_rate(engine);
+
+    fading.assign(size_t(channels) * blockFrames, 0.0f);
+
+    // instantiated for the old rate, and a plugin gone since leaves it off
+    if (!specs.empty())
+    {
+        const std::vector<PluginSpec> chain = specs;
+
+        specs.clear();
+        pluginNames.clear();
+
+        std::string error;
+
+        load(chain, error);
+    }
+
+    return attach(engine, next);
+}
+
+bool PluginNode::load(const std::vector<PluginSpec>& chain, std::string& error)
+{
+    if (chain.empty())
+    {
+        specs.clear();
+        pluginNames.clear();
+
+        publish(&off);
+
+        return true;
+    }
+
+    if (sampleRate == 0)
+    {
+        // picked up by init
+        specs = chain;
+
+        return true;
+    }
+
+    const bool samePlugins = latest
+        && std::equal(
+            chain.begin(),
+            chain.end(),
+            specs.begin(),
+            specs.end(),
+            [](const PluginSpec& a, const PluginSpec& b)
+            {
+                return a.uri == b.uri;
+            }
+        );
+
+    if (samePlugins)
+    {
+        for (size_t i = 0; i < chain.size(); ++i)
+        {
+            for (const auto& [symbol, value] : chain[i].controls)
+            {
+                if (!setControl(i, symbol, value))
+                {
+                    error = chain[i].uri + " has no control input " + symbol;
+
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<std::string> names;
+
+    Chain* c = build(chain, names, error);
+
+    if (!c)
+    {
+        return false;
+    }
+
+    specs = chain;
+    pluginNames = std::move(names);
+
+    publish(c);
+
+    return true;
+}
+
+bool PluginNode::setControl(size_t plugin, const std::string& symbol, float value)
+{
+    if (!latest
+        || plugin >= latest->plugins.size())
+    {
+        return false;
+    }
+
+    Chain::Plugin& p = latest->plugins[plugin];
+
+    const auto it = std::find(p.symbols.begin(), p.symbols.end(), symbol);
+
+    if (it == p.symbols.end())
+    {
+        return false;
+    }
+
+    const size_t k = size_t(it - p.symbols.begin());
+
+    const float v = std::clamp(value, p.lows[k], p.highs[k]);
+
+    p.targets[k].store(v, std::memory_order_relaxed);
+
+    // kept for a rebuild at another rate
+    auto& controls = specs[plugin].controls;
+
+    const auto known = std::find_if(
+        controls.begin(),
+        controls.end(),
+        [&symbol](const std::pair<std::string, float>& c)
+        {
+            return c.first == symbol;
+        }
+    );
+
+    if (known != controls.end())
+    {
+        known->second = v;
+    }
+    else
+    {
+        controls.emplace_back(symbol, v);
+    }
+
+    return true;
+}
+
+float PluginNode::lastCost(size_t plugin) const
+{
+    return plugin < maxPlugins
+        ? lastUs[plugin].load(std::memory_order_relaxed)
+        : 0.0f;
+}
+
+float PluginNode::peakCost(size_t plugin) const
+{
+    return plugin < maxPlugins
+        ? peakUs[plugin].load(std::memory_order_relaxed)
+        : 0.0f;
+}
+
+void PluginNode::collect()
+{
+    Chain* c = retired.exchange(nullptr, std::memory_order_acquire);
+
+    while (c)
+    {
+        Chain* n = c->retiredNext;
+
+        delete c;
+
+        c = n;
+    }
+}
+
+PluginNode::Chain* PluginNode::build(
+    [[maybe_unused]] const std::vector<PluginSpec>& chain,
+    [[maybe_unused]] std::vector<std::string>& names,
+    std::string& error) const
+{
+#ifndef HAVE_LILV
+    error = "built without lv2 support";
+
+    return nullptr;
+#else
+    if (chain.size() > maxPlugins)
+    {
+        error = "at most " + std::to_string(maxPlugins) + " plugins";
+
+        return nullptr;
+    }
+
+    Host& h = host();
+
+    auto c = std::make_unique<Chain>();
+
+    c->buffers.assign(size_t(2) * channels * blockFrames, 0.0f);
+    c->rate = float(sampleRate);
+
+    const LV2_URID intType = h.urids.map(LV2_ATOM__Int);
+    const LV2_URID floatType = h.urids.map(LV2_ATOM__Float);
+
+    c->options[0] = { LV2_OPTIONS_INSTANCE, 0, h.urids.map(LV2_BUF_SIZE__minBlockLength), sizeof(int32_t), intType, &c->minBlock };
+    c->options[1] = { LV2_OPTIONS_INSTANCE, 0, h.urids.map(LV2_BUF_SIZE__maxBlockLength), sizeof(int32_t), intType, &c->maxBlock };
+    c->options[2] = { LV2_OPTIONS_INSTANCE, 0, h.urids.map(LV2_BUF_SIZE__nominalBlockLength), sizeof(int32_t), intType, &c->maxBlock };
+    c->options[3] = { LV2_OPTIONS_INSTANCE, 0, h.urids.map(LV2_PARAMETERS__sampleRate), sizeof(float), floatType, &c->rate };
+    c->options[4] = { LV2_OPTIONS_INSTANCE, 0, 0, 0, 0, nullptr };
+
+    c->optionsFeature = { LV2_OPTIONS__options, c->options };
+
+    c->features[0] = &h.mapFeature;
+    c->features[1] = &h.unmapFeature;
+    c->features[2] = &c->optionsFeature;
+    c->features[3] = &h.boundedFeature;
+    c->features[4] = nullptr;
+
+    c->plugins.reserve(chain.size());
+
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+        const PluginSpec& spec = chain[i];
+
+        LilvNode* uri = lilv_new_uri(h.world, spec.uri.c_str());
+
+        const LilvPlugin* plugin = uri
+            ? lilv_plugins_get_by_uri(lilv_world_get_all_plugins(h.world), uri)
+            : nullptr;
+
+        lilv_node_free(uri);
+
+        if (!plugin)
+        {
+            error = "no lv2 plugin " + spec.uri;
+
+            return nullptr;
+        }
+
+        LilvNodes* required = lilv_plugin_get_required_features(plugin);
+
+        std::string missing;
+
+        LILV_FOREACH(nodes, it, required)
+        {
+            const char* feature = lilv_node_as_uri(lilv_nodes_get(required, it));
+
+            if (!h.supports(feature))
+            {
+                missing = feature;
+            }
+        }
+
+        lilv_nodes_free(required);
+
+        if (!missing.empty())
+        {
+            error = spec.uri + " needs " + missing;
+
+            return nullptr;
+        }
+
+        const uint32_t ports = lilv_plugin_get_num_ports(plugin);
+
+        std::vector<float> mins(ports);
+        std::vector<float> maxs(ports);
+        std::vector<float> defaults(ports);
+
+        lilv_plugin_get_port_ranges_float(plugin, mins.data(), maxs.data(), defaults.data());
+
+        std::vector<uint32_t> audioIn;
+        std::vector<uint32_t> audioOut;
+        std::vector<uint32_t> controlIn;
+        std::vector<uint32_t> controlOut;
+        std::vector<uint32_t> unused;
+
+        for (uint32_t port = 0; port < ports; ++port)
+        {
+            const LilvPort* p = lilv_plugin_get_port_by_index(plugin, port);
+
+            const bool input = lilv_port_is_a(plugin, p, h.inputPort);
+            const bool output = lilv_port_is_a(plugin, p, h.outputPort);
+
+            if (lilv_port_is_a(plugin, p, h.audioPort)
+                && (input || output))
+            {
+                (input
+                    ? audioIn
+                    : audioOut).push_back(port);
+            }
+            else if (lilv_port_is_a(plugin, p, h.controlPort)
+                && (input || output))
+            {
+                (input
+                    ? controlIn
+                    : controlOut).push_back(port);
+            }
+            else if (lilv_port_has_property(plugin, p, h.optional))
+            {
+                unused.push_back(port);
+            }
+            else
+            {
+                // atom and cv ports, midi in, sidechains
+                error = spec.uri + " has a port of a kind not hosted here";
+
+                return nullptr;
+            }
+        }
+
+        // a mono plugin is run once per channel, anything else has to match the engine
+        if (audioIn.size() != audioOut.size()
+            || (audioIn.size() != 1 && audioIn.size() != channels))
+        {
+            error = spec.uri + " has " + std::to_string(audioIn.size()) + " inputs and "
+                + std::to_string(audioOut.size()) + " outputs, the engine runs "
+                + std::to_string(channels) + " channels";
+
+            return nullptr;
+        }
+
+        Chain::Plugin& pl = c->plugins.emplace_back();
+
+        pl.targets = std::make_unique<std::atomic<float>[]>(controlIn.size());
+
+        for (size_t k = 0; k < controlIn.size(); ++k)
+        {
+            const uint32_t port = controlIn[k];
+
+            const LilvPort* p = lilv_plugin_get_port_by_index(plugin, port);
+
+            pl.symbols.push_back(lilv_node_as_string(lilv_port_get_symbol(plugin, p)));
+
+            pl.lows.push_back(std::isnan(mins[port])
+                ? -INFINITY
+                : mins[port]);
+
+            pl.highs.push_back(std::isnan(maxs[port])
+                ? INFINITY
+                : maxs[port]);
+
+            const float value = std::isnan(defaults[port])
+                ? std::clamp(0.0f, pl.lows[k], pl.highs[k])
+                : defaults[port];
+
+            pl.controls.push_back(value);
+            pl.targets[k].store(value, std::memory_order_relaxed);
+        }
+
+        for (const auto& [symbol, value] : spec.controls)
+        {
+            const auto it = std::find(pl.symbols.begin(), pl.symbols.end(), symbol);
+
+            if (it == pl.symbols.end())
+            {
+                error = spec.uri + " has no control input " + symbol;
+
+                return nullptr;
+            }
+
+            const size_t k = size_t(it - pl.symbols.begin());
+
+            pl.controls[k] = std::clamp(value, pl.lows[k], pl.highs[k]);
+            pl.targets[k].store(pl.controls[k], std::memory_order_relaxed);
+        }
+
+        pl.sink.assign(controlOut.size(), 0.0f);
+
+        for (size_t k = 0; k < controlOut.size(); ++k)
+        {
+            if (lilv_port_has_property(plugin, lilv_plugin_get_port_by_index(plugin, controlOut[k]), h.reportsLatency))
+            {
+                pl.latencyOut = k;
+            }
+        }
+
+        const size_t copies = audioIn.size() == 1
+            ? channels
+            : 1;
+
+        float* in = c->buffers.data() + (i % 2) * channels * blockFrames;
+        float* out = c->buffers.data() + ((i + 1) % 2) * channels * blockFrames;
+
+        for (size_t copy = 0; copy < copies; ++copy)
+        {
+            LilvInstance* instance = lilv_plugin_instantiate(plugin, double(sampleRate), c->features);
+
+            if (!instance)
+            {
+                error = spec.uri + " could not be instantiated";
+
+                return nullptr;
+            }
+
+            for (size_t j = 0; j < audioIn.size(); ++j)
+            {
+                const size_t ch = copies > 1
+                    ? copy
+                    : j;
+
+                lilv_instance_connect_port(instance, audioIn[j], in + ch * blockFrames);
+                lilv_instance_connect_port(instance, audioOut[j], out + ch * blockFrames);
+            }
+
+            for (size_t k = 0; k < controlIn.size(); ++k)
+            {
+                lilv_instance_connect_port(instance, controlIn[k], &pl.controls[k]);
+            }
+
+            for (size_t k = 0; k < controlOut.size(); ++k)
+            {
+                lilv_instance_connect_port(instance, controlOut[k], &pl.sink[k]);
+            }
+
+            for (uint32_t port : unused)
+            {
+                lilv_instance_connect_port(instance, port, nullptr);
+            }
+
+            lilv_instance_activate(instance);
+
+            pl.instances.push_back(instance);
+        }
+
+        LilvNode* name = lilv_plugin_get_name(plugin);
+
+        names.push_back(name
+            ? lilv_node_as_string(name)
+            : spec.uri);
+
+        lilv_node_free(name);
+    }
+
+    return c.release();
+#endif
+}
+
+void PluginNode::publish(Chain* chain)
+{
+    collect();
+
+    latest = chain == &off
+        ? nullptr
+        : chain;
+
+    Chain* untaken = pending.exchange(chain, std::memory_order_acq_rel);
+
+    // one the audio thread never got to
+    if (untaken != &off)
+    {
+        delete untaken;
+    }
+}
+
+void PluginNode::reset()
+{
+    Chain* c = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (c != &off)
+    {
+        delete c;
+    }
+
+    delete current;
+    delete outgoing;
+
+    current = nullptr;
+    outgoing = nullptr;
+    latest = nullptr;
+
+    fadeActive = false;
+
+    collect();
+}
+
+ma_uint64 PluginNode::latency() const
+{
+    if (!current)
+    {
+        return 0;
+    }
+
+    float frames = 0.0f;
+
+    for (const Chain::Plugin& p : current->plugins)
+    {
+        if (p.latencyOut < p.sink.size())
+        {
+            frames += std::max(0.0f, p.sink[p.latencyOut]);
+        }
+    }
+
+    return ma_uint64(std::lround(frames));
+}
+
+void PluginNode::process(float* frames, size_t count)
+{
+    std::fill(std::begin(spent), std::end(spent), 0);
+
+    for (size_t done = 0; done < count; done += blockFrames)
+    {
+        runBlock(frames + done * channels, std::min(blockFrames, count - done));
+    }
+
+    const size_t running = current
+        ? current->plugins.size()
+        : 0;
+
+    for (size_t i = 0; i < running; ++i)
+    {
+        const float us = float(spent[i]) / 1000.0f;
+
+        lastUs[i].store(us, std::memory_order_relaxed);
+
+        if (us > peakUs[i].load(std::memory_order_relaxed))
+        {
+            peakUs[i].store(us, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PluginNode::runBlock(float* frames, size_t count)
+{
+    Chain* request = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (request)
+    {
+        Chain* next = request == &off
+            ? nullptr
+            : request;
+
+        if (next != current)
+        {
+            // a fade still going is cut short, the chain it was fading out goes now
+            if (outgoing)
+            {
+                retire(outgoing);
+            }
+
+            outgoing = current;
+            current = next;
+
+            fadeActive = true;
+            fadePos = 0;
+
+            for (size_t i = 0; i < maxPlugins; ++i)
+            {
+                lastUs[i].store(0.0f, std::memory_order_relaxed);
+                peakUs[i].store(0.0f, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (!fadeActive)
+    {
+        if (current)
+        {
+            runChain(*current, frames, frames, count, true);
+        }
+
+        return;
+    }
+
+    const size_t samples = count * channels;
+
+    // the old side first, the new one overwrites the input
+    if (outgoing)
+    {
+        runChain(*outgoing, frames, fading.data(), count, false);
+    }
+    else
+    {
+        std::memcpy(fading.data(), frames, samples * sizeof(float));
+    }
+
+    if (current)
+    {
+        runChain(*current, frames, frames, count, true);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float g = std::min(1.0f, float(fadePos + i) / float(blockFrames));
+
+        for (ma_uint32 ch = 0; ch < channels; ++ch)
+        {
+            float& s = frames[i * channels + ch];
+
+            s = fading[i * channels + ch] * (1.0f - g) + s * g;
+        }
+    }
+
+    fadePos += count;
+
+    if (fadePos >= blockFrames)
+    {
+        if (outgoing)
+        {
+            retire(outgoing);
+        }
+
+        outgoing = nullptr;
+        fadeActive = false;
+    }
+}
+
+void PluginNode::runChain(Chain& chain, const float* in, float* out, size_t count, bool timed)
+{
+    using clock = std::chrono::steady_clock;
+
+    float* planar = chain.buffers.data();
+
+    for (ma_uint32 ch = 0; ch < channels; ++ch)
+    {
+        float* p = planar + size_t(ch) * blockFrames;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            p[i] = in[i * channels + ch];
+        }
+    }
+
+    for (size_t i = 0; i < chain.plugins.size(); ++i)
+    {
+        Chain::Plugin& p = chain.plugins[i];
+
+        for (size_t k = 0; k < p.controls.size(); ++k)
+        {
+            p.controls[k] = p.targets[k].load(std::memory_order_relaxed);
+        }
+
+        const auto start = clock::now();
+
+#ifdef HAVE_LILV
+        for (LilvInstance* instance : p.instances)
+        {
+            lilv_instance_run(instance, uint32_t(count));
+        }
+#endif
+
+        if (timed)
+        {
+            spent[i] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        }
+    }
+
+    const float* result = planar + (chain.plugins.size() % 2) * channels * blockFrames;
+
+    for (ma_uint32 ch = 0; ch < channels; ++ch)
+    {
+        const float* p = result + size_t(ch) * blockFrames;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i * channels + ch] = p[i];
+        }
+    }
+}
+
+void PluginNode::retire(Chain* chain)
+{
+    chain->retiredNext = retired.load(std::memory_order_relaxed);
+
+    while (!retired.compare_exchange_weak(
+        chain->retiredNext,
+        chain,
+        std::memory_order_release,
+        std::memory_order_relaxed))
+    {
+    }
+}
\ No newline at end of file
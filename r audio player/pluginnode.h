@@ -0,0 +1,116 @@
+#pragma once
+
+#include "graphnode.h"
+#include "miniaudio.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// a plugin of the chain by uri, with control inputs to set by symbol, the rest start at their defaults
+struct PluginSpec
+{
+    std::string uri;
+    std::vector<std::pair<std::string, float>> controls;
+};
+
+// between the sound and the eq, runs the audio through a chain of lv2 plugins hosted with lilv
+// the chain is instantiated and activated on the engine thread with all its buffers, handed over whole
+// and crossfaded in over a block, the old one is freed on the engine thread again
+// without lilv at build time it stays empty and every load but an empty one fails
+class PluginNode : public GraphNode<PluginNode>
+{
+public:
+    static constexpr size_t maxPlugins = 8;
+
+    // the plugins never get more frames at a time than this, longer callbacks are split
+    static constexpr size_t blockFrames = 512;
+
+    // built with lilv
+    static bool available();
+
+    PluginNode();
+    ~PluginNode();
+
+    PluginNode(const PluginNode&) = delete;
+    PluginNode& operator=(const PluginNode&) = delete;
+
+    // feeds 'next', a chain already loaded is instantiated again at the engine's rate
+    bool init(ma_engine* engine, ma_node* next);
+
+    // engine thread, an empty chain turns it off, the same plugins in the same order only get their controls set
+    // false with the reason when a plugin can't be found or hosted, the chain in use then stays
+    bool load(const std::vector<PluginSpec>& chain, std::string& error);
+    bool enabled() const { return !specs.empty(); }
+
+    // engine thread, names of the plugins running, in order
+    const std::vector<std::string>& names() const { return pluginNames; }
+
+    // engine thread, the audio thread picks the value up at its next block without locking
+    // false when there is no such plugin or control input
+    bool setControl(size_t plugin, const std::string& symbol, float value);
+
+    // any thread, microseconds the plugin at that position took in the last device callback,
+    // and the most it took in one since its chain went in
+    float lastCost(size_t plugin) const;
+    float peakCost(size_t plugin) const;
+
+    // frees chains the audio thread has finished with, engine thread only
+    void collect();
+
+    // audio thread, in place on interleaved frames of the engine's channels
+    void process(float* frames, size_t count);
+
+    // audio thread, frames the chain in use is behind its input, summed from what the plugins report
+    // on their latency outputs as of the last block they ran, none when off
+    ma_uint64 latency() const;
+private:
+    struct Chain;
+
+    ma_uint32 sampleRate = 0;
+
+    // engine thread, kept so a device reopened at another rate gets the same chain
+    std::vector<PluginSpec> specs;
+    std::vector<std::string> pluginNames;
+
+    // the chain last handed over, whose controls setControl writes
+    Chain* latest = nullptr;
+
+    // set by the engine thread, taken by the audio thread at a block boundary, &off asks it to stop
+    static Chain off;
+
+    std::atomic<Chain*> pending{ nullptr };
+
+    // lock free stack, pushed from the audio thread
+    std::atomic<Chain*> retired{ nullptr };
+
+    std::atomic<float> lastUs[maxPlugins]{};
+    std::atomic<float> peakUs[maxPlugins]{};
+
+    // audio thread only
+    Chain* current = nullptr;
+
+    // a chain coming in is crossfaded with the one it replaces, or the dry signal when that is null
+    Chain* outgoing = nullptr;
+    bool fadeActive{};
+    size_t fadePos = 0;
+
+    // the outgoing side of a crossfade, interleaved
+    std::vector<float> fading;
+
+    // nanoseconds per plugin so far in this callback
+    int64_t spent[maxPlugins]{};
+
+    // engine thread
+    Chain* build(const std::vector<PluginSpec>& chain, std::vector<std::string>& names, std::string& error) const;
+    void publish(Chain* chain);
+    void reset();
+
+    // audio thread
+    void runBlock(float* frames, size_t count);
+    void runChain(Chain& chain, const float* in, float* out, size_t count, bool timed);
+    void retire(Chain* chain);
+};
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <numbers>
+#include <vector>
+
+#include "dspkernels.h"
+#include "resampler.h"
+
+namespace
+{
+    struct Tier
+    {
+        // at 1:1, scaled up when decimating so the transition band keeps its width in input samples
+        uint32_t taps;
+
+        // of the lower nyquist
+        double cutoff;
+
+        // kaiser window shape, higher trades transition width for stopband depth
+        double beta;
+    };
+
+    const Tier sincTier{ 32, 0.91, 8.0 };
+    const Tier bestTier{ 96, 0.96, 12.0 };
+
+    // past this many phases the table holds a fixed grid and neighbouring rows are blended
+    constexpr uint32_t maxRows = 1024;
+
+    // lives at the start of the heap miniaudio hands to onInit, the table and history follow it
+    struct State
+    {
+        uint32_t channels;
+        uint32_t taps;
+
+        // output advances by step / phases input frames
+        uint32_t phases;
+        uint32_t step;
+
+        // table rows, phases when the ratio is exact, maxRows + 1 otherwise
+        uint32_t rows;
+
+        // input frames still to push before the next output
+        uint64_t need;
+
+        // of the next output, in 1 / phases of an input frame
+        uint32_t phase;
+
+        // newest sample of each channel's history
+        uint32_t head;
+
+        // rows * taps, each row a filter for one fractional position
+        float* table;
+
+        // channels * taps * 2, every sample written twice so a window never wraps
+        float* history;
+    };
+
+    struct Layout
+    {
+        uint32_t taps;
+        uint32_t phases;
+        uint32_t step;
+        uint32_t rows;
+        double cutoff;
+
+        size_t tableOffset;
+        size_t historyOffset;
+        size_t size;
+    };
+
+    inline size_t alignUp(size_t n)
+    {
+        return (n + 63) & ~size_t(63);
+    }
+
+    Layout layoutOf(const Tier& tier, const ma_resampler_config& config)
+    {
+        Layout l{};
+
+        const uint32_t g = std::gcd(config.sampleRateIn, config.sampleRateOut);
+
+        l.phases = config.sampleRateOut / g;
+        l.step = config.sampleRateIn / g;
+        l.rows = l.phases <= maxRows ? l.phases : maxRows + 1;
+
+        // decimating moves the cutoff down to the output's nyquist, the filter gets longer to match
+        const double ratio = std::min(1.0, double(config.sampleRateOut) / double(config.sampleRateIn));
+
+        l.taps = uint32_t(std::ceil(double(tier.taps) / ratio / 8.0)) * 8;
+        l.cutoff = tier.cutoff * ratio;
+
+        l.tableOffset = alignUp(sizeof(State));
+        l.historyOffset = l.tableOffset + alignUp(size_t(l.rows) * l.taps * sizeof(float));
+        l.size = l.historyOffset + size_t(config.channels) * l.taps * 2 * sizeof(float);
+
+        return l;
+    }
+
+    // zeroth order modified bessel function of the first kind
+    double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+
+        for (int k = 1; k < 64; ++k)
+        {
+            const double h = x / (2.0 * k);
+
+            term *= h * h;
+            sum += term;
+
+            if (term < sum * 1e-17)
+            {
+                break;
+            }
+        }
+
+        return sum;
+    }
+
+    // row r filters an output r / phases past the window's centre sample, or r / maxRows on the blended grid
+    void buildTable(const Layout& l, double beta, float* table)
+    {
+        const double half = double(l.taps) / 2.0;
+        const double norm = besselI0(beta);
+        const double divisions = l.phases <= maxRows
+            ? double(l.phases)
+            : double(maxRows);
+
+        std::vector<double> row(l.taps);
+
+        for (uint32_t r = 0; r < l.rows; ++r)
+        {
+            const double frac = double(r) / divisions;
+
+            double sum = 0.0;
+
+            for (uint32_t j = 0; j < l.taps; ++j)
+            {
+                const double x = double(j) - (half - 1.0) - frac;
+                const double u = x / half;
+                const double window = std::abs(u) < 1.0
+                    ? besselI0(beta * std::sqrt(1.0 - u * u)) / norm
+                    : 0.0;
+                const double t = std::numbers::pi * l.cutoff * x;
+                const double sinc = t == 0.0
+                    ? 1.0
+                    : std::sin(t) / t;
+
+                row[j] = l.cutoff * sinc * window;
+                sum += row[j];
+            }
+
+            // unity at dc on every phase, otherwise low frequencies pick up a ripple at the phase rate
+            for (uint32_t j = 0; j < l.taps; ++j)
+            {
+                table[size_t(r) * l.taps + j] = float(row[j] / sum);
+            }
+        }
+    }
+
+    inline State* stateOf(ma_resampling_backend* backend)
+    {
+        return static_cast<State*>(backend);
+    }
+
+    inline const State* stateOf(const ma_resampling_backend* backend)
+    {
+        return static_cast<const State*>(backend);
+    }
+
+    void clear(State& s)
+    {
+        std::memset(s.history, 0, size_t(s.channels) * s.taps * 2 * sizeof(float));
+
+        // the first output lines up with the first input frame, so half a window of lookahead is needed
+        s.need = s.taps / 2 + 1;
+        s.phase = 0;
+        s.head = 0;
+    }
+
+    inline void push(State& s, const float* frame)
+    {
+        s.head = s.head + 1 == s.taps
+            ? 0
+            : s.head + 1;
+
+        for (uint32_t c = 0; c < s.channels; ++c)
+        {
+            float* h = s.history + size_t(c) * s.taps * 2;
+            const float x = frame ? frame[c] : 0.0f;
+
+            h[s.head] = x;
+            h[s.head + s.taps] = x;
+        }
+    }
+
+    inline void produce(const State& s, const DspKernels& k, float* out)
+    {
+        const uint32_t oldest = s.head + 1;
+
+        if (s.phases <= maxRows)
+        {
+            const float* row = s.table + size_t(s.phase) * s.taps;
+
+            for (uint32_t c = 0; c < s.channels; ++c)
+            {
+                out[c] = k.dot(s.history + size_t(c) * s.taps * 2 + oldest, row, s.taps);
+            }
+
+            return;
+        }
+
+        // between two rows of the grid
+        const double at = double(s.phase) * maxRows / double(s.phases);
+        const uint32_t r = std::min(uint32_t(at), maxRows - 1);
+        const float blend = float(at - r);
+
+        const float* lo = s.table + size_t(r) * s.taps;
+        const float* hi = lo + s.taps;
+
+        for (uint32_t c = 0; c < s.channels; ++c)
+        {
+            const float* window = s.history + size_t(c) * s.taps * 2 + oldest;
+            const float a = k.dot(window, lo, s.taps);
+            const float b = k.dot(window, hi, s.taps);
+
+            out[c] = a + (b - a) * blend;
+        }
+    }
+
+    ma_result onGetHeapSize(void* userData, const ma_resampler_config* config, size_t* size)
+    {
+        if (config->format != ma_format_f32
+            || config->channels == 0
+            || config->sampleRateIn == 0
+            || config->sampleRateOut == 0)
+        {
+            return MA_INVALID_ARGS;
+        }
+
+        *size = layoutOf(*static_cast<const Tier*>(userData), *config).size;
+
+        return MA_SUCCESS;
+    }
+
+    ma_result onInit(void* userData, const ma_resampler_config* config, void* heap, ma_resampling_backend** backend)
+    {
+        if (!heap
+            || config->format != ma_format_f32)
+        {
+            return MA_INVALID_ARGS;
+        }
+
+        const Tier& tier = *static_cast<const Tier*>(userData);
+        const Layout l = layoutOf(tier, *config);
+
+        auto* base = static_cast<char*>(heap);
+        auto* s = new (base) State{};
+
+        s->channels = config->channels;
+        s->taps = l.taps;
+        s->phases = l.phases;
+        s->step = l.step;
+        s->rows = l.rows;
+        s->table = reinterpret_cast<float*>(base + l.tableOffset);
+        s->history = reinterpret_cast<float*>(base + l.historyOffset);
+
+        buildTable(l, tier.beta, s->table);
+        clear(*s);
+
+        // resolved here rather than on the first callback
+        dspKernels();
+
+        *backend = s;
+
+        return MA_SUCCESS;
+    }
+
+    void onUninit(void*, ma_resampling_backend*, const ma_allocation_callbacks*)
+    {
+        // everything sits in the heap, which miniaudio frees
+    }
+
+    ma_result onProcess(void*, ma_resampling_backend* backend, const void* framesIn, ma_uint64* frameCountIn, void* framesOut, ma_uint64* frameCountOut)
+    {
+        State& s = *stateOf(backend);
+
+        const DspKernels& k = dspKernels();
+
+        // a null input reads as silence and a null output throws the frames away, miniaudio uses both
+        const auto* in = static_cast<const float*>(framesIn);
+        auto* out = static_cast<float*>(framesOut);
+
+        const ma_uint64 inCount = frameCountIn ? *frameCountIn : 0;
+        const ma_uint64 outCount = frameCountOut ? *frameCountOut : 0;
+
+        ma_uint64 inUsed = 0;
+        ma_uint64 outUsed = 0;
+
+        float discard[MA_MAX_CHANNELS];
+
+        while (outUsed < outCount)
+        {
+            while (s.need > 0
+                && inUsed < inCount)
+            {
+                push(s, in ? in + inUsed * s.channels : nullptr);
+
+                --s.need;
+                ++inUsed;
+            }
+
+            if (s.need > 0)
+            {
+                break;
+            }
+
+            produce(s, k, out ? out + outUsed * s.channels : discard);
+
+            ++outUsed;
+
+            s.phase += s.step;
+            s.need += s.phase / s.phases;
+            s.phase %= s.phases;
+        }
+
+        if (frameCountIn)
+        {
+            *frameCountIn = inUsed;
+        }
+
+        if (frameCountOut)
+        {
+            *frameCountOut = outUsed;
+        }
+
+        return MA_SUCCESS;
+    }
+
+    ma_uint64 onGetInputLatency(void*, const ma_resampling_backend* backend)
+    {
+        return stateOf(backend)->taps / 2;
+    }
+
+    ma_uint64 onGetOutputLatency(void*, const ma_resampling_backend*)
+    {
+        return 0;
+    }
+
+    ma_result onGetRequiredInputFrameCount(void*, const ma_resampling_backend* backend, ma_uint64 outputFrameCount, ma_uint64* inputFrameCount)
+    {
+        const State& s = *stateOf(backend);
+
+        *inputFrameCount = outputFrameCount == 0
+            ? 0
+            : s.need + (s.phase + (outputFrameCount - 1) * s.step) / s.phases;
+
+        return MA_SUCCESS;
+    }
+
+    ma_result onGetExpectedOutputFrameCount(void*, const ma_resampling_backend* backend, ma_uint64 inputFrameCount, ma_uint64* outputFrameCount)
+    {
+        const State& s = *stateOf(backend);
+
+        if (inputFrameCount < s.need)
+        {
+            *outputFrameCount = 0;
+
+            return MA_SUCCESS;
+        }
+
+        // outputs k with need + (phase + k * step) / phases <= input
+        const ma_uint64 span = (inputFrameCount - s.need + 1) * s.phases - s.phase;
+
+        *outputFrameCount = (span + s.step - 1) / s.step;
+
+        return MA_SUCCESS;
+    }
+
+    ma_result onReset(void*, ma_resampling_backend* backend)
+    {
+        clear(*stateOf(backend));
+
+        return MA_SUCCESS;
+    }
+
+    ma_resampling_backend_vtable vtable =
+    {
+        &onGetHeapSize,
+        &onInit,
+        &onUninit,
+        &onProcess,
+        nullptr,
+        &onGetInputLatency,
+        &onGetOutputLatency,
+        &onGetRequiredInputFrameCount,
+        &onGetExpectedOutputFrameCount,
+        &onReset
+    };
+}
+
+ma_resampling_backend_vtable* resamplerBackend(ResamplerQuality quality)
+{
+    return quality == ResamplerQuality::Linear
+        ? nullptr
+        : &vtable;
+}
+
+ma_uint64 resamplerTail(const ma_resampler& resampler)
+{
+    return resampler.pBackendVTable == &vtable
+        ? onGetInputLatency(nullptr, resampler.pBackend)
+        : 0;
+}
+
+void* resamplerTier(ResamplerQuality quality)
+{
+    switch (quality)
+    {
+    case ResamplerQuality::Sinc:
+        return const_cast<Tier*>(&sincTier);
+
+    case ResamplerQuality::Best:
+        return const_cast<Tier*>(&bestTier);
+
+    default:
+        return nullptr;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "miniaudio.h"
+
+// sample rate conversion for the decoders and the device, picked per tier
+// linear is miniaudio's own, the others are windowed sinc polyphase filters run through the dot kernel
+enum class ResamplerQuality
+{
+    Linear,
+    Sinc,
+    Best
+};
+
+// the custom backend for a tier and its user data, nullptr for linear
+ma_resampling_backend_vtable* resamplerBackend(ResamplerQuality quality);
+void* resamplerTier(ResamplerQuality quality);
+
+// input frames of silence to push in after the end to get the last output out,
+// the sinc tiers hold half a window back, miniaudio's linear one lines its output up itself
+ma_uint64 resamplerTail(const ma_resampler& resampler);
+
+// fills in either a decoder's ma_resampler_config or a device config's resampling block
+template <typename Config>
+void configureResampler(Config& config, ResamplerQuality quality)
+{
+    config.algorithm = quality == ResamplerQuality::Linear
+        ? ma_resample_algorithm_linear
+        : ma_resample_algorithm_custom;
+
+    config.pBackendVTable = resamplerBackend(quality);
+    config.pBackendUserData = resamplerTier(quality);
+}
+
+// cpu time per second of audio and thd+n of each tier on a few rate pairs, prints a table, 0 when every tier is in bounds
+int runResamplerBenchmark();
\ No newline at end of file
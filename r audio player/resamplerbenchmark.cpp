@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <vector>
+
+#include "dspkernels.h"
+#include "resampler.h"
+
+namespace
+{
+    constexpr ma_uint32 channels = 2;
+
+    // one engine period at a time, the way the decoders and the device feed it
+    constexpr ma_uint64 chunkFrames = 1024;
+
+    // of input, per tier and rate pair
+    constexpr double timedSeconds = 8.0;
+    constexpr double measuredSeconds = 1.0;
+
+    struct Pair
+    {
+        ma_uint32 in;
+        ma_uint32 out;
+    };
+
+    const Pair pairs[] =
+    {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 96000, 44100 },
+        { 44100, 96000 }
+    };
+
+    struct TierCase
+    {
+        const char* name;
+        ResamplerQuality quality;
+
+        // thd+n at 1 and 10 khz has to come in under these, in db
+        double floorLow;
+        double floorHigh;
+    };
+
+    const TierCase tiers[] =
+    {
+        { "linear", ResamplerQuality::Linear, -55.0, -15.0 },
+        { "sinc", ResamplerQuality::Sinc, -85.0, -80.0 },
+        { "best", ResamplerQuality::Best, -125.0, -125.0 }
+    };
+
+    std::vector<float> sine(double hz, ma_uint32 rate, double seconds)
+    {
+        const size_t frames = size_t(seconds * rate);
+
+        std::vector<float> x(frames * channels);
+
+        for (size_t i = 0; i < frames; ++i)
+        {
+            const float v = float(0.5 * std::sin(2.0 * std::numbers::pi * hz * double(i) / rate));
+
+            for (ma_uint32 c = 0; c < channels; ++c)
+            {
+                x[i * channels + c] = v;
+            }
+        }
+
+        return x;
+    }
+
+    // runs the whole input through in chunks, empty on failure
+    std::vector<float> resample(const Pair& pair, ResamplerQuality quality, const std::vector<float>& in)
+    {
+        ma_resampler_config config = ma_resampler_config_init(
+            ma_format_f32,
+            channels,
+            pair.in,
+            pair.out,
+            ma_resample_algorithm_linear
+        );
+
+        configureResampler(config, quality);
+
+        ma_resampler resampler;
+
+        if (ma_resampler_init(&config, nullptr, &resampler) != MA_SUCCESS)
+        {
+            return {};
+        }
+
+        const ma_uint64 inFrames = in.size() / channels;
+
+        std::vector<float> out(size_t(double(inFrames) * pair.out / pair.in + chunkFrames) * channels);
+
+        ma_uint64 inUsed = 0;
+        ma_uint64 outUsed = 0;
+
+        while (inUsed < inFrames)
+        {
+            ma_uint64 frameCountIn = std::min(chunkFrames, inFrames - inUsed);
+            ma_uint64 frameCountOut = out.size() / channels - outUsed;
+
+            ma_resampler_process_pcm_frames(
+                &resampler,
+                in.data() + inUsed * channels,
+                &frameCountIn,
+                out.data() + outUsed * channels,
+                &frameCountOut
+            );
+
+            if (frameCountIn == 0
+                && frameCountOut == 0)
+            {
+                break;
+            }
+
+            inUsed += frameCountIn;
+            outUsed += frameCountOut;
+        }
+
+        ma_resampler_uninit(&resampler, nullptr);
+
+        out.resize(outUsed * channels);
+
+        return out;
+    }
+
+    // least squares fit of a sine, a cosine and dc at the known frequency on the first channel,
+    // everything left over is distortion and noise, relative to the fundamental
+    double thdN(const std::vector<float>& y, double hz, ma_uint32 rate)
+    {
+        const size_t frames = y.size() / channels;
+
+        // the filters settle and the input runs out at the edges
+        const size_t from = frames / 10;
+        const size_t to = frames - frames / 10;
+
+        double m[3][3]{};
+        double v[3]{};
+
+        for (size_t i = from; i < to; ++i)
+        {
+            const double w = 2.0 * std::numbers::pi * hz * double(i) / rate;
+            const double b[3] = { std::sin(w), std::cos(w), 1.0 };
+
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    m[r][c] += b[r] * b[c];
+                }
+
+                v[r] += b[r] * y[i * channels];
+            }
+        }
+
+        // gaussian elimination, the basis is close to orthogonal so no pivoting is needed
+        for (int p = 0; p < 3; ++p)
+        {
+            for (int r = p + 1; r < 3; ++r)
+            {
+                const double f = m[r][p] / m[p][p];
+
+                for (int c = p; c < 3; ++c)
+                {
+                    m[r][c] -= f * m[p][c];
+                }
+
+                v[r] -= f * v[p];
+            }
+        }
+
+        double a[3]{};
+
+        for (int r = 2; r >= 0; --r)
+        {
+            double s = v[r];
+
+            for (int c = r + 1; c < 3; ++c)
+            {
+                s -= m[r][c] * a[c];
+            }
+
+            a[r] = s / m[r][r];
+        }
+
+        double residual = 0.0;
+
+        for (size_t i = from; i < to; ++i)
+        {
+            const double w = 2.0 * std::numbers::pi * hz * double(i) / rate;
+            const double e = y[i * channels] - (a[0] * std::sin(w) + a[1] * std::cos(w) + a[2]);
+
+            residual += e * e;
+        }
+
+        const double fundamental = (a[0] * a[0] + a[1] * a[1]) / 2.0 * double(to - from);
+
+        return 10.0 * std::log10(std::max(residual, 1e-30) / fundamental);
+    }
+
+    // ms of cpu per second of audio
+    double timeTier(const Pair& pair, ResamplerQuality quality)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const std::vector<float> in = sine(997.0, pair.in, timedSeconds);
+
+        // the first run builds the tables and warms the caches
+        resample(pair, quality, in);
+
+        const auto start = clock::now();
+
+        resample(pair, quality, in);
+
+        const double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        return ms / timedSeconds;
+    }
+}
+
+int runResamplerBenchmark()
+{
+    std::printf("resamplers, %u channels, %llu frames a call, dot kernel %s\n\n", channels, (unsigned long long)chunkFrames, dspKernels().name);
+    std::printf("%-8s %-14s %10s %10s %12s %12s\n", "tier", "rates", "ms/s", "realtime", "thd+n 1k", "thd+n 10k");
+
+    int failed = 0;
+
+    for (const TierCase& t : tiers)
+    {
+        for (const Pair& pair : pairs)
+        {
+            const double ms = timeTier(pair, t.quality);
+
+            const double low = thdN(resample(pair, t.quality, sine(1000.0, pair.in, measuredSeconds)), 1000.0, pair.out);
+            const double high = thdN(resample(pair, t.quality, sine(10000.0, pair.in, measuredSeconds)), 10000.0, pair.out);
+
+            const bool ok = low <= t.floorLow
+                && high <= t.floorHigh;
+
+            if (!ok)
+            {
+                ++failed;
+            }
+
+            char rates[32];
+
+            std::snprintf(rates, sizeof(rates), "%u>%u", pair.in, pair.out);
+
+            std::printf(
+                "%-8s %-14s %10.3f %9.0fx %9.1f dB %9.1f dB%s\n",
+                t.name,
+                rates,
+                ms,
+                1000.0 / ms,
+                low,
+                high,
+                ok
+                    ? ""
+                    : "  out of bounds"
+            );
+        }
+    }
+
+    std::fflush(stdout);
+
+    return failed == 0
+        ? 0
+        : 1;
+}
\ No newline at end of file
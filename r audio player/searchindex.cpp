@@ -0,0 +1,540 @@
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+#include "casefold.h"
+#include "library.h"
+#include "searchindex.h"
+
+namespace
+{
+    inline bool isTokenChar(char c)
+    {
+        // anything outside ascii belongs to a word, folded keys are already lowercase
+        return static_cast<unsigned char>(c) >= 0x80
+            || (c >= 'a' && c <= 'z')
+            || (c >= '0' && c <= '9');
+    }
+
+    std::vector<std::string> tokenize(std::string_view folded)
+    {
+        std::vector<std::string> out;
+
+        size_t i = 0;
+
+        while (i < folded.size())
+        {
+            while (i < folded.size()
+                && !isTokenChar(folded[i]))
+            {
+                ++i;
+            }
+
+            const size_t b = i;
+
+            while (i < folded.size()
+                && isTokenChar(folded[i]))
+            {
+                ++i;
+            }
+
+            if (i > b)
+            {
+                out.emplace_back(folded.substr(b, i - b));
+            }
+        }
+
+        return out;
+    }
+
+    std::string joinTokens(const std::vector<std::string>& tokens)
+    {
+        std::string out;
+
+        for (const auto& t : tokens)
+        {
+            if (!out.empty())
+            {
+                out += ' ';
+            }
+
+            out += t;
+        }
+
+        return out;
+    }
+
+    bool matchText(const std::string& text, const std::string& needle, bool exact)
+    {
+        size_t pos = text.find(needle);
+
+        while (pos != std::string::npos)
+        {
+            const size_t end = pos + needle.size();
+
+            if ((pos == 0 || text[pos - 1] == ' ')
+                && (!exact || end == text.size() || text[end] == ' '))
+            {
+                return true;
+            }
+
+            pos = text.find(needle, pos + 1);
+        }
+
+        return false;
+    }
+
+    std::vector<uint32_t> intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+    {
+        std::vector<uint32_t> out;
+
+        out.reserve(std::min(a.size(), b.size()));
+
+        std::set_intersection(
+            a.begin(),
+            a.end(),
+            b.begin(),
+            b.end(),
+            std::back_inserter(out)
+        );
+
+        return out;
+    }
+
+    bool fieldFromName(std::string_view name, SearchField& field)
+    {
+        const std::string n = foldKey(name);
+
+        if (n == "artist")
+        {
+            field = SearchField::Artist;
+        }
+        else if (n == "album")
+        {
+            field = SearchField::Album;
+        }
+        else if (n == "title"
+            || n == "track")
+        {
+            field = SearchField::Title;
+        }
+        else if (n == "path")
+        {
+            field = SearchField::Path;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+}
+
+Query Query::parse(std::string_view text)
+{
+    Query q;
+
+    size_t i = 0;
+
+    while (i < text.size())
+    {
+        while (i < text.size()
+            && (text[i] == ' ' || text[i] == '\t'))
+        {
+            ++i;
+        }
+
+        if (i >= text.size())
+        {
+            break;
+        }
+
+        QueryTerm term;
+
+        if (text[i] == '-'
+            && i + 1 < text.size()
+            && text[i + 1] != ' ')
+        {
+            term.negated = true;
+
+            ++i;
+        }
+
+        const size_t colon = text.find(':', i);
+        const size_t space = text.find(' ', i);
+
+        if (colon != std::string_view::npos
+            && colon < space
+            && text[i] != '"'
+            && fieldFromName(text.substr(i, colon - i), term.field))
+        {
+            i = colon + 1;
+        }
+
+        std::string_view value;
+
+        if (i < text.size()
+            && text[i] == '"')
+        {
+            const size_t close = text.find('"', i + 1);
+
+            value = text.substr(i + 1, close == std::string_view::npos
+                ? std::string_view::npos
+                : close - i - 1);
+
+            term.exact = true;
+
+            i = close == std::string_view::npos
+                ? text.size()
+                : close + 1;
+        }
+        else
+        {
+            const size_t end = std::min(text.find(' ', i), text.size());
+
+            value = text.substr(i, end - i);
+
+            i = end;
+        }
+
+        term.tokens = tokenize(foldKey(value));
+
+        if (!term.tokens.empty())
+        {
+            q.terms.push_back(std::move(term));
+        }
+    }
+
+    return q;
+}
+
+void SearchIndex::build(const std::vector<Album>& albums)
+{
+    std::unordered_map<std::string, std::vector<uint32_t>> terms[fieldCount];
+
+    for (auto& t : texts)
+    {
+        t.clear();
+    }
+
+    albumFirst.clear();
+    trackAlbum.clear();
+
+    uint32_t id = 0;
+
+    for (size_t a = 0; a < albums.size(); ++a)
+    {
+        const Album& album = albums[a];
+
+        albumFirst.push_back(id);
+
+        const std::vector<std::string> albumArtist = tokenize(album.artistKey);
+        const std::vector<std::string> albumTitle = tokenize(album.titleKey);
+
+        for (const Track& track : album.tracks)
+        {
+            std::vector<std::string> fields[fieldCount];
+
+            fields[size_t(SearchField::Artist)] = albumArtist;
+
+            for (auto& tok : tokenize(track.artistKey))
+            {
+                fields[size_t(SearchField::Artist)].push_back(std::move(tok));
+            }
+
+            fields[size_t(SearchField::Album)] = albumTitle;
+            fields[size_t(SearchField::Title)] = tokenize(track.titleKey);
+            fields[size_t(SearchField::Path)] = tokenize(foldKey(track.path));
+
+            for (size_t f = 0; f < fieldCount; ++f)
+            {
+                for (const auto& tok : fields[f])
+                {
+                    auto& ids = terms[f][tok];
+
+                    if (ids.empty()
+                        || ids.back() != id)
+                    {
+                        ids.push_back(id);
+                    }
+                }
+
+                texts[f].push_back(joinTokens(fields[f]));
+            }
+
+            trackAlbum.push_back(uint32_t(a));
+
+            ++id;
+        }
+    }
+
+    albumFirst.push_back(id);
+
+    for (size_t f = 0; f < fieldCount; ++f)
+    {
+        postings[f].clear();
+        postings[f].reserve(terms[f].size());
+
+        for (auto& [term, ids] : terms[f])
+        {
+            postings[f].push_back({ term, std::move(ids) });
+        }
+
+        std::sort(
+            postings[f].begin(),
+            postings[f].end(),
+            [](const Posting& a, const Posting& b)
+            {
+                return a.term < b.term;
+            }
+        );
+    }
+}
+
+std::vector<uint32_t> SearchIndex::lookup(SearchField field, const std::string& token, bool prefix) const
+{
+    if (field == SearchField::Any)
+    {
+        std::vector<uint32_t> out;
+
+        for (SearchField f : { SearchField::Artist, SearchField::Album, SearchField::Title })
+        {
+            const std::vector<uint32_t> ids = lookup(f, token, prefix);
+
+            std::vector<uint32_t> merged;
+
+            merged.reserve(out.size() + ids.size());
+
+            std::set_union(
+                out.begin(),
+                out.end(),
+                ids.begin(),
+                ids.end(),
+                std::back_inserter(merged)
+            );
+
+            out.swap(merged);
+        }
+
+        return out;
+    }
+
+    const auto& list = postings[size_t(field)];
+
+    auto it = std::lower_bound(
+        list.begin(),
+        list.end(),
+        token,
+        [](const Posting& p, const std::string& t)
+        {
+            return p.term < t;
+        }
+    );
+
+    if (!prefix)
+    {
+        if (it != list.end()
+            && it->term == token)
+        {
+            return it->ids;
+        }
+
+        return {};
+    }
+
+    std::vector<uint32_t> out;
+
+    for (; it != list.end() && it->term.compare(0, token.size(), token) == 0; ++it)
+    {
+        out.insert(out.end(), it->ids.begin(), it->ids.end());
+    }
+
+    std::sort(out.begin(), out.end());
+
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+
+    return out;
+}
+
+size_t SearchIndex::estimate(const QueryTerm& term) const
+{
+    size_t best = SIZE_MAX;
+
+    for (size_t k = 0; k < term.tokens.size(); ++k)
+    {
+        const std::string& token = term.tokens[k];
+        const bool prefix = !term.exact && k + 1 == term.tokens.size();
+
+        size_t n = 0;
+
+        for (size_t f = 0; f < fieldCount; ++f)
+        {
+            if (term.field != SearchField::Any
+                && size_t(term.field) != f)
+            {
+                continue;
+            }
+
+            if (term.field == SearchField::Any
+                && f == size_t(SearchField::Path))
+            {
+                continue;
+            }
+
+            const auto& list = postings[f];
+
+            auto it = std::lower_bound(
+                list.begin(),
+                list.end(),
+                token,
+                [](const Posting& p, const std::string& t)
+                {
+                    return p.term < t;
+                }
+            );
+
+            for (; it != list.end(); ++it)
+            {
+                if (prefix
+                    ? it->term.compare(0, token.size(), token) != 0
+                    : it->term != token)
+                {
+                    break;
+                }
+
+                n += it->ids.size();
+            }
+        }
+
+        best = std::min(best, n);
+    }
+
+    return best;
+}
+
+std::vector<uint32_t> SearchIndex::materialize(const QueryTerm& term) const
+{
+    std::vector<uint32_t> out;
+
+    for (size_t k = 0; k < term.tokens.size(); ++k)
+    {
+        const bool prefix = !term.exact && k + 1 == term.tokens.size();
+        const std::vector<uint32_t> ids = lookup(term.field, term.tokens[k], prefix);
+
+        out = k == 0
+            ? ids
+            : intersect(out, ids);
+
+        if (out.empty())
+        {
+            return out;
+        }
+    }
+
+    // postings only say the words occur, phrases still need adjacency
+    if (term.tokens.size() > 1)
+    {
+        std::erase_if(
+            out,
+            [&](uint32_t id)
+            {
+                return !matches(id, term);
+            }
+        );
+    }
+
+    return out;
+}
+
+bool SearchIndex::matches(uint32_t id, const QueryTerm& term) const
+{
+    const std::string needle = joinTokens(term.tokens);
+
+    if (term.field == SearchField::Any)
+    {
+        return matchText(texts[size_t(SearchField::Artist)][id], needle, term.exact)
+            || matchText(texts[size_t(SearchField::Album)][id], needle, term.exact)
+            || matchText(texts[size_t(SearchField::Title)][id], needle, term.exact);
+    }
+
+    return matchText(texts[size_t(term.field)][id], needle, term.exact);
+}
+
+std::vector<uint32_t> SearchIndex::run(const Query& query) const
+{
+    std::vector<const QueryTerm*> positive;
+    std::vector<const QueryTerm*> negative;
+
+    for (const auto& t : query.terms)
+    {
+        (t.negated ? negative : positive).push_back(&t);
+    }
+
+    std::vector<uint32_t> out;
+
+    if (positive.empty())
+    {
+        out.resize(trackCount());
+
+        for (uint32_t i = 0; i < trackCount(); ++i)
+        {
+            out[i] = i;
+        }
+    }
+    else
+    {
+        std::vector<std::pair<size_t, const QueryTerm*>> plan;
+
+        for (const QueryTerm* t : positive)
+        {
+            plan.emplace_back(estimate(*t), t);
+        }
+
+        // smallest first, so every later step works on the shortest candidate list
+        std::sort(
+            plan.begin(),
+            plan.end(),
+            [](const auto& a, const auto& b)
+            {
+                return a.first < b.first;
+            }
+        );
+
+        out = materialize(*plan.front().second);
+
+        for (size_t k = 1; k < plan.size() && !out.empty(); ++k)
+        {
+            const auto& [cost, term] = plan[k];
+
+            // checking a handful of candidates directly beats merging a long posting list
+            if (out.size() * 16 < cost)
+            {
+                std::erase_if(
+                    out,
+                    [&](uint32_t id)
+                    {
+                        return !matches(id, *term);
+                    }
+                );
+            }
+            else
+            {
+                out = intersect(out, materialize(*term));
+            }
+        }
+    }
+
+    for (const QueryTerm* t : negative)
+    {
+        std::erase_if(
+            out,
+            [&](uint32_t id)
+            {
+                return matches(id, *t);
+            }
+        );
+    }
+
+    return out;
+}
\ No newline at end of file
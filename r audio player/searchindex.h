@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Album;
+
+enum class SearchField
+{
+    Artist,
+    Album,
+    Title,
+    Path,
+    Any // artist, album or title
+};
+
+struct QueryTerm
+{
+    SearchField field = SearchField::Any;
+
+    // folded tokens, matched as adjacent words
+    std::vector<std::string> tokens;
+
+    // quoted terms match whole words only, otherwise the last token is a prefix
+    bool exact = false;
+    bool negated = false;
+};
+
+// artist:bowie album:"low" -live
+struct Query
+{
+    std::vector<QueryTerm> terms;
+
+    bool empty() const { return terms.empty(); }
+
+    static Query parse(std::string_view text);
+};
+
+// per-field inverted index over every track in the library
+// track ids follow the library order, so the tracks of an album are contiguous
+class SearchIndex
+{
+public:
+    void build(const std::vector<Album>& albums);
+
+    // sorted ids of the tracks matching every positive and no negated term
+    std::vector<uint32_t> run(const Query& query) const;
+
+    uint32_t trackCount() const { return uint32_t(trackAlbum.size()); }
+    uint32_t firstTrack(size_t album) const { return albumFirst[album]; }
+    uint32_t albumOf(uint32_t id) const { return trackAlbum[id]; }
+private:
+    static constexpr size_t fieldCount = size_t(SearchField::Any);
+
+    struct Posting
+    {
+        std::string term;
+        std::vector<uint32_t> ids;
+    };
+
+    // sorted by term, ids sorted ascending
+    std::vector<Posting> postings[fieldCount];
+
+    // tokens joined by single spaces, used to verify phrases and to filter small candidate sets
+    std::vector<std::string> texts[fieldCount];
+
+    std::vector<uint32_t> albumFirst;
+    std::vector<uint32_t> trackAlbum;
+
+    size_t estimate(const QueryTerm& term) const;
+    std::vector<uint32_t> lookup(SearchField field, const std::string& token, bool prefix) const;
+    std::vector<uint32_t> materialize(const QueryTerm& term) const;
+    bool matches(uint32_t id, const QueryTerm& term) const;
+};
\ No newline at end of file
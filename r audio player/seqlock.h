@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// one writer publishes a small value, any number of readers copy it without ever blocking the writer
+// a reader that overlaps a write sees an odd or changed sequence and tries again
+// the value is kept in atomic words so the overlapping copy is not a data race
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+public:
+    void store(const T& value)
+    {
+        uint64_t buf[wordCount]{};
+
+        std::memcpy(buf, &value, sizeof(T));
+
+        const uint32_t s = sequence.load(std::memory_order_relaxed);
+
+        sequence.store(s + 1, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < wordCount; ++i)
+        {
+            words[i].store(buf[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        uint64_t buf[wordCount];
+
+        for (;;)
+        {
+            const uint32_t before = sequence.load(std::memory_order_acquire);
+
+            if (before & 1)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < wordCount; ++i)
+            {
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (sequence.load(std::memory_order_relaxed) == before)
+            {
+                break;
+            }
+        }
+
+        T value;
+
+        std::memcpy(&value, buf, sizeof(T));
+
+        return value;
+    }
+private:
+    static constexpr size_t wordCount = (sizeof(T) + 7) / 8;
+
+    std::atomic<uint32_t> sequence{ 0 };
+    std::atomic<uint64_t> words[wordCount]{};
+};
\ No newline at end of file
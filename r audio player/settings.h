@@ -15,6 +15,30 @@ struct Settings
     bool iconButtons = true;
     bool coverNewWindow = true;
     bool trackNumbers = true;
+    bool durations = true;
+    bool meters = true;
+    int sortOrder = 0;
+    double crossfade = 0.0;
+    int fadeCurve = 1;
+    bool skipFade = true;
+    bool scrubPreview = true;
+    int replayGain = 2;
+    int readAhead = 1500;
+    int preloadMode = 1;
+    int positionRate = 25;
+    QString outputBackend;
+    QString outputDevice;
+    int latencyProfile = 1;
+    bool bitPerfect = false;
+    int resampler = 1;
+    bool eqEnabled = false;
+    int eqPreset = 0;
+    QList<double> eqGains = QList<double>(10, 0.0);
+    bool convolution = false;
+    QString convolutionPath;
+    bool limiter = true;
+    bool plugins = false;
+    QString pluginChain;
     QString lastfmUsername;
     QString lastfmSessionKey;
 
@@ -28,6 +52,30 @@ struct Settings
     static constexpr const char* K_ICONBUTTONS = "iconButtons";
     static constexpr const char* K_COVERNEWWINDOW = "coverNewWindow";
     static constexpr const char* K_TRACKNUMBERS = "trackNumbers";
+    static constexpr const char* K_DURATIONS = "durations";
+    static constexpr const char* K_METERS = "meters";
+    static constexpr const char* K_SORTORDER = "sortOrder";
+    static constexpr const char* K_CROSSFADE = "crossfade";
+    static constexpr const char* K_FADECURVE = "fadeCurve";
+    static constexpr const char* K_SKIPFADE = "skipFade";
+    static constexpr const char* K_SCRUBPREVIEW = "scrubPreview";
+    static constexpr const char* K_REPLAYGAIN = "replayGain";
+    static constexpr const char* K_READAHEAD = "readAhead";
+    static constexpr const char* K_PRELOADMODE = "preloadMode";
+    static constexpr const char* K_POSITIONRATE = "positionRate";
+    static constexpr const char* K_OUTPUTBACKEND = "outputBackend";
+    static constexpr const char* K_OUTPUTDEVICE = "outputDevice";
+    static constexpr const char* K_LATENCYPROFILE = "latencyProfile";
+    static constexpr const char* K_BITPERFECT = "bitPerfect";
+    static constexpr const char* K_RESAMPLER = "resampler";
+    static constexpr const char* K_EQENABLED = "eqEnabled";
+    static constexpr const char* K_EQPRESET = "eqPreset";
+    static constexpr const char* K_EQGAINS = "eqGains";
+    static constexpr const char* K_CONVOLUTION = "convolution";
+    static constexpr const char* K_CONVOLUTIONPATH = "convolutionPath";
+    static constexpr const char* K_LIMITER = "limiter";
+    static constexpr const char* K_PLUGINS = "plugins";
+    static constexpr const char* K_PLUGINCHAIN = "pluginChain";
     static constexpr const char* K_LASTFM_USERNAME = "lastfmUsername";
     static constexpr const char* K_LASTFM_SESSIONKEY = "lastfmSessionKey";
 
@@ -49,6 +97,38 @@ struct Settings
         iconButtons = s.value(K_ICONBUTTONS, iconButtons).toBool();
         coverNewWindow = s.value(K_COVERNEWWINDOW, coverNewWindow).toBool();
         trackNumbers = s.value(K_TRACKNUMBERS, trackNumbers).toBool();
+        durations = s.value(K_DURATIONS, durations).toBool();
+        meters = s.value(K_METERS, meters).toBool();
+        sortOrder = s.value(K_SORTORDER, sortOrder).toInt();
+        crossfade = s.value(K_CROSSFADE, crossfade).toDouble();
+        fadeCurve = s.value(K_FADECURVE, fadeCurve).toInt();
+        skipFade = s.value(K_SKIPFADE, skipFade).toBool();
+        scrubPreview = s.value(K_SCRUBPREVIEW, scrubPreview).toBool();
+        replayGain = s.value(K_REPLAYGAIN, replayGain).toInt();
+        readAhead = s.value(K_READAHEAD, readAhead).toInt();
+        preloadMode = s.value(K_PRELOADMODE, preloadMode).toInt();
+        positionRate = s.value(K_POSITIONRATE, positionRate).toInt();
+        outputBackend = s.value(K_OUTPUTBACKEND, outputBackend).toString();
+        outputDevice = s.value(K_OUTPUTDEVICE, outputDevice).toString();
+        latencyProfile = s.value(K_LATENCYPROFILE, latencyProfile).toInt();
+        bitPerfect = s.value(K_BITPERFECT, bitPerfect).toBool();
+        resampler = s.value(K_RESAMPLER, resampler).toInt();
+        eqEnabled = s.value(K_EQENABLED, eqEnabled).toBool();
+        eqPreset = s.value(K_EQPRESET, eqPreset).toInt();
+
+        // a list of the wrong length is from some other layout, the flat curve is kept instead
+        if (const QVariantList gains = s.value(K_EQGAINS).toList(); gains.size() == eqGains.size())
+        {
+            for (int i = 0; i < gains.size(); ++i)
+            {
+                eqGains[i] = gains[i].toDouble();
+            }
+        }
+        convolution = s.value(K_CONVOLUTION, convolution).toBool();
+        convolutionPath = s.value(K_CONVOLUTIONPATH, convolutionPath).toString();
+        limiter = s.value(K_LIMITER, limiter).toBool();
+        plugins = s.value(K_PLUGINS, plugins).toBool();
+        pluginChain = s.value(K_PLUGINCHAIN, pluginChain).toString();
         lastfmUsername = s.value(K_LASTFM_USERNAME, "").toString();
         lastfmSessionKey = s.value(K_LASTFM_SESSIONKEY, "").toString();
     }
@@ -67,6 +147,38 @@ struct Settings
         s.setValue(K_ICONBUTTONS, iconButtons);
         s.setValue(K_COVERNEWWINDOW, coverNewWindow);
         s.setValue(K_TRACKNUMBERS, trackNumbers);
+        s.setValue(K_DURATIONS, durations);
+        s.setValue(K_METERS, meters);
+        s.setValue(K_SORTORDER, sortOrder);
+        s.setValue(K_CROSSFADE, crossfade);
+        s.setValue(K_FADECURVE, fadeCurve);
+        s.setValue(K_SKIPFADE, skipFade);
+        s.setValue(K_SCRUBPREVIEW, scrubPreview);
+        s.setValue(K_REPLAYGAIN, replayGain);
+        s.setValue(K_READAHEAD, readAhead);
+        s.setValue(K_PRELOADMODE, preloadMode);
+        s.setValue(K_POSITIONRATE, positionRate);
+        s.setValue(K_OUTPUTBACKEND, outputBackend);
+        s.setValue(K_OUTPUTDEVICE, outputDevice);
+        s.setValue(K_LATENCYPROFILE, latencyProfile);
+        s.setValue(K_BITPERFECT, bitPerfect);
+        s.setValue(K_RESAMPLER, resampler);
+        s.setValue(K_EQENABLED, eqEnabled);
+        s.setValue(K_EQPRESET, eqPreset);
+
+        QVariantList gains;
+
+        for (double g : eqGains)
+        {
+            gains << g;
+        }
+
+        s.setValue(K_EQGAINS, gains);
+        s.setValue(K_CONVOLUTION, convolution);
+        s.setValue(K_CONVOLUTIONPATH, convolutionPath);
+        s.setValue(K_LIMITER, limiter);
+        s.setValue(K_PLUGINS, plugins);
+        s.setValue(K_PLUGINCHAIN, pluginChain);
         s.setValue(K_LASTFM_USERNAME, lastfmUsername);
         s.setValue(K_LASTFM_SESSIONKEY, lastfmSessionKey);
     }
@@ -1,5 +1,6 @@
 #include "settingsdialog.h"
 #include "settings.h"
+#include "audioplayer.h"
 #include "folderdialog.h"
 
 #include <QCursor>
@@ -8,11 +9,15 @@
 #include <QListWidget>
 #include <QPushButton>
 #include <QSpinBox>
+#include <QDoubleSpinBox>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QSlider>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QDialogButtonBox>
+#include <QSignalBlocker>
 
 #include <QNetworkAccessManager>
 #include <QCryptographicHash>
@@ -23,6 +28,9 @@
 #include <QJsonObject>
 #include <QMessageBox>
 
+#include <algorithm>
+#include <cmath>
+
 int SettingsDialog::selectedCoverSize() const
 {
     return coverSizeSpin->value();
@@ -33,6 +41,16 @@ QString SettingsDialog::selectedBackgroundImagePath() const
     return backgroundImageEdit->text().trimmed();
 }
 
+QString SettingsDialog::selectedConvolutionPath() const
+{
+    return convolutionEdit->text().trimmed();
+}
+
+QString SettingsDialog::selectedPluginChain() const
+{
+    return pluginsEdit->text().trimmed();
+}
+
 bool SettingsDialog::selectedFillBackground() const
 {
     return fillBackgroundCheck->isChecked();
@@ -53,6 +71,138 @@ bool SettingsDialog::selectedTrackNumbers() const
     return trackNumbersCheck->isChecked();
 }
 
+bool SettingsDialog::selectedDurations() const
+{
+    return durationsCheck->isChecked();
+}
+
+bool SettingsDialog::selectedMeters() const
+{
+    return metersCheck->isChecked();
+}
+
+bool SettingsDialog::selectedSkipFade() const
+{
+    return skipFadeCheck->isChecked();
+}
+
+bool SettingsDialog::selectedScrubPreview() const
+{
+    return scrubPreviewCheck->isChecked();
+}
+
+bool SettingsDialog::selectedBitPerfect() const
+{
+    return bitPerfectCheck->isChecked();
+}
+
+bool SettingsDialog::selectedEqEnabled() const
+{
+    return eqCheck->isChecked();
+}
+
+bool SettingsDialog::selectedConvolution() const
+{
+    return convolutionCheck->isChecked();
+}
+
+bool SettingsDialog::selectedLimiter() const
+{
+    return limiterCheck->isChecked();
+}
+
+bool SettingsDialog::selectedPlugins() const
+{
+    return pluginsCheck->isChecked();
+}
+
+double SettingsDialog::selectedCrossfade() const
+{
+    return crossfadeSpin->value();
+}
+
+int SettingsDialog::selectedFadeCurve() const
+{
+    return fadeCurveBox->currentIndex();
+}
+
+int SettingsDialog::selectedReplayGain() const
+{
+    return replayGainBox->currentIndex();
+}
+
+int SettingsDialog::selectedReadAhead() const
+{
+    return readAheadSpin->value();
+}
+
+int SettingsDialog::selectedPreloadMode() const
+{
+    return preloadBox->currentIndex();
+}
+
+int SettingsDialog::selectedPositionRate() const
+{
+    return positionRateSpin->value();
+}
+
+int SettingsDialog::selectedLatencyProfile() const
+{
+    return latencyBox->currentIndex();
+}
+
+int SettingsDialog::selectedResampler() const
+{
+    return resamplerBox->currentIndex();
+}
+
+int SettingsDialog::selectedEqPreset() const
+{
+    return eqPresetBox->currentIndex();
+}
+
+QList<double> SettingsDialog::selectedEqGains() const
+{
+    QList<double> gains;
+
+    for (const QSlider* slider : eqSliders)
+    {
+        gains << slider->value();
+    }
+
+    return gains;
+}
+
+QString SettingsDialog::selectedOutputBackend() const
+{
+    return backendBox->currentData().toString();
+}
+
+QString SettingsDialog::selectedOutputDevice() const
+{
+    return deviceBox->currentData().toString();
+}
+
+void SettingsDialog::listDevices(const QString& selected)
+{
+    deviceBox->clear();
+    deviceBox->addItem("default device", QString());
+
+    for (const QString& name : AudioPlayer::outputDevices(selectedOutputBackend()))
+    {
+        deviceBox->addItem(name, name);
+    }
+
+    // a saved device that isn't plugged in right now stays selected
+    if (!selected.isEmpty()
+        && deviceBox->findData(selected) < 0)
+    {
+        deviceBox->addItem(selected + " (not found)", selected);
+    }
+
+    deviceBox->setCurrentIndex(std::max(0, deviceBox->findData(selected)));
+}
+
 SettingsDialog::SettingsDialog(
     const QStringList& musicFolders,
     bool /* autoplay */,
@@ -63,6 +213,31 @@ SettingsDialog::SettingsDialog(
     bool iconButtons,
     bool coverNewWindow,
     bool trackNumbers,
+    bool durations,
+    bool meters,
+    double crossfade,
+    int fadeCurve,
+    bool skipFade,
+    bool scrubPreview,
+    int replayGain,
+    int readAhead,
+    int preloadMode,
+    int positionRate,
+    const QString& outputBackend,
+    const QString& outputDevice,
+    int latencyProfile,
+    bool bitPerfect,
+    int resampler,
+    bool eqEnabled,
+    int eqPreset,
+    const QList<double>& eqGains,
+    bool convolution,
+    const QString& convolutionPath,
+    bool limiter,
+    bool plugins,
+    const QString& pluginChain,
+    const QString& pluginInfo,
+    const QString& outputInfo,
     const QString& lastfmUsername,
     const QString& lastfmSessionKey,
     QWidget* parent)
@@ -179,6 +354,209 @@ SettingsDialog::SettingsDialog(
     trackNumbersCheck = new QCheckBox("track number", this);
     trackNumbersCheck->setChecked(trackNumbers);
 
+    durationsCheck = new QCheckBox("durations", this);
+    durationsCheck->setChecked(durations);
+
+    metersCheck = new QCheckBox("meters", this);
+    metersCheck->setChecked(meters);
+
+    crossfadeSpin = new QDoubleSpinBox(this);
+    crossfadeSpin->setRange(0.0, 12.0);
+    crossfadeSpin->setSingleStep(0.5);
+    crossfadeSpin->setDecimals(1);
+    crossfadeSpin->setPrefix("crossfade (0-12): ");
+    crossfadeSpin->setSuffix(" s");
+    crossfadeSpin->setMinimumWidth(crossfadeSpin->fontMetrics().horizontalAdvance("crossfade (0-12): 12.0 s"));
+    crossfadeSpin->setValue(crossfade);
+
+    fadeCurveBox = new QComboBox(this);
+    fadeCurveBox->addItems({ "linear", "equal power" });
+    fadeCurveBox->setCurrentIndex(fadeCurve);
+
+    skipFadeCheck = new QCheckBox("fade on skip", this);
+    skipFadeCheck->setChecked(skipFade);
+
+    scrubPreviewCheck = new QCheckBox("preview while scrubbing", this);
+    scrubPreviewCheck->setChecked(scrubPreview);
+
+    replayGainBox = new QComboBox(this);
+    replayGainBox->addItems({ "no replaygain", "track gain", "album gain" });
+    replayGainBox->setCurrentIndex(replayGain);
+
+    readAheadSpin = new QSpinBox(this);
+    readAheadSpin->setRange(100, 10000);
+    readAheadSpin->setSingleStep(100);
+    readAheadSpin->setPrefix("read-ahead (100-10000): ");
+    readAheadSpin->setSuffix(" ms");
+    readAheadSpin->setMinimumWidth(readAheadSpin->fontMetrics().horizontalAdvance("read-ahead (100-10000): 10000 ms"));
+    readAheadSpin->setValue(readAhead);
+
+    preloadBox = new QComboBox(this);
+    preloadBox->addItems({ "stream from disk", "preload from removable drives", "always preload" });
+    preloadBox->setCurrentIndex(preloadMode);
+
+    positionRateSpin = new QSpinBox(this);
+    positionRateSpin->setRange(1, 60);
+    positionRateSpin->setPrefix("position updates (1-60): ");
+    positionRateSpin->setSuffix(" hz");
+    positionRateSpin->setMinimumWidth(positionRateSpin->fontMetrics().horizontalAdvance("position updates (1-60): 60 hz"));
+    positionRateSpin->setValue(positionRate);
+
+    backendBox = new QComboBox(this);
+    backendBox->addItem("automatic backend", QString());
+
+    for (const QString& name : AudioPlayer::outputBackends())
+    {
+        backendBox->addItem(name, name);
+    }
+
+    backendBox->setCurrentIndex(std::max(0, backendBox->findData(outputBackend)));
+
+    deviceBox = new QComboBox(this);
+
+    listDevices(outputDevice);
+
+    connect(
+        backendBox,
+        &QComboBox::currentIndexChanged,
+        this,
+        [this]()
+        {
+            listDevices(QString());
+        }
+    );
+
+    latencyBox = new QComboBox(this);
+    latencyBox->addItems({ "low latency", "standard latency", "long buffer" });
+    latencyBox->setCurrentIndex(latencyProfile);
+
+    bitPerfectCheck = new QCheckBox("bit-perfect", this);
+    bitPerfectCheck->setChecked(bitPerfect);
+
+    limiterCheck = new QCheckBox("true peak limiter", this);
+    limiterCheck->setChecked(limiter);
+
+    resamplerBox = new QComboBox(this);
+    resamplerBox->addItems({ "linear resampling", "sinc resampling", "best resampling" });
+    resamplerBox->setCurrentIndex(resampler);
+
+    eqCheck = new QCheckBox("equalizer", this);
+    eqCheck->setChecked(eqEnabled);
+
+    // the presets, then custom for anything moved by hand
+    eqPresetBox = new QComboBox(this);
+
+    for (const EqPreset& preset : eqPresets())
+    {
+        eqPresetBox->addItem(preset.name);
+    }
+
+    eqPresetBox->addItem("custom");
+    eqPresetBox->setCurrentIndex(std::clamp(eqPreset, 0, eqPresetBox->count() - 1));
+
+    auto eqBandsLayout = new QHBoxLayout;
+
+    for (size_t i = 0; i < eqBands; ++i)
+    {
+        auto slider = new QSlider(Qt::Vertical, this);
+        slider->setRange(-12, 12);
+        slider->setFixedHeight(72);
+        slider->setValue(i < size_t(eqGains.size())
+            ? int(std::lround(eqGains[int(i)]))
+            : 0);
+
+        const float hz = eqFrequency(i);
+
+        auto label = new QLabel(
+            hz >= 1000.0f
+                ? QString("%1k").arg(hz / 1000.0f)
+                : QString::number(hz),
+            this
+        );
+
+        auto column = new QVBoxLayout;
+        column->addWidget(slider, 0, Qt::AlignHCenter);
+        column->addWidget(label, 0, Qt::AlignHCenter);
+
+        eqBandsLayout->addLayout(column);
+        eqSliders << slider;
+
+        connect(
+            slider,
+            &QSlider::valueChanged,
+            this,
+            [this]()
+            {
+                QSignalBlocker block(eqPresetBox);
+
+                eqPresetBox->setCurrentIndex(eqPresetBox->count() - 1);
+
+                Q_EMIT equalizerChanged();
+            }
+        );
+    }
+
+    connect(
+        eqPresetBox,
+        &QComboBox::currentIndexChanged,
+        this,
+        [this](int index)
+        {
+            const std::vector<EqPreset>& presets = eqPresets();
+
+            if (index < 0
+                || size_t(index) >= presets.size())
+            {
+                return;
+            }
+
+            for (size_t i = 0; i < eqBands; ++i)
+            {
+                QSignalBlocker block(eqSliders[int(i)]);
+
+                eqSliders[int(i)]->setValue(int(presets[index].gains[i]));
+            }
+
+            Q_EMIT equalizerChanged();
+        }
+    );
+
+    connect(
+        eqCheck,
+        &QCheckBox::toggled,
+        this,
+        &SettingsDialog::equalizerChanged
+    );
+
+    convolutionCheck = new QCheckBox("convolution", this);
+    convolutionCheck->setChecked(convolution);
+
+    convolutionEdit = new QLineEdit(this);
+    convolutionEdit->setMinimumWidth(convolutionEdit->fontMetrics().horizontalAdvance("impulse response (e.g. headphones.wav)"));
+    convolutionEdit->setPlaceholderText("impulse response (e.g. headphones.wav)");
+    convolutionEdit->setText(convolutionPath);
+
+    pluginsCheck = new QCheckBox("lv2 plugins", this);
+    pluginsCheck->setChecked(plugins);
+
+    pluginsEdit = new QLineEdit(this);
+    pluginsEdit->setMinimumWidth(pluginsEdit->fontMetrics().horizontalAdvance("plugin uri symbol=value; next plugin uri ..."));
+    pluginsEdit->setPlaceholderText("plugin uri symbol=value; next plugin uri ...");
+    pluginsEdit->setText(pluginChain);
+
+    auto pluginInfoLabel = new QLabel(pluginInfo, this);
+    pluginInfoLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    pluginInfoLabel->setVisible(!pluginInfo.isEmpty());
+
+    auto outputInfoLabel = new QLabel(
+        outputInfo.isEmpty()
+            ? QString("no output open")
+            : outputInfo,
+        this
+    );
+
+    outputInfoLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
     auto formatLayout = new QHBoxLayout;
     //formatLayout->addStretch();
     formatLayout->addWidget(coverSizeSpin);
@@ -195,8 +573,49 @@ SettingsDialog::SettingsDialog(
     controlsLayout->addWidget(iconButtonsCheck);
     controlsLayout->addWidget(coverNewWindowCheck);
     controlsLayout->addWidget(trackNumbersCheck);
+    controlsLayout->addWidget(durationsCheck);
+    controlsLayout->addWidget(metersCheck);
     //controlsLayout->addStretch();
 
+    auto playbackLayout = new QHBoxLayout;
+    playbackLayout->addWidget(crossfadeSpin);
+    playbackLayout->addWidget(fadeCurveBox);
+    playbackLayout->addWidget(skipFadeCheck);
+    playbackLayout->addWidget(scrubPreviewCheck);
+    playbackLayout->addWidget(replayGainBox);
+    playbackLayout->addStretch();
+
+    auto readingLayout = new QHBoxLayout;
+    readingLayout->addWidget(readAheadSpin);
+    readingLayout->addWidget(preloadBox);
+    readingLayout->addWidget(positionRateSpin);
+    readingLayout->addStretch();
+
+    auto eqLayout = new QHBoxLayout;
+    eqLayout->addWidget(eqCheck);
+    eqLayout->addWidget(eqPresetBox);
+    eqLayout->addLayout(eqBandsLayout);
+    eqLayout->addStretch();
+
+    auto convolutionLayout = new QHBoxLayout;
+    convolutionLayout->addWidget(convolutionCheck);
+    convolutionLayout->addWidget(convolutionEdit);
+    convolutionLayout->addStretch();
+
+    auto pluginsLayout = new QHBoxLayout;
+    pluginsLayout->addWidget(pluginsCheck);
+    pluginsLayout->addWidget(pluginsEdit);
+    pluginsLayout->addStretch();
+
+    auto outputLayout = new QHBoxLayout;
+    outputLayout->addWidget(backendBox);
+    outputLayout->addWidget(deviceBox);
+    outputLayout->addWidget(latencyBox);
+    outputLayout->addWidget(bitPerfectCheck);
+    outputLayout->addWidget(limiterCheck);
+    outputLayout->addWidget(resamplerBox);
+    outputLayout->addStretch();
+
     auto credentialsLayout = new QVBoxLayout;
     lastfmUsernameEdit = new QLineEdit(this);
     lastfmUsernameEdit->setPlaceholderText("username");
@@ -401,6 +820,20 @@ SettingsDialog::SettingsDialog(
     layout->addWidget(new QLabel("controls:", this));
     layout->addLayout(controlsLayout);
     layout->addSpacing(6);
+    layout->addWidget(new QLabel("playback:", this));
+    layout->addLayout(playbackLayout);
+    layout->addLayout(readingLayout);
+    layout->addSpacing(6);
+    layout->addWidget(new QLabel("equalizer, convolution and plugins:", this));
+    layout->addLayout(eqLayout);
+    layout->addLayout(convolutionLayout);
+    layout->addLayout(pluginsLayout);
+    layout->addWidget(pluginInfoLabel);
+    layout->addSpacing(6);
+    layout->addWidget(new QLabel("output:", this));
+    layout->addLayout(outputLayout);
+    layout->addWidget(outputInfoLabel);
+    layout->addSpacing(6);
     layout->addLayout(credentialsLayout);
     layout->addStretch();
     layout->addWidget(buttons);
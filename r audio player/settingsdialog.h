@@ -7,7 +7,10 @@
 class QListWidget;
 class QPushButton;
 class QSpinBox;
+class QDoubleSpinBox;
 class QCheckBox;
+class QComboBox;
+class QSlider;
 
 class SettingsDialog : public QDialog
 {
@@ -23,6 +26,31 @@ public:
         bool iconButtons,
         bool coverNewWindow,
         bool trackNumbers,
+        bool durations,
+        bool meters,
+        double crossfade,
+        int fadeCurve,
+        bool skipFade,
+        bool scrubPreview,
+        int replayGain,
+        int readAhead,
+        int preloadMode,
+        int positionRate,
+        const QString& outputBackend,
+        const QString& outputDevice,
+        int latencyProfile,
+        bool bitPerfect,
+        int resampler,
+        bool eqEnabled,
+        int eqPreset,
+        const QList<double>& eqGains,
+        bool convolution,
+        const QString& convolutionPath,
+        bool limiter,
+        bool plugins,
+        const QString& pluginChain,
+        const QString& pluginInfo,
+        const QString& outputInfo,
         const QString& lastfmUsername,
         const QString& lastfmSessionKey,
         QWidget* parent = nullptr
@@ -34,11 +62,40 @@ public:
     int selectedCoverSize() const;
 
     QString selectedBackgroundImagePath() const;
+    QString selectedConvolutionPath() const;
+    QString selectedPluginChain() const;
 
     bool selectedFillBackground() const;
     bool selectedIconButtons() const;
     bool selectedCoverNewWindow() const;
     bool selectedTrackNumbers() const;
+    bool selectedDurations() const;
+    bool selectedMeters() const;
+    bool selectedSkipFade() const;
+    bool selectedScrubPreview() const;
+    bool selectedBitPerfect() const;
+    bool selectedEqEnabled() const;
+    bool selectedConvolution() const;
+    bool selectedLimiter() const;
+    bool selectedPlugins() const;
+
+    double selectedCrossfade() const;
+
+    int selectedFadeCurve() const;
+    int selectedReplayGain() const;
+    int selectedReadAhead() const;
+    int selectedPreloadMode() const;
+    int selectedPositionRate() const;
+    int selectedLatencyProfile() const;
+    int selectedResampler() const;
+    int selectedEqPreset() const;
+
+    // db, one per band
+    QList<double> selectedEqGains() const;
+
+    // empty for the automatic choice
+    QString selectedOutputBackend() const;
+    QString selectedOutputDevice() const;
 
     QStringList selectedFolders() const;
     QStringList selectedTrackFormat() const;
@@ -48,11 +105,17 @@ Q_SIGNALS:
     // safe to ignore
     void lastfmLoggedOut();
     void rescanRequested();
+
+    // any eq control moved, for hearing it before saving
+    void equalizerChanged();
 private Q_SLOTS:
     void addFolder();
     void removeSelectedFolder();
 private:
     QString lastfmSessionKey;
+
+    void listDevices(const QString& selected);
+
     QListWidget* foldersList = nullptr;
     QPushButton* addButton = nullptr;
     QPushButton* removeButton = nullptr;
@@ -67,6 +130,29 @@ private:
     QCheckBox* iconButtonsCheck = nullptr;
     QCheckBox* coverNewWindowCheck = nullptr;
     QCheckBox* trackNumbersCheck = nullptr;
+    QCheckBox* durationsCheck = nullptr;
+    QCheckBox* metersCheck = nullptr;
+    QDoubleSpinBox* crossfadeSpin = nullptr;
+    QComboBox* fadeCurveBox = nullptr;
+    QCheckBox* skipFadeCheck = nullptr;
+    QCheckBox* scrubPreviewCheck = nullptr;
+    QComboBox* replayGainBox = nullptr;
+    QSpinBox* readAheadSpin = nullptr;
+    QComboBox* preloadBox = nullptr;
+    QSpinBox* positionRateSpin = nullptr;
+    QComboBox* backendBox = nullptr;
+    QComboBox* deviceBox = nullptr;
+    QComboBox* latencyBox = nullptr;
+    QCheckBox* bitPerfectCheck = nullptr;
+    QCheckBox* limiterCheck = nullptr;
+    QComboBox* resamplerBox = nullptr;
+    QCheckBox* eqCheck = nullptr;
+    QComboBox* eqPresetBox = nullptr;
+    QList<QSlider*> eqSliders;
+    QCheckBox* convolutionCheck = nullptr;
+    QLineEdit* convolutionEdit = nullptr;
+    QCheckBox* pluginsCheck = nullptr;
+    QLineEdit* pluginsEdit = nullptr;
     QLineEdit* lastfmUsernameEdit = nullptr;
     QLineEdit* lastfmPasswordEdit = nullptr;
 };
\ No newline at end of file
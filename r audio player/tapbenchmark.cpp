@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tapnode.h"
+
+namespace
+{
+    constexpr ma_uint32 channels = 2;
+
+    // an odd device period, so calls never line up with the ring
+    constexpr size_t callFrames = 441;
+
+    // of audio pushed, per rate
+    constexpr double timedSeconds = 20.0;
+
+    const ma_uint32 rates[] =
+    {
+        44100,
+        96000,
+        192000
+    };
+
+    std::vector<float> noise(size_t frames)
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+
+        std::vector<float> x(frames * channels);
+
+        for (float& v : x)
+        {
+            v = sample(rng);
+        }
+
+        return x;
+    }
+
+    // what a meter reads back after the ring has wrapped a few times is what went in
+    bool checkRing()
+    {
+        TapNode tap;
+
+        tap.prepare(channels, 48000, 0);
+
+        const size_t frames = TapNode::ringSamples * 3;
+        const std::vector<float> x = noise(frames);
+
+        for (size_t i = 0; i < frames; i += callFrames)
+        {
+            tap.push(x.data() + i * channels, std::min(callFrames, frames - i));
+        }
+
+        const TapNode::Format f = tap.format();
+        const uint64_t end = tap.written();
+        const size_t count = 4096;
+
+        std::vector<float> out(count * channels);
+
+        if (!tap.read(f, end, count, out.data())
+            || !std::equal(out.begin(), out.end(), x.end() - out.size()))
+        {
+            return false;
+        }
+
+        // long gone
+        return !tap.read(f, end - frames / 2, count, out.data());
+    }
+
+    // ms of cpu per second of audio
+    double timeRate(ma_uint32 rate)
+    {
+        using clock = std::chrono::steady_clock;
+
+        TapNode tap;
+
+        tap.prepare(channels, rate, 0);
+
+        const std::vector<float> x = noise(callFrames);
+        const size_t calls = size_t(timedSeconds * rate) / callFrames;
+
+        const auto start = clock::now();
+
+        for (size_t i = 0; i < calls; ++i)
+        {
+            tap.push(x.data(), callFrames);
+        }
+
+        const double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        return ms * double(rate) / (double(calls * callFrames) * 1000.0) * 1000.0;
+    }
+}
+
+int runTapBenchmark()
+{
+    std::printf("analysis tap, %u channels, %zu frames a call\n\n", channels, callFrames);
+
+    const bool ok = checkRing();
+
+    std::printf(
+        "read back after wrapping: %s\n\n",
+        ok
+            ? "match"
+            : "mismatch"
+    );
+
+    std::printf("%-8s %10s %10s\n", "rate", "ms/s", "realtime");
+
+    for (const ma_uint32 rate : rates)
+    {
+        const double ms = timeRate(rate);
+
+        std::printf("%-8u %10.4f %9.0fx\n", rate, ms, 1000.0 / ms);
+    }
+
+    std::fflush(stdout);
+
+    return ok
+        ? 0
+        : 1;
+}
\ No newline at end of file
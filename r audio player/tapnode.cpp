@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "tapnode.h"
+
+TapNode::TapNode()
+    : ring(std::make_unique<std::atomic<float>[]>(ringSamples))
+{
+}
+
+TapNode::~TapNode()
+{
+    uninit();
+}
+
+bool TapNode::init(ma_engine* engine, ma_uint64 latency)
+{
+    if (baseInit)
+    {
+        return true;
+    }
+
+    prepare(
+        ma_engine_get_channels(engine),
+        ma_engine_get_sample_rate(engine),
+        latency
+    );
+
+    return attach(engine, ma_engine_get_endpoint(engine));
+}
+
+void TapNode::prepare(ma_uint32 count, ma_uint32 sampleRate, ma_uint64 latency)
+{
+    channels = count;
+
+    // nothing runs the node, the writer is this thread
+    Format f;
+
+    f.channels = channels;
+    f.sampleRate = sampleRate;
+    f.start = head.load(std::memory_order_relaxed);
+    f.latency = latency;
+
+    origin = 0;
+
+    published.store(f);
+}
+
+void TapNode::push(const float* frames, size_t count)
+{
+    const size_t samples = count * channels;
+
+    size_t at = size_t(origin) & mask;
+
+    // at most two contiguous runs, so the loops carry no wrap check
+    for (size_t done = 0; done < samples;)
+    {
+        const size_t n = std::min(samples - done, ringSamples - at);
+
+        std::atomic<float>* r = ring.get() + at;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            r[i].store(frames[done + i], std::memory_order_relaxed);
+        }
+
+        done += n;
+        at = 0;
+    }
+
+    origin += samples;
+
+    head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+bool TapNode::read(const Format& f, uint64_t end, size_t count, float* out) const
+{
+    const uint64_t h = head.load(std::memory_order_acquire);
+
+    // the frames a ring of samples holds in this format
+    const uint64_t held = f.channels == 0
+        ? 0
+        : ringSamples / f.channels;
+
+    if (count > held
+        || end > h
+        || end < f.start + count
+        || h - (end - count) > held)
+    {
+        return false;
+    }
+
+    const size_t samples = count * f.channels;
+
+    size_t at = size_t((end - count - f.start) * f.channels) & mask;
+
+    for (size_t done = 0; done < samples;)
+    {
+        const size_t n = std::min(samples - done, ringSamples - at);
+
+        const std::atomic<float>* r = ring.get() + at;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[done + i] = r[i].load(std::memory_order_relaxed);
+        }
+
+        done += n;
+        at = 0;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // the writer may have come round over the oldest frames, or the device reopened, while copying
+    return head.load(std::memory_order_relaxed) - (end - count) <= held
+        && published.load().start == f.start;
+}
\ No newline at end of file
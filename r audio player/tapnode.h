@@ -0,0 +1,76 @@
+#pragma once
+
+#include "graphnode.h"
+#include "miniaudio.h"
+#include "seqlock.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// the last node before the endpoint, copies what goes to the device into a ring for the meters
+// the audio thread only stores samples and moves a counter on, it never waits and never allocates
+// a reader copies the stretch it wants and checks the counter again, a copy the writer lapped is thrown away
+// the direct path skips the graph and pushes its frames in itself
+class TapNode : public GraphNode<TapNode>
+{
+public:
+    // samples whatever the channels, so the ring is allocated once and never moves under a reader
+    static constexpr size_t ringSamples = size_t(1) << 19;
+
+    struct Format
+    {
+        ma_uint32 channels = 0;
+        ma_uint32 sampleRate = 0;
+
+        // the first frame written in this format, the ones before belong to an earlier device
+        uint64_t start = 0;
+
+        // frames between the tap and the speakers, the device's buffer
+        uint64_t latency = 0;
+    };
+
+    TapNode();
+    ~TapNode();
+
+    TapNode(const TapNode&) = delete;
+    TapNode& operator=(const TapNode&) = delete;
+
+    bool init(ma_engine* engine, ma_uint64 latency);
+
+    // for running it without a graph: a new format starting at the current position, then push
+    void prepare(ma_uint32 channels, ma_uint32 sampleRate, ma_uint64 latency);
+
+    // audio thread, interleaved frames of the engine's channels
+    void push(const float* frames, size_t count);
+
+    // any thread
+    Format format() const { return published.load(); }
+
+    // frames written so far, the one at the speakers is about latency behind
+    uint64_t written() const { return head.load(std::memory_order_acquire); }
+
+    // copies the frames of the given format in [end - count, end), false when they aren't all in the ring (any more)
+    bool read(const Format& f, uint64_t end, size_t count, float* out) const;
+private:
+    static constexpr size_t mask = ringSamples - 1;
+
+    // atomic so a read overlapping a write is not a data race, relaxed stores cost what plain ones do
+    std::unique_ptr<std::atomic<float>[]> ring;
+
+    std::atomic<uint64_t> head{ 0 };
+
+    SeqLock<Format> published;
+
+    // audio thread, the sample the format's first frame went to
+    uint64_t origin = 0;
+
+    // audio thread, what the graph passes through goes in like the direct path's frames
+    void process(float* frames, size_t count) { push(frames, count); }
+
+    friend class GraphNode<TapNode>;
+};
+
+// what the tap costs the audio thread per second of audio, printed as a table
+int runTapBenchmark();
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "casefold.h"
+#include "library.h"
+#include "termdictionary.h"
+
+namespace
+{
+    inline bool isWordChar(char c)
+    {
+        return static_cast<unsigned char>(c) >= 0x80
+            || (c >= 'a' && c <= 'z')
+            || (c >= '0' && c <= '9');
+    }
+
+    struct Pending
+    {
+        std::string text;
+        uint32_t weight = 0;
+    };
+
+    void add(std::unordered_map<std::string, Pending>& m, const std::string& text, uint32_t weight)
+    {
+        const std::string key = foldKey(text);
+
+        if (key.empty())
+        {
+            return;
+        }
+
+        Pending& p = m[key];
+
+        if (p.text.empty())
+        {
+            p.text = text;
+        }
+
+        p.weight += weight;
+    }
+}
+
+uint32_t TermDictionary::Table::best(uint32_t l, uint32_t r) const
+{
+    const uint32_t n = uint32_t(entries.size());
+
+    uint32_t out = l;
+
+    for (l += n, r += n; l < r; l /= 2, r /= 2)
+    {
+        if (l & 1)
+        {
+            if (weight(tree[l]) > weight(out))
+            {
+                out = tree[l];
+            }
+
+            ++l;
+        }
+
+        if (r & 1)
+        {
+            --r;
+
+            if (weight(tree[r]) > weight(out))
+            {
+                out = tree[r];
+            }
+        }
+    }
+
+    return out;
+}
+
+void TermDictionary::Table::finish()
+{
+    std::sort(
+        entries.begin(),
+        entries.end(),
+        [this](const Entry& a, const Entry& b)
+        {
+            return key(a) < key(b);
+        }
+    );
+
+    const size_t n = entries.size();
+
+    tree.assign(2 * n, 0);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        tree[n + i] = uint32_t(i);
+    }
+
+    for (size_t i = n; i-- > 1;)
+    {
+        const uint32_t a = tree[2 * i];
+        const uint32_t b = tree[2 * i + 1];
+
+        tree[i] = weight(b) > weight(a)
+            ? b
+            : a;
+    }
+}
+
+void TermDictionary::build(const std::vector<Album>& albums)
+{
+    std::unordered_map<std::string, Pending> pending[2];
+
+    for (const auto& album : albums)
+    {
+        if (album.variousArtists)
+        {
+            for (const auto& t : album.tracks)
+            {
+                add(pending[0], t.artists.front(), 1);
+            }
+        }
+        else
+        {
+            add(pending[0], album.artists.front(), uint32_t(album.tracks.size()));
+        }
+
+        add(pending[1], album.title, uint32_t(album.tracks.size()));
+    }
+
+    for (int k = 0; k < 2; ++k)
+    {
+        Table& t = tables[k];
+
+        t.kind = k == 0
+            ? Artist
+            : AlbumTitle;
+
+        t.names.clear();
+        t.pool.clear();
+        t.entries.clear();
+
+        for (auto& [key, p] : pending[k])
+        {
+            const uint32_t name = uint32_t(t.names.size());
+
+            t.names.push_back({ std::move(p.text), p.weight });
+
+            const uint32_t base = uint32_t(t.pool.size());
+
+            t.pool += key;
+
+            for (size_t i = 0; i < key.size(); ++i)
+            {
+                if (isWordChar(key[i])
+                    && (i == 0 || !isWordChar(key[i - 1])))
+                {
+                    t.entries.push_back({ base + uint32_t(i), uint32_t(key.size() - i), name });
+                }
+            }
+        }
+
+        t.finish();
+    }
+}
+
+std::vector<TermDictionary::Suggestion> TermDictionary::complete(std::string_view prefix, size_t k, uint8_t kinds) const
+{
+    const std::string p = foldKey(prefix);
+
+    if (p.empty()
+        || k == 0)
+    {
+        return {};
+    }
+
+    struct Range
+    {
+        uint32_t weight;
+        uint32_t table;
+        uint32_t l;
+        uint32_t r;
+        uint32_t at;
+
+        bool operator<(const Range& o) const { return weight < o.weight; }
+    };
+
+    std::priority_queue<Range> heap;
+
+    for (uint32_t ti = 0; ti < 2; ++ti)
+    {
+        const Table& t = tables[ti];
+
+        if (!(kinds & t.kind)
+            || t.entries.empty())
+        {
+            continue;
+        }
+
+        const auto lo = std::lower_bound(
+            t.entries.begin(),
+            t.entries.end(),
+            p,
+            [&t](const Entry& e, const std::string& v)
+            {
+                return t.key(e) < v;
+            }
+        );
+
+        const auto hi = std::upper_bound(
+            lo,
+            t.entries.end(),
+            p,
+            [&t](const std::string& v, const Entry& e)
+            {
+                return t.key(e).substr(0, v.size()) > v;
+            }
+        );
+
+        if (lo == hi)
+        {
+            continue;
+        }
+
+        const uint32_t l = uint32_t(lo - t.entries.begin());
+        const uint32_t r = uint32_t(hi - t.entries.begin());
+        const uint32_t at = t.best(l, r);
+
+        heap.push({ t.weight(at), ti, l, r, at });
+    }
+
+    std::vector<Suggestion> out;
+    std::unordered_set<uint64_t> seen;
+
+    // a name may own several keys in range, so keep splitting until k distinct names
+    while (!heap.empty()
+        && out.size() < k)
+    {
+        const Range top = heap.top();
+
+        heap.pop();
+
+        const Table& t = tables[top.table];
+        const uint32_t name = t.entries[top.at].name;
+
+        if (seen.insert((uint64_t(top.table) << 32) | name).second)
+        {
+            out.push_back({ t.names[name].text, t.kind, t.names[name].weight });
+        }
+
+        if (top.l < top.at)
+        {
+            const uint32_t at = t.best(top.l, top.at);
+
+            heap.push({ t.weight(at), top.table, top.l, top.at, at });
+        }
+
+        if (top.at + 1 < top.r)
+        {
+            const uint32_t at = t.best(top.at + 1, top.r);
+
+            heap.push({ t.weight(at), top.table, top.at + 1, top.r, at });
+        }
+    }
+
+    return out;
+}
\ No newline at end of file
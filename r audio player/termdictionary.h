@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Album;
+
+// sorted dictionary of artist and album names for search completion
+// every word start of a name is a key, so "bow" finds "David Bowie"
+class TermDictionary
+{
+public:
+    enum Kind : uint8_t
+    {
+        Artist = 1,
+        AlbumTitle = 2
+    };
+
+    struct Suggestion
+    {
+        std::string text;
+        Kind kind;
+        uint32_t weight;
+    };
+
+    void build(const std::vector<Album>& albums);
+
+    // at most k distinct names whose keys start with the folded prefix, most popular first
+    std::vector<Suggestion> complete(std::string_view prefix, size_t k, uint8_t kinds = Artist | AlbumTitle) const;
+private:
+    struct Name
+    {
+        std::string text;
+        uint32_t weight;
+    };
+
+    struct Entry
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t name;
+    };
+
+    struct Table
+    {
+        Kind kind;
+
+        std::vector<Name> names;
+
+        // keys live back to back in one buffer
+        std::string pool;
+        std::vector<Entry> entries;
+
+        // iterative max segment tree over entry weights, leaves at entries.size()
+        std::vector<uint32_t> tree;
+
+        std::string_view key(const Entry& e) const { return std::string_view(pool).substr(e.offset, e.length); }
+        uint32_t weight(uint32_t i) const { return names[entries[i].name].weight; }
+        uint32_t best(uint32_t l, uint32_t r) const;
+
+        void finish();
+    };
+
+    Table tables[2];
+};
\ No newline at end of file
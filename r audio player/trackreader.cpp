@@ -0,0 +1,72 @@
+#include <algorithm>
+
+#include "trackreader.h"
+#include "tracksource.h"
+
+TrackReader::TrackReader()
+{
+    thread = std::thread(
+        [this]
+        {
+            run();
+        }
+    );
+}
+
+TrackReader::~TrackReader()
+{
+    quit.store(true, std::memory_order_release);
+
+    wake();
+
+    thread.join();
+}
+
+void TrackReader::add(TrackSource* track)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        tracks.push_back(track);
+    }
+
+    wake();
+}
+
+void TrackReader::remove(TrackSource* track)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::erase(tracks, track);
+}
+
+void TrackReader::wake()
+{
+    wakeup.notify();
+}
+
+void TrackReader::run()
+{
+    while (!quit.load(std::memory_order_acquire))
+    {
+        bool busy = false;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            // tracks are served in the order they were opened, the playing one before the queued one
+            for (TrackSource* t : tracks)
+            {
+                busy |= t->fill();
+            }
+        }
+
+        if (busy)
+        {
+            continue;
+        }
+
+        // rings are full, sleep until a consumer drains one or a track comes or goes
+        wakeup.wait();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "wakeup.h"
+
+class TrackSource;
+
+// one thread that keeps every open track's ring topped up,
+// so disk and decoder stalls stay away from the audio callback
+class TrackReader
+{
+public:
+    TrackReader();
+    ~TrackReader();
+
+    TrackReader(const TrackReader&) = delete;
+    TrackReader& operator=(const TrackReader&) = delete;
+
+    void add(TrackSource* track);
+
+    // returns once the reader is no longer touching the track
+    void remove(TrackSource* track);
+
+    // safe from the audio thread, never blocks
+    void wake();
+private:
+    std::mutex lock;
+    std::vector<TrackSource*> tracks;
+
+    Wakeup wakeup;
+
+    std::atomic<bool> quit{ false };
+
+    std::thread thread;
+
+    void run();
+};
\ No newline at end of file
@@ -0,0 +1,444 @@
+#include <fstream>
+
+#include "dspkernels.h"
+#include "mp3stream.h"
+#include "trackreader.h"
+#include "tracksource.h"
+
+namespace
+{
+    // frames decoded per pass, keeps the reader moving between tracks
+    constexpr size_t fillChunk = 4096;
+
+    // anything bigger streams from disk anyway
+    constexpr std::uintmax_t maxPreloadBytes = 512ull * 1024 * 1024;
+
+    bool readWholeFile(const std::filesystem::path& path, std::vector<char>& out)
+    {
+        std::error_code ec;
+
+        const std::uintmax_t size = std::filesystem::file_size(path, ec);
+
+        if (ec
+            || size == 0
+            || size > maxPreloadBytes)
+        {
+            return false;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+
+        if (!in)
+        {
+            return false;
+        }
+
+        out.resize(size_t(size));
+
+        return bool(in.read(out.data(), std::streamsize(size)));
+    }
+
+    bool isMp3(const std::filesystem::path& path)
+    {
+        const auto ext = path.extension().native();
+
+        return ext.size() == 4
+            && ext[0] == '.'
+            && (ext[1] == 'm' || ext[1] == 'M')
+            && (ext[2] == 'p' || ext[2] == 'P')
+            && ext[3] == '3';
+    }
+
+    // what the file decodes to before any conversion, from memory when it was preloaded
+    // unknown asks every backend for its native format, no converter is set up
+    bool nativeFormat(const std::filesystem::path& path, const std::vector<char>& file, ma_format& format, ma_uint32& channels, ma_uint32& sampleRate)
+    {
+        ma_decoder_config config = ma_decoder_config_init(
+            ma_format_unknown,
+            0,
+            0
+        );
+
+        ma_decoder decoder;
+
+        ma_result result = MA_ERROR;
+
+        if (!file.empty())
+        {
+            result = ma_decoder_init_memory(
+                file.data(),
+                file.size(),
+                &config,
+                &decoder
+            );
+        }
+        else
+        {
+#ifdef _WIN32
+            result = ma_decoder_init_file_w(
+                path.c_str(),
+                &config,
+                &decoder
+            );
+#else
+            result = ma_decoder_init_file(
+                path.c_str(),
+                &config,
+                &decoder
+            );
+#endif
+        }
+
+        if (result != MA_SUCCESS)
+        {
+            return false;
+        }
+
+        result = ma_decoder_get_data_format(
+            &decoder,
+            &format,
+            &channels,
+            &sampleRate,
+            nullptr,
+            0
+        );
+
+        ma_decoder_uninit(&decoder);
+
+        return result == MA_SUCCESS
+            && channels != 0
+            && sampleRate != 0;
+    }
+}
+
+TrackSource::~TrackSource()
+{
+    if (reader)
+    {
+        reader->remove(this);
+    }
+
+    if (decoderInit)
+    {
+        ma_decoder_uninit(&decoder);
+    }
+}
+
+TrackSource* TrackSource::open(const std::filesystem::path& path, const Options& options, TrackReader& reader)
+{
+    ma_decoder_config config = ma_decoder_config_init(
+        ma_format_f32,
+        options.channels,
+        options.sampleRate
+    );
+
+    configureResampler(config.resampling, options.resampler);
+
+    ma_decoding_backend_vtable* backends[] = { Mp3Stream::backend() };
+
+    // only offered for mp3 files, dr_mp3 is happy to find frame syncs in anything else
+    if (isMp3(path))
+    {
+        config.ppCustomBackendVTables = backends;
+        config.customBackendCount = 1;
+        config.pCustomBackendUserData = const_cast<std::filesystem::path*>(&path);
+    }
+
+    auto* t = new TrackSource();
+
+    ma_result result = MA_ERROR;
+
+    if (options.preload
+        && readWholeFile(path, t->file))
+    {
+        result = ma_decoder_init_memory(
+            t->file.data(),
+            t->file.size(),
+            &config,
+            &t->decoder
+        );
+    }
+    else
+    {
+        t->file.clear();
+
+#ifdef _WIN32
+        result = ma_decoder_init_file_w(
+            path.c_str(),
+            &config,
+            &t->decoder
+        );
+#else
+        result = ma_decoder_init_file(
+            path.c_str(),
+            &config,
+            &t->decoder
+        );
+#endif
+    }
+
+    if (result != MA_SUCCESS)
+    {
+        delete t;
+
+        return nullptr;
+    }
+
+    t->decoderInit = true;
+    t->channels = options.channels;
+
+    t->mp3 = Mp3Stream::of(t->decoder);
+
+    if (t->mp3)
+    {
+        t->mp3->expect(options.lengthMs);
+    }
+
+    // some formats only know their length after a scan, do it once here rather than per query
+    t->frames.store(t->queryLength(), std::memory_order_relaxed);
+
+    // long mp3s get a seek table, built once and kept for the next time the file is opened
+    if (t->mp3)
+    {
+        t->mp3->index();
+    }
+
+    // f32 holds 16 and 24 bit samples exactly, 32 bit ones lose their low bits
+    // the wav and flac backends decode to the f32 asked for themselves, so the converter's input
+    // says f32 for a 32 bit file too and the file's own format has to be asked for separately
+    const ma_data_converter& converter = t->decoder.converter;
+
+    if (converter.channelsIn == converter.channelsOut
+        && converter.sampleRateIn == converter.sampleRateOut)
+    {
+        ma_format native = ma_format_unknown;
+        ma_uint32 nativeChannels = 0;
+        ma_uint32 nativeRate = 0;
+
+        // mp3 only ever decodes to floats, and its backend isn't offered to the native decoder
+        t->exact = t->mp3 != nullptr
+            || (nativeFormat(path, t->file, native, nativeChannels, nativeRate)
+                && native != ma_format_s32);
+    }
+
+    t->ring.init(
+        size_t(options.readAheadFrames),
+        options.channels
+    );
+
+    // a first chunk up front, so playback starts without waiting on the reader
+    t->fill();
+
+    t->reader = &reader;
+
+    reader.add(t);
+
+    return t;
+}
+
+bool TrackSource::probe(const std::filesystem::path& path, ma_format& format, ma_uint32& channels, ma_uint32& sampleRate)
+{
+    return nativeFormat(path, {}, format, channels, sampleRate);
+}
+
+ma_uint64 TrackSource::queryLength()
+{
+    ma_uint64 length = 0;
+
+    ma_decoder_get_length_in_pcm_frames(
+        &decoder,
+        &length
+    );
+
+    return length;
+}
+
+bool TrackSource::fill()
+{
+    if (mp3
+        && mp3->poll())
+    {
+        frames.store(queryLength(), std::memory_order_relaxed);
+    }
+
+    const uint32_t request = seekRequest.load(std::memory_order_acquire);
+
+    if (request != seekHandled)
+    {
+        seekHandled = request;
+
+        ma_decoder_seek_to_pcm_frame(
+            &decoder,
+            seekTarget.load(std::memory_order_relaxed)
+        );
+
+        exhausted = false;
+        tail = 0;
+
+        decoded.store(false, std::memory_order_relaxed);
+        seekStart.store(ring.writePosition(), std::memory_order_relaxed);
+        seekDone.store(request, std::memory_order_release);
+    }
+
+    if (decoded.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    size_t space = 0;
+
+    float* span = ring.writeSpan(space);
+
+    space = std::min(space, fillChunk);
+
+    if (space == 0)
+    {
+        return false;
+    }
+
+    ma_uint64 n = 0;
+
+    if (!exhausted)
+    {
+        const ma_result result = ma_decoder_read_pcm_frames(
+            &decoder,
+            span,
+            space,
+            &n
+        );
+
+        if (n < space
+            || result != MA_SUCCESS)
+        {
+            exhausted = true;
+
+            // a read error ends the track where it is
+            tail = decoder.converter.hasResampler
+                && (result == MA_SUCCESS || result == MA_AT_END)
+                ? resamplerTail(decoder.converter.resampler)
+                : 0;
+        }
+    }
+
+    if (exhausted)
+    {
+        n += flushTail(span + n * channels, space - n);
+    }
+
+    ring.commit(size_t(n));
+
+    if (exhausted
+        && tail == 0)
+    {
+        decoded.store(true, std::memory_order_release);
+    }
+
+    return true;
+}
+
+ma_uint64 TrackSource::flushTail(float* out, ma_uint64 room)
+{
+    if (tail == 0
+        || room == 0)
+    {
+        return 0;
+    }
+
+    const ma_data_converter& converter = decoder.converter;
+
+    // silence in whatever the converter takes in, which isn't zero bytes for u8
+    std::vector<char> silence(size_t(tail) * ma_get_bytes_per_frame(converter.formatIn, converter.channelsIn));
+
+    ma_silence_pcm_frames(
+        silence.data(),
+        tail,
+        converter.formatIn,
+        converter.channelsIn
+    );
+
+    ma_uint64 in = tail;
+    ma_uint64 made = room;
+
+    ma_data_converter_process_pcm_frames(
+        &decoder.converter,
+        silence.data(),
+        &in,
+        out,
+        &made
+    );
+
+    // nothing went in, nothing will, so the end isn't held up
+    tail = in == 0 && made == 0
+        ? 0
+        : tail - in;
+
+    return made;
+}
+
+ma_uint64 TrackSource::read(float* out, ma_uint64 count)
+{
+    if (seekWaiting)
+    {
+        if (seekDone.load(std::memory_order_acquire) != seekRequest.load(std::memory_order_relaxed))
+        {
+            // the reader has not repositioned yet, hold with silence
+            std::fill(out, out + count * channels, 0.0f);
+
+            return count;
+        }
+
+        ring.skipTo(seekStart.load(std::memory_order_relaxed));
+
+        seekWaiting = false;
+    }
+
+    // read the flag first, anything decoded before it was set is already in the ring
+    const bool ended = decoded.load(std::memory_order_acquire);
+
+    const ma_uint64 n = ring.read(out, size_t(count));
+
+    position.store(position.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+
+    const float g = gain.load(std::memory_order_relaxed);
+
+    if (g != 1.0f)
+    {
+        dspKernels().gain(out, size_t(n * channels), g);
+    }
+
+    if (ring.readable() < ring.capacity() / 2)
+    {
+        reader->wake();
+    }
+
+    if (n == count
+        || ended)
+    {
+        return n;
+    }
+
+    // an underrun, not the end of the track
+    std::fill(out + n * channels, out + count * channels, 0.0f);
+
+    return count;
+}
+
+ma_result TrackSource::seek(ma_uint64 frame)
+{
+    if (length() != 0
+        && frame > length())
+    {
+        return MA_INVALID_ARGS;
+    }
+
+    seekTarget.store(frame, std::memory_order_relaxed);
+    seekRequest.fetch_add(1, std::memory_order_release);
+
+    seekWaiting = true;
+
+    position.store(frame, std::memory_order_relaxed);
+
+    reader->wake();
+
+    return MA_SUCCESS;
+}
\ No newline at end of file
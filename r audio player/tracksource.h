@@ -0,0 +1,117 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "pcmring.h"
+#include "resampler.h"
+
+#include <atomic>
+#include <filesystem>
+#include <vector>
+
+class Mp3Stream;
+class TrackReader;
+
+// one open track, decoded straight into the engine's format
+// every track in a chain shares that format, so they can be spliced sample for sample
+// decoding runs ahead on the reader thread, the audio thread only copies out of the ring
+class TrackSource
+{
+public:
+    struct Options
+    {
+        ma_uint32 channels = 2;
+        ma_uint32 sampleRate = 48000;
+
+        // ring depth
+        ma_uint64 readAheadFrames = 48000;
+
+        // read the whole file into memory first, so the drive can stall or spin down
+        bool preload = false;
+
+        // used when the file's rate differs from sampleRate
+        ResamplerQuality resampler = ResamplerQuality::Sinc;
+
+        // what the library's scan found, 0 when unknown, spares a long mp3 a frame walk before it plays
+        unsigned int lengthMs = 0;
+    };
+
+    ~TrackSource();
+
+    static TrackSource* open(const std::filesystem::path& path, const Options& options, TrackReader& reader);
+
+    // the file's own sample format, channels and rate, read from its header
+    static bool probe(const std::filesystem::path& path, ma_format& format, ma_uint32& channels, ma_uint32& sampleRate);
+
+    // audio thread
+    // fewer frames than asked for means the track has ended, a slow disk reads as silence instead
+    ma_uint64 read(float* out, ma_uint64 frames);
+    ma_result seek(ma_uint64 frame);
+
+    ma_uint64 cursor() const { return position.load(std::memory_order_relaxed); }
+    ma_uint64 length() const { return frames.load(std::memory_order_relaxed); }
+
+    // linear, applied as frames leave the ring so a change is heard right away
+    void setGain(float g) { gain.store(g, std::memory_order_relaxed); }
+
+    // no resampling, channel mixing or gain, and every sample survives the trip through f32
+    bool unaltered() const { return exact && gain.load(std::memory_order_relaxed) == 1.0f; }
+
+    // reader thread, true while there was something to do
+    bool fill();
+
+    // link for the deck's retired list
+    TrackSource* retiredNext = nullptr;
+private:
+    TrackSource() = default;
+
+    TrackReader* reader = nullptr;
+
+    bool decoderInit{};
+
+    ma_decoder decoder{};
+
+    // set when the mp3 backend opened the file
+    Mp3Stream* mp3 = nullptr;
+
+    // backing store for a preloaded file
+    std::vector<char> file;
+
+    ma_uint32 channels = 0;
+
+    // set by the reader again when a seek table brings an mp3's exact length
+    std::atomic<ma_uint64> frames{ 0 };
+
+    bool exact{};
+
+    PcmRing ring;
+
+    // advanced by the audio thread as frames leave the ring
+    std::atomic<ma_uint64> position{ 0 };
+
+    std::atomic<float> gain{ 1.0f };
+
+    // the audio thread asks for a seek by bumping seekRequest,
+    // the reader answers with seekDone and the ring position where the new data starts
+    std::atomic<ma_uint64> seekTarget{ 0 };
+    std::atomic<uint32_t> seekRequest{ 0 };
+    std::atomic<uint32_t> seekDone{ 0 };
+    std::atomic<uint64_t> seekStart{ 0 };
+
+    // reader thread only
+    uint32_t seekHandled = 0;
+
+    // reader thread only, set once the decoder has run dry, the resampler still holds its last half window
+    // and tail frames of silence pushed in after the track bring it out before the end is reported
+    bool exhausted{};
+    ma_uint64 tail = 0;
+
+    ma_uint64 flushTail(float* out, ma_uint64 room);
+
+    ma_uint64 queryLength();
+
+    // audio thread only
+    bool seekWaiting = false;
+
+    // set by the reader once the decoder is exhausted
+    std::atomic<bool> decoded{ false };
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <semaphore>
+
+// wakes one sleeping worker thread
+// notify never blocks, so the audio thread may call it
+class Wakeup
+{
+public:
+    void notify()
+    {
+        // one pending release is enough, the worker drains everything when it wakes
+        if (!pending.exchange(true, std::memory_order_acq_rel))
+        {
+            signal.release();
+        }
+    }
+
+    void wait()
+    {
+        signal.acquire();
+
+        pending.store(false, std::memory_order_release);
+    }
+
+    // true when woken, false on timeout
+    template <typename Rep, typename Period>
+    bool wait(std::chrono::duration<Rep, Period> timeout)
+    {
+        const bool woken = signal.try_acquire_for(timeout);
+
+        pending.store(false, std::memory_order_release);
+
+        return woken;
+    }
+private:
+    std::counting_semaphore<> signal{ 0 };
+    std::atomic<bool> pending{ false };
+};
\ No newline at end of file